@@ -0,0 +1,82 @@
+// DashboardPage.h
+
+// gzip compressed dashboard page served at HTTP /, kept in flash,
+// generated from web/dashboard.html with: gzip -9 -n -c web/dashboard.html | xxd -i
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+
+static const uint8_t dashboardPage[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x8d, 0x55,
+  0x6d, 0x6f, 0xdb, 0x36, 0x10, 0xfe, 0x1e, 0x20, 0xff, 0x81, 0x55, 0xd1,
+  0x41, 0xc6, 0x22, 0xa9, 0x0a, 0xda, 0x25, 0x96, 0x25, 0x17, 0xad, 0x1b,
+  0x0c, 0x1d, 0xda, 0x26, 0x80, 0x83, 0x15, 0xc3, 0x30, 0x04, 0xb4, 0x78,
+  0x92, 0x09, 0xf3, 0x45, 0xa0, 0x28, 0xbb, 0xae, 0x91, 0xff, 0xbe, 0xa3,
+  0x5e, 0x12, 0x27, 0xf3, 0x8c, 0x7e, 0x11, 0xc9, 0xbb, 0xe7, 0x79, 0xc8,
+  0x3b, 0x1e, 0x4f, 0xe9, 0x8b, 0x8f, 0xd7, 0xb3, 0xdb, 0xbf, 0x6e, 0xae,
+  0xc8, 0xd2, 0x4a, 0x31, 0x3d, 0x3d, 0x49, 0xdd, 0x48, 0x04, 0x55, 0x65,
+  0xe6, 0x81, 0xf2, 0x5a, 0x0b, 0x50, 0xe6, 0x46, 0x09, 0x96, 0x92, 0x7c,
+  0x49, 0x4d, 0x0d, 0x36, 0xf3, 0x1a, 0x5b, 0x04, 0x97, 0xde, 0x83, 0x5d,
+  0x51, 0x09, 0x99, 0xb7, 0xe6, 0xb0, 0xa9, 0xb4, 0xb1, 0x1e, 0xc9, 0xb5,
+  0xb2, 0xa0, 0x10, 0xb7, 0xe1, 0xcc, 0x2e, 0x33, 0x06, 0x6b, 0x9e, 0x43,
+  0xd0, 0x2e, 0xce, 0xb8, 0xe2, 0x96, 0x53, 0x11, 0xd4, 0x39, 0x15, 0x90,
+  0xc5, 0xad, 0x88, 0xe5, 0x56, 0xc0, 0x74, 0xae, 0x05, 0x35, 0xe4, 0x8b,
+  0x46, 0x80, 0x36, 0x69, 0xd4, 0x19, 0xd1, 0x5b, 0xdb, 0x6d, 0x3b, 0x59,
+  0x68, 0xb6, 0xdd, 0x49, 0x6a, 0x4a, 0xae, 0x92, 0xd7, 0x93, 0x02, 0xf7,
+  0x08, 0x0a, 0x2a, 0xb9, 0xd8, 0x26, 0x35, 0x55, 0x75, 0x50, 0x83, 0xe1,
+  0xc5, 0x64, 0x41, 0xf3, 0x55, 0x69, 0x74, 0xa3, 0x58, 0xf2, 0x32, 0x8e,
+  0xe3, 0x49, 0xae, 0x85, 0x36, 0xc9, 0x4b, 0x00, 0xb8, 0x3f, 0x3d, 0x59,
+  0xc6, 0x03, 0x3f, 0x06, 0xd9, 0x29, 0xd4, 0xfc, 0x07, 0x24, 0x71, 0xf8,
+  0xb0, 0xde, 0x00, 0x2f, 0x97, 0x36, 0x51, 0xda, 0x48, 0x2a, 0x06, 0x76,
+  0x31, 0x7e, 0x8d, 0x6c, 0x49, 0xb9, 0xda, 0x31, 0x5e, 0x57, 0x82, 0x6e,
+  0x93, 0xd2, 0x70, 0x36, 0x71, 0x9f, 0xc0, 0x82, 0x44, 0x8b, 0x85, 0x00,
+  0xc1, 0x8d, 0x54, 0x75, 0x62, 0xa0, 0x02, 0x6a, 0x7d, 0xda, 0x58, 0x1d,
+  0x14, 0xdc, 0x9e, 0x49, 0xae, 0x24, 0xfd, 0xee, 0x8f, 0x41, 0x9e, 0xc5,
+  0x85, 0x19, 0x8d, 0x26, 0x25, 0xad, 0x92, 0xf0, 0x37, 0xdc, 0x71, 0x08,
+  0x86, 0xe0, 0xf6, 0xb8, 0x01, 0xe3, 0xeb, 0x5d, 0x45, 0x19, 0xe3, 0xaa,
+  0x4c, 0xc2, 0x4b, 0xf4, 0x2f, 0xb4, 0x61, 0x60, 0x02, 0x43, 0x19, 0x6f,
+  0xea, 0x24, 0x7c, 0xe3, 0x4c, 0x7b, 0xf1, 0x9d, 0x9f, 0x9f, 0x23, 0xab,
+  0xae, 0xe8, 0xe3, 0xb1, 0x16, 0x42, 0xe7, 0xab, 0xbd, 0xc8, 0x5a, 0x99,
+  0x3e, 0x8a, 0xf1, 0x78, 0x8c, 0xf0, 0xc5, 0x6e, 0x3f, 0xee, 0xcb, 0xe3,
+  0x71, 0xd3, 0xb7, 0xc8, 0x28, 0xb4, 0xb6, 0x60, 0x0e, 0x67, 0x6e, 0x5f,
+  0xff, 0xe2, 0xe2, 0x02, 0xd1, 0x69, 0x34, 0xdc, 0x57, 0x1a, 0x0d, 0xc5,
+  0xe3, 0x6e, 0xae, 0x2d, 0xa6, 0xf8, 0xf9, 0x25, 0xa3, 0xc5, 0x15, 0x11,
+  0x66, 0xd6, 0x8d, 0x98, 0x80, 0x69, 0xea, 0xe2, 0xe9, 0x61, 0x95, 0xde,
+  0x00, 0x82, 0x5a, 0x4b, 0xba, 0x20, 0x9c, 0x65, 0xde, 0xcd, 0xdd, 0xcd,
+  0x9f, 0xde, 0x34, 0x48, 0xa3, 0xc5, 0x94, 0x7c, 0x4b, 0x23, 0xc7, 0x78,
+  0x42, 0xfc, 0x40, 0x2d, 0x1e, 0x76, 0x7b, 0x98, 0xfa, 0x7e, 0xb5, 0x6a,
+  0x8e, 0x91, 0x7f, 0xc7, 0xfb, 0x3c, 0xcc, 0x74, 0x9e, 0x63, 0xcc, 0xcf,
+  0x9a, 0xfe, 0x0f, 0xd3, 0x79, 0x7e, 0xe6, 0xc0, 0xee, 0x6d, 0x95, 0xf0,
+  0x94, 0x3d, 0xbf, 0x9e, 0x0d, 0xd4, 0x57, 0x07, 0xa8, 0xef, 0xb1, 0xc2,
+  0x94, 0x96, 0xdb, 0xa7, 0x24, 0x03, 0xe2, 0x6e, 0xf0, 0x1c, 0x63, 0xcf,
+  0x41, 0x14, 0xee, 0xa5, 0xd6, 0x8d, 0xac, 0x2c, 0xd7, 0xea, 0xbf, 0x2a,
+  0x0e, 0x31, 0x7b, 0x04, 0x1c, 0x13, 0xbb, 0x52, 0xb9, 0xd0, 0x75, 0x63,
+  0x9e, 0x05, 0x70, 0x7b, 0xf7, 0xe0, 0x18, 0xd8, 0xbf, 0x30, 0x28, 0x27,
+  0xb3, 0x07, 0x89, 0x68, 0xb8, 0xfb, 0xae, 0xca, 0x5a, 0x56, 0x6d, 0xa9,
+  0x6d, 0x6a, 0x6f, 0x8a, 0x87, 0x53, 0x90, 0x5b, 0x7c, 0x0e, 0x69, 0xd4,
+  0xb9, 0xdb, 0x76, 0x90, 0x1b, 0x5e, 0x59, 0x9c, 0xad, 0xb1, 0x42, 0x3a,
+  0x28, 0xc9, 0x08, 0xd3, 0x79, 0x23, 0xb1, 0xe7, 0x84, 0x25, 0xd8, 0x2b,
+  0x01, 0x6e, 0xfa, 0x61, 0xfb, 0x89, 0xf9, 0x83, 0xd8, 0x68, 0xd2, 0x11,
+  0x60, 0x8d, 0x1e, 0x47, 0x50, 0xb0, 0x21, 0x57, 0x6e, 0x31, 0xd7, 0x8d,
+  0xc9, 0xc1, 0xf7, 0xa2, 0xce, 0xd5, 0x22, 0xbb, 0x69, 0xa8, 0x95, 0x84,
+  0xba, 0xa6, 0x25, 0x20, 0xbe, 0x68, 0x54, 0xee, 0xb2, 0x40, 0xfc, 0xde,
+  0x36, 0x22, 0xbb, 0xd3, 0x13, 0x42, 0x9c, 0xe8, 0x9a, 0x8a, 0x06, 0x9c,
+  0xe8, 0x1f, 0xf3, 0xeb, 0xaf, 0x61, 0xe5, 0x9a, 0xe4, 0x80, 0x0a, 0x19,
+  0xb5, 0xd4, 0x49, 0x12, 0x52, 0x68, 0x43, 0x7c, 0x07, 0x5f, 0xc1, 0x96,
+  0x70, 0xd5, 0xb3, 0x7a, 0x99, 0x4e, 0x08, 0xba, 0x93, 0x1f, 0x89, 0x07,
+  0xb9, 0x9d, 0x1a, 0x21, 0xbc, 0x20, 0x7e, 0x4f, 0x18, 0x0d, 0xcc, 0xd0,
+  0xc2, 0x77, 0x3b, 0xeb, 0xda, 0x2f, 0xaa, 0xf8, 0xdd, 0x1e, 0x7f, 0x23,
+  0xeb, 0x1f, 0x92, 0x65, 0x18, 0x75, 0x23, 0xc4, 0x88, 0xbc, 0x23, 0x5e,
+  0xe0, 0x91, 0x84, 0x7c, 0xa1, 0x76, 0x19, 0xb6, 0xcd, 0x64, 0x1f, 0xd8,
+  0xe9, 0xdf, 0xbb, 0x4f, 0x97, 0xbc, 0x67, 0xa2, 0x5e, 0x53, 0x61, 0x50,
+  0xc0, 0x88, 0x47, 0x7e, 0x6d, 0xd3, 0xf8, 0x11, 0x57, 0xfe, 0x28, 0xb4,
+  0xfa, 0xb3, 0x76, 0x4d, 0xfd, 0x96, 0x4b, 0x98, 0x5b, 0x83, 0xd7, 0xe6,
+  0x3b, 0xa9, 0xfb, 0xfd, 0x7c, 0x82, 0x31, 0x98, 0x85, 0xfd, 0x6c, 0xf6,
+  0xf1, 0x1f, 0xde, 0xc9, 0xc0, 0x63, 0x0d, 0x78, 0xbd, 0x16, 0x56, 0xd8,
+  0x50, 0x01, 0x58, 0x50, 0x7d, 0x67, 0x89, 0xfa, 0x3f, 0xd8, 0xbf, 0x58,
+  0x15, 0xec, 0xdc, 0xd3, 0x06, 0x00, 0x00
+};
@@ -11,6 +11,29 @@
 // SET TO 1 TO USE TRACES
 #define DEBUG 0
 
+// SET TO 1 TO DECODE THE BITS SHIFTED TO THE DISPLAYS AND PRINT THE VISIBLE CONTENT
+// AFTER EACH STORE COMMIT
+#define VIRTUAL_DISPLAY 0
+
+// SET TO 1 TO REPLACE THE LIGHT SENSOR BY A SIMULATED ONE SWEEPING BETWEEN DARK AND BRIGHT
+#define SIMULATED_LIGHT_SENSOR 0
+
+// LEVEL OF THE DEFERRED LOGGER, MESSAGES ABOVE IT ARE REMOVED AT COMPILE TIME
+// 0 NONE, 1 ERROR, 2 WARNING, 3 INFO, 4 VERBOSE
+#define LOG_LEVEL (DEBUG ? 4 : 0)
+
+// MODULES OF THE DEFERRED LOGGER, MESSAGES OF OTHER MODULES ARE REMOVED AT COMPILE TIME
+// 0x01 MAIN, 0x02 CONTROLLER, 0x04 NETWORK, 0x08 INVERTER, 0x10 DISPLAY, 0x20 SENSORS, 0x40 INPUT, 0x80 SCHEDULER
+#define LOG_MODULES 0xFF
+
+// SET TO 1 TO RECORD LATENCY HISTOGRAMS FROM THE INVERTER REQUEST TO THE LATCHED TUBES,
+// PRINTED ON SERIAL AND SERVED AT HTTP /metrics
+#define PROFILING 0
+
+// SET TO 1 TO STOP WITH A BACKTRACE ON HEAP ALLOCATIONS AFTER THE INITIALIZATION,
+// THE STEADY STATE ALLOCATES NOTHING
+#define HEAP_GUARD DEBUG
+
 #if DEBUG
 #define D_Begin(...) Serial.begin(__VA_ARGS__);
 #define D_print(...) Serial.print(__VA_ARGS__)
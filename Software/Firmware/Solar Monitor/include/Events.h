@@ -0,0 +1,26 @@
+// Events.h
+
+// events waking up the main loop
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <limits.h>
+
+// returned as time to the next deadline if there is nothing to wait for
+#define NO_DEADLINE ULONG_MAX
+
+enum class controller_event : uint8_t
+{
+  pir,
+  button,
+  gps,
+  network,
+  config
+};
+
+// callback used to post an event
+typedef void (*EVENT_CALLBACK)(void *arg, controller_event event);
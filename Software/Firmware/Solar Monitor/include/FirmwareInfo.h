@@ -9,6 +9,6 @@
 
 //- VERSION
 #define MAJOR_VERSION 0
-#define MINOR_VERSION 1
-#define REVISION 5
+#define MINOR_VERSION 2
+#define REVISION 0
 #define FW_STATUS "beta"
\ No newline at end of file
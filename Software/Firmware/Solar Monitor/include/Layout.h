@@ -0,0 +1,71 @@
+// Layout.h
+
+// layout of the display chain
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Display.hpp>
+#include <Backlight.hpp>
+
+// value range of a rating step
+typedef struct
+{
+  double min;
+  double max;
+} RATING_RANGE;
+
+// layout of a display board
+typedef struct
+{
+  display_type displayType;
+  value_type valueType;
+  RATING_RANGE ratings[RATING_COUNT]; // poor, fair, good, excellent, defaults of the runtime configuration
+  uint8_t minLED;                     // first backlight LED, counted on the board
+  uint8_t maxLED;                     // last backlight LED, counted on the board
+  bool overallStatus;                 // board has the overall status tube (IN-15A on the right)
+  uint8_t overallLED;                 // LED of the overall status tube, counted on the board
+  bool flowEffect;                    // backlight shows the power flow as animated chase
+} DISPLAY_LAYOUT;
+
+// one entry per display board, the first entry is the board most far away from the controller,
+// boards can be added or removed here, the LED numbers are counted from the first LED of each board
+static const DISPLAY_LAYOUT displayLayout[] = {
+    // solar power display
+    {display_type::solar_power, value_type::watts,
+     {{0, 250}, {251, 1500}, {1501, 5000}, {5001, 999999}},
+     0, 5, false, 0, false},
+
+    // battery power display, charging and discharging shown as animated chase
+    {display_type::battery_power, value_type::watts,
+     {{1501, 999999}, {0, 1500}, {-3001, 1}, {-999999, -3000}},
+     0, 5, false, 0, true},
+
+    // grid power display
+    {display_type::grid_power, value_type::watts,
+     {{1501, 999999}, {0, 1500}, {-3001, 1}, {-999999, -3000}},
+     0, 5, false, 0, false},
+
+    // load power display
+    {display_type::load_power, value_type::watts,
+     {{-999999, -1501}, {-1500, -501}, {-500, -251}, {-250, 0}},
+     0, 5, false, 0, false},
+
+    // battery charge display, has also the overall status tube
+    {display_type::battery_charge, value_type::battery_charge,
+     {{0, 10}, {11, 50}, {51, 90}, {91, 100}},
+     0, 3, true, 5, false},
+
+    // further boards, e.g.
+    // {display_type::autonomy, value_type::percent,
+    //  {{0, 25}, {26, 50}, {51, 90}, {91, 100}},
+    //  0, 5, false, 0, false},
+    // {display_type::self_consumption, value_type::percent,
+    //  {{0, 25}, {26, 50}, {51, 90}, {91, 100}},
+    //  0, 5, false, 0, false},
+};
+
+// number of display boards
+#define DISPLAY_COUNT ((int)(sizeof(displayLayout) / sizeof(displayLayout[0])))
@@ -1,32 +1,137 @@
 // Settings.h
 
-// adjustable settings
+// adjustable settings, the settings marked with [config] are the defaults of the runtime
+// configuration, they are changed without reflashing at HTTP /config and stored in NVS
 
 // Copyright (C) 2024 highvoltglow
 // Licensed under the MIT License
 
 #pragma once
 
-// HV shutdown delay
+// HV shutdown delay [config]
 #define PIR_DELAY 5 // in minutes, 0 disables PIR
 
-// cathode poisoning
+// tube brightness, dimmed using PWM on the blank line
+#define TUBE_BRIGHTNESS 100 // in percent
+#define TUBE_FADE_TIME 1000 // in ms, used when turning the tubes on and off
+
+// ambient light sensor (BH1750 on I2C), the tubes and LEDs are dimmed in dark rooms, 0 disables
+#define AMBIENT_DIMMING 1
+#define AMBIENT_READ_INTERVAL 1000 // in ms
+#define AMBIENT_FILTER 0.2         // weight of a new reading, 0..1
+#define AMBIENT_DARK_LUX 1         // minimum brightness at and below
+#define AMBIENT_BRIGHT_LUX 300     // full brightness at and above
+#define AMBIENT_MIN_BRIGHTNESS 20  // in percent
+#define AMBIENT_HYSTERESIS 5       // in percent, smaller brightness changes are ignored
+#define AMBIENT_FADE_TIME 2000     // in ms
+
+// enclosure temperature (DS18B20 on PIN_TEMP), above the limits tubes and LEDs are dimmed
+// and the inverter is polled less often, 0 disables
+#define THERMAL_MONITORING 1
+#define THERMAL_READ_INTERVAL 10     // in seconds
+#define THERMAL_WARM 45              // in degrees celsius
+#define THERMAL_HOT 55               // in degrees celsius
+#define THERMAL_HYSTERESIS 3         // in degrees celsius
+#define THERMAL_WARM_BRIGHTNESS 70   // in percent
+#define THERMAL_HOT_BRIGHTNESS 40    // in percent
+#define THERMAL_HOT_POLLING_FACTOR 3 // polling interval multiplier when hot
+
+// GPS module on PIN_GPSRX, sets the clock, 0 disables
+#define GPS_CLOCK 1
+#define GPS_BAUDRATE 9600
+#define GPS_SENTENCE_DELAY 0 // in ms, delay of the sentences after the second they refer to
+#define GPS_SYNC_TIMEOUT 24  // in hours, the clock is considered unsynchronized without GPS time
+
+// POSIX time zone of the local time, e.g. "UTC0" or "CET-1CEST,M3.5.0,M10.5.0/3"
+#define TIMEZONE "CET-1CEST,M3.5.0,M10.5.0/3"
+
+// tubes and LEDs are dimmed during the night, needs the GPS clock, 0 disables
+#define NIGHT_DIMMING 1
+#define NIGHT_START 22      // hour
+#define NIGHT_END 6         // hour
+#define NIGHT_BRIGHTNESS 30 // in percent
+
+// the main loop sleeps until the next event or deadline, with the tubes off the CPU enters light sleep,
+// needs power management enabled in the ESP-IDF configuration, 0 keeps the CPU awake
+#define LIGHT_SLEEP 1
+
+// cathode poisoning [config]
 #define ROTATION_INTERVAL 5       // in minutes
 #define ROTATION_STEPINTERVAL 250 // in ms
 
-// the solar API V1 allows a polling interval down to 4 seconds, don't go below this
+// cathodes lit less than this since the last exercise are exercised, least used first
+#define CATHODE_EXERCISE_MIN_ONTIME 1000 // in ms
+#define CATHODE_EXERCISE_MAX_STEPS 12    // maximum number of exercise steps
+
+// changed digits roll forward through the numbers in between, 0 switches the digits instantly
+#define DIGIT_TRANSITION 1
+#define DIGIT_TRANSITION_STEPINTERVAL 20 // in ms
+
+// the cathode usage counters are written to NVS in this interval to keep the flash wear low
+#define CATHODE_USAGE_SAVE_INTERVAL 60 // in minutes
+
+// the solar API V1 allows a polling interval down to 4 seconds, don't go below this [config]
 #define INVERTER_POLLINGINTERVAL 5 // in seconds
 
-// IP address of the inverter
+// IP address of the inverter [config]
 #define INVERTER_IPADDRESS "x.x.x.x"
 
-// Inverter connection port
+// Inverter connection port [config]
 #define INVERTER_PORT 80
 
-// values in the defined range are set to 0 to keep the display quieter
+// port of the built-in web server
+#define HTTP_PORT 80
+
+// shared secret of the requests changing the monitor, sent as header "Authorization: Bearer <token>",
+// up to 32 characters, an empty token refuses all changes [config]
+#define HTTP_API_TOKEN ""
+
+// address configuration of the ethernet port
+#define NETWORK_DHCP 1   // address assigned by a DHCP server
+#define NETWORK_STATIC 2 // address defined below, available at once after boot
+
+// used address configuration
+#define NETWORK_MODE NETWORK_DHCP
+
+// static address, used with NETWORK_STATIC
+#define NETWORK_STATIC_IP "x.x.x.x"
+#define NETWORK_STATIC_GATEWAY "x.x.x.x"
+#define NETWORK_STATIC_SUBNET "255.255.255.0"
+#define NETWORK_STATIC_DNS "x.x.x.x"
+
+// with DHCP the last assigned address is reused at boot without waiting for the DHCP server,
+// the server is asked after the first inverter request, 0 always waits for DHCP at boot
+#define NETWORK_LEASE_REUSE 1
+
+// several monitors reading the same inverter share its values, one unit is elected to poll the inverter
+// and sends the values to the others by UDP multicast, another unit takes over if it goes silent,
+// 0 polls the inverter always
+#define CLUSTER_ENABLED 0
+#define CLUSTER_GROUP "239.255.77.77" // multicast group of the units
+#define CLUSTER_PORT 47700
+
+// the last values are shown at boot until new values arrive, they are written to NVS
+// in this interval to survive a power loss, a reset keeps them in RTC memory
+#define SNAPSHOT_SAVE_INTERVAL 15 // in minutes
+
+// values in the defined range are set to 0 to keep the display quieter [config]
 // set this value to 0 if you dont want to round towards zero
 #define POWER_ROUND_TO_ZERO_RANGE 10 // in watts
 
+// the values pass a filter before they are shown, keeps the tubes and LEDs quiet on cloudy days [config]
+// window: median of the last 1, 3 or 5 values, removes single spikes
+// outlier: values further away from the median are ignored up to 2 times in a row, 0 disables
+// smoothing: weight of a new value in percent, 100 disables
+// deadband: the shown value changes only by at least this amount, 0 disables
+#define FILTER_POWER_WINDOW 3
+#define FILTER_POWER_OUTLIER 0       // in watts
+#define FILTER_POWER_SMOOTHING 50    // in percent
+#define FILTER_POWER_DEADBAND 20     // in watts
+#define FILTER_PERCENT_WINDOW 1
+#define FILTER_PERCENT_OUTLIER 0     // in percent
+#define FILTER_PERCENT_SMOOTHING 100 // in percent
+#define FILTER_PERCENT_DEADBAND 1    // in percent
+
 // methods to get the load power value
 #define LOADPOWER_CALCULATE 1    // calculate the load power using the grid, solar and battery power values
 #define LOADPOWER_FROMINVERTER 2 // take the load power value provided by the inverter, always slightly lower as calculated
@@ -34,7 +139,26 @@
 // used method to get the load power value
 #define GET_LOADPOWER_METHOD LOADPOWER_CALCULATE
 
-// rating backlight colors R, G, B
+// drivers for the backlight LEDs
+#define LED_DRIVER_NEOPIXEL 1 // Adafruit NeoPixel library, blocks with interrupts disabled while sending
+#define LED_DRIVER_RMT 2      // RMT peripheral, sends in the background
+
+// used LED driver
+#define LED_DRIVER LED_DRIVER_RMT
+
+// backlight colors are blended between the rating colors, 0 uses the plain rating colors
+#define BACKLIGHT_GRADIENT 1
+#define BACKLIGHT_GAMMA 2.2 // colors are blended in linear light, the rating colors are kept, 1.0 blends the values
+
+// animated chase on the boards with flow effect enabled in Layout.h
+#define FLOW_FRAME_INTERVAL 40 // in ms
+#define FLOW_SPEED_PER_KW 2.0  // in LEDs per second and kW
+#define FLOW_MAX_SPEED 12.0    // in LEDs per second
+#define FLOW_MIN_POWER 50      // in watts, below the LEDs are not animated
+#define FLOW_TAIL_LENGTH 3.0   // in LEDs
+#define FLOW_MIN_LEVEL 64      // brightness of the LEDs outside the chase, 0..255
+
+// rating backlight colors R, G, B [config]
 #define COLOR_EXCELLENT 0, 153, 153
 #define COLOR_GOOD 0, 255, 0
 #define COLOR_FAIR 255, 100, 0
@@ -0,0 +1,145 @@
+// ApiCache.hpp
+
+// keeps the raw body of the last inverter response and serves it to other clients on the network,
+// so they don't cause additional requests to the inverter, the followers of a cluster have no response
+// and send the clients to the leader
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <DebugDefs.h>
+#include <Config.hpp>
+
+#define API_CACHE_SIZE 4096 // in bytes, holds the body of an inverter response
+#define API_CACHE_PATH "/solar_api/v1/GetPowerFlowRealtimeData.fcgi"
+
+class ApiCache
+{
+public:
+  ApiCache()
+  {
+    _current = 0;
+    _lengths[0] = 0;
+    _lengths[1] = 0;
+    _timestamp = 0;
+    _lastRequest = 0;
+    _requested = false;
+    _hits = 0;
+    _misses = 0;
+    _redirects = 0;
+  }
+
+  virtual ~ApiCache()
+  {
+  }
+
+  // returns the buffer to read the next response into, the cached body stays valid until commit(),
+  // also marks the time of the inverter request
+  char *getBuffer(size_t *size)
+  {
+    _lastRequest = millis();
+    _requested = true;
+    *size = API_CACHE_SIZE;
+    return (_bodies[1 - _current]);
+  }
+
+  // makes the body read into the buffer the cached body
+  void commit(size_t length)
+  {
+    _current = 1 - _current;
+    _lengths[_current] = length;
+    _timestamp = millis();
+  }
+
+  // returns if a request to the inverter has been made within the given time in ms
+  bool isRequestedWithin(unsigned long interval) const
+  {
+    return (_requested && (millis() - _lastRequest < interval));
+  }
+
+  // returns if no request has been made to the inverter within the polling interval,
+  // a client may then cause a new request
+  bool isRequestDue() const
+  {
+    return (!isRequestedWithin(getPollingInterval()));
+  }
+
+  // sends the cached body unchanged, the age tells the client how long ago it has been received,
+  // returns false if there is no body yet
+  bool send(EthernetClient &client, bool requested)
+  {
+    size_t length = _lengths[_current];
+
+    if (length == 0)
+    {
+      return (false);
+    }
+    requested ? _misses++ : _hits++;
+    client.println(F("HTTP/1.1 200 OK"));
+    client.println(F("Content-Type: application/json"));
+    client.print(F("Content-Length: "));
+    client.println((unsigned int)length);
+    client.print(F("Cache-Control: max-age="));
+    client.println((unsigned long)(getPollingInterval() / 1000));
+    client.print(F("Age: "));
+    client.println((unsigned long)((millis() - _timestamp) / 1000));
+    client.println(F("Connection: close"));
+    client.println();
+    client.write((const uint8_t *)_bodies[_current], length);
+    return (true);
+  }
+
+  // sends the client to the same target on the given unit
+  void redirect(EthernetClient &client, IPAddress address, const char *target)
+  {
+    char location[32];
+
+    _redirects++;
+    snprintf(location, sizeof(location), "http://%u.%u.%u.%u", address[0], address[1], address[2], address[3]);
+    client.println(F("HTTP/1.1 307 Temporary Redirect"));
+    client.print(F("Location: "));
+    client.print(location);
+    client.println(target);
+    client.println(F("Content-Length: 0"));
+    client.println(F("Connection: close"));
+    client.println();
+  }
+
+  // returns the number of clients served without a request to the inverter
+  unsigned long getHits() const
+  {
+    return (_hits);
+  }
+
+  // returns the number of clients causing a request to the inverter
+  unsigned long getMisses() const
+  {
+    return (_misses);
+  }
+
+  // returns the number of clients sent to the leader
+  unsigned long getRedirects() const
+  {
+    return (_redirects);
+  }
+
+private:
+  char _bodies[2][API_CACHE_SIZE]; // cached body and the body being read
+  uint8_t _current;
+  size_t _lengths[2];
+  unsigned long _timestamp;   // when the cached body has been received
+  unsigned long _lastRequest; // last request to the inverter, successful or not
+  bool _requested;
+  unsigned long _hits;
+  unsigned long _misses;
+  unsigned long _redirects;
+
+  static unsigned long getPollingInterval()
+  {
+    return (Config::get().getActive().pollingInterval * 1000UL);
+  }
+};
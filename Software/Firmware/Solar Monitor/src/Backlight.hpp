@@ -20,6 +20,8 @@ enum class rating_step
 
 #define RATING_COUNT 4 // modify if changing rating_steps
 
+#define BACKLIGHT_LUT_SIZE 64 // number of precomputed gradient colors
+
 // holds LED color and the value range
 typedef struct
 {
@@ -41,6 +43,12 @@ public:
     }
     _minLED = -1;
     _maxLED = -1;
+    for (int i = 0; i < BACKLIGHT_LUT_SIZE; i++)
+    {
+      _gradient[i] = 0;
+    }
+    _gradientMin = 0;
+    _gradientMax = 0;
   }
 
   virtual ~Backlight()
@@ -75,6 +83,72 @@ public:
     return (color);
   }
 
+  // precomputes the gradient colors, call after setting the ratings,
+  // the colors are interpolated between the centers of the rating ranges,
+  // the lowest and highest range use their inner limit, the centers keep the configured colors
+  void buildGradient(double gamma)
+  {
+    int order[RATING_COUNT];
+    double stops[RATING_COUNT];
+
+    // sort the ratings by value
+    for (int i = 0; i < RATING_COUNT; i++)
+    {
+      int position = i;
+      while ((position > 0) && (_ratings[order[position - 1]].min > _ratings[i].min))
+      {
+        order[position] = order[position - 1];
+        position--;
+      }
+      order[position] = i;
+    }
+    for (int i = 0; i < RATING_COUNT; i++)
+    {
+      const RATING &rating = _ratings[order[i]];
+      if (i == 0)
+      {
+        stops[i] = rating.max;
+      }
+      else if (i == RATING_COUNT - 1)
+      {
+        stops[i] = rating.min;
+      }
+      else
+      {
+        stops[i] = (rating.min + rating.max) / 2;
+      }
+    }
+    _gradientMin = stops[0];
+    _gradientMax = stops[RATING_COUNT - 1];
+
+    for (int i = 0; i < BACKLIGHT_LUT_SIZE; i++)
+    {
+      double value = _gradientMin + (_gradientMax - _gradientMin) * i / (BACKLIGHT_LUT_SIZE - 1);
+      int segment = 0;
+      while ((segment < RATING_COUNT - 2) && (value > stops[segment + 1]))
+      {
+        segment++;
+      }
+      double span = stops[segment + 1] - stops[segment];
+      double weight = (span > 0) ? (value - stops[segment]) / span : 0;
+      weight = constrain(weight, 0.0, 1.0);
+      _gradient[i] = blend(_ratings[order[segment]].color, _ratings[order[segment + 1]].color, weight, gamma);
+    }
+  }
+
+  // get LED color for a specific value from the gradient
+  int getGradientColor(double value) const
+  {
+    int index = 0;
+
+    if (_gradientMax > _gradientMin)
+    {
+      double position = (value - _gradientMin) / (_gradientMax - _gradientMin);
+      index = (int)round(constrain(position, 0.0, 1.0) * (BACKLIGHT_LUT_SIZE - 1));
+    }
+    return (_gradient[index]);
+  }
+
   // set the first LED number in the LED array section of the display
   void setMinLED(int minLED)
   {
@@ -103,4 +177,23 @@ private:
   RATING _ratings[RATING_COUNT];
   int _minLED;
   int _maxLED;
+  int _gradient[BACKLIGHT_LUT_SIZE];
+  double _gradientMin;
+  double _gradientMax;
+
+  // mixes two colors in linear light, the configured colors are gamma encoded like the LED values,
+  // a weight of 0 or 1 returns the configured color unchanged
+  static int blend(int color1, int color2, double weight, double gamma)
+  {
+    int result = 0;
+
+    for (int shift = 16; shift >= 0; shift -= 8)
+    {
+      double channel1 = pow(((color1 >> shift) & 255) / 255.0, gamma);
+      double channel2 = pow(((color2 >> shift) & 255) / 255.0, gamma);
+      double channel = channel1 + (channel2 - channel1) * weight;
+      result |= ((int)round(pow(channel, 1.0 / gamma) * 255)) << shift;
+    }
+    return (result);
+  }
 };
\ No newline at end of file
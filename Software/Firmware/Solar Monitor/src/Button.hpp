@@ -1,7 +1,9 @@
 // Button.hpp
 
 // class for using OneButton in a class
-// based on the FunctionalButton example
+// based on the FunctionalButton example,
+// the button is sampled by its own task, started by an edge interrupt,
+// so presses are detected while the main loop is busy
 
 // Copyright (C) 2024 highvoltglow
 // Licensed under the MIT License
@@ -10,37 +12,180 @@
 
 #include <Arduino.h>
 #include <OneButton.h>
+#include <driver/gpio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Events.h>
+
+#define BUTTON_TICK_INTERVAL 10 // in ms
+#define BUTTON_DEBOUNCE_TIME 50 // in ms, OneButton takes a level after it has been stable this long
+#define BUTTON_ACTIVE_LEVEL LOW // the button pulls the pin low, as OneButton expects by default
+#define BUTTON_CLICK_TIME 250   // in ms, a second click within starts a double click
+#define BUTTON_PRESS_TIME 1000  // in ms, for a long press
+#define BUTTON_QUEUE_LENGTH 4
+#define BUTTON_TASK_STACK 2048
+#define BUTTON_TASK_PRIORITY 2
+
+enum class button_action : uint8_t
+{
+  click,
+  double_click,
+  long_press
+};
+
+// action recognized by the button task
+typedef struct
+{
+  button_action action;
+  unsigned long timestamp; // when the action was recognized
+} BUTTON_EVENT;
 
 class Button
 {
 private:
   OneButton _button;
-  bool _isPressed;
+  uint8_t _pin;
+  QueueHandle_t _actions;
+  SemaphoreHandle_t _wake;
+  TaskHandle_t _task;
+  volatile bool _wakeupArmed;
+  EVENT_CALLBACK _notify;
+  void *_notifyArg;
 
 public:
-  explicit Button(uint8_t pin) : _button(pin)
+  explicit Button(uint8_t pin) : _button(pin), _pin(pin)
   {
-    // attaching callback
+    _actions = nullptr;
+    _wake = nullptr;
+    _task = nullptr;
+    _wakeupArmed = false;
+    _notify = nullptr;
+    _notifyArg = nullptr;
+
+    // attaching callbacks
     _button.attachClick([](void *scope)
-                        { ((Button *)scope)->pressed(); }, this);
+                        { ((Button *)scope)->recognized(button_action::click); }, this);
+    _button.attachDoubleClick([](void *scope)
+                              { ((Button *)scope)->recognized(button_action::double_click); }, this);
+    _button.attachLongPressStart([](void *scope)
+                                 { ((Button *)scope)->recognized(button_action::long_press); }, this);
+    _button.setDebounceMs(BUTTON_DEBOUNCE_TIME);
+    _button.setClickMs(BUTTON_CLICK_TIME);
+    _button.setPressMs(BUTTON_PRESS_TIME);
+  }
+
+  virtual ~Button()
+  {
+    if (_task != nullptr)
+    {
+      detachInterrupt(_pin);
+      vTaskDelete(_task);
+    }
+  }
+
+  // starts the button task, the callback is notified on each recognized action
+  void begin(EVENT_CALLBACK notify, void *notifyArg)
+  {
+    _notify = notify;
+    _notifyArg = notifyArg;
+    _actions = xQueueCreate(BUTTON_QUEUE_LENGTH, sizeof(BUTTON_EVENT));
+    _wake = xSemaphoreCreateBinary();
+    if (xTaskCreatePinnedToCore(&Button::run, "button", BUTTON_TASK_STACK, this,
+                                BUTTON_TASK_PRIORITY, &_task, 1) != pdPASS)
+    {
+      LOG_ERROR(LOG_INPUT, "Failed to create button task");
+      _task = nullptr;
+      return;
+    }
+    attachInterruptArg(_pin, &Button::onInterrupt, this, CHANGE);
+  }
+
+  // gets the next recognized action, returns false if there is none
+  bool getAction(BUTTON_EVENT *event)
+  {
+    return ((_actions != nullptr) && (xQueueReceive(_actions, event, 0) == pdTRUE));
   }
 
-  // called if button is pressed
-  void pressed()
+  // lets a pressed button wake up the CPU from light sleep,
+  // this turns the interrupt into a level interrupt until the first wakeup
+  void enableWakeup()
   {
-    _isPressed = true;
+    if ((_task != nullptr) && !_wakeupArmed)
+    {
+      _wakeupArmed = true;
+      gpio_wakeup_enable((gpio_num_t)_pin, GPIO_INTR_LOW_LEVEL);
+    }
+  }
+
+  // restores the edge interrupt
+  void disableWakeup()
+  {
+    if (_wakeupArmed)
+    {
+      _wakeupArmed = false;
+      gpio_wakeup_disable((gpio_num_t)_pin);
+      gpio_set_intr_type((gpio_num_t)_pin, GPIO_INTR_ANYEDGE);
+    }
+  }
+
+private:
+  // called by OneButton if an action has been recognized
+  void recognized(button_action action)
+  {
+    BUTTON_EVENT event = {action, millis()};
+    xQueueSend(_actions, &event, 0);
+    if (_notify != nullptr)
+    {
+      _notify(_notifyArg, controller_event::button);
+    }
+  }
+
+  static void IRAM_ATTR onInterrupt(void *arg)
+  {
+    Button *button = (Button *)arg;
+    BaseType_t woken = pdFALSE;
+
+    // woken up from light sleep, the level interrupt would fire as long as the button is pressed
+    if (button->_wakeupArmed)
+    {
+      button->_wakeupArmed = false;
+      gpio_wakeup_disable((gpio_num_t)button->_pin);
+      gpio_set_intr_type((gpio_num_t)button->_pin, GPIO_INTR_ANYEDGE);
+    }
+    xSemaphoreGiveFromISR(button->_wake, &woken);
+    if (woken)
+    {
+      portYIELD_FROM_ISR();
+    }
   }
 
-  // returns if button has been pressed
-  bool isPressed() const
+  static void run(void *arg)
   {
-    return (_isPressed);
+    ((Button *)arg)->loop();
   }
 
-  // check for button events
-  void process()
+  // button task, sleeps until the button is touched and ticks OneButton until it is idle again,
+  // OneButton is still idle while it debounces a press, so the ticks go on until the button
+  // has also been released for the debounce and the click time
+  void loop()
   {
-    _isPressed = false;
-    _button.tick();
+    while (true)
+    {
+      xSemaphoreTake(_wake, portMAX_DELAY);
+      unsigned long released = millis();
+      do
+      {
+        _button.tick();
+        if (digitalRead(_pin) == BUTTON_ACTIVE_LEVEL)
+        {
+          released = millis();
+        }
+        vTaskDelay(pdMS_TO_TICKS(BUTTON_TICK_INTERVAL));
+      } while (!_button.isIdle() || (millis() - released < BUTTON_DEBOUNCE_TIME + BUTTON_CLICK_TIME));
+    }
   }
-};
\ No newline at end of file
+};
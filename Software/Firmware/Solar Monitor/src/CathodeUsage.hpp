@@ -0,0 +1,139 @@
+// CathodeUsage.hpp
+
+// keeps track of the on-time of every cathode of a display board
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <DisplayHAL.hpp>
+#include <DebugDefs.h>
+
+class CathodeUsage
+{
+public:
+  CathodeUsage()
+  {
+    for (int i = 0; i < REGISTERCOUNT; i++)
+    {
+      _onTime[i] = 0;
+      _remainder[i] = 0;
+      _recentOnTime[i] = 0;
+    }
+    _frame = 0;
+    _lit = false;
+    _dirty = false;
+    _lastTimestamp = millis();
+  }
+
+  virtual ~CathodeUsage()
+  {
+  }
+
+  // called each time a frame has been stored in the shift registers
+  void setFrame(uint64_t frame)
+  {
+    account();
+    _frame = frame;
+  }
+
+  // called when the high voltage is switched, tubes are only lit with high voltage on
+  void setLit(bool lit)
+  {
+    account();
+    _lit = lit;
+  }
+
+  // adds the time elapsed since the last call to all registers set in the current frame
+  void account()
+  {
+    unsigned long now = millis();
+    unsigned long elapsed = now - _lastTimestamp;
+    _lastTimestamp = now;
+
+    if (_lit && (elapsed > 0))
+    {
+      // only visit the registers which are on
+      uint64_t frame = _frame;
+      while (frame != 0)
+      {
+        uint8_t index = __builtin_ctzll(frame);
+        frame &= frame - 1;
+
+        uint32_t ms = _remainder[index] + elapsed;
+        if (ms >= 1000)
+        {
+          _onTime[index] += ms / 1000;
+          _dirty = true;
+        }
+        _remainder[index] = ms % 1000;
+        _recentOnTime[index] += elapsed;
+      }
+    }
+  }
+
+  // returns the accumulated on-time of a register in seconds
+  uint32_t getOnTime(uint8_t registerNumber) const
+  {
+    return (_onTime[registerNumber - 1]);
+  }
+
+  // returns the on-time of a register since the last exercise in ms
+  uint32_t getRecentOnTime(uint8_t registerNumber) const
+  {
+    return (_recentOnTime[registerNumber - 1]);
+  }
+
+  // starts a new exercise interval
+  void startInterval()
+  {
+    account();
+    for (int i = 0; i < REGISTERCOUNT; i++)
+    {
+      _recentOnTime[i] = 0;
+    }
+  }
+
+  // reads the on-time counters from NVS
+  bool load(Preferences &preferences, const char *key)
+  {
+    bool result = false;
+    uint32_t onTime[REGISTERCOUNT];
+
+    if (preferences.getBytes(key, onTime, sizeof(onTime)) == sizeof(onTime))
+    {
+      memcpy(_onTime, onTime, sizeof(_onTime));
+      result = true;
+    }
+    return (result);
+  }
+
+  // writes the on-time counters to NVS, only if they have changed
+  bool save(Preferences &preferences, const char *key)
+  {
+    bool result = true;
+
+    account();
+    if (_dirty)
+    {
+      result = (preferences.putBytes(key, _onTime, sizeof(_onTime)) == sizeof(_onTime));
+      if (result)
+      {
+        _dirty = false;
+      }
+    }
+    return (result);
+  }
+
+private:
+  uint32_t _onTime[REGISTERCOUNT];       // in seconds, persisted
+  uint16_t _remainder[REGISTERCOUNT];    // in ms, not yet added to _onTime
+  uint32_t _recentOnTime[REGISTERCOUNT]; // in ms, since the last exercise
+  uint64_t _frame;
+  bool _lit;
+  bool _dirty;
+  unsigned long _lastTimestamp;
+};
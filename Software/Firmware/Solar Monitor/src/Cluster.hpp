@@ -0,0 +1,317 @@
+// Cluster.hpp
+
+// shares the inverter values between several monitors, one unit is elected to poll the inverter
+// and sends each response as UDP multicast datagram, the other units only listen
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Inverter.hpp>
+#include <Config.hpp>
+#include <Helper.hpp>
+#include <Settings.h>
+
+#define CLUSTER_MAGIC 0x4E4F4D53UL     // "SMON"
+#define CLUSTER_VERSION 1
+#define CLUSTER_FLAG_VALUES 0x01       // the datagram has values, without the leader only reports to be alive
+#define CLUSTER_STARTUP_TIMEOUT 2      // in polling intervals, a starting unit listens this time for a leader
+#define CLUSTER_LEADER_TIMEOUT 4       // in polling intervals, covers a failing inverter request
+#define CLUSTER_STAGGER_SLOTS 16       // units take over one after the other, ordered by their node id
+#define CLUSTER_STAGGER_INTERVAL 250   // in ms, time between two slots
+
+enum class cluster_role
+{
+  standalone, // polls the inverter, nothing is sent
+  follower,   // takes the values of the leader
+  leader      // polls the inverter and sends the values
+};
+
+// datagram sent by the leader, all units have the same byte order
+typedef struct
+{
+  uint32_t magic;
+  uint8_t version;
+  uint8_t flags;
+  uint16_t reserved;
+  uint32_t nodeId;    // sender, the lowest node id wins if two leaders meet
+  uint32_t sequence;  // incremented with each datagram of the sender
+  uint32_t timestamp; // uptime of the sender in ms when the values have been received
+  float SOC;
+  float P_Akku;
+  float P_Grid;
+  float P_Load;
+  float P_PV;
+  float rel_Autonomy;
+  float rel_SelfConsumption;
+  uint32_t checksum; // of all fields above
+} CLUSTER_PACKET;
+
+class Cluster
+{
+public:
+  Cluster()
+  {
+    _role = cluster_role::standalone;
+    _nodeId = 0;
+    _leaderId = 0;
+    _leaderAddress = IPAddress();
+    _sequence = 0;
+    _leaderSequence = 0;
+    _leaderTimestamp = 0;
+    _lastReceived = 0;
+    _lastSent = 0;
+    _received = 0;
+    _dropped = 0;
+    _elections = 0;
+  }
+
+  virtual ~Cluster()
+  {
+  }
+
+  // joins the multicast group, the unit listens for a leader before it takes over,
+  // the node id is taken from the mac address
+  void begin(const byte *mac)
+  {
+    _nodeId = ((uint32_t)mac[2] << 24) | ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5];
+    _group.fromString(CLUSTER_GROUP);
+    if (_udp.beginMulticast(_group, CLUSTER_PORT) == 0)
+    {
+      LOG_ERROR(LOG_NETWORK, "Failed to join the cluster group");
+      _role = cluster_role::standalone;
+      return;
+    }
+    LOG_INFO(LOG_NETWORK, "Cluster node %08lX listening", (unsigned long)_nodeId);
+    _role = cluster_role::follower;
+    _leaderId = 0;
+    _leaderAddress = IPAddress();
+    _lastReceived = millis();
+  }
+
+  // returns if this unit polls the inverter itself
+  bool isPolling() const
+  {
+    return (_role != cluster_role::follower);
+  }
+
+  // returns if the leader has to poll to keep the other units updated,
+  // e.g. while its own display is off
+  bool isPollDue() const
+  {
+    return ((_role == cluster_role::leader) && (millis() - _lastSent >= getPollingInterval()));
+  }
+
+  // sends the values of a successful request, without values the leader only reports to be alive
+  void publish(const INVERTER_VALUES *values)
+  {
+    CLUSTER_PACKET packet;
+
+    if (_role != cluster_role::leader)
+    {
+      return;
+    }
+    memset(&packet, 0, sizeof(packet));
+    packet.magic = CLUSTER_MAGIC;
+    packet.version = CLUSTER_VERSION;
+    packet.nodeId = _nodeId;
+    packet.sequence = ++_sequence;
+    packet.timestamp = millis();
+    if (values != nullptr)
+    {
+      packet.flags = CLUSTER_FLAG_VALUES;
+      packet.SOC = values->SOC;
+      packet.P_Akku = values->P_Akku;
+      packet.P_Grid = values->P_Grid;
+      packet.P_Load = values->P_Load;
+      packet.P_PV = values->P_PV;
+      packet.rel_Autonomy = values->rel_Autonomy;
+      packet.rel_SelfConsumption = values->rel_SelfConsumption;
+    }
+    packet.checksum = Helper::getChecksum(&packet, offsetof(CLUSTER_PACKET, checksum));
+    _udp.beginPacket(_group, CLUSTER_PORT);
+    _udp.write((const uint8_t *)&packet, sizeof(packet));
+    _udp.endPacket();
+    _lastSent = millis();
+  }
+
+  // reads the received datagrams, returns true if new values of the leader have been copied
+  bool receive(INVERTER_VALUES *values)
+  {
+    CLUSTER_PACKET packet;
+    bool result = false;
+
+    if (_role == cluster_role::standalone)
+    {
+      return (false);
+    }
+    while (_udp.parsePacket() > 0)
+    {
+      int length = _udp.read((uint8_t *)&packet, sizeof(packet));
+      if ((length != (int)sizeof(packet)) || (packet.magic != CLUSTER_MAGIC) || (packet.version != CLUSTER_VERSION) ||
+          (packet.checksum != Helper::getChecksum(&packet, offsetof(CLUSTER_PACKET, checksum))))
+      {
+        _dropped++;
+        continue;
+      }
+      if (packet.nodeId == _nodeId)
+      {
+        // own datagram looped back
+        continue;
+      }
+      if (accept(packet))
+      {
+        _received++;
+        _leaderAddress = _udp.remoteIP();
+        if (packet.flags & CLUSTER_FLAG_VALUES)
+        {
+          values->SOC = packet.SOC;
+          values->P_Akku = packet.P_Akku;
+          values->P_Grid = packet.P_Grid;
+          values->P_Load = packet.P_Load;
+          values->P_PV = packet.P_PV;
+          values->rel_Autonomy = packet.rel_Autonomy;
+          values->rel_SelfConsumption = packet.rel_SelfConsumption;
+          result = true;
+        }
+      }
+      else
+      {
+        _dropped++;
+      }
+    }
+    return (result);
+  }
+
+  // takes over if the leader has been silent, called by the network task
+  void process()
+  {
+    if ((_role == cluster_role::follower) && (millis() - _lastReceived >= getTakeoverTimeout()))
+    {
+      LOG_INFO(LOG_NETWORK, "Cluster node %08lX is leader", (unsigned long)_nodeId);
+      _role = cluster_role::leader;
+      _leaderId = _nodeId;
+      _leaderAddress = IPAddress();
+      _lastSent = millis() - getPollingInterval();
+      _elections++;
+    }
+  }
+
+  cluster_role getRole() const
+  {
+    return (_role);
+  }
+
+  uint32_t getNodeId() const
+  {
+    return (_nodeId);
+  }
+
+  uint32_t getLeaderId() const
+  {
+    return (_leaderId);
+  }
+
+  // returns the address of the leader followed, 0.0.0.0 until one has been heard
+  IPAddress getLeaderAddress() const
+  {
+    return (_leaderAddress);
+  }
+
+  // prints the role and the datagram counters
+  void print(Print &out) const
+  {
+    static const char *roles[] = {"standalone", "follower", "leader"};
+    char line[64];
+
+    snprintf(line, sizeof(line), "role=%s", roles[(int)_role]);
+    out.println(line);
+    snprintf(line, sizeof(line), "node=%08lX", (unsigned long)_nodeId);
+    out.println(line);
+    snprintf(line, sizeof(line), "leader=%08lX", (unsigned long)_leaderId);
+    out.println(line);
+    snprintf(line, sizeof(line), "leader_address=%u.%u.%u.%u",
+             _leaderAddress[0], _leaderAddress[1], _leaderAddress[2], _leaderAddress[3]);
+    out.println(line);
+    snprintf(line, sizeof(line), "received=%lu", _received);
+    out.println(line);
+    snprintf(line, sizeof(line), "dropped=%lu", _dropped);
+    out.println(line);
+    snprintf(line, sizeof(line), "elections=%lu", _elections);
+    out.println(line);
+  }
+
+private:
+  EthernetUDP _udp;
+  IPAddress _group;
+  volatile cluster_role _role;
+  uint32_t _nodeId;
+  uint32_t _leaderId;        // node followed, 0 until a leader has been heard
+  IPAddress _leaderAddress;  // of the node followed, API clients are sent there
+  uint32_t _sequence;        // of the own datagrams
+  uint32_t _leaderSequence;  // of the last accepted datagram
+  uint32_t _leaderTimestamp; // of the last accepted datagram
+  unsigned long _lastReceived;
+  unsigned long _lastSent;
+  unsigned long _received;
+  unsigned long _dropped;    // invalid, repeated or out of order datagrams
+  unsigned long _elections;  // times this unit became leader
+
+  // decides if a datagram of another unit is taken, the lowest node id leads,
+  // a leader hearing a lower node id steps back
+  bool accept(const CLUSTER_PACKET &packet)
+  {
+    bool result = false;
+
+    if (packet.nodeId == _leaderId)
+    {
+      // the leader restarted if its uptime went backwards
+      result = ((int32_t)(packet.sequence - _leaderSequence) > 0) || (packet.timestamp < _leaderTimestamp);
+    }
+    else if ((packet.nodeId < _leaderId) ||
+             ((_role == cluster_role::follower) && ((_leaderId == 0) || (millis() - _lastReceived >= getLeaderTimeout()))))
+    {
+      if (_role == cluster_role::leader)
+      {
+        LOG_INFO(LOG_NETWORK, "Cluster node %08lX is follower", (unsigned long)_nodeId);
+      }
+      _role = cluster_role::follower;
+      _leaderId = packet.nodeId;
+      result = true;
+    }
+    if (result)
+    {
+      _leaderSequence = packet.sequence;
+      _leaderTimestamp = packet.timestamp;
+      _lastReceived = millis();
+    }
+    return (result);
+  }
+
+  // returns the polling interval of the configuration in ms, the leader keeps it also if it is hot
+  static unsigned long getPollingInterval()
+  {
+    return (Config::get().getActive().pollingInterval * 1000UL);
+  }
+
+  // returns the time in ms a follower waits for the leader before it follows another unit,
+  // shorter at startup to get the first values early
+  unsigned long getLeaderTimeout() const
+  {
+    unsigned long intervals = (_leaderId == 0) ? CLUSTER_STARTUP_TIMEOUT : CLUSTER_LEADER_TIMEOUT;
+
+    return (getPollingInterval() * intervals);
+  }
+
+  // returns the time in ms a follower waits for the leader before it takes over itself, staggered by the node id,
+  // the units of the later slots follow the first one taking over
+  unsigned long getTakeoverTimeout() const
+  {
+    return (getLeaderTimeout() + (_nodeId % CLUSTER_STAGGER_SLOTS) * CLUSTER_STAGGER_INTERVAL);
+  }
+};
@@ -0,0 +1,537 @@
+// Config.hpp
+
+// runtime configuration, stored as compact binary in NVS and edited at HTTP /config,
+// the settings in Settings.h and Layout.h are the defaults
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <stddef.h>
+#include <errno.h>
+#include <atomic>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <HeapGuard.hpp>
+#include <Helper.hpp>
+#include <Errors.hpp>
+#include <SignalFilter.hpp>
+#include <Layout.h>
+#include <Settings.h>
+
+// NVS namespace and key of the configuration
+#define CONFIG_NAMESPACE "config"
+#define CONFIG_KEY "config"
+
+// schema version, increased when fields are appended to CONFIG
+#define CONFIG_VERSION 4
+
+// rating rows stored for the boards, fixed so the stored layout does not depend on DISPLAY_MAX_COUNT
+#define CONFIG_BOARD_COUNT 16
+#define CONFIG_V2_BOARD_COUNT 8 // rating rows stored by version 1 and 2
+
+#define CONFIG_ADDRESS_SIZE 16       // dotted address with terminator
+#define CONFIG_TOKEN_SIZE 33         // API token with terminator
+#define CONFIG_MIN_POLLINGINTERVAL 4 // in seconds, the solar API V1 allows no less
+#define CONFIG_LINE_LENGTH 48
+
+// value range of a rating step
+typedef struct
+{
+  int32_t min;
+  int32_t max;
+} CONFIG_RANGE;
+
+// settings changeable at runtime, fields are only appended to keep a configuration
+// stored by an older firmware, the fields it does not have keep their defaults
+typedef struct
+{
+  char inverterAddress[CONFIG_ADDRESS_SIZE];
+  uint16_t inverterPort;
+  uint16_t pollingInterval;                               // in seconds
+  uint16_t pirDelay;                                      // in minutes, 0 disables PIR
+  uint16_t rotationInterval;                              // in minutes
+  uint16_t rotationStepInterval;                          // in ms
+  uint16_t powerRoundToZeroRange;                         // in watts
+  uint32_t colors[RATING_COUNT];                          // 0xRRGGBB, poor, fair, good, excellent
+  CONFIG_RANGE ratings[CONFIG_BOARD_COUNT][RATING_COUNT]; // per display board, poor, fair, good, excellent, 8 boards before version 3
+  FILTER_SETTINGS filters[DISPLAY_TYPE_COUNT];            // per quantity, in the order of display_type, version 2
+  char apiToken[CONFIG_TOKEN_SIZE];                       // shared secret of the changing requests, version 4
+} CONFIG;
+
+static_assert(DISPLAY_MAX_COUNT <= CONFIG_BOARD_COUNT, "Too many display boards for the stored configuration");
+static_assert(sizeof(HTTP_API_TOKEN) <= CONFIG_TOKEN_SIZE, "HTTP_API_TOKEN too long");
+
+// stored configuration
+typedef struct
+{
+  uint16_t version;
+  uint16_t size;     // of the stored CONFIG
+  uint32_t checksum; // of the stored CONFIG
+  CONFIG config;
+} CONFIG_RECORD;
+
+// numeric settings, key, field and valid range
+typedef struct
+{
+  const char *key;
+  size_t offset;
+  uint16_t min;
+  uint16_t max;
+} CONFIG_NUMBER;
+
+static const CONFIG_NUMBER configNumbers[] = {
+    {"inverter.port", offsetof(CONFIG, inverterPort), 1, 65535},
+    {"inverter.interval", offsetof(CONFIG, pollingInterval), CONFIG_MIN_POLLINGINTERVAL, 3600},
+    {"pir.delay", offsetof(CONFIG, pirDelay), 0, 1440},
+    {"rotation.interval", offsetof(CONFIG, rotationInterval), 1, 1440},
+    {"rotation.step", offsetof(CONFIG, rotationStepInterval), 10, 10000},
+    {"power.zero", offsetof(CONFIG, powerRoundToZeroRange), 0, 10000},
+};
+
+// names of the rating steps in the keys
+static const char *const configSteps[RATING_COUNT] = {"poor", "fair", "good", "excellent"};
+
+// names of the quantities in the keys, in the order of display_type
+static const char *const configQuantities[DISPLAY_TYPE_COUNT] = {"solar", "battery", "grid", "load",
+                                                                 "charge", "autonomy", "consumption"};
+
+class Config
+{
+public:
+  // returns the configuration of the whole firmware
+  static Config &get()
+  {
+    static Config config;
+    return (config);
+  }
+
+  // loads the stored configuration, without one the defaults are used
+  void begin()
+  {
+    int64_t start = esp_timer_get_time();
+    CONFIG &config = _configs[_active];
+
+    setDefaults(&config);
+    _open = _preferences.begin(CONFIG_NAMESPACE, false);
+    if (!_open)
+    {
+      LOG_ERROR(LOG_CONTROLLER, "Failed to open configuration storage");
+    }
+    else if (load(&config))
+    {
+      LOG_INFO(LOG_CONTROLLER, "Configuration loaded in %u us", (unsigned int)(esp_timer_get_time() - start));
+    }
+    else
+    {
+      LOG_INFO(LOG_CONTROLLER, "No stored configuration, using the defaults");
+    }
+  }
+
+  // returns the active configuration, read by the main loop and the network task,
+  // the network task only writes the other buffer and the main loop only swaps them
+  const CONFIG &getActive() const
+  {
+    return (_configs[_active]);
+  }
+
+  // makes an updated configuration active, called by the main loop between two passes,
+  // returns true if the configuration has changed
+  bool apply()
+  {
+    if (!_pending)
+    {
+      return (false);
+    }
+    _active = _active ^ 1;
+    _pending = false;
+    return (true);
+  }
+
+  // changes the settings given as key=value pairs separated by new lines or '&',
+  // all pairs must be valid, the configuration is stored and becomes active with the next apply(),
+  // called by the network task
+  int update(char *text)
+  {
+    int result = ERR_SUCCESS;
+    char *line = text;
+
+    // the last update has not been applied yet
+    if (_pending)
+    {
+      return (ERR_CONFIG_BUSY);
+    }
+
+    CONFIG &config = _configs[_active ^ 1];
+    config = _configs[_active];
+    while ((line != nullptr) && (result == ERR_SUCCESS))
+    {
+      char *end = line + strcspn(line, "\r\n&");
+      char *next = (*end != '\0') ? end + 1 : nullptr;
+      *end = '\0';
+      if (*line != '\0')
+      {
+        result = setValue(&config, line);
+      }
+      line = next;
+    }
+    if (result == ERR_SUCCESS)
+    {
+      result = save(config);
+    }
+    if (result == ERR_SUCCESS)
+    {
+      _latest = _active ^ 1;
+      _pending = true;
+    }
+    return (result);
+  }
+
+  // returns if the token matches the API token of the last updated configuration,
+  // an empty API token matches no token, called by the network task
+  bool isAuthorized(const char *token) const
+  {
+    const char *apiToken = _configs[_latest].apiToken;
+    size_t length = strlen(apiToken);
+    size_t tokenLength = strlen(token);
+    uint8_t difference = (tokenLength != length) ? 1 : 0;
+
+    // all characters are compared, so the response time does not tell how many of them match
+    for (size_t i = 0; i < length; i++)
+    {
+      difference |= apiToken[i] ^ ((i < tokenLength) ? token[i] : 0);
+    }
+    return ((length > 0) && (difference == 0));
+  }
+
+  // prints the last updated configuration as key=value pairs, the format accepted by update(),
+  // the API token is not printed, called by the network task
+  void print(Print &out) const
+  {
+    const CONFIG &config = _configs[_latest];
+    char line[CONFIG_LINE_LENGTH];
+
+    snprintf(line, sizeof(line), "inverter.address=%s", config.inverterAddress);
+    out.println(line);
+    for (size_t i = 0; i < sizeof(configNumbers) / sizeof(configNumbers[0]); i++)
+    {
+      snprintf(line, sizeof(line), "%s=%u", configNumbers[i].key, *getNumber(&config, configNumbers[i]));
+      out.println(line);
+    }
+    for (int i = 0; i < RATING_COUNT; i++)
+    {
+      snprintf(line, sizeof(line), "color.%s=%06X", configSteps[i], (unsigned int)config.colors[i]);
+      out.println(line);
+    }
+    for (int i = 0; i < DISPLAY_COUNT; i++)
+    {
+      for (int j = 0; j < RATING_COUNT; j++)
+      {
+        snprintf(line, sizeof(line), "rating.%d.%s=%ld,%ld", i, configSteps[j],
+                 (long)config.ratings[i][j].min, (long)config.ratings[i][j].max);
+        out.println(line);
+      }
+    }
+    for (int i = 0; i < DISPLAY_TYPE_COUNT; i++)
+    {
+      const FILTER_SETTINGS &filter = config.filters[i];
+      snprintf(line, sizeof(line), "filter.%s=%u,%u,%u,%u", configQuantities[i],
+               filter.window, filter.outlier, filter.smoothing, filter.deadband);
+      out.println(line);
+    }
+  }
+
+private:
+  Preferences _preferences;
+  bool _open;
+  CONFIG _configs[2];           // active and updated configuration
+  std::atomic<uint8_t> _active; // index of the active configuration
+  std::atomic<bool> _pending;   // the other configuration has been updated and waits for apply()
+  uint8_t _latest;              // index of the last updated configuration, used by the network task
+
+  Config()
+  {
+    _open = false;
+    _active = 0;
+    _pending = false;
+    _latest = 0;
+    setDefaults(&_configs[0]);
+    setDefaults(&_configs[1]);
+  }
+
+  // the settings of Settings.h and Layout.h
+  static void setDefaults(CONFIG *config)
+  {
+    memset(config, 0, sizeof(CONFIG));
+    strncpy(config->inverterAddress, INVERTER_IPADDRESS, CONFIG_ADDRESS_SIZE - 1);
+    strncpy(config->apiToken, HTTP_API_TOKEN, CONFIG_TOKEN_SIZE - 1);
+    config->inverterPort = INVERTER_PORT;
+    config->pollingInterval = INVERTER_POLLINGINTERVAL;
+    config->pirDelay = PIR_DELAY;
+    config->rotationInterval = ROTATION_INTERVAL;
+    config->rotationStepInterval = ROTATION_STEPINTERVAL;
+    config->powerRoundToZeroRange = POWER_ROUND_TO_ZERO_RANGE;
+    config->colors[(int)rating_step::poor] = Helper::rgbToInt(COLOR_POOR);
+    config->colors[(int)rating_step::fair] = Helper::rgbToInt(COLOR_FAIR);
+    config->colors[(int)rating_step::good] = Helper::rgbToInt(COLOR_GOOD);
+    config->colors[(int)rating_step::excellent] = Helper::rgbToInt(COLOR_EXCELLENT);
+    for (int i = 0; i < DISPLAY_COUNT; i++)
+    {
+      for (int j = 0; j < RATING_COUNT; j++)
+      {
+        config->ratings[i][j].min = (int32_t)displayLayout[i].ratings[j].min;
+        config->ratings[i][j].max = (int32_t)displayLayout[i].ratings[j].max;
+      }
+    }
+    for (int i = 0; i < DISPLAY_TYPE_COUNT; i++)
+    {
+      FILTER_SETTINGS &filter = config->filters[i];
+      if (i < (int)display_type::battery_charge)
+      {
+        filter = {FILTER_POWER_WINDOW, FILTER_POWER_OUTLIER, FILTER_POWER_SMOOTHING, FILTER_POWER_DEADBAND};
+      }
+      else
+      {
+        filter = {FILTER_PERCENT_WINDOW, FILTER_PERCENT_OUTLIER, FILTER_PERCENT_SMOOTHING, FILTER_PERCENT_DEADBAND};
+      }
+    }
+  }
+
+  // reads the stored configuration over the defaults, returns false if there is none or it is invalid
+  bool load(CONFIG *config)
+  {
+    CONFIG_RECORD record;
+    size_t length = _preferences.getBytesLength(CONFIG_KEY);
+
+    if ((length < offsetof(CONFIG_RECORD, config)) || (length > sizeof(record)) ||
+        (_preferences.getBytes(CONFIG_KEY, &record, length) != length))
+    {
+      return (false);
+    }
+    if ((record.version > CONFIG_VERSION) || (record.size != length - offsetof(CONFIG_RECORD, config)) ||
+        (record.checksum != Helper::getChecksum(&record.config, record.size)))
+    {
+      LOG_WARNING(LOG_CONTROLLER, "Stored configuration invalid, using the defaults");
+      return (false);
+    }
+    // a shorter configuration of an older version keeps the defaults of the appended fields
+    if (record.version < 3)
+    {
+      loadVersion2(config, record);
+    }
+    else
+    {
+      memcpy(config, &record.config, record.size);
+    }
+    return (true);
+  }
+
+  // takes a configuration of version 1 or 2, it has the ratings of fewer boards and the fields behind them move
+  static void loadVersion2(CONFIG *config, const CONFIG_RECORD &record)
+  {
+    const uint8_t *stored = (const uint8_t *)&record.config;
+    size_t ratingsEnd = offsetof(CONFIG, ratings) + CONFIG_V2_BOARD_COUNT * sizeof(config->ratings[0]);
+
+    memcpy(config, stored, min((size_t)record.size, ratingsEnd));
+    if (record.size > ratingsEnd)
+    {
+      memcpy(config->filters, stored + ratingsEnd, min(record.size - ratingsEnd, sizeof(config->filters)));
+    }
+  }
+
+  // writes a configuration to NVS
+  int save(const CONFIG &config)
+  {
+    CONFIG_RECORD record;
+    bool result = false;
+
+    record.version = CONFIG_VERSION;
+    record.size = sizeof(CONFIG);
+    record.checksum = Helper::getChecksum(&config, sizeof(CONFIG));
+    record.config = config;
+    if (_open)
+    {
+      // NVS allocates internally
+      HeapGuard::get().suspend();
+      result = (_preferences.putBytes(CONFIG_KEY, &record, sizeof(record)) == sizeof(record));
+      HeapGuard::get().resume();
+    }
+    return (result ? ERR_SUCCESS : ERR_CONFIG_STORE);
+  }
+
+  // sets one setting given as key=value
+  static int setValue(CONFIG *config, char *line)
+  {
+    char *value = strchr(line, '=');
+    const char *key = line;
+    int step;
+
+    if (value == nullptr)
+    {
+      return (ERR_CONFIG_SYNTAX);
+    }
+    *value++ = '\0';
+
+    if (strcmp(key, "inverter.address") == 0)
+    {
+      IPAddress address;
+      size_t length = strlen(value);
+      if ((length >= CONFIG_ADDRESS_SIZE) || !address.fromString(value))
+      {
+        return (ERR_CONFIG_VALUE);
+      }
+      // the length has been checked, the terminator is copied as well
+      memcpy(config->inverterAddress, value, length + 1);
+      return (ERR_SUCCESS);
+    }
+
+    if (strcmp(key, "api.token") == 0)
+    {
+      size_t length = strlen(value);
+      if ((length == 0) || (length >= CONFIG_TOKEN_SIZE) || (strcspn(value, " \t") != length))
+      {
+        return (ERR_CONFIG_VALUE);
+      }
+      memcpy(config->apiToken, value, length + 1);
+      return (ERR_SUCCESS);
+    }
+
+    for (size_t i = 0; i < sizeof(configNumbers) / sizeof(configNumbers[0]); i++)
+    {
+      if (strcmp(key, configNumbers[i].key) == 0)
+      {
+        long number;
+        if (!parseNumber(value, &number, 10) || (number < configNumbers[i].min) || (number > configNumbers[i].max))
+        {
+          return (ERR_CONFIG_VALUE);
+        }
+        *getNumber(config, configNumbers[i]) = (uint16_t)number;
+        return (ERR_SUCCESS);
+      }
+    }
+
+    // color.<step>=RRGGBB
+    if ((strncmp(key, "color.", 6) == 0) && ((step = findStep(key + 6)) >= 0))
+    {
+      long color;
+      if ((strlen(value) != 6) || !parseNumber(value, &color, 16) || (color < 0))
+      {
+        return (ERR_CONFIG_VALUE);
+      }
+      config->colors[step] = (uint32_t)color;
+      return (ERR_SUCCESS);
+    }
+
+    // rating.<board>.<step>=min,max
+    if (strncmp(key, "rating.", 7) == 0)
+    {
+      char *end;
+      long board = strtol(key + 7, &end, 10);
+      if ((end == key + 7) || (*end != '.') || (board < 0) || (board >= DISPLAY_COUNT) || ((step = findStep(end + 1)) < 0))
+      {
+        return (ERR_CONFIG_KEY);
+      }
+      char *separator = strchr(value, ',');
+      long min, max;
+      if (separator == nullptr)
+      {
+        return (ERR_CONFIG_VALUE);
+      }
+      *separator = '\0';
+      if (!parseNumber(value, &min, 10) || !parseNumber(separator + 1, &max, 10) || (min > max))
+      {
+        return (ERR_CONFIG_VALUE);
+      }
+      config->ratings[board][step].min = min;
+      config->ratings[board][step].max = max;
+      return (ERR_SUCCESS);
+    }
+
+    // filter.<quantity>=window,outlier,smoothing,deadband
+    if (strncmp(key, "filter.", 7) == 0)
+    {
+      int quantity = findQuantity(key + 7);
+      long numbers[4];
+      char *next = value;
+      if (quantity < 0)
+      {
+        return (ERR_CONFIG_KEY);
+      }
+      for (int i = 0; i < 4; i++)
+      {
+        char *number = next;
+        next = strchr(number, ',');
+        if ((next == nullptr) != (i == 3))
+        {
+          return (ERR_CONFIG_VALUE);
+        }
+        if (next != nullptr)
+        {
+          *next++ = '\0';
+        }
+        if (!parseNumber(number, &numbers[i], 10) || (numbers[i] < 0) || (numbers[i] > 65535))
+        {
+          return (ERR_CONFIG_VALUE);
+        }
+      }
+      // odd window up to the maximum, smoothing in percent
+      if ((numbers[0] % 2 == 0) || (numbers[0] > FILTER_MAX_WINDOW) || (numbers[2] < 1) || (numbers[2] > 100))
+      {
+        return (ERR_CONFIG_VALUE);
+      }
+      config->filters[quantity] = {(uint16_t)numbers[0], (uint16_t)numbers[1], (uint16_t)numbers[2], (uint16_t)numbers[3]};
+      return (ERR_SUCCESS);
+    }
+    return (ERR_CONFIG_KEY);
+  }
+
+  static uint16_t *getNumber(CONFIG *config, const CONFIG_NUMBER &number)
+  {
+    return ((uint16_t *)((uint8_t *)config + number.offset));
+  }
+
+  static const uint16_t *getNumber(const CONFIG *config, const CONFIG_NUMBER &number)
+  {
+    return ((const uint16_t *)((const uint8_t *)config + number.offset));
+  }
+
+  // returns the rating step of a name, -1 if unknown
+  static int findStep(const char *name)
+  {
+    for (int i = 0; i < RATING_COUNT; i++)
+    {
+      if (strcmp(name, configSteps[i]) == 0)
+      {
+        return (i);
+      }
+    }
+    return (-1);
+  }
+
+  // returns the quantity of a name, -1 if unknown
+  static int findQuantity(const char *name)
+  {
+    for (int i = 0; i < DISPLAY_TYPE_COUNT; i++)
+    {
+      if (strcmp(name, configQuantities[i]) == 0)
+      {
+        return (i);
+      }
+    }
+    return (-1);
+  }
+
+  // converts a whole text to a number, returns false if it is empty, has other characters or is out of range
+  static bool parseNumber(const char *text, long *number, int base)
+  {
+    char *end;
+
+    errno = 0;
+    *number = strtol(text, &end, base);
+    return ((end != text) && (*end == '\0') && (errno == 0));
+  }
+};
@@ -7,19 +7,39 @@
 
 #pragma once
 
-#include <esp_mac.h>
 #include <Arduino.h>
-#include <SPI.h>
-#include <Ethernet.h>
-#include <Adafruit_NeoPixel.h>
+#include <new>
+#include <LedStrip.hpp>
+#include <FlowEffect.hpp>
+#include <esp_timer.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <Preferences.h>
 #include <Button.hpp>
+#include <Dimmer.hpp>
+#include <LightSensor.hpp>
+#include <TemperatureSensor.hpp>
+#include <GpsClock.hpp>
 #include <DebugDefs.h>
+#include <Logger.hpp>
 #include <Helper.hpp>
 #include <Display.hpp>
 #include <PIR.hpp>
 #include <Inverter.hpp>
+#include <Network.hpp>
+#include <Snapshot.hpp>
+#include <SignalFilter.hpp>
+#include <Config.hpp>
+#include <Scheduler.hpp>
+#include <Profiler.hpp>
+#include <HeapGuard.hpp>
 #include <Errors.hpp>
 #include <Settings.h>
+#include <Layout.h>
+#include <Events.h>
 
 // IO pins
 #define PIN_BUTTON1 34
@@ -42,15 +62,36 @@
 #define PIN_SCL 22
 #define PIN_MOSI 23
 
+// LEDC channel used to dim the tubes
+#define DIMMER_CHANNEL 0
+
 // shift register store transition
 #define STORE_BEGIN LOW
 #define STORE_COMMIT HIGH
 
-// number of display boards
-#define DISPLAY_COUNT 5
-
-// display number with the overall status
-#define OVERALL_DISPLAY_NUMBER 4
+// NVS namespace of the cathode usage counters
+#define CATHODE_USAGE_NAMESPACE "cathodes"
+
+// main loop events
+#define EVENT_QUEUE_LENGTH 16
+#define LOOP_ACTIVE_INTERVAL 10 // in ms, while the button is in use or the tubes fade out
+#define LOOP_MAX_WAIT 10000     // in ms
+
+// run time budgets of the scheduler tasks in us, longer runs are counted as overruns
+#define BUDGET_TRANSITION 2000
+#define BUDGET_ROTATION 2000
+#define BUDGET_POLL 200
+#define BUDGET_EFFECTS 2000
+#define BUDGET_AMBIENT 3000
+#define BUDGET_THERMAL 5000
+#define BUDGET_NIGHT 500
+#define BUDGET_PERSISTENCE 50000
+#define BUDGET_SNAPSHOT 50000
+#define BUDGET_METRICS 20000
+
+// the LED strip and the virtual display have fixed buffers
+static_assert(DISPLAY_COUNT <= DISPLAY_MAX_COUNT, "Too many display boards in the layout");
+static_assert(DISPLAY_COUNT * LEDCOUNT <= LEDSTRIP_MAX_LEDS, "Too many backlight LEDs in the layout");
 
 enum class backlight_mode
 {
@@ -59,102 +100,105 @@ enum class backlight_mode
   full
 };
 
+enum class thermal_level
+{
+  normal,
+  warm,
+  hot
+};
+
 class Controller
 {
 public:
-  Controller() : _button(PIN_BUTTON1)
+  Controller() : _network(PIN_CS), _button(PIN_BUTTON1), _dimmer(PIN_BLANK, DIMMER_CHANNEL),
+                 _lightSensor(PIN_SDA, PIN_SCL), _temperatureSensor(PIN_TEMP),
+                 _gpsClock(Serial2, PIN_GPSRX, PIN_GPSTX), _leds(DISPLAY_COUNT * LEDCOUNT, PIN_LEDCTL),
+                 _pir(PIN_PIR, PIR_DELAY)
+#if VIRTUAL_DISPLAY
+                 , _virtualDisplay(DISPLAY_COUNT)
+#endif
   {
+    _events = nullptr;
+    _sleepLock = nullptr;
+    _sleepLocked = false;
+    _wakeupCount = 0;
+    _busyTime = 0;
+    _wakeupMicros = 0;
+    _lastLoopStatisticsTimestamp = 0;
+    _nightDimmed = false;
+    _ambientBrightness = 100;
+    _thermalLevel = thermal_level::normal;
     _highVoltageOn = true;
-    _lastRequestTimestamp = 0;
+    _fadingOut = false;
+    _networkState = network_state::initializing;
+    _valuesTimestamp = 0;
+    _snapshotShown = false;
+    _hasValues = false;
     _backLight = backlight_mode::off;
     _backLightState = true;
-    _lastRotationTimestamp = millis();
-    _lastRotationStepTimestamp = 0;
+    _rotating = false;
     _rotationStep = 0;
-    _rotation = false;
-
-    // initialize displays
-    // solar power display
-    _displays[0] = new Display(display_type::solar_power, value_type ::watts,
-                               PIN_DATA, PIN_STORE, PIN_SHIFT,
-                               PIN_BLANK, PIN_LEDCTL);
-    _displays[0]->getBacklight()->setRating(rating_step::poor, 0, 250, Helper::rgbToInt(COLOR_POOR));
-    _displays[0]->getBacklight()->setRating(rating_step::fair, 251, 1500, Helper::rgbToInt(COLOR_FAIR));
-    _displays[0]->getBacklight()->setRating(rating_step::good, 1501, 5000, Helper::rgbToInt(COLOR_GOOD));
-    _displays[0]->getBacklight()->setRating(rating_step::excellent, 5001, 999999, Helper::rgbToInt(COLOR_EXCELLENT));
-    _displays[0]->getBacklight()->setMinLED(24);
-    _displays[0]->getBacklight()->setMaxLED(29);
-
-    // battery power display
-    _displays[1] = new Display(display_type::battery_power, value_type ::watts,
-                               PIN_DATA, PIN_STORE, PIN_SHIFT,
-                               PIN_BLANK, PIN_LEDCTL);
-    _displays[1]->getBacklight()->setRating(rating_step::poor, 1501, 999999, Helper::rgbToInt(COLOR_POOR));
-    _displays[1]->getBacklight()->setRating(rating_step::fair, 0, 1500, Helper::rgbToInt(COLOR_FAIR));
-    _displays[1]->getBacklight()->setRating(rating_step::good, -3001, 1, Helper::rgbToInt(COLOR_GOOD));
-    _displays[1]->getBacklight()->setRating(rating_step::excellent, -999999, -3000, Helper::rgbToInt(COLOR_EXCELLENT));
-    _displays[1]->getBacklight()->setMinLED(18);
-    _displays[1]->getBacklight()->setMaxLED(23);
-
-    // grid power display
-    _displays[2] = new Display(display_type::grid_power, value_type ::watts,
-                               PIN_DATA, PIN_STORE, PIN_SHIFT,
-                               PIN_BLANK, PIN_LEDCTL);
-    _displays[2]->getBacklight()->setRating(rating_step::poor, 1501, 999999, Helper::rgbToInt(COLOR_POOR));
-    _displays[2]->getBacklight()->setRating(rating_step::fair, 0, 1500, Helper::rgbToInt(COLOR_FAIR));
-    _displays[2]->getBacklight()->setRating(rating_step::good, -3001, 1, Helper::rgbToInt(COLOR_GOOD));
-    _displays[2]->getBacklight()->setRating(rating_step::excellent, -999999, -3000, Helper::rgbToInt(COLOR_EXCELLENT));
-    _displays[2]->getBacklight()->setMinLED(12);
-    _displays[2]->getBacklight()->setMaxLED(17);
-
-    // load power display
-    _displays[3] = new Display(display_type::load_power, value_type ::watts,
-                               PIN_DATA, PIN_STORE, PIN_SHIFT,
-                               PIN_BLANK, PIN_LEDCTL);
-    _displays[3]->getBacklight()->setRating(rating_step::poor, -999999, -1501, Helper::rgbToInt(COLOR_POOR));
-    _displays[3]->getBacklight()->setRating(rating_step::fair, -1500, -501, Helper::rgbToInt(COLOR_FAIR));
-    _displays[3]->getBacklight()->setRating(rating_step::good, -500, -251, Helper::rgbToInt(COLOR_GOOD));
-    _displays[3]->getBacklight()->setRating(rating_step::excellent, -250, 0, Helper::rgbToInt(COLOR_EXCELLENT));
-    _displays[3]->getBacklight()->setMinLED(6);
-    _displays[3]->getBacklight()->setMaxLED(11);
-
-    // battery charge display
-    _displays[4] = new Display(display_type::battery_charge, value_type ::battery_charge,
-                               PIN_DATA, PIN_STORE, PIN_SHIFT,
-                               PIN_BLANK, PIN_LEDCTL);
-    _displays[4]->getBacklight()->setRating(rating_step::poor, 0, 10, Helper::rgbToInt(COLOR_POOR));
-    _displays[4]->getBacklight()->setRating(rating_step::fair, 11, 50, Helper::rgbToInt(COLOR_FAIR));
-    _displays[4]->getBacklight()->setRating(rating_step::good, 51, 90, Helper::rgbToInt(COLOR_GOOD));
-    _displays[4]->getBacklight()->setRating(rating_step::excellent, 91, 100, Helper::rgbToInt(COLOR_EXCELLENT));
-    _displays[4]->getBacklight()->setMinLED(0);
-    _displays[4]->getBacklight()->setMaxLED(3);
-
-    // this display has also the overall status indicator with separate settings for the rating
-    _displays[4]->getOverallBacklight()->setRatingColor(overall_rating::poor, Helper::rgbToInt(COLOR_POOR));
-    _displays[4]->getOverallBacklight()->setRatingColor(overall_rating::fair, Helper::rgbToInt(COLOR_FAIR));
-    _displays[4]->getOverallBacklight()->setRatingColor(overall_rating::good, Helper::rgbToInt(COLOR_GOOD));
-    _displays[4]->getOverallBacklight()->setRatingColor(overall_rating::excellent, Helper::rgbToInt(COLOR_EXCELLENT));
-    _displays[4]->getOverallBacklight()->setMinLED(5);
-    _displays[4]->getOverallBacklight()->setMaxLED(5);
+    _rotationStepCount = 0;
+    _transitionStep = 0;
+    _transitionStepCount = 0;
+
+    // initialize displays as defined in the layout, constructed in place in fixed storage,
+    // the LEDs are chained starting at the last display, the ratings are set from the configuration in begin()
+    for (int i = 0; i < DISPLAY_COUNT; i++)
+    {
+      const DISPLAY_LAYOUT &layout = displayLayout[i];
+      _displays[i] = new (_displayStorage[i]) Display(layout.displayType, layout.valueType, layout.overallStatus,
+                                                      PIN_DATA, PIN_STORE, PIN_SHIFT,
+                                                      PIN_BLANK, PIN_LEDCTL);
+      int firstLED = (DISPLAY_COUNT - 1 - i) * _displays[i]->getLedCount();
+
+      Backlight *backlight = _displays[i]->getBacklight();
+      backlight->setMinLED(firstLED + layout.minLED);
+      backlight->setMaxLED(firstLED + layout.maxLED);
+
+      _flowEffects[i] = nullptr;
+      if (layout.flowEffect)
+      {
+        _flowEffects[i] = new (_flowEffectStorage[i]) FlowEffect(backlight->getMinLED(), backlight->getMaxLED());
+      }
+
+      // this display has also the overall status indicator with separate settings for the rating
+      if (layout.overallStatus)
+      {
+        overallBacklight *overall = _displays[i]->getOverallBacklight();
+        overall->setMinLED(firstLED + layout.overallLED);
+        overall->setMaxLED(firstLED + layout.overallLED);
+      }
+    }
 
     _ledCount = 0;
     for (int i = 0; i < DISPLAY_COUNT; i++)
     {
       _ledCount += _displays[i]->getLedCount();
     }
-    _leds = new Adafruit_NeoPixel(_ledCount, PIN_LEDCTL, NEO_GRB + NEO_KHZ800);
-    _leds->begin();
+    _lastEffectTimestamp = 0;
 
-    _pir = new PIR(PIN_PIR, PIR_DELAY);
+#if VIRTUAL_DISPLAY
+    for (int i = 0; i < DISPLAY_COUNT; i++)
+    {
+      _displays[i]->setVirtualDisplay(&_virtualDisplay);
+    }
+#endif
   }
 
   virtual ~Controller()
   {
-    delete (_pir);
+    if (_events != nullptr)
+    {
+      vQueueDelete(_events);
+    }
     for (int i = 0; i < DISPLAY_COUNT; i++)
     {
-      delete (_displays[i]);
-      delete (_leds);
+      _displays[i]->~Display();
+      if (_flowEffects[i] != nullptr)
+      {
+        _flowEffects[i]->~FlowEffect();
+      }
     }
   }
 
@@ -163,9 +207,25 @@ public:
   {
     int result = ERR_SUCCESS;
 
+    // events waking up the main loop
+    _events = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(controller_event));
+    _wakeupMicros = micros();
+    _lastLoopStatisticsTimestamp = millis();
+
+    // runtime configuration, used by the scheduler and the displays
+    Config::get().begin();
+    applyRatings();
+
+    initPowerManagement();
+    initScheduler();
+
     // clear leds
+    _leds.begin();
     clearLEDs();
 
+    // PWM on the blank line, tubes are blanked until the high voltage is turned on
+    _dimmer.begin();
+
     // set high voltage off
     pinMode(PIN_HVENABLE, OUTPUT);
     pinMode(PIN_HVLED, OUTPUT);
@@ -176,217 +236,450 @@ public:
     pinMode(PIN_DATA, OUTPUT);
     pinMode(PIN_STORE, OUTPUT);
     pinMode(PIN_SHIFT, OUTPUT);
-    pinMode(PIN_BLANK, OUTPUT);
     pinMode(PIN_BUTTON1, INPUT);
 
-    // set blank line to high
-    digitalWrite(PIN_BLANK, HIGH);
-
     clearDisplays();
 
-    // initialize PIR
-    _pir->begin();
+    // restore the cathode usage counters
+    loadCathodeUsage();
+
+    // show the last known values at once, the network comes up meanwhile
+    _snapshot.begin();
+    INVERTER_VALUES values;
+    _snapshotShown = _snapshot.load(&values);
+    _hasValues = _snapshotShown;
+    if (_snapshotShown)
+    {
+      _inverter.setValues(values);
+      for (int i = 0; i < DISPLAY_TYPE_COUNT; i++)
+      {
+        _filters[i].setOutput(getRawValue((display_type)i));
+      }
+      applyValues();
+    }
 
     // high voltage on
     hvON();
 
-    // initialize ethernet
-    int err = initNetwork();
-    if (err != ERR_SUCCESS)
+    // initialize PIR
+    _pir.setDelay(Config::get().getActive().pirDelay);
+    _pir.begin(&Controller::onEvent, this);
+
+    // the button is sampled by its own task
+    _button.begin(&Controller::onEvent, this);
+
+    // initialize the ambient light sensor
+    if (AMBIENT_DIMMING)
     {
-      result = err;
-      // error, shutdown high voltage
-      hvOFF();
+      _lightSensor.begin();
     }
-    else
+
+    // initialize the temperature sensor
+    if (THERMAL_MONITORING)
     {
-      initClient();
+      _temperatureSensor.begin();
     }
+
+    // initialize the GPS clock
+    if (GPS_CLOCK)
+    {
+      _gpsClock.begin(&Controller::onEvent, this);
+    }
+
+    // initialize ethernet in the network task, process() runs meanwhile
+    _network.begin(&Controller::onEvent, this);
     return (result);
   }
 
   // loop
   bool process()
   {
-    // check if it is time to rotate symbols to avoid cathode poisoning
-    if (millis() - _lastRotationTimestamp > ROTATION_INTERVAL * 60 * 1000)
+    // a configuration changed at HTTP /config becomes active between two passes
+    if (Config::get().apply())
     {
-      rotate();
+      applyConfig();
     }
-    else
+
+    // wait for the network before polling
+    if (_networkState != _network.getState())
     {
-      // check if it is time to request new values
-      if (millis() - _lastRequestTimestamp > INVERTER_POLLINGINTERVAL * 1000)
+      _networkState = _network.getState();
+      if (_networkState == network_state::ready)
       {
-        // renew DHCP lease if needed
-        Ethernet.maintain();
-        if (isHVON()) // request values only if HV is on
+        // the IP address is shown until the first values arrive, the last known values stay
+        if (!_snapshotShown)
         {
-          // request inverter values
-          if (_inverter.requestValues(&_client))
-          {
-            D_print("PV power: ");
-            D_println(_inverter.getSolarPower());
-            D_print("Battery Power: ");
-            D_println(_inverter.getBatteryPower());
-            D_print("Grid Power: ");
-            D_println(_inverter.getGridPower());
-            D_print("Load Power: ");
-            D_println(_inverter.getLoadPower());
-            D_print("Battery Charge % ");
-            D_println(_inverter.getBatteryCharge());
-
-            // set values and leds
-            for (int i = 0; i < DISPLAY_COUNT; i++)
-            {
-              double value = getValueByDisplayType(_displays[i]->getDisplayType());
-              setDisplayValue(i, value, _displays[i]->getValueType());
-              switch (_backLight)
-              {
-              case backlight_mode::off:
-                clearLEDs();
-                break;
-
-              case backlight_mode::overall_only:
-                setOverallBacklight(i);
-                break;
-
-              case backlight_mode::full:
-                setBacklight(i, value);
-                setOverallBacklight(i);
-                break;
-              }
-            }
-            // now update all displays
-            updateDisplays();
-
-            // update LEDs
-            if (_backLight != backlight_mode::off)
-            {
-              _leds->show();
-              _backLightState = true;
-            }
-          }
-          _lastRequestTimestamp = millis();
+          showIP();
+        }
+        // first request at once, the tubes may be off already
+        if (isHVON())
+        {
+          _scheduler.enable(_pollTask, 0);
         }
+        // the initialization ends with the network, nothing is allocated from now on
+        HeapGuard::get().seal();
+      }
+      else if (_networkState == network_state::failed)
+      {
+        LOG_ERROR(LOG_CONTROLLER, "Network initialization failed. Error: %d %s",
+                  _network.getError(), Errors::getErrorText(_network.getError()));
+        // error, shutdown high voltage
+        hvOFF();
+        return (false);
       }
     }
 
-    // check if button is pressed
-    _button.process();
-    if (_button.isPressed())
+    // a new firmware has been written by the network task, it runs after a restart
+    if (_network.isRestartPending())
     {
-      D_println("Button pressed");
-      // jump to next backlight mode
-      switch (_backLight)
-      {
-      case backlight_mode::off:
-        _backLight = backlight_mode::overall_only;
-        break;
+      restartFirmware();
+    }
 
-      case backlight_mode::overall_only:
-        _backLight = backlight_mode::full;
-        break;
+    // apply button actions at once, also during transitions and rotations
+    processButton();
 
-      case backlight_mode::full:
-        _backLight = backlight_mode::off;
-        break;
-      }
+    // run the due tasks, digit transition and cathode exercise first
+    _scheduler.run();
 
-      if (_backLight != backlight_mode::off)
-      {
-        if (isHVON())
-        {
-          setLEDs();
-        }
-      }
-      else
-      {
-        clearLEDs();
-      }
+    // show the values received by the network task, not while the digits roll or the cathodes are exercised
+    if (!isTransitionRunning() && !isRotating() && _network.takeValues(&_inverter, &_valuesTimestamp) && isHVON())
+    {
+      LOG_VERBOSE(LOG_CONTROLLER, "PV power: %.0f, Battery Power: %.0f, Grid Power: %.0f, Load Power: %.0f",
+                  _inverter.getSolarPower(), _inverter.getBatteryPower(),
+                  _inverter.getGridPower(), _inverter.getLoadPower());
+      LOG_VERBOSE(LOG_CONTROLLER, "Battery Charge %% %.0f", _inverter.getBatteryCharge());
+
+      // kept in RTC memory to be shown after a reset
+      INVERTER_VALUES values;
+      _inverter.getValues(&values);
+      _snapshot.update(values);
+      _hasValues = true;
+      filterValues();
+      applyValues();
     }
+
+    // send LED colors delayed by a running transmission
+    _leds.update();
+
+    // set the clock from GPS
+    if (GPS_CLOCK)
+    {
+      _gpsClock.process();
+    }
+
     // check PIR status
-    if (_pir->process())
+    if (_pir.process())
     {
       if (!isHVON())
       {
-        // waking up, clear stale values
+        // waking up, clear stale values, hvON() requests new ones at once
         clearDisplays();
       }
+      else if (_fadingOut)
+      {
+        // presence detected again while fading out
+        _fadingOut = false;
+        setBrightness(getTubeBrightness(), TUBE_FADE_TIME);
+      }
       hvON();
     }
+    else if (isHVON())
+    {
+      // fade out, then shutdown high voltage
+      if (!_fadingOut)
+      {
+        _fadingOut = true;
+        setBrightness(0, TUBE_FADE_TIME);
+      }
+      else if (!_dimmer.isFading())
+      {
+        _fadingOut = false;
+        hvOFF();
+        clearLEDs();
+      }
+    }
     else
     {
-      hvOFF();
       clearLEDs();
     }
+
+    if (HEAP_GUARD)
+    {
+      HeapGuard::get().check();
+    }
     return (true);
   }
 
-  // rotate symbols
+  // blocks until an event arrives or the next deadline is reached,
+  // the CPU idles in between, with the tubes off it enters light sleep
+  void waitForEvent()
+  {
+    controller_event event;
+    unsigned long wait = getTimeToNextDeadline();
+
+    _busyTime += micros() - _wakeupMicros;
+    if ((wait > 0) && (xQueueReceive(_events, &event, pdMS_TO_TICKS(wait)) == pdTRUE))
+    {
+      // all pending events are handled by the next process() call
+      while (xQueueReceive(_events, &event, 0) == pdTRUE)
+        ;
+    }
+    _wakeupMicros = micros();
+    _wakeupCount++;
+  }
+
+  // returns the time in ms until the main loop has something to do
+  unsigned long getTimeToNextDeadline() const
+  {
+    unsigned long wait = min((unsigned long)LOOP_MAX_WAIT, _scheduler.getTimeToNextDeadline());
+
+    // LED colors waiting for a running transmission
+    if (_leds.isPending())
+    {
+      wait = min(wait, 1UL);
+    }
+    // fades are checked until done
+    if (_fadingOut)
+    {
+      wait = min(wait, (unsigned long)LOOP_ACTIVE_INTERVAL);
+    }
+    if (isHVON())
+    {
+      wait = min(wait, _pir.getTimeToTimeout());
+    }
+    return (wait);
+  }
+
+  // returns if the digits are rolling to new values
+  bool isTransitionRunning() const
+  {
+    return (_transitionStep < _transitionStepCount);
+  }
+
+  // returns if the cathode exercise is running
+  bool isRotating() const
+  {
+    return (_rotating);
+  }
+
+  // exercise the cathodes which have not been lit recently to avoid cathode poisoning,
+  // scheduler task, one step per run
   void rotate()
   {
-    if (millis() - _lastRotationStepTimestamp > ROTATION_STEPINTERVAL)
+    // wait for the digit transition to finish
+    if (isTransitionRunning())
+    {
+      _scheduler.schedule(_rotationTask, DIGIT_TRANSITION_STEPINTERVAL);
+      return;
+    }
+
+    if (!_rotating)
     {
-      switch (_rotationStep % 10)
+      // generate the exercise schedules, the longest one defines the number of steps
+      // no need to exercise if the tubes are not lit
+      _rotating = true;
+      _rotationStep = 0;
+      _rotationStepCount = 0;
+      for (int i = 0; (i < DISPLAY_COUNT) && isHVON(); i++)
       {
-      case 0:
-        setSymbols(register_type::mu_sign, register_type::mu_sign, register_type::W_sign);
-        break;
-      case 1:
-        setSymbols(register_type::P_sign, register_type::P_sign, register_type::F_sign);
-        break;
-      case 2:
-        setSymbols(register_type::minus_sign, register_type::minus_sign, register_type::A_sign);
-        break;
-      case 3:
-        setSymbols(register_type::plus_sign, register_type::plus_sign, register_type::overall_plus_sign);
-        break;
-      case 4:
-        setSymbols(register_type::m_sign, register_type::m_sign, register_type::H_sign);
-        break;
-      case 5:
-        setSymbols(register_type::M_sign, register_type::M_sign, register_type::V_sign);
-        break;
-      case 6:
-        setSymbols(register_type::k_sign, register_type::k_sign, register_type::S_sign);
-        break;
-      case 7:
-        setSymbols(register_type::pi_sign, register_type::pi_sign, register_type::F_sign);
-        break;
-      case 8:
-        setSymbols(register_type::percent_sign, register_type::percent_sign, register_type::omega_sign);
-        break;
-      case 9:
-        setSymbols(register_type::n_sign, register_type::n_sign, register_type::A_sign);
-        break;
+        uint8_t stepCount = _displays[i]->prepareExercise();
+        if (stepCount > _rotationStepCount)
+        {
+          _rotationStepCount = stepCount;
+        }
       }
+      LOG_VERBOSE(LOG_CONTROLLER, "Cathode exercise steps: %u", _rotationStepCount);
+      _scheduler.setInterval(_rotationTask, Config::get().getActive().rotationStepInterval + 1);
+    }
+
+    if (_rotationStep < _rotationStepCount)
+    {
+      PROFILE_START(probe);
+      setStore(STORE_BEGIN);
       for (int i = 0; i < DISPLAY_COUNT; i++)
       {
-        _displays[i]->setSymbolRegisters();
+        _displays[i]->setSequenceRegisters(_rotationStep);
       }
-      _lastRotationStepTimestamp = millis();
+      setStore(STORE_COMMIT);
+      latchDisplays();
+      PROFILE_STOP(probe, profile_stage::rotation_step);
       _rotationStep++;
-      if (_rotationStep > 20)
+    }
+    else
+    {
+      // exercise done, show the values again
+      _rotating = false;
+      _rotationStep = 0;
+      _scheduler.setInterval(_rotationTask, getRotationInterval());
+      updateDisplays();
+      for (int i = 0; i < DISPLAY_COUNT; i++)
       {
-        _rotationStep = 0;
-        _lastRotationTimestamp = millis();
-        updateDisplays();
+        _displays[i]->getCathodeUsage()->startInterval();
       }
     }
   }
 
-  // set symbols for rotation
-  void setSymbols(register_type symbol0, register_type symbol4, register_type symbol5) const
+  // sets the rating ranges and colors of the configuration on all backlights
+  void applyRatings()
   {
+    const CONFIG &config = Config::get().getActive();
+
     for (int i = 0; i < DISPLAY_COUNT; i++)
     {
-      _displays[i]->setSymbols(symbol0, symbol4, symbol5);
+      Backlight *backlight = _displays[i]->getBacklight();
+      for (int j = 0; j < RATING_COUNT; j++)
+      {
+        backlight->setRating((rating_step)j, config.ratings[i][j].min, config.ratings[i][j].max, config.colors[j]);
+      }
+      if (BACKLIGHT_GRADIENT)
+      {
+        backlight->buildGradient(BACKLIGHT_GAMMA);
+      }
+
+      // the overall status indicator uses the same colors
+      overallBacklight *overall = _displays[i]->getOverallBacklight();
+      if (overall != nullptr)
+      {
+        overall->setRatingColor(overall_rating::poor, config.colors[(int)rating_step::poor]);
+        overall->setRatingColor(overall_rating::fair, config.colors[(int)rating_step::fair]);
+        overall->setRatingColor(overall_rating::good, config.colors[(int)rating_step::good]);
+        overall->setRatingColor(overall_rating::excellent, config.colors[(int)rating_step::excellent]);
+      }
     }
   }
 
-  // get current inverter value by display type
+  // takes over a changed configuration, the inverter address and port are used with the next request
+  void applyConfig()
+  {
+    LOG_INFO(LOG_CONTROLLER, "Configuration changed");
+    _pir.setDelay(Config::get().getActive().pirDelay);
+    applyRatings();
+
+    // the new intervals count from now
+    _scheduler.setInterval(_pollTask, getPollingInterval());
+    if (_scheduler.isEnabled(_pollTask))
+    {
+      _scheduler.schedule(_pollTask, getPollingInterval());
+    }
+    if (!_rotating)
+    {
+      _scheduler.setInterval(_rotationTask, getRotationInterval());
+      _scheduler.schedule(_rotationTask, getRotationInterval());
+    }
+
+    // show the current values with the new ratings
+    if (_hasValues && !isTransitionRunning() && !isRotating() && isHVON())
+    {
+      applyValues();
+    }
+  }
+
+  // sets the values of the inverter on all displays and LEDs
+  void applyValues()
+  {
+    for (int i = 0; i < DISPLAY_COUNT; i++)
+    {
+      double value = getValueByDisplayType(_displays[i]->getDisplayType());
+      setDisplayValue(i, value, _displays[i]->getValueType());
+      if (_flowEffects[i] != nullptr)
+      {
+        _flowEffects[i]->setPower(value);
+      }
+      switch (_backLight)
+      {
+      case backlight_mode::off:
+        clearLEDs();
+        break;
+
+      case backlight_mode::overall_only:
+        setOverallBacklight(i);
+        break;
+
+      case backlight_mode::full:
+        setBacklight(i, value);
+        setOverallBacklight(i);
+        break;
+      }
+    }
+    // now update all displays
+    showValues();
+
+    // update LEDs
+    if (_backLight != backlight_mode::off)
+    {
+      _leds.show();
+      _backLightState = true;
+    }
+  }
+
+  // shows new values on all displays, rolling the changed digits if enabled
+  void showValues()
+  {
+    _transitionStep = 0;
+    _transitionStepCount = 0;
+    if (DIGIT_TRANSITION)
+    {
+      for (int i = 0; i < DISPLAY_COUNT; i++)
+      {
+        uint8_t stepCount = _displays[i]->prepareTransition();
+        if (stepCount > _transitionStepCount)
+        {
+          _transitionStepCount = stepCount;
+        }
+      }
+    }
+
+    if (_transitionStepCount > 0)
+    {
+      showTransitionStep();
+      _scheduler.enable(_transitionTask, DIGIT_TRANSITION_STEPINTERVAL);
+    }
+    else
+    {
+      updateDisplays();
+      recordLatency();
+    }
+  }
+
+  // shows the next frame of the digit transition
+  void showTransitionStep()
+  {
+    setStore(STORE_BEGIN);
+    for (int i = 0; i < DISPLAY_COUNT; i++)
+    {
+      _displays[i]->setSequenceRegisters(_transitionStep);
+    }
+    setStore(STORE_COMMIT);
+    latchDisplays();
+    _transitionStep++;
+  }
+
+  // returns the filtered value shown by a display type
   double getValueByDisplayType(display_type displayType) const
+  {
+    return (_filters[(int)displayType].getOutput());
+  }
+
+  // passes the received values through the filters of their quantities
+  void filterValues()
+  {
+    const CONFIG &config = Config::get().getActive();
+    unsigned long maxGap = getPollingInterval() * FILTER_MAX_GAP;
+
+    for (int i = 0; i < DISPLAY_TYPE_COUNT; i++)
+    {
+      _filters[i].add(getRawValue((display_type)i), config.filters[i], millis(), maxGap);
+    }
+  }
+
+  // returns the overall status of the shown values, no power taken from the grid
+  bool getOverallStatus() const
+  {
+    return (getValueByDisplayType(display_type::grid_power) <= 0);
+  }
+
+  // get current inverter value by display type
+  double getRawValue(display_type displayType) const
   {
     double value = 0.0;
     switch (displayType)
@@ -410,18 +703,37 @@ public:
     case display_type::battery_charge:
       value = _inverter.getBatteryCharge();
       break;
+
+    case display_type::autonomy:
+      value = _inverter.getAutonomy();
+      break;
+
+    case display_type::self_consumption:
+      value = _inverter.getSelfConsumption();
+      break;
     }
     return (value);
   }
 
-  // turn on high voltage
+  // turn on high voltage, the tubes fade in
   void hvON()
   {
     if (!_highVoltageOn)
     {
       _highVoltageOn = true;
+      setBrightness(0, 0);
       digitalWrite(PIN_HVENABLE, HIGH);
       digitalWrite(PIN_HVLED, HIGH);
+      setCathodesLit(true);
+      setBrightness(getTubeBrightness(), TUBE_FADE_TIME);
+      allowLightSleep(false);
+      updateEffects();
+      _scheduler.enable(_ambientTask, 0);
+      // values are only requested while they are shown
+      if (_networkState == network_state::ready)
+      {
+        _scheduler.enable(_pollTask, 0);
+      }
     }
   }
 
@@ -433,6 +745,12 @@ public:
       _highVoltageOn = false;
       digitalWrite(PIN_HVENABLE, LOW);
       digitalWrite(PIN_HVLED, LOW);
+      setCathodesLit(false);
+      setBrightness(0, 0);
+      updateEffects();
+      _scheduler.disable(_ambientTask);
+      _scheduler.disable(_pollTask);
+      allowLightSleep(true);
     }
   }
 
@@ -453,7 +771,7 @@ public:
         break;
       }
     }
-    _leds->show();
+    _leds.show();
     _backLightState = true;
   }
 
@@ -462,40 +780,45 @@ public:
   {
     if (_backLightState)
     {
-      _leds->clear();
-      _leds->show();
+      _leds.clear();
+      _leds.show();
     }
     _backLightState = false;
   }
 
   // set the color of all LEDs of a specific display according to a value
-  void setBacklight(int displayNumber, double value) const
+  void setBacklight(int displayNumber, double value)
   {
-    int color = _displays[displayNumber]->getBacklight()->getColor(value);
+    Backlight *backlight = _displays[displayNumber]->getBacklight();
+    int color = BACKLIGHT_GRADIENT ? backlight->getGradientColor(value) : backlight->getColor(value);
     for (int i = _displays[displayNumber]->getBacklight()->getMinLED(); i <= _displays[displayNumber]->getBacklight()->getMaxLED(); i++)
     {
-      _leds->setPixelColor(i, color);
+      _leds.setPixelColor(i, color);
     }
   }
 
   // set the overall status LED color
-  void setOverallBacklight(int displayNumber) const
+  void setOverallBacklight(int displayNumber)
   {
     // check if correct display
-    if (displayNumber == OVERALL_DISPLAY_NUMBER)
+    if (_displays[displayNumber]->hasOverallStatus())
     {
       overall_rating rating;
+      // the rating follows the shown values, a single spike does not change the color
+      double gridPower = getValueByDisplayType(display_type::grid_power);
+      double batteryPower = getValueByDisplayType(display_type::battery_power);
+      double batteryCharge = getValueByDisplayType(display_type::battery_charge);
 
       // rating rules
-      if (_inverter.getGridPower() <= 0 && _inverter.getBatteryCharge() > 99 && _inverter.getBatteryPower() <= 0)
+      if (gridPower <= 0 && batteryCharge > 99 && batteryPower <= 0)
       {
         rating = overall_rating::excellent;
       }
-      else if (_inverter.getGridPower() <= 0 && _inverter.getBatteryPower() < 0)
+      else if (gridPower <= 0 && batteryPower < 0)
       {
         rating = overall_rating::good;
       }
-      else if (_inverter.getGridPower() <= 0 && _inverter.getBatteryPower() >= 0)
+      else if (gridPower <= 0 && batteryPower >= 0)
       {
         rating = overall_rating::fair;
       }
@@ -508,8 +831,43 @@ public:
       int color = _displays[displayNumber]->getOverallBacklight()->getRatingColor(rating);
       for (int i = _displays[displayNumber]->getOverallBacklight()->getMinLED(); i <= _displays[displayNumber]->getOverallBacklight()->getMaxLED(); i++)
       {
-        _leds->setPixelColor(i, color);
+        _leds.setPixelColor(i, color);
+      }
+    }
+  }
+
+  // runs the effects task only while the effects are shown, it would wake up the loop for nothing otherwise
+  void updateEffects()
+  {
+    if (!_highVoltageOn || (_backLight != backlight_mode::full))
+    {
+      _scheduler.disable(_effectTask);
+    }
+    else if (!_scheduler.isEnabled(_effectTask))
+    {
+      _lastEffectTimestamp = esp_timer_get_time();
+      _scheduler.enable(_effectTask, FLOW_FRAME_INTERVAL);
+    }
+  }
+
+  // renders the animated backlight effects, scheduler task,
+  // the effects are only shown with full backlight
+  void renderEffects()
+  {
+    int64_t now = esp_timer_get_time();
+    uint32_t elapsed = (now - _lastEffectTimestamp) / 1000;
+    _lastEffectTimestamp = now;
+
+    if (_highVoltageOn && _backLightState && (_backLight == backlight_mode::full))
+    {
+      for (int i = 0; i < DISPLAY_COUNT; i++)
+      {
+        if (_flowEffects[i] != nullptr)
+        {
+          _flowEffects[i]->render(&_leds, elapsed);
+        }
       }
+      _leds.show();
     }
   }
 
@@ -523,26 +881,31 @@ public:
   void setDisplayValue(int displayNumber, double value, value_type valueType) const
   {
     DISPLAY_VALUE displayValue = {0};
+    PROFILE_START(probe);
 
     _displays[displayNumber]->clear();
     switch (valueType)
     {
     case value_type::watts:
       Helper::convertDoubleToDisplayValue(value, displayValue);
-      _displays[displayNumber]->setValues(displayValue);
       break;
 
     case value_type::battery_charge:
+    case value_type::percent:
       Helper::convertDoubleToDisplayValue(value, displayValue, true);
-      displayValue.overallStatusPlusFlag = _inverter.getOverallStatus();
-      displayValue.overallStatusMinusFlag = !displayValue.overallStatusPlusFlag;
-      _displays[displayNumber]->setValues(displayValue);
       break;
 
     case value_type::number:
       Helper::convertDoubleToNumericDisplayValue(value, displayValue);
-      _displays[displayNumber]->setValues(displayValue);
+      break;
     }
+    if ((valueType != value_type::number) && _displays[displayNumber]->hasOverallStatus())
+    {
+      displayValue.overallStatusPlusFlag = getOverallStatus();
+      displayValue.overallStatusMinusFlag = !displayValue.overallStatusPlusFlag;
+    }
+    _displays[displayNumber]->setValues(displayValue);
+    PROFILE_STOP(probe, profile_stage::formatting);
   }
 
   // clear the value to display on the given display board
@@ -555,115 +918,665 @@ public:
   void clearDisplays() const
   {
 
-    digitalWrite(PIN_STORE, STORE_BEGIN);
+    setStore(STORE_BEGIN);
     for (int i = 0; i < DISPLAY_COUNT; i++)
     {
       _displays[i]->clear();
       _displays[i]->clearRegisters();
     }
-    digitalWrite(PIN_STORE, STORE_COMMIT);
+    setStore(STORE_COMMIT);
+    latchDisplays();
   }
 
   // updates all display boards
   void updateDisplays() const
   {
-    digitalWrite(PIN_STORE, STORE_BEGIN);
+    setStore(STORE_BEGIN);
     for (int i = 0; i < DISPLAY_COUNT; i++)
     {
       _displays[i]->setRegisters();
     }
-    digitalWrite(PIN_STORE, STORE_COMMIT);
+    setStore(STORE_COMMIT);
+    latchDisplays();
+  }
+
+  // sets the store line of the shift registers
+  void setStore(uint8_t level) const
+  {
+    digitalWrite(PIN_STORE, level);
+#if VIRTUAL_DISPLAY
+    _virtualDisplay.store(level);
+#endif
+  }
+
+  // sets the tube brightness in percent using PWM on the blank line, fading over the given time in ms
+  void setBrightness(uint8_t brightness, uint32_t fadeTime)
+  {
+    _dimmer.setBrightness(brightness, fadeTime);
+#if VIRTUAL_DISPLAY
+    _virtualDisplay.blank(brightness > 0 ? HIGH : LOW);
+#endif
+  }
+
+  // returns the thermal level for a temperature, a level is only left
+  // if the temperature is below its limit by the hysteresis
+  thermal_level getThermalLevel(float temperature) const
+  {
+    thermal_level level = thermal_level::normal;
+
+    if ((temperature >= THERMAL_HOT) ||
+        ((_thermalLevel == thermal_level::hot) && (temperature > THERMAL_HOT - THERMAL_HYSTERESIS)))
+    {
+      level = thermal_level::hot;
+    }
+    else if ((temperature >= THERMAL_WARM) ||
+             ((_thermalLevel != thermal_level::normal) && (temperature > THERMAL_WARM - THERMAL_HYSTERESIS)))
+    {
+      level = thermal_level::warm;
+    }
+    return (level);
+  }
+
+  // returns the brightness in percent allowed by the thermal level
+  uint8_t getThermalBrightness() const
+  {
+    uint8_t brightness = 100;
+
+    switch (_thermalLevel)
+    {
+    case thermal_level::normal:
+      break;
+
+    case thermal_level::warm:
+      brightness = THERMAL_WARM_BRIGHTNESS;
+      break;
+
+    case thermal_level::hot:
+      brightness = THERMAL_HOT_BRIGHTNESS;
+      break;
+    }
+    return (brightness);
+  }
+
+  // returns the inverter polling interval in ms, longer if the enclosure is hot
+  unsigned long getPollingInterval() const
+  {
+    unsigned long interval = Config::get().getActive().pollingInterval * 1000UL;
+
+    if (_thermalLevel == thermal_level::hot)
+    {
+      interval *= THERMAL_HOT_POLLING_FACTOR;
+    }
+    return (interval);
+  }
+
+  // returns the interval of the cathode exercise in ms
+  unsigned long getRotationInterval() const
+  {
+    return (Config::get().getActive().rotationInterval * 60 * 1000UL);
+  }
+
+  // returns the enclosure temperature in degrees celsius, NAN if not available
+  float getTemperature() const
+  {
+    return (_temperatureSensor.isValid() ? _temperatureSensor.getTemperature() : NAN);
+  }
+
+  // returns if the local time is within the night hours, false without a synchronized clock
+  bool isNight() const
+  {
+    bool result = false;
+    struct tm localTime;
+
+    if (_gpsClock.getLocalTime(&localTime))
+    {
+      if (NIGHT_START > NIGHT_END)
+      {
+        result = (localTime.tm_hour >= NIGHT_START) || (localTime.tm_hour < NIGHT_END);
+      }
+      else
+      {
+        result = (localTime.tm_hour >= NIGHT_START) && (localTime.tm_hour < NIGHT_END);
+      }
+    }
+    return (result);
+  }
+
+  // returns the LED brightness in percent for the current conditions
+  uint8_t getLedBrightness() const
+  {
+    uint16_t brightness = _ambientBrightness * getThermalBrightness() / 100;
+
+    if (_nightDimmed)
+    {
+      brightness = brightness * NIGHT_BRIGHTNESS / 100;
+    }
+    return (brightness);
+  }
+
+  // returns the tube brightness in percent for the current conditions
+  uint8_t getTubeBrightness() const
+  {
+    return (TUBE_BRIGHTNESS * getLedBrightness() / 100);
+  }
+
+  // applies the brightness for the current conditions to tubes and LEDs
+  void updateBrightness(uint32_t fadeTime)
+  {
+    _leds.setBrightness(getLedBrightness());
+    if (_backLightState)
+    {
+      _leds.show();
+    }
+    if (isHVON() && !_fadingOut)
+    {
+      setBrightness(getTubeBrightness(), fadeTime);
+    }
+  }
+
+  // informs all display boards that the shifted frames are visible now
+  void latchDisplays() const
+  {
+    for (int i = 0; i < DISPLAY_COUNT; i++)
+    {
+      _displays[i]->latchFrame();
+    }
+  }
+
+  // informs the cathode usage counters about the high voltage state
+  void setCathodesLit(bool lit) const
+  {
+    for (int i = 0; i < DISPLAY_COUNT; i++)
+    {
+      _displays[i]->getCathodeUsage()->setLit(lit);
+    }
+  }
+
+  // reads the cathode usage counters of all display boards from NVS
+  void loadCathodeUsage()
+  {
+    char key[16];
+
+    if (_preferences.begin(CATHODE_USAGE_NAMESPACE, false))
+    {
+      for (int i = 0; i < DISPLAY_COUNT; i++)
+      {
+        sprintf(key, "usage%d", i);
+        if (!_displays[i]->getCathodeUsage()->load(_preferences, key))
+        {
+          LOG_WARNING(LOG_DISPLAY, "No cathode usage stored for display %d", i);
+        }
+      }
+    }
+    else
+    {
+      LOG_ERROR(LOG_DISPLAY, "Failed to open cathode usage storage");
+    }
+  }
+
+  // saves the counters and the last values, then restarts with the new firmware
+  void restartFirmware()
+  {
+    LOG_INFO(LOG_CONTROLLER, "Restarting with the new firmware");
+    saveCathodeUsage();
+    saveSnapshot();
+    hvOFF();
+    clearLEDs();
+    // let the logger print the last messages
+    delay(LOG_FLUSH_INTERVAL * 2);
+    ESP.restart();
+  }
+
+  // writes the last values to NVS, scheduler task
+  void saveSnapshot()
+  {
+    if (!_snapshot.save())
+    {
+      LOG_ERROR(LOG_CONTROLLER, "Failed to save the last values");
+    }
+  }
+
+  // writes the cathode usage counters of all display boards to NVS
+  void saveCathodeUsage()
+  {
+    char key[16];
+
+    // NVS allocates internally
+    HeapGuard::get().suspend();
+    for (int i = 0; i < DISPLAY_COUNT; i++)
+    {
+      sprintf(key, "usage%d", i);
+      if (!_displays[i]->getCathodeUsage()->save(_preferences, key))
+      {
+        LOG_ERROR(LOG_DISPLAY, "Failed to save cathode usage of display %d", i);
+      }
+    }
+    HeapGuard::get().resume();
   }
 
 private:
   bool _highVoltageOn;
-  byte _mac[6];
-  EthernetClient _client;
+  bool _fadingOut;
+  Network _network;
+  network_state _networkState;
   Inverter _inverter;
-  unsigned long _lastRequestTimestamp;
-  unsigned long _lastRotationTimestamp;
-  unsigned long _lastRotationStepTimestamp;
+  int64_t _valuesTimestamp; // in us, when the values not yet latched have been received
+  Snapshot _snapshot;
+  SignalFilter _filters[DISPLAY_TYPE_COUNT]; // per quantity, the displays show the filtered values
+  bool _snapshotShown; // the values restored at boot are shown
+  bool _hasValues;     // values have been received or restored at boot
+  bool _rotating;
   int _rotationStep;
-  bool _rotation;
-  backlight_mode _backLight;
-  bool _backLightState;
+  uint8_t _rotationStepCount;
+  uint8_t _transitionStep;
+  uint8_t _transitionStepCount;
+  volatile backlight_mode _backLight;
+  volatile bool _backLightState;
   Button _button;
+  Dimmer _dimmer;
+  LightSensor _lightSensor;
+  uint8_t _ambientBrightness; // in percent
+  TemperatureSensor _temperatureSensor;
+  thermal_level _thermalLevel;
+  GpsClock _gpsClock;
+  bool _nightDimmed;
   Display *_displays[DISPLAY_COUNT];
-  Adafruit_NeoPixel *_leds;
+  LedStrip _leds;
+  FlowEffect *_flowEffects[DISPLAY_COUNT];
+  int64_t _lastEffectTimestamp; // in us
   uint8_t _ledCount;
-  PIR *_pir;
+  PIR _pir;
+  Scheduler _scheduler;
+  uint8_t _transitionTask;
+  uint8_t _rotationTask;
+  uint8_t _pollTask;
+  uint8_t _effectTask;
+  uint8_t _ambientTask;
+  uint8_t _thermalTask;
+  uint8_t _nightTask;
+  uint8_t _persistenceTask;
+  uint8_t _snapshotTask;
+  uint8_t _metricsTask;
+  uint8_t _profileTask;
+  QueueHandle_t _events;
+  esp_pm_lock_handle_t _sleepLock;
+  bool _sleepLocked;
+  unsigned long _wakeupCount;
+  unsigned long _busyTime; // in us
+  unsigned long _wakeupMicros;
+  unsigned long _lastLoopStatisticsTimestamp;
+  Preferences _preferences;
+#if VIRTUAL_DISPLAY
+  mutable VirtualDisplay _virtualDisplay; // only observes the output lines
+#endif
+
+  // storage of the displays and flow effects, constructed in place at boot
+  alignas(Display) uint8_t _displayStorage[DISPLAY_COUNT][sizeof(Display)];
+  alignas(FlowEffect) uint8_t _flowEffectStorage[DISPLAY_COUNT][sizeof(FlowEffect)];
+
+  // returns the time in ms until an interval since a timestamp has elapsed
+  static unsigned long getRemainingTime(unsigned long timestamp, unsigned long interval)
+  {
+    unsigned long elapsed = millis() - timestamp;
+    return ((elapsed < interval) ? interval - elapsed : 0);
+  }
 
-  // initializes the network hardware
-  uint8_t initNetwork()
+  // posts an event to wake up the main loop, called from tasks and from the PIR interrupt
+  static void IRAM_ATTR onEvent(void *arg, controller_event event)
   {
-    int result = ERR_SUCCESS;
+    Controller *controller = (Controller *)arg;
+    if (xPortInIsrContext())
+    {
+      BaseType_t woken = pdFALSE;
+      xQueueSendFromISR(controller->_events, &event, &woken);
+      if (woken)
+      {
+        portYIELD_FROM_ISR();
+      }
+    }
+    else
+    {
+      xQueueSend(controller->_events, &event, 0);
+    }
+  }
 
-    D_println("Initializing network...");
-    D_println("Getting mac address");
-    // get mac address, this ESP32 type provides an ethernet mac address
-    esp_err_t err = esp_read_mac(_mac, ESP_MAC_ETH);
-    if (err == ESP_OK)
-    {
-      char buffer[18] = {0};
-      sprintf(buffer, "%2X:%2X:%2X:%2X:%2X:%2X",
-              _mac[0], _mac[1], _mac[2], _mac[3], _mac[4], _mac[5]);
-      D_print("MAC Address: ");
-      D_println(buffer);
-
-      // init Ethernet lib using DHCP
-      D_println("Initializing ethernet port...");
-      Ethernet.init(PIN_CS);
-      D_println("Getting IP address using DHCP...");
-      if (Ethernet.begin(_mac) != 0)
-      {
-        // give time to initalize
-        delay(1000);
-        D_print("DHCP assigned IP: ");
-        D_println(Ethernet.localIP());
-        D_print("Gateway: ");
-        D_println(Ethernet.gatewayIP());
-        D_print("DNS Server ");
-        D_println(Ethernet.dnsServerIP());
-        // display IP address
-        setDisplayValue(0, (double)Ethernet.localIP()[0], value_type::number);
-        setDisplayValue(1, (double)Ethernet.localIP()[1], value_type::number);
-        setDisplayValue(2, (double)Ethernet.localIP()[2], value_type::number);
-        setDisplayValue(3, (double)Ethernet.localIP()[3], value_type::number);
-        clearDisplayValue(4);
-        updateDisplays();
-        delay(1000);
-        result = ERR_SUCCESS;
+  // enables light sleep while the main loop waits, the PIR and the button wake up the CPU
+  void initPowerManagement()
+  {
+#if CONFIG_PM_ENABLE
+    if (LIGHT_SLEEP)
+    {
+      esp_pm_config_esp32_t config = {};
+      config.max_freq_mhz = 240;
+      config.min_freq_mhz = 80;
+      config.light_sleep_enable = true;
+      if ((esp_pm_configure(&config) != ESP_OK) ||
+          (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "tubes", &_sleepLock) != ESP_OK))
+      {
+        LOG_WARNING(LOG_CONTROLLER, "Light sleep not available");
+        _sleepLock = nullptr;
+        return;
+      }
+      // light sleep stops the PWM on the blank line, so it is only allowed with the tubes off
+      esp_pm_lock_acquire(_sleepLock);
+      _sleepLocked = true;
+      esp_sleep_enable_gpio_wakeup();
+    }
+#endif
+  }
+
+  // allows or prevents light sleep
+  void allowLightSleep(bool allow)
+  {
+#if CONFIG_PM_ENABLE
+    if ((_sleepLock != nullptr) && (allow == _sleepLocked))
+    {
+      if (allow)
+      {
+        _pir.enableWakeup();
+        _button.enableWakeup();
+        esp_pm_lock_release(_sleepLock);
       }
       else
       {
-        D_println("Failed to initialize network using DHCP");
-        if (Ethernet.hardwareStatus() == EthernetNoHardware)
-        {
-          D_println("Ethernet port not found");
-          result = ERR_ETHERNET_NOHARDWARE;
-        }
-        else
-        {
-          if (Ethernet.linkStatus() == LinkOFF)
-          {
-            D_println("Ethernet cable not connected");
-            result = ERR_ETHERNET_LINKOFF;
-          }
-        }
+        esp_pm_lock_acquire(_sleepLock);
+        _pir.disableWakeup();
+        _button.disableWakeup();
+      }
+      _sleepLocked = !allow;
+    }
+#endif
+  }
+
+  // registers the periodic jobs of the main loop, tasks registered first run first on equal deadlines
+  void initScheduler()
+  {
+    _transitionTask = _scheduler.add("transition", [](void *arg)
+                                     { ((Controller *)arg)->processTransition(); }, this,
+                                     DIGIT_TRANSITION_STEPINTERVAL, BUDGET_TRANSITION, false);
+    _rotationTask = _scheduler.add("rotation", [](void *arg)
+                                   { ((Controller *)arg)->rotate(); }, this,
+                                   getRotationInterval(), BUDGET_ROTATION);
+    // enabled when the network is ready
+    _pollTask = _scheduler.add("poll", [](void *arg)
+                               { ((Controller *)arg)->poll(); }, this,
+                               getPollingInterval(), BUDGET_POLL, false);
+
+    // enabled with the high voltage
+    _effectTask = SCHEDULER_NO_TASK;
+    for (int i = 0; (i < DISPLAY_COUNT) && (_effectTask == SCHEDULER_NO_TASK); i++)
+    {
+      if (_flowEffects[i] != nullptr)
+      {
+        _effectTask = _scheduler.add("effects", [](void *arg)
+                                     { ((Controller *)arg)->renderEffects(); }, this,
+                                     FLOW_FRAME_INTERVAL, BUDGET_EFFECTS, false);
+      }
+    }
+    _ambientTask = SCHEDULER_NO_TASK;
+    if (AMBIENT_DIMMING)
+    {
+      _ambientTask = _scheduler.add("ambient", [](void *arg)
+                                    { ((Controller *)arg)->processAmbientLight(); }, this,
+                                    AMBIENT_READ_INTERVAL, BUDGET_AMBIENT, false);
+    }
+
+    _thermalTask = SCHEDULER_NO_TASK;
+    if (THERMAL_MONITORING)
+    {
+      _thermalTask = _scheduler.add("thermal", [](void *arg)
+                                    { ((Controller *)arg)->processTemperature(); }, this,
+                                    0, BUDGET_THERMAL);
+    }
+    _nightTask = SCHEDULER_NO_TASK;
+    if (NIGHT_DIMMING)
+    {
+      _nightTask = _scheduler.add("night", [](void *arg)
+                                  { ((Controller *)arg)->processNightDimming(); }, this,
+                                  60 * 1000UL, BUDGET_NIGHT);
+      _scheduler.trigger(_nightTask);
+    }
+    // batched to keep the flash wear low
+    _persistenceTask = _scheduler.add("persistence", [](void *arg)
+                                      { ((Controller *)arg)->saveCathodeUsage(); }, this,
+                                      CATHODE_USAGE_SAVE_INTERVAL * 60 * 1000UL, BUDGET_PERSISTENCE);
+    _snapshotTask = _scheduler.add("snapshot", [](void *arg)
+                                   { ((Controller *)arg)->saveSnapshot(); }, this,
+                                   SNAPSHOT_SAVE_INTERVAL * 60 * 1000UL, BUDGET_SNAPSHOT);
+    _metricsTask = SCHEDULER_NO_TASK;
+#if DEBUG
+    _metricsTask = _scheduler.add("metrics", [](void *arg)
+                                  { ((Controller *)arg)->printStatistics(); }, this,
+                                  60 * 1000UL, BUDGET_METRICS);
+#endif
+    _profileTask = SCHEDULER_NO_TASK;
+#if PROFILING
+    _profileTask = _scheduler.add("profile", [](void *arg)
+                                  { Profiler::get().print(Serial); }, this,
+                                  PROFILE_PRINT_INTERVAL * 1000UL, BUDGET_METRICS);
+#endif
+  }
+
+  // records the time from receiving the values until the final values are latched
+  void recordLatency()
+  {
+#if PROFILING
+    if (_valuesTimestamp != 0)
+    {
+      Profiler::get().record(profile_stage::end_to_end, esp_timer_get_time() - _valuesTimestamp);
+      _valuesTimestamp = 0;
+    }
+#endif
+  }
+
+  // shows the next step of the digit transition, scheduler task
+  void processTransition()
+  {
+    if (isTransitionRunning())
+    {
+      showTransitionStep();
+    }
+    if (!isTransitionRunning())
+    {
+      _scheduler.disable(_transitionTask);
+      recordLatency();
+    }
+  }
+
+  // asks the network task for new values, scheduler task
+  void poll()
+  {
+    // the interval follows the thermal level
+    _scheduler.setInterval(_pollTask, getPollingInterval());
+    if (isHVON()) // request values only if HV is on
+    {
+      _network.requestValues();
+    }
+  }
+
+  // requests new values at once if the network is ready
+  void pollNow()
+  {
+    if (_scheduler.isEnabled(_pollTask))
+    {
+      _scheduler.trigger(_pollTask);
+    }
+  }
+
+  // dims tubes and LEDs according to the ambient light, scheduler task, runs only with the tubes on
+  void processAmbientLight()
+  {
+    if (_lightSensor.process())
+    {
+      uint8_t brightness = _lightSensor.getBrightness();
+      if ((abs(brightness - _ambientBrightness) >= AMBIENT_HYSTERESIS) ||
+          ((brightness != _ambientBrightness) && ((brightness == 100) || (brightness == AMBIENT_MIN_BRIGHTNESS))))
+      {
+        LOG_INFO(LOG_SENSORS, "Ambient light: %.1f lux, brightness %u", _lightSensor.getLux(), brightness);
+        _ambientBrightness = brightness;
+        updateBrightness(AMBIENT_FADE_TIME);
       }
     }
+    // follow the read interval of the sensor, stop if there is no sensor
+    if (_lightSensor.getTimeToNextRead() == NO_DEADLINE)
+    {
+      _scheduler.disable(_ambientTask);
+    }
     else
     {
-      D_println("Failed to retrieve mac address");
-      result = ERR_ETHERNET_NOMAC;
+      _scheduler.schedule(_ambientTask, _lightSensor.getTimeToNextRead());
     }
-    return (result);
   }
 
-  // initialize ethernet client
-  bool initClient()
+  // throttles tubes, LEDs and polling if the enclosure gets too warm, scheduler task
+  void processTemperature()
   {
-    _client.setTimeout(10000);
-    return (true);
+    if (_temperatureSensor.process())
+    {
+      _network.setTemperature(getTemperature());
+      thermal_level level = getThermalLevel(_temperatureSensor.getTemperature());
+      if (level != _thermalLevel)
+      {
+        LOG_INFO(LOG_SENSORS, "Temperature: %.1f C, thermal level %d",
+                 _temperatureSensor.getTemperature(), (int)level);
+        _thermalLevel = level;
+        updateBrightness(AMBIENT_FADE_TIME);
+      }
+    }
+    // the conversion time and the read interval are defined by the sensor
+    if (_temperatureSensor.getTimeToNextRead() == NO_DEADLINE)
+    {
+      _scheduler.disable(_thermalTask);
+    }
+    else
+    {
+      _scheduler.schedule(_thermalTask, _temperatureSensor.getTimeToNextRead());
+    }
+  }
+
+  // dims tubes and LEDs during the night, scheduler task
+  void processNightDimming()
+  {
+    bool night = isNight();
+    if (night != _nightDimmed)
+    {
+      LOG_INFO(LOG_CONTROLLER, night ? "Night dimming on" : "Night dimming off");
+      _nightDimmed = night;
+      updateBrightness(AMBIENT_FADE_TIME);
+    }
+  }
+
+#if DEBUG
+  // prints the loop, LED, PIR and scheduler statistics, scheduler task
+  void printStatistics()
+  {
+    unsigned long elapsed = millis() - _lastLoopStatisticsTimestamp;
+
+    // wakeups and share of time spent in process(), a proxy for CPU load and current draw
+    D_print("Loop: ");
+    D_print(_wakeupCount * 1000.0 / elapsed);
+    D_print(" wakeups/s, ");
+    D_print(_busyTime / (elapsed * 10.0));
+    D_println(" % busy");
+    // time spent sending LED colors
+    D_print("LED output: ");
+    D_print(_leds.takeOutputTime() * 1000 / elapsed);
+    D_println(" us/s");
+    D_print("PIR: ");
+    D_print(_pir.getInterruptsPerMinute());
+    D_println(" interrupts/min");
+    D_print("Temperature: ");
+    D_print(getTemperature());
+    D_println(" C");
+    HeapGuard::get().print(Serial);
+    D_print("JSON arena: ");
+    D_print((unsigned long)_network.getJsonArena()->getPeak());
+    D_print(" of ");
+    D_print(JSON_ARENA_SIZE);
+    D_print(" bytes peak, ");
+    D_print(_network.getJsonArena()->getFailures());
+    D_println(" failures");
+    _scheduler.printStatistics(Serial);
+    _scheduler.resetStatistics();
+    _wakeupCount = 0;
+    _busyTime = 0;
+    _lastLoopStatisticsTimestamp = millis();
+  }
+#endif
+
+  // shows the IP address on the first 4 displays
+  void showIP()
+  {
+    IPAddress ip = _network.getLocalIP();
+
+    for (int i = 0; i < DISPLAY_COUNT; i++)
+    {
+      if (i < 4)
+      {
+        setDisplayValue(i, (double)ip[i], value_type::number);
+      }
+      else
+      {
+        clearDisplayValue(i);
+      }
+    }
+    updateDisplays();
+  }
+
+  // applies the actions recognized by the button task
+  void processButton()
+  {
+    BUTTON_EVENT event;
+
+    while (_button.getAction(&event))
+    {
+      LOG_VERBOSE(LOG_INPUT, "Button action %d, latency %lu ms", (int)event.action, millis() - event.timestamp);
+      switch (event.action)
+      {
+      case button_action::click:
+        // jump to next backlight mode
+        switch (_backLight)
+        {
+        case backlight_mode::off:
+          _backLight = backlight_mode::overall_only;
+          break;
+
+        case backlight_mode::overall_only:
+          _backLight = backlight_mode::full;
+          break;
+
+        case backlight_mode::full:
+          _backLight = backlight_mode::off;
+          break;
+        }
+
+        if (_backLight != backlight_mode::off)
+        {
+          if (isHVON())
+          {
+            setLEDs();
+          }
+        }
+        else
+        {
+          clearLEDs();
+        }
+        updateEffects();
+        break;
+
+      case button_action::double_click:
+        // request new values at once
+        pollNow();
+        break;
+
+      case button_action::long_press:
+        // start the cathode exercise at once, unless it is already running
+        if (isHVON() && !isRotating())
+        {
+          _scheduler.trigger(_rotationTask);
+        }
+        break;
+      }
+    }
   }
 };
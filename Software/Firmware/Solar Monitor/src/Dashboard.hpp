@@ -0,0 +1,187 @@
+// Dashboard.hpp
+
+// serves the dashboard page and pushes the values received by the network task
+// to the connected browsers as server-sent events
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Profiler.hpp>
+#include <Inverter.hpp>
+#include <DashboardPage.h>
+
+#define DASHBOARD_MAX_VIEWERS 4            // browsers receiving the events at the same time
+#define DASHBOARD_KEEPALIVE_INTERVAL 15000 // in ms, closed connections are found by sending a comment
+#define DASHBOARD_RETRY 5000               // in ms, browsers reconnect after this time
+#define DASHBOARD_EVENT_SIZE 256
+
+class Dashboard
+{
+public:
+  Dashboard()
+  {
+    for (int i = 0; i < DASHBOARD_MAX_VIEWERS; i++)
+    {
+      _active[i] = false;
+    }
+    _event[0] = '\0';
+    _eventLength = 0;
+    _lastKeepAlive = 0;
+    _skipped = 0;
+  }
+
+  virtual ~Dashboard()
+  {
+  }
+
+  // sends the compressed page, the browser inflates it
+  void sendPage(EthernetClient &client)
+  {
+    client.println(F("HTTP/1.1 200 OK"));
+    client.println(F("Content-Type: text/html"));
+    client.println(F("Content-Encoding: gzip"));
+    client.print(F("Content-Length: "));
+    client.println((unsigned int)sizeof(dashboardPage));
+    client.println(F("Connection: close"));
+    client.println();
+    client.write(dashboardPage, sizeof(dashboardPage));
+  }
+
+  // keeps the client open to receive the events, the last values are sent at once,
+  // returns false if all viewers are taken
+  bool addViewer(EthernetClient &client)
+  {
+    for (int i = 0; i < DASHBOARD_MAX_VIEWERS; i++)
+    {
+      if (_active[i] && !_viewers[i].connected())
+      {
+        removeViewer(i);
+      }
+      if (!_active[i])
+      {
+        _viewers[i] = client;
+        _active[i] = true;
+        client.println(F("HTTP/1.1 200 OK"));
+        client.println(F("Content-Type: text/event-stream"));
+        client.println(F("Cache-Control: no-cache"));
+        client.println(F("Connection: keep-alive"));
+        client.println();
+        client.print(F("retry: "));
+        client.println(DASHBOARD_RETRY);
+        client.println();
+        if (_eventLength > 0)
+        {
+          send(i, _event, _eventLength);
+        }
+        LOG_INFO(LOG_NETWORK, "Dashboard viewer %d connected", i);
+        return (true);
+      }
+    }
+    return (false);
+  }
+
+  // sends new values and the enclosure temperature to all viewers, no viewer is waited for,
+  // the temperature is null without sensor
+  void publish(const INVERTER_VALUES &values, float temperature)
+  {
+    char temperatureText[12] = "null";
+
+    if (!isnan(temperature))
+    {
+      snprintf(temperatureText, sizeof(temperatureText), "%.1f", temperature);
+    }
+    int length = snprintf(_event, sizeof(_event),
+                          "data: {\"P_PV\":%.0f,\"P_Akku\":%.0f,\"P_Grid\":%.0f,\"P_Load\":%.0f,"
+                          "\"SOC\":%.1f,\"rel_Autonomy\":%.1f,\"rel_SelfConsumption\":%.1f,\"T_Enclosure\":%s}\n\n",
+                          values.P_PV, values.P_Akku, values.P_Grid, values.P_Load,
+                          values.SOC, values.rel_Autonomy, values.rel_SelfConsumption, temperatureText);
+    _eventLength = ((length > 0) && ((size_t)length < sizeof(_event))) ? length : 0;
+    for (int i = 0; (i < DASHBOARD_MAX_VIEWERS) && (_eventLength > 0); i++)
+    {
+      if (_active[i])
+      {
+        send(i, _event, _eventLength);
+      }
+    }
+  }
+
+  // sends a comment in the keep-alive interval to find the closed connections, called by the network task
+  void process()
+  {
+    static const char comment[] = ":\n\n";
+
+    if (millis() - _lastKeepAlive >= DASHBOARD_KEEPALIVE_INTERVAL)
+    {
+      _lastKeepAlive = millis();
+      for (int i = 0; i < DASHBOARD_MAX_VIEWERS; i++)
+      {
+        if (_active[i])
+        {
+          send(i, comment, sizeof(comment) - 1);
+        }
+      }
+    }
+  }
+
+  // returns the number of connected viewers
+  int getViewerCount() const
+  {
+    int count = 0;
+
+    for (int i = 0; i < DASHBOARD_MAX_VIEWERS; i++)
+    {
+      if (_active[i])
+      {
+        count++;
+      }
+    }
+    return (count);
+  }
+
+  // returns the number of events not sent because the socket buffer of a viewer was full
+  unsigned long getSkipped() const
+  {
+    return (_skipped);
+  }
+
+private:
+  EthernetClient _viewers[DASHBOARD_MAX_VIEWERS];
+  bool _active[DASHBOARD_MAX_VIEWERS];
+  char _event[DASHBOARD_EVENT_SIZE]; // last event, sent to new viewers
+  size_t _eventLength;
+  unsigned long _lastKeepAlive;
+  unsigned long _skipped;
+
+  // writes only if the socket buffer takes the whole event, a slow viewer misses it,
+  // a closed connection is removed
+  void send(int i, const char *data, size_t length)
+  {
+    PROFILE_START(probe);
+    if (!_viewers[i].connected())
+    {
+      removeViewer(i);
+    }
+    else if (_viewers[i].availableForWrite() >= (int)length)
+    {
+      _viewers[i].write((const uint8_t *)data, length);
+    }
+    else
+    {
+      _skipped++;
+    }
+    PROFILE_STOP(probe, profile_stage::event_push);
+  }
+
+  void removeViewer(int i)
+  {
+    _viewers[i].stop();
+    _active[i] = false;
+    LOG_INFO(LOG_NETWORK, "Dashboard viewer %d disconnected", i);
+  }
+};
@@ -0,0 +1,178 @@
+// Dimmer.hpp
+
+// dims the tubes using PWM on the blank line, fades are driven by a timer
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+
+#define DIMMER_FREQUENCY 1000  // PWM frequency in Hz
+#define DIMMER_RESOLUTION 10   // PWM resolution in bits
+#define DIMMER_FADE_INTERVAL 5 // fade step interval in ms
+
+class Dimmer
+{
+public:
+  Dimmer(uint8_t pin, uint8_t channel) : _pin(pin), _channel(channel)
+  {
+    _timer = nullptr;
+    _duty = 0;
+    _startDuty = 0;
+    _targetDuty = 0;
+    _fadeStart = 0;
+    _fadeTime = 0;
+    _fading = false;
+    _lock = portMUX_INITIALIZER_UNLOCKED;
+  }
+
+  virtual ~Dimmer()
+  {
+    if (_timer != nullptr)
+    {
+      esp_timer_stop(_timer);
+      esp_timer_delete(_timer);
+    }
+  }
+
+  // initializes PWM and the fade timer, the tubes are blanked
+  void begin()
+  {
+    ledcSetup(_channel, DIMMER_FREQUENCY, DIMMER_RESOLUTION);
+    ledcAttachPin(_pin, _channel);
+    ledcWrite(_channel, 0);
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = &Dimmer::onTimer;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "dimmer";
+    if (esp_timer_create(&timerArgs, &_timer) != ESP_OK)
+    {
+      LOG_ERROR(LOG_DISPLAY, "Failed to create dimmer timer");
+      _timer = nullptr;
+    }
+  }
+
+  // sets the brightness in percent, fading from the current brightness over the given time in ms,
+  // without fade time a running fade is stopped and the brightness is set at once
+  void setBrightness(uint8_t brightness, uint32_t fadeTime)
+  {
+    uint32_t duty = toDuty(brightness);
+    bool instant = (fadeTime == 0) || (_timer == nullptr);
+    bool startTimer = false;
+    bool stopTimer = false;
+
+    portENTER_CRITICAL(&_lock);
+    _startDuty = _duty;
+    _targetDuty = duty;
+    _fadeStart = esp_timer_get_time();
+    _fadeTime = (int64_t)fadeTime * 1000;
+    instant = instant || (_startDuty == _targetDuty);
+    if (instant)
+    {
+      // a timer call already on its way only sets the target again
+      stopTimer = _fading;
+      _duty = _targetDuty;
+      _startDuty = _targetDuty;
+      _fadeTime = 0;
+      _fading = false;
+    }
+    else if (!_fading)
+    {
+      _fading = true;
+      startTimer = true;
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    if (stopTimer)
+    {
+      esp_timer_stop(_timer);
+    }
+    if (startTimer)
+    {
+      esp_timer_start_once(_timer, DIMMER_FADE_INTERVAL * 1000);
+    }
+    else if (instant)
+    {
+      ledcWrite(_channel, duty);
+    }
+  }
+
+  // returns the brightness in percent, while fading the current brightness
+  uint8_t getBrightness() const
+  {
+    return ((_duty * 100 + getMaxDuty() / 2) / getMaxDuty());
+  }
+
+  // returns if a fade is in progress
+  bool isFading() const
+  {
+    return (_fading);
+  }
+
+private:
+  uint8_t _pin;
+  uint8_t _channel;
+  esp_timer_handle_t _timer;
+  portMUX_TYPE _lock;
+  volatile uint32_t _duty;
+  uint32_t _startDuty;
+  uint32_t _targetDuty;
+  int64_t _fadeStart; // in us
+  int64_t _fadeTime;  // in us
+  volatile bool _fading;
+
+  static uint32_t getMaxDuty()
+  {
+    return ((1 << DIMMER_RESOLUTION) - 1);
+  }
+
+  static uint32_t toDuty(uint8_t brightness)
+  {
+    if (brightness > 100)
+    {
+      brightness = 100;
+    }
+    return ((getMaxDuty() * brightness + 50) / 100);
+  }
+
+  static void onTimer(void *arg)
+  {
+    ((Dimmer *)arg)->fade();
+  }
+
+  // called by the timer, sets the duty cycle for the elapsed fade time
+  // and restarts the timer until the fade is done
+  void fade()
+  {
+    bool done = false;
+
+    portENTER_CRITICAL(&_lock);
+    int64_t elapsed = esp_timer_get_time() - _fadeStart;
+    if (elapsed >= _fadeTime)
+    {
+      _duty = _targetDuty;
+      done = true;
+      _fading = false;
+    }
+    else
+    {
+      int64_t delta = ((int64_t)_targetDuty - (int64_t)_startDuty) * elapsed / _fadeTime;
+      _duty = _startDuty + delta;
+    }
+    uint32_t duty = _duty;
+    portEXIT_CRITICAL(&_lock);
+
+    ledcWrite(_channel, duty);
+    if (!done)
+    {
+      esp_timer_start_once(_timer, DIMMER_FADE_INTERVAL * 1000);
+    }
+  }
+};
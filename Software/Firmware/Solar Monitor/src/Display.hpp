@@ -11,11 +11,21 @@
 #include <DisplayHAL.hpp>
 #include <Structs.h>
 #include <DebugDefs.h>
+#include <Profiler.hpp>
 #include <Backlight.hpp>
 #include <OverallBacklight.hpp>
+#include <CathodeUsage.hpp>
+#include <Settings.h>
+#include <VirtualDisplay.hpp>
 
 #define DIGIT_OFF 255
 
+// a digit transition rolls over at most 9 numbers
+#define TRANSITION_MAX_FRAMES 9
+
+// frames held for a cathode exercise or a digit transition
+#define SEQUENCE_MAX_FRAMES ((CATHODE_EXERCISE_MAX_STEPS > TRANSITION_MAX_FRAMES) ? CATHODE_EXERCISE_MAX_STEPS : TRANSITION_MAX_FRAMES)
+
 // shift transition for shift registers
 #define SHIFT_BEGIN HIGH
 #define SHIFT_COMMIT LOW
@@ -25,6 +35,7 @@ enum class value_type
 {
   watts,
   battery_charge,
+  percent,
   number
 };
 
@@ -35,9 +46,14 @@ enum class display_type
   battery_power,
   grid_power,
   load_power,
-  battery_charge
+  battery_charge,
+  autonomy,
+  self_consumption
 };
 
+// number of display types
+#define DISPLAY_TYPE_COUNT 7
+
 enum class sign_state
 {
   off,
@@ -54,10 +70,12 @@ class Display
 {
 public:
   // constructor sets types and IO pins
-  Display(display_type displayType, value_type valueType, uint8_t dataPin, uint8_t storePin,
+  Display(display_type displayType, value_type valueType, bool overallStatus,
+          uint8_t dataPin, uint8_t storePin,
           uint8_t shiftPin, uint8_t blankPin,
           uint8_t ledCtlPin) : _displayType(displayType),
                                _valueType(valueType),
+                               _overallStatus(overallStatus),
                                _dataPin(dataPin),
                                _storePin(storePin),
                                _shiftPin(shiftPin),
@@ -65,22 +83,23 @@ public:
                                _ledCtlPin(ledCtlPin)
 
   {
-    _displayHAL = new DisplayHAL();
-
-    _backlight = new Backlight();
+    _ledCount = _displayHAL.getLedCount();
+    _digitCount = _displayHAL.getDigitCount();
+    _decimalPointCount = _displayHAL.getDecimalPointCount();
+    _registerCount = _displayHAL.getRegisterCount();
 
-    _ledCount = _displayHAL->getLedCount();
-    _digitCount = _displayHAL->getDigitCount();
-    _decimalPointCount = _displayHAL->getDecimalPointCount();
-    _registerCount = _displayHAL->getRegisterCount();
-
-    // array of digits
     // digit 0 is the most left nixie
-    _digits = new uint8_t[_digitCount];
+    for (int i = 0; i < _digitCount; i++)
+    {
+      _digits[i] = DIGIT_OFF;
+      _shownDigits[i] = DIGIT_OFF;
+    }
 
-    // array of decimal points
     // decimal points are on the right side of the digits
-    _decimalPoints = new decimal_point_state[_decimalPointCount];
+    for (int i = 0; i < _decimalPointCount; i++)
+    {
+      _decimalPoints[i] = decimal_point_state::off;
+    }
 
     // set signs off
     _minusSign = sign_state::off;
@@ -92,24 +111,13 @@ public:
     _overallStatusMinusSign = sign_state::off;
     _overallStatusMinusSign = sign_state::off;
 
-    // on the battery charge display there is also the overall status nixie
-    if (_displayType == display_type::battery_charge)
-    {
-      _overallBacklight = new overallBacklight();
-    }
+    _pendingFrame = 0;
+    _sequenceLength = 0;
+    _virtualDisplay = nullptr;
   }
 
   virtual ~Display()
   {
-    // clean up
-    delete _displayHAL;
-    delete _backlight;
-    if (_displayType == display_type::battery_charge)
-    {
-      delete _overallBacklight;
-    }
-    delete (_digits);
-    delete (_decimalPoints);
   }
 
   uint8_t getLedCount() const
@@ -123,7 +131,7 @@ public:
 
     if (displayValue.errorFlag)
     {
-      clearRegisters();
+      clear();
       _FSign = sign_state::on;
     }
     else
@@ -158,111 +166,198 @@ public:
     }
   }
 
-  // used for symbol rotation
-  void setSymbols(register_type symbol0, register_type symbol4, register_type symbol5)
+  // prepares the frames for exercising cathodes which have not been lit recently,
+  // the least used cathodes of each tube come first, returns the number of steps needed
+  uint8_t prepareExercise()
   {
-    _symbolDigit0 = symbol0;
-    _symbolDigit4 = symbol4;
-    _symbolDigit5 = symbol5;
-  }
-
-  // set registers for symbol rotation, keeps the numeric values untouched
-  void setSymbolRegisters() const
-  {
-    register_type regType;
+    uint8_t candidates[TUBECOUNT][CATHODE_EXERCISE_MAX_STEPS];
+    uint8_t candidateCount[TUBECOUNT] = {0};
+    uint64_t tubeMasks[TUBECOUNT] = {0};
     uint8_t digit = 0;
     uint8_t number = 0;
 
-    for (uint8_t i = _registerCount; i > 0; i--)
+    // the time of the frame shown now counts as well
+    _cathodeUsage.account();
+    uint8_t stepCount = 0;
+    for (uint8_t i = 1; i <= _registerCount; i++)
     {
-      regType = _displayHAL->getRegisterInfo(i, &digit, &number);
-      switch (digit)
+      if (!isExercisable(i))
       {
-      case 0:
-        if (regType == _symbolDigit0)
-        {
-          commitBit(HIGH);
-        }
-        else
-        {
-          commitBit(LOW);
-        }
-        break;
+        continue;
+      }
+      _displayHAL.getRegisterInfo(i, &digit, &number);
+      tubeMasks[digit] |= REGISTER_BIT(i);
+      if (_cathodeUsage.getRecentOnTime(i) >= CATHODE_EXERCISE_MIN_ONTIME)
+      {
+        continue;
+      }
 
-      case 4:
-        if (regType == _symbolDigit4)
-        {
-          commitBit(HIGH);
-        }
-        else
-        {
-          commitBit(LOW);
-        }
-        break;
+      // sorted insert by total on-time, the most used candidate drops out if the list is full
+      uint8_t count = candidateCount[digit];
+      uint8_t *list = candidates[digit];
+      if ((count == CATHODE_EXERCISE_MAX_STEPS) &&
+          (_cathodeUsage.getOnTime(i) >= _cathodeUsage.getOnTime(list[count - 1])))
+      {
+        continue;
+      }
+      uint8_t position = (count < CATHODE_EXERCISE_MAX_STEPS) ? count : count - 1;
+      while ((position > 0) && (_cathodeUsage.getOnTime(list[position - 1]) > _cathodeUsage.getOnTime(i)))
+      {
+        list[position] = list[position - 1];
+        position--;
+      }
+      list[position] = i;
+      if (count < CATHODE_EXERCISE_MAX_STEPS)
+      {
+        candidateCount[digit]++;
+      }
+      if (candidateCount[digit] > stepCount)
+      {
+        stepCount = candidateCount[digit];
+      }
+    }
 
-      case 5:
-        if (regType == _symbolDigit5)
-        {
-          commitBit(HIGH);
-        }
-        else
+    // tubes without candidates keep showing their current content
+    uint64_t frame = buildFrame();
+    _sequenceLength = stepCount;
+    for (uint8_t step = 0; step < _sequenceLength; step++)
+    {
+      _sequenceFrames[step] = frame;
+      for (uint8_t tube = 0; tube < TUBECOUNT; tube++)
+      {
+        if (step < candidateCount[tube])
         {
-          commitBit(LOW);
+          _sequenceFrames[step] &= ~tubeMasks[tube];
+          _sequenceFrames[step] |= REGISTER_BIT(candidates[tube][step]);
         }
-        break;
+      }
+    }
+    return (_sequenceLength);
+  }
+
+  // prepares the frames rolling each changed digit forward through the numbers in between,
+  // returns the number of frames, the last frame shows the new value
+  uint8_t prepareTransition()
+  {
+    uint8_t distances[DIGITCOUNT];
+    uint8_t rollingDigits[DIGITCOUNT];
+
+    _sequenceLength = 0;
+    for (uint8_t i = 0; i < _digitCount; i++)
+    {
+      // digits turned on or off are switched instantly
+      distances[i] = 0;
+      if ((_shownDigits[i] != DIGIT_OFF) && (_digits[i] != DIGIT_OFF))
+      {
+        distances[i] = (_digits[i] + 10 - _shownDigits[i]) % 10;
+      }
+      if (distances[i] > _sequenceLength)
+      {
+        _sequenceLength = distances[i];
+      }
+    }
 
-      case 1:
-      case 2:
-      case 3:
-        if (regType == register_type::decimal_point)
+    for (uint8_t step = 0; step < _sequenceLength; step++)
+    {
+      for (uint8_t i = 0; i < _digitCount; i++)
+      {
+        if (step + 1 < distances[i])
         {
-          commitDecimalPoint(digit);
+          rollingDigits[i] = (_shownDigits[i] + step + 1) % 10;
         }
-        if (regType == register_type::number)
+        else
         {
-          commitDigitNumber(digit, number);
+          rollingDigits[i] = _digits[i];
         }
       }
+      _sequenceFrames[step] = buildFrame(rollingDigits);
     }
+
+    for (uint8_t i = 0; i < _digitCount; i++)
+    {
+      _shownDigits[i] = _digits[i];
+    }
+    return (_sequenceLength);
+  }
+
+  // set registers for a step of the prepared exercise or transition, shows the current values
+  // if there are less steps for this display
+  void setSequenceRegisters(uint8_t step)
+  {
+    PROFILE_START(probe);
+    if (step < _sequenceLength)
+    {
+      _pendingFrame = _sequenceFrames[step];
+    }
+    else
+    {
+      _pendingFrame = buildFrame();
+      PROFILE_LAP(probe, profile_stage::frame);
+    }
+    shiftFrame(_pendingFrame);
+    PROFILE_STOP(probe, profile_stage::shift_out);
   }
 
   // clears all registers
-  void clearRegisters() const
+  void clearRegisters()
   {
-    for (uint8_t i = _registerCount; i > 0; i--)
+    _pendingFrame = 0;
+    shiftFrame(_pendingFrame);
+    for (uint8_t i = 0; i < _digitCount; i++)
     {
-      commitBit(LOW);
+      _shownDigits[i] = DIGIT_OFF;
     }
   }
 
   // set registers for digits, decimal points and signs
-  void setRegisters() const
+  void setRegisters()
+  {
+    PROFILE_START(probe);
+    _pendingFrame = buildFrame();
+    PROFILE_LAP(probe, profile_stage::frame);
+    shiftFrame(_pendingFrame);
+    PROFILE_STOP(probe, profile_stage::shift_out);
+    for (uint8_t i = 0; i < _digitCount; i++)
+    {
+      _shownDigits[i] = _digits[i];
+    }
+  }
+
+  // called after the shift registers have been stored, the shifted frame is visible now
+  void latchFrame()
   {
+    _cathodeUsage.setFrame(_pendingFrame);
+  }
+
+  // builds the frame for digits, decimal points and signs, one bit per register
+  uint64_t buildFrame() const
+  {
+    return (buildFrame(_digits));
+  }
+
+  // builds the frame with the given digits, decimal points and signs, one bit per register
+  uint64_t buildFrame(const uint8_t *digits) const
+  {
+    uint64_t frame = 0;
     register_type regType;
     uint8_t digit = 0;
     uint8_t number = 0;
+    bool on;
 
-    for (uint8_t i = _registerCount; i > 0; i--)
+    for (uint8_t i = 1; i <= _registerCount; i++)
     {
+      on = false;
       // get information about what is connected to a register
-      regType = _displayHAL->getRegisterInfo(i, &digit, &number);
+      regType = _displayHAL.getRegisterInfo(i, &digit, &number);
       switch (regType)
       {
-      case register_type::unknown:
-        break;
-
       // this signs are for digit 0
       case register_type::percent_sign:
       case register_type::plus_sign:
       case register_type::minus_sign:
         if (digit == 0)
         {
-          commitSign(regType);
-          // commitBit(LOW);
-        }
-        else
-        {
-          commitBit(LOW);
+          on = isSignOn(regType);
         }
         break;
         // this sign is for digit 4
@@ -272,11 +367,7 @@ public:
       case register_type::k_sign:
         if (digit == 4)
         {
-          commitSign(regType);
-        }
-        else
-        {
-          commitBit(LOW);
+          on = isSignOn(regType);
         }
         break;
 
@@ -289,32 +380,27 @@ public:
       case register_type::F_sign:
         if (digit == 5)
         {
-          commitSign(regType);
-        }
-        else
-        {
-          commitBit(LOW);
+          on = isSignOn(regType);
         }
         break;
 
       case register_type::decimal_point:
-        commitDecimalPoint(digit);
+        on = isDecimalPointOn(digit);
         break;
 
       case register_type::number:
-        commitDigitNumber(digit, number);
-        break;
-
-      case register_type::not_used:
-      case register_type::not_connected:
-        commitBit(LOW);
+        on = isDigitNumberOn(digits, digit, number);
         break;
 
       default:
-        commitBit(LOW);
         break;
       }
+      if (on)
+      {
+        frame |= REGISTER_BIT(i);
+      }
     }
+    return (frame);
   }
 
   // clear variables
@@ -351,24 +437,44 @@ public:
     return (_valueType);
   }
 
+  // returns if the display has the overall status nixie
+  bool hasOverallStatus() const
+  {
+    return (_overallStatus);
+  }
+
   // provides access to backlight
-  Backlight *getBacklight() const
+  Backlight *getBacklight()
+  {
+    return (&_backlight);
+  }
+
+  // sets the sink receiving a copy of all shifted bits
+  void setVirtualDisplay(VirtualDisplay *virtualDisplay)
   {
-    return (_backlight);
+    _virtualDisplay = virtualDisplay;
   }
 
-  // provides acces to overall status backlight
-  overallBacklight *getOverallBacklight() const
+  // provides access to the cathode usage counters
+  CathodeUsage *getCathodeUsage()
   {
-    return (_overallBacklight);
+    return (&_cathodeUsage);
+  }
+
+  // provides acces to overall status backlight, nullptr if the display has no overall status nixie
+  overallBacklight *getOverallBacklight()
+  {
+    return (_overallStatus ? &_overallBacklight : nullptr);
   }
 
 private:
-  DisplayHAL *_displayHAL;
-  Backlight *_backlight;
-  overallBacklight *_overallBacklight;
-  value_type _valueType;
+  DisplayHAL _displayHAL;
+  Backlight _backlight;
+  CathodeUsage _cathodeUsage;
+  overallBacklight _overallBacklight; // used only with the overall status nixie
   display_type _displayType;
+  value_type _valueType;
+  bool _overallStatus;
 
   // pins
   uint8_t _dataPin;
@@ -384,8 +490,9 @@ private:
   uint8_t _registerCount;
 
   // digits and symbols
-  uint8_t *_digits;
-  decimal_point_state *_decimalPoints;
+  uint8_t _digits[DIGITCOUNT];
+  uint8_t _shownDigits[DIGITCOUNT]; // digits currently shown, used for digit transitions
+  decimal_point_state _decimalPoints[DECIMALPOINTCOUNT];
   sign_state _minusSign;
   sign_state _plusSign;
   sign_state _kSign;
@@ -395,75 +502,101 @@ private:
   sign_state _overallStatusPlusSign;
   sign_state _overallStatusMinusSign;
 
-  // symbol store for cathode poisoning prevention
-  register_type _symbolDigit0;
-  register_type _symbolDigit4;
-  register_type _symbolDigit5;
+  // frame shifted out last, becomes visible with the store transition
+  uint64_t _pendingFrame;
 
-  // commit number to shift registers
-  void commitDigitNumber(uint8_t digit, uint8_t number) const
+  // frames for cathode poisoning prevention and digit transitions
+  uint64_t _sequenceFrames[SEQUENCE_MAX_FRAMES];
+  uint8_t _sequenceLength;
+
+  // receives a copy of all shifted bits
+  VirtualDisplay *_virtualDisplay;
+
+  // returns if a number of a digit is on
+  bool isDigitNumberOn(const uint8_t *digits, uint8_t digit, uint8_t number) const
   {
     // digit is shifted by one
-    if (_digits[digit - 1] == number)
-    {
-      commitBit(HIGH);
-    }
-    else
-    {
-      commitBit(LOW);
-    }
+    return (digits[digit - 1] == number);
   }
 
-  // commit decimal point to shift registers
-  void commitDecimalPoint(uint8_t decimalPoint) const
+  // returns if a decimal point is on
+  bool isDecimalPointOn(uint8_t decimalPoint) const
   {
-    if (_decimalPoints[decimalPoint - 1] == decimal_point_state::off)
-    {
-      commitBit(LOW);
-    }
-    else
-    {
-      commitBit(HIGH);
-    }
+    return (_decimalPoints[decimalPoint - 1] == decimal_point_state::on);
   }
 
-  // commit sign to shift registers
-  void commitSign(register_type regType) const
+  // returns if a sign is on
+  bool isSignOn(register_type regType) const
   {
+    sign_state state = sign_state::off;
+
     switch (regType)
     {
     case register_type::plus_sign:
-      commitBit(_plusSign == sign_state::off ? LOW : HIGH);
+      state = _plusSign;
       break;
 
     case register_type::minus_sign:
-      commitBit(_minusSign == sign_state::off ? LOW : HIGH);
+      state = _minusSign;
       break;
 
     case register_type::percent_sign:
-      commitBit(_percentSign == sign_state::off ? LOW : HIGH);
+      state = _percentSign;
       break;
 
     case register_type::W_sign:
-      commitBit(_WSign == sign_state::off ? LOW : HIGH);
+      state = _WSign;
       break;
 
     case register_type::k_sign:
-      commitBit(_kSign == sign_state::off ? LOW : HIGH);
+      state = _kSign;
       break;
 
     case register_type::F_sign:
-      commitBit(_FSign == sign_state::off ? LOW : HIGH);
+      state = _FSign;
       break;
 
     case register_type::overall_minus_sign:
-      commitBit(_overallStatusMinusSign == sign_state::off ? LOW : HIGH);
+      state = _overallStatusMinusSign;
       break;
 
     case register_type::overall_plus_sign:
-      commitBit(_overallStatusPlusSign == sign_state::off ? LOW : HIGH);
+      state = _overallStatusPlusSign;
+      break;
+
+    default:
       break;
     }
+    return (state == sign_state::on);
+  }
+
+  // returns if a register drives a cathode which takes part in the exercise
+  bool isExercisable(uint8_t registerNumber) const
+  {
+    bool result = _displayHAL.isCathode(registerNumber);
+#ifndef OLD_BOARDS
+    if (result && !_overallStatus)
+    {
+      // the IN-15B on the right of the boards without overall status has no cathodes for these registers
+      uint8_t digit = 0;
+      uint8_t number = 0;
+      register_type regType = _displayHAL.getRegisterInfo(registerNumber, &digit, &number);
+      if ((digit == 5) && ((regType == register_type::overall_minus_sign) || (regType == register_type::pi_sign)))
+      {
+        result = false;
+      }
+    }
+#endif
+    return (result);
+  }
+
+  // shifts a frame to the shift registers, the highest register first
+  void shiftFrame(uint64_t frame) const
+  {
+    for (uint8_t i = _registerCount; i > 0; i--)
+    {
+      commitBit((frame & REGISTER_BIT(i)) ? HIGH : LOW);
+    }
   }
 
   // commit bit to shift registers
@@ -473,5 +606,11 @@ private:
     digitalWrite(_dataPin, value);
     // delayMicroseconds(5);
     digitalWrite(_shiftPin, SHIFT_COMMIT);
+#if VIRTUAL_DISPLAY
+    if (_virtualDisplay != nullptr)
+    {
+      _virtualDisplay->shiftBit(value);
+    }
+#endif
   }
 };
@@ -14,6 +14,21 @@
 #define ERR_ETHERNET_NOMAC 1
 #define ERR_ETHERNET_NOHARDWARE 2
 #define ERR_ETHERNET_LINKOFF 3
+#define ERR_ETHERNET_NODHCP 4
+#define ERR_CONFIG_BUSY 5
+#define ERR_CONFIG_SYNTAX 6
+#define ERR_CONFIG_KEY 7
+#define ERR_CONFIG_VALUE 8
+#define ERR_CONFIG_STORE 9
+#define ERR_UPDATE_BUSY 10
+#define ERR_UPDATE_REQUEST 11
+#define ERR_UPDATE_CONNECT 12
+#define ERR_UPDATE_HTTP 13
+#define ERR_UPDATE_BEGIN 14
+#define ERR_UPDATE_WRITE 15
+#define ERR_UPDATE_TIMEOUT 16
+#define ERR_UPDATE_VERIFY 17
+#define ERR_UNAUTHORIZED 18
 
 class Errors
 {
@@ -22,9 +37,9 @@ public:
   };
 
   // returns error description
-  static String getErrorText(int errorCode)
+  static const char *getErrorText(int errorCode)
   {
-    String text;
+    const char *text = "Unknown error";
 
     switch (errorCode)
     {
@@ -43,6 +58,66 @@ public:
     case ERR_ETHERNET_LINKOFF:
       text = "Ethernet link down";
       break;
+
+    case ERR_ETHERNET_NODHCP:
+      text = "No IP address from DHCP";
+      break;
+
+    case ERR_CONFIG_BUSY:
+      text = "Configuration not yet applied";
+      break;
+
+    case ERR_CONFIG_SYNTAX:
+      text = "Expected key=value";
+      break;
+
+    case ERR_CONFIG_KEY:
+      text = "Unknown configuration key";
+      break;
+
+    case ERR_CONFIG_VALUE:
+      text = "Invalid configuration value";
+      break;
+
+    case ERR_CONFIG_STORE:
+      text = "Failed to store the configuration";
+      break;
+
+    case ERR_UPDATE_BUSY:
+      text = "Firmware update running";
+      break;
+
+    case ERR_UPDATE_REQUEST:
+      text = "Expected url=http://host[:port]/path&md5=hash";
+      break;
+
+    case ERR_UPDATE_CONNECT:
+      text = "Failed to connect to the update server";
+      break;
+
+    case ERR_UPDATE_HTTP:
+      text = "Update server returned no image";
+      break;
+
+    case ERR_UPDATE_BEGIN:
+      text = "Failed to prepare the update partition";
+      break;
+
+    case ERR_UPDATE_WRITE:
+      text = "Failed to write the update partition";
+      break;
+
+    case ERR_UPDATE_TIMEOUT:
+      text = "Update download interrupted";
+      break;
+
+    case ERR_UPDATE_VERIFY:
+      text = "Firmware image verification failed";
+      break;
+
+    case ERR_UNAUTHORIZED:
+      text = "Missing or wrong API token";
+      break;
     }
     return (text);
   }
@@ -0,0 +1,322 @@
+// FirmwareUpdate.hpp
+
+// downloads a firmware image from a local HTTP server and streams it in chunks to a firmware writer,
+// the inactive app partition on the target, the image is checked against its MD5 hash before it becomes
+// the boot partition
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <HeapGuard.hpp>
+#include <Errors.hpp>
+#include <FirmwareWriter.hpp>
+
+#define UPDATE_CHUNK_SIZE 1024       // bytes read from the server and written to flash at once
+#define UPDATE_TIMEOUT 10000         // in ms, the download fails without data for this time
+#define UPDATE_REPORT_INTERVAL 1000  // in ms, progress and throughput are logged in this interval
+#define UPDATE_HOST_SIZE 64
+#define UPDATE_PATH_SIZE 128
+#define UPDATE_MD5_SIZE 33           // 32 hex digits with terminator
+
+enum class update_state
+{
+  idle,
+  requested,
+  downloading,
+  done,
+  failed
+};
+
+class FirmwareUpdate
+{
+public:
+  FirmwareUpdate()
+  {
+    _state = update_state::idle;
+    _error = ERR_SUCCESS;
+    _host[0] = '\0';
+    _port = 80;
+    _path[0] = '\0';
+    _md5[0] = '\0';
+    _size = 0;
+    _written = 0;
+    _duration = 0;
+  }
+
+  virtual ~FirmwareUpdate()
+  {
+  }
+
+  // takes the image location and its hash given as url=http://host[:port]/path&md5=<32 hex digits>,
+  // the download is started by run(), returns an error if the request is invalid or an update is running
+  int request(char *text)
+  {
+    char *line = text;
+    bool hasURL = false;
+    bool hasMD5 = false;
+
+    if ((_state == update_state::requested) || (_state == update_state::downloading))
+    {
+      return (ERR_UPDATE_BUSY);
+    }
+    while (line != nullptr)
+    {
+      char *end = line + strcspn(line, "\r\n&");
+      char *next = (*end != '\0') ? end + 1 : nullptr;
+      *end = '\0';
+      if (strncmp(line, "url=", 4) == 0)
+      {
+        hasURL = parseURL(line + 4);
+      }
+      else if (strncmp(line, "md5=", 4) == 0)
+      {
+        hasMD5 = (strlen(line + 4) == UPDATE_MD5_SIZE - 1) && (strspn(line + 4, "0123456789abcdefABCDEF") == UPDATE_MD5_SIZE - 1);
+        if (hasMD5)
+        {
+          strcpy(_md5, line + 4);
+        }
+      }
+      line = next;
+    }
+    if (!hasURL || !hasMD5)
+    {
+      return (ERR_UPDATE_REQUEST);
+    }
+    _state = update_state::requested;
+    return (ERR_SUCCESS);
+  }
+
+  // returns if an update has been requested and waits for run()
+  bool isRequested() const
+  {
+    return (_state == update_state::requested);
+  }
+
+  // downloads the requested image and writes it with the writer, blocks until done, called by the network task,
+  // the new firmware runs after the next restart
+  int run(Client &client, FirmwareWriter &writer)
+  {
+    unsigned long start = millis();
+
+    _state = update_state::downloading;
+    _size = 0;
+    _written = 0;
+    LOG_INFO(LOG_NETWORK, "Firmware update started");
+    // the update library and the OTA driver allocate their buffers
+    HeapGuard::get().suspend();
+    _error = download(client, writer);
+    HeapGuard::get().resume();
+    client.stop();
+    _duration = millis() - start;
+    if (_error == ERR_SUCCESS)
+    {
+      _state = update_state::done;
+      LOG_INFO(LOG_NETWORK, "Firmware update done, %lu bytes in %lu ms, %lu KB/s",
+               (unsigned long)_written, _duration, getThroughput());
+    }
+    else
+    {
+      _state = update_state::failed;
+      LOG_ERROR(LOG_NETWORK, "Firmware update failed after %lu bytes: %s",
+                (unsigned long)_written, Errors::getErrorText(_error));
+    }
+    return (_error);
+  }
+
+  // returns the state of the last update
+  update_state getState() const
+  {
+    return (_state);
+  }
+
+  // returns the download throughput of the last update in KB/s
+  unsigned long getThroughput() const
+  {
+    return ((_duration > 0) ? (unsigned long)((uint64_t)_written * 1000 / 1024 / _duration) : 0);
+  }
+
+  // prints the state of the last update
+  void print(Print &out) const
+  {
+    static const char *states[] = {"idle", "requested", "downloading", "done", "failed"};
+    char line[96];
+
+    snprintf(line, sizeof(line), "state=%s", states[(int)_state]);
+    out.println(line);
+    snprintf(line, sizeof(line), "written=%lu", (unsigned long)_written);
+    out.println(line);
+    snprintf(line, sizeof(line), "size=%lu", (unsigned long)_size);
+    out.println(line);
+    snprintf(line, sizeof(line), "throughput=%lu KB/s", getThroughput());
+    out.println(line);
+    if (_state == update_state::failed)
+    {
+      snprintf(line, sizeof(line), "error=%s", Errors::getErrorText(_error));
+      out.println(line);
+    }
+  }
+
+private:
+  volatile update_state _state;
+  int _error;
+  char _host[UPDATE_HOST_SIZE];
+  uint16_t _port;
+  char _path[UPDATE_PATH_SIZE];
+  char _md5[UPDATE_MD5_SIZE];
+  uint8_t _chunk[UPDATE_CHUNK_SIZE];
+  volatile uint32_t _size;    // of the image in bytes
+  volatile uint32_t _written; // bytes written to flash
+  unsigned long _duration;    // in ms
+
+  // splits http://host[:port]/path, returns false if the URL is invalid
+  bool parseURL(const char *url)
+  {
+    if (strncmp(url, "http://", 7) != 0)
+    {
+      return (false);
+    }
+    const char *host = url + 7;
+    const char *path = strchr(host, '/');
+    if (path == nullptr)
+    {
+      return (false);
+    }
+    size_t hostLength = path - host;
+    const char *colon = (const char *)memchr(host, ':', hostLength);
+    long port = 80;
+    if (colon != nullptr)
+    {
+      char *end;
+      port = strtol(colon + 1, &end, 10);
+      if ((end != path) || (port < 1) || (port > 65535))
+      {
+        return (false);
+      }
+      hostLength = colon - host;
+    }
+    if ((hostLength == 0) || (hostLength >= UPDATE_HOST_SIZE) || (strlen(path) >= UPDATE_PATH_SIZE))
+    {
+      return (false);
+    }
+    memcpy(_host, host, hostLength);
+    _host[hostLength] = '\0';
+    strcpy(_path, path);
+    _port = port;
+    return (true);
+  }
+
+  // requests the image and writes it chunk by chunk, no more than one chunk is held in memory
+  int download(Client &client, FirmwareWriter &writer)
+  {
+    char line[64];
+    size_t length;
+    size_t contentLength = 0;
+
+    if (!client.connect(_host, _port))
+    {
+      return (ERR_UPDATE_CONNECT);
+    }
+    client.print(F("GET "));
+    client.print(_path);
+    client.println(F(" HTTP/1.1"));
+    client.print(F("Host: "));
+    client.println(_host);
+    client.println(F("Connection: close"));
+    client.println();
+
+    // status line and headers, the image size is needed to reserve the partition
+    client.setTimeout(UPDATE_TIMEOUT);
+    length = client.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[length] = '\0';
+    if ((strncmp(line, "HTTP/1.", 7) != 0) || (atoi(line + 9) != 200))
+    {
+      return (ERR_UPDATE_HTTP);
+    }
+    while (true)
+    {
+      length = client.readBytesUntil('\n', line, sizeof(line) - 1);
+      line[length] = '\0';
+      if ((length == 0) || (strcmp(line, "\r") == 0))
+      {
+        break;
+      }
+      if (strncasecmp(line, "Content-Length:", 15) == 0)
+      {
+        contentLength = strtoul(line + 15, nullptr, 10);
+      }
+    }
+    if (contentLength == 0)
+    {
+      return (ERR_UPDATE_HTTP);
+    }
+
+    if (!writer.begin(contentLength) || !writer.setMD5(_md5))
+    {
+      LOG_ERROR(LOG_NETWORK, "Update error %u", (unsigned int)writer.getError());
+      writer.abort();
+      return (ERR_UPDATE_BEGIN);
+    }
+    _size = contentLength;
+
+    unsigned long lastData = millis();
+    unsigned long lastReport = millis();
+    unsigned long reportStart = millis();
+    uint32_t reportWritten = 0;
+    while (_written < _size)
+    {
+      int available = client.available();
+      if (available > 0)
+      {
+        size_t count = min((size_t)available, min(sizeof(_chunk), (size_t)(_size - _written)));
+        int received = client.read(_chunk, count);
+        if (received > 0)
+        {
+          if (writer.write(_chunk, received) != (size_t)received)
+          {
+            LOG_ERROR(LOG_NETWORK, "Update error %u", (unsigned int)writer.getError());
+            writer.abort();
+            return (ERR_UPDATE_WRITE);
+          }
+          _written += received;
+          lastData = millis();
+        }
+      }
+      else if (!client.connected() || (millis() - lastData >= UPDATE_TIMEOUT))
+      {
+        writer.abort();
+        return (ERR_UPDATE_TIMEOUT);
+      }
+      else
+      {
+        // let the other tasks of this core run while waiting for data
+        vTaskDelay(1);
+      }
+
+      if (millis() - lastReport >= UPDATE_REPORT_INTERVAL)
+      {
+        unsigned long elapsed = millis() - reportStart;
+        LOG_INFO(LOG_NETWORK, "Firmware update %lu of %lu bytes, %lu KB/s", (unsigned long)_written, (unsigned long)_size,
+                 (unsigned long)((uint64_t)(_written - reportWritten) * 1000 / 1024 / elapsed));
+        lastReport = millis();
+        reportStart = lastReport;
+        reportWritten = _written;
+      }
+    }
+
+    // checks the MD5 hash and sets the new boot partition
+    if (!writer.end())
+    {
+      LOG_ERROR(LOG_NETWORK, "Update error %u", (unsigned int)writer.getError());
+      return (ERR_UPDATE_VERIFY);
+    }
+    return (ERR_SUCCESS);
+  }
+};
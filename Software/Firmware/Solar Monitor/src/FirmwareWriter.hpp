@@ -0,0 +1,37 @@
+// FirmwareWriter.hpp
+
+// interface of the storage a downloaded firmware image is written to, implemented by FlashWriter
+// for the inactive app partition, lets the download be tested without flash
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+
+class FirmwareWriter
+{
+public:
+  virtual ~FirmwareWriter()
+  {
+  }
+
+  // prepares the storage for an image of the given size in bytes
+  virtual bool begin(size_t size) = 0;
+
+  // sets the expected MD5 hash of the image as 32 hex digits
+  virtual bool setMD5(const char *md5) = 0;
+
+  // writes the next part of the image, returns the number of bytes written
+  virtual size_t write(uint8_t *data, size_t length) = 0;
+
+  // checks the complete image against its hash and makes it the one started next
+  virtual bool end() = 0;
+
+  // drops a partly written image
+  virtual void abort() = 0;
+
+  // returns the error code of the implementation, logged if a step fails
+  virtual uint8_t getError() = 0;
+};
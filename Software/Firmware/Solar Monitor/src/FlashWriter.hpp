@@ -0,0 +1,47 @@
+// FlashWriter.hpp
+
+// writes a firmware image to the inactive app partition with the Update library,
+// the partition becomes the boot partition if the MD5 hash matches
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Update.h>
+#include <FirmwareWriter.hpp>
+
+class FlashWriter : public FirmwareWriter
+{
+public:
+  bool begin(size_t size) override
+  {
+    return (Update.begin(size));
+  }
+
+  bool setMD5(const char *md5) override
+  {
+    return (Update.setMD5(md5));
+  }
+
+  size_t write(uint8_t *data, size_t length) override
+  {
+    return (Update.write(data, length));
+  }
+
+  bool end() override
+  {
+    return (Update.end());
+  }
+
+  void abort() override
+  {
+    Update.abort();
+  }
+
+  uint8_t getError() override
+  {
+    return (Update.getError());
+  }
+};
@@ -0,0 +1,83 @@
+// FlowEffect.hpp
+
+// animated chase on the backlight LEDs of a board, showing direction and amount of a power flow
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <LedStrip.hpp>
+#include <Settings.h>
+
+class FlowEffect
+{
+public:
+  FlowEffect(int minLED, int maxLED) : _minLED(minLED), _maxLED(maxLED)
+  {
+    _position = 0;
+    _speed = 0;
+  }
+
+  virtual ~FlowEffect()
+  {
+  }
+
+  // sets the speed from a power value in watts, positive values move towards the last LED
+  void setPower(double power)
+  {
+    float speed = 0;
+
+    if (fabs(power) >= FLOW_MIN_POWER)
+    {
+      speed = power / 1000 * FLOW_SPEED_PER_KW;
+      speed = constrain(speed, -FLOW_MAX_SPEED, FLOW_MAX_SPEED);
+    }
+    _speed = speed;
+  }
+
+  // advances the chase by the elapsed time in ms and sets the brightness of the LEDs,
+  // the head is fully lit, the tail behind it fades out
+  void render(LedStrip *leds, uint32_t elapsed)
+  {
+    int count = _maxLED - _minLED + 1;
+    float speed = _speed;
+
+    if (speed == 0)
+    {
+      for (int i = _minLED; i <= _maxLED; i++)
+      {
+        leds->setPixelScale(i, 255);
+      }
+      return;
+    }
+
+    _position = fmodf(_position + speed * elapsed / 1000, count);
+    if (_position < 0)
+    {
+      _position += count;
+    }
+    for (int i = 0; i < count; i++)
+    {
+      // distance behind the head in moving direction
+      float distance = (speed > 0) ? _position - i : i - _position;
+      if (distance < 0)
+      {
+        distance += count;
+      }
+      uint8_t scale = FLOW_MIN_LEVEL;
+      if (distance < FLOW_TAIL_LENGTH)
+      {
+        scale = 255 - (255 - FLOW_MIN_LEVEL) * distance / FLOW_TAIL_LENGTH;
+      }
+      leds->setPixelScale(_minLED + i, scale);
+    }
+  }
+
+private:
+  int _minLED;
+  int _maxLED;
+  float _position;       // position of the head in LEDs from the first LED
+  volatile float _speed; // in LEDs per second
+};
@@ -0,0 +1,167 @@
+// GpsClock.hpp
+
+// sets the system clock from the time received by the GPS module
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <sys/time.h>
+#include <time.h>
+#include <NmeaParser.hpp>
+#include <Events.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Settings.h>
+
+// size of the UART receive ring buffer, filled by the UART driver in the background
+#define GPS_RX_BUFFER_SIZE 1024
+
+// bytes taken from the ring buffer at once
+#define GPS_READ_CHUNK_SIZE 64
+
+// clock errors above are corrected at once, smaller ones are slewed
+#define GPS_STEP_THRESHOLD 1000 // in ms
+
+class GpsClock
+{
+public:
+  GpsClock(HardwareSerial &serial, uint8_t pinRX, uint8_t pinTX) : _serial(serial), _pinRX(pinRX), _pinTX(pinTX)
+  {
+    _synchronized = false;
+    _lastSyncTimestamp = 0;
+    _lastSyncTime = 0;
+  }
+
+  virtual ~GpsClock()
+  {
+  }
+
+  // starts receiving from the GPS module and sets the time zone for the local time,
+  // the callback is notified when the receiver pauses after a burst of sentences
+  void begin(EVENT_CALLBACK notify = nullptr, void *notifyArg = nullptr)
+  {
+    _serial.setRxBufferSize(GPS_RX_BUFFER_SIZE);
+    _serial.begin(GPS_BAUDRATE, SERIAL_8N1, _pinRX, _pinTX);
+    if (notify != nullptr)
+    {
+      _serial.onReceive([notify, notifyArg]()
+                        { notify(notifyArg, controller_event::gps); },
+                        true);
+    }
+    setenv("TZ", TIMEZONE, 1);
+    tzset();
+  }
+
+  // parses the received characters, returns true if the clock has been synchronized
+  bool process()
+  {
+    bool result = false;
+    uint8_t buffer[GPS_READ_CHUNK_SIZE];
+    int available = _serial.available();
+
+    while (available > 0)
+    {
+      size_t count = _serial.read(buffer, min(available, GPS_READ_CHUNK_SIZE));
+      if (count == 0)
+      {
+        break;
+      }
+      for (size_t i = 0; i < count; i++)
+      {
+        if (_parser.encode(buffer[i]))
+        {
+          result |= synchronize(_parser.getTime());
+        }
+      }
+      available -= count;
+    }
+    return (result);
+  }
+
+  // returns if the clock has been set from GPS within the sync timeout
+  bool isSynchronized() const
+  {
+    return (_synchronized && (millis() - _lastSyncTimestamp < GPS_SYNC_TIMEOUT * 60 * 60 * 1000UL));
+  }
+
+  // gets the local time, returns false if the clock is not synchronized
+  bool getLocalTime(struct tm *localTime) const
+  {
+    bool result = false;
+
+    if (isSynchronized())
+    {
+      time_t now = time(nullptr);
+      result = (localtime_r(&now, localTime) != nullptr);
+    }
+    return (result);
+  }
+
+  // returns the NMEA parser, e.g. for statistics
+  const NmeaParser &getParser() const
+  {
+    return (_parser);
+  }
+
+private:
+  HardwareSerial &_serial;
+  uint8_t _pinRX;
+  uint8_t _pinTX;
+  NmeaParser _parser;
+  bool _synchronized;
+  unsigned long _lastSyncTimestamp;
+  time_t _lastSyncTime;
+
+  // returns the days since 1970-01-01 of a date
+  static int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day)
+  {
+    year -= (month <= 2);
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t yearOfEra = year - era * 400;
+    uint32_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return (era * 146097 + (int32_t)dayOfEra - 719468);
+  }
+
+  // corrects the system clock, only the first sentence of each second is used,
+  // later ones of the same second arrive with more delay
+  bool synchronize(const NMEA_TIME &gpsTime)
+  {
+    time_t seconds = (time_t)daysFromCivil(gpsTime.year, gpsTime.month, gpsTime.day) * 86400 +
+                     gpsTime.hour * 3600 + gpsTime.minute * 60 + gpsTime.second;
+    if (seconds == _lastSyncTime)
+    {
+      return (false);
+    }
+    _lastSyncTime = seconds;
+
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    int64_t gpsMs = (int64_t)seconds * 1000 + gpsTime.millisecond + GPS_SENTENCE_DELAY;
+    int64_t systemMs = (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+    int64_t error = gpsMs - systemMs;
+
+    if (!_synchronized || (error > GPS_STEP_THRESHOLD) || (error < -GPS_STEP_THRESHOLD))
+    {
+      struct timeval gps;
+      gps.tv_sec = gpsMs / 1000;
+      gps.tv_usec = (gpsMs % 1000) * 1000;
+      settimeofday(&gps, nullptr);
+      LOG_INFO(LOG_SENSORS, "Clock set from GPS, error %ld ms", (long)error);
+    }
+    else
+    {
+      // slew the clock to avoid jumps
+      struct timeval delta;
+      delta.tv_sec = error / 1000;
+      delta.tv_usec = (error % 1000) * 1000;
+      adjtime(&delta, nullptr);
+    }
+    _synchronized = true;
+    _lastSyncTimestamp = millis();
+    return (true);
+  }
+};
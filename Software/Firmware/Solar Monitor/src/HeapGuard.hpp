@@ -0,0 +1,142 @@
+// HeapGuard.hpp
+
+// watches the heap once the controller is initialized, the steady state must not allocate,
+// with HEAP_GUARD set in DebugDefs.h the first allocation found stops the firmware with a backtrace
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+
+#define HEAP_GUARD_CAPS MALLOC_CAP_8BIT
+
+class HeapGuard
+{
+public:
+  // returns the guard of the whole firmware
+  static HeapGuard &get()
+  {
+    static HeapGuard guard;
+    return (guard);
+  }
+
+  // ends the initialization, the free heap becomes the baseline
+  void seal()
+  {
+    _baseline = getFreeHeap();
+    _sealed = true;
+    LOG_INFO(LOG_MAIN, "Heap sealed, %u bytes free, largest block %u bytes",
+             (unsigned int)_baseline, (unsigned int)getLargestFreeBlock());
+  }
+
+  // returns if the initialization has ended
+  bool isSealed() const
+  {
+    return (_sealed);
+  }
+
+  // allows allocations of ESP-IDF components which cannot do without, e.g. NVS,
+  // calls may be nested
+  void suspend()
+  {
+    _suspended++;
+  }
+
+  // the memory kept by the component becomes part of the baseline
+  void resume()
+  {
+    if ((_suspended > 0) && (--_suspended == 0) && _sealed)
+    {
+      _baseline = getFreeHeap();
+    }
+  }
+
+  // fails if memory has been taken since sealing, called by the main loop,
+  // finds allocations of all tasks which are still held
+  void check()
+  {
+    if (_sealed && (_suspended == 0))
+    {
+      size_t freeHeap = getFreeHeap();
+      if (freeHeap < _baseline)
+      {
+        fail("memory allocated after initialization", _baseline - freeHeap);
+      }
+    }
+  }
+
+  // fails on any allocation after sealing, called by operator new in main.cpp,
+  // finds also allocations which are released at once
+  void onAllocation(size_t size)
+  {
+    if (_sealed && (_suspended == 0))
+    {
+      fail("operator new after initialization", size);
+    }
+  }
+
+  // returns the free heap in bytes
+  size_t getFreeHeap() const
+  {
+    return (heap_caps_get_free_size(HEAP_GUARD_CAPS));
+  }
+
+  // returns the lowest free heap since boot in bytes
+  size_t getMinFreeHeap() const
+  {
+    return (heap_caps_get_minimum_free_size(HEAP_GUARD_CAPS));
+  }
+
+  // returns the largest block which can be allocated in bytes, shows the fragmentation
+  size_t getLargestFreeBlock() const
+  {
+    return (heap_caps_get_largest_free_block(HEAP_GUARD_CAPS));
+  }
+
+  // prints the heap usage
+  void print(Print &out) const
+  {
+    out.print("Heap: ");
+    out.print((unsigned long)getFreeHeap());
+    out.print(" bytes free, min ");
+    out.print((unsigned long)getMinFreeHeap());
+    out.print(", largest block ");
+    out.print((unsigned long)getLargestFreeBlock());
+    if (_sealed)
+    {
+      out.print(", baseline ");
+      out.print((unsigned long)_baseline);
+    }
+    out.println();
+  }
+
+private:
+  volatile bool _sealed;
+  volatile uint8_t _suspended;
+  size_t _baseline; // free heap at the end of the initialization, in bytes
+
+  HeapGuard()
+  {
+    _sealed = false;
+    _suspended = 0;
+    _baseline = 0;
+  }
+
+  // prints the reason without allocating and stops, the panic handler prints the backtrace
+  void fail(const char *reason, size_t size)
+  {
+    _sealed = false;
+    D_print("Heap guard: ");
+    D_print(reason);
+    D_print(", ");
+    D_print((unsigned long)size);
+    D_println(" bytes");
+    Serial.flush();
+    abort();
+  }
+};
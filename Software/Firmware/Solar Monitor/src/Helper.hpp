@@ -9,7 +9,10 @@
 
 #include <Arduino.h>
 #include <Structs.h>
-#include <Debugdefs.h>
+#include <DebugDefs.h>
+
+// number of numeric digits of a display value
+#define DISPLAY_DIGITS 3
 
 class Helper
 {
@@ -24,7 +27,7 @@ public:
     // set value
     value = inputValue;
 
-    // if near 0 then 0
+    // if near 0 then 0, this also removes a negative zero
     if (abs(value) < 0.5)
     {
       value = 0;
@@ -52,7 +55,6 @@ public:
 
     // set the flags
     displayValue.errorFlag = false;
-    displayValue.kiloFlag = (abs(value) >= 1000);
     displayValue.minusFlag = (value < 0);
     displayValue.plusFlag = (value > 0);
     displayValue.percentageFlag = percent;
@@ -68,48 +70,34 @@ public:
       displayValue.wattFlag = true;
     }
 
-    // just 3 numeric nixies, if kiloflag set, divide by 1000
-    if (displayValue.kiloFlag)
-    {
-      value /= 1000;
-    }
-
-    // set decimals for rounding
-    int decimals;
-    if (abs(value) >= 100)
+    // just 3 numeric nixies, round to 3 significant digits,
+    // rounding may carry into the next range, e.g. 99.995 -> 100 or 999.6 -> 1.00k
+    uint8_t decimals = 0;
+    long scaled = roundToDisplayDigits(abs(value), 1, &decimals);
+    if (scaled < 0)
     {
-      decimals = 0;
-    }
-    else if (abs(value) >= 10)
-    {
-      decimals = 1;
+      // does not fit, use kilo
+      displayValue.kiloFlag = true;
+      scaled = roundToDisplayDigits(abs(value), 1000, &decimals);
+      if (scaled < 0)
+      {
+        // overflow after rounding
+        result = false;
+        displayValue.errorFlag = true;
+        return (result);
+      }
     }
     else
     {
-      decimals = 2;
+      displayValue.kiloFlag = false;
     }
 
-    // fill the 3 digits and the decimal point location
-    uint8_t index = 0;
-    String s = String(abs(value), decimals);
-    for (int i = 0; i < s.length(); i++)
-    {
-      if (index > 2)
-      {
-        exit;
-      }
-      switch (s[i])
-      {
-      case '.':
-        displayValue.decimalIndex = index;
-        break;
-
-      default:
-        displayValue.digits[index] = s[i] - '0';
-        index++;
-        break;
-      }
-    }
+    // fill the 3 digits and the decimal point location,
+    // the decimal point index is the number of digits in front of the decimal point
+    displayValue.digits[0] = scaled / 100;
+    displayValue.digits[1] = (scaled / 10) % 10;
+    displayValue.digits[2] = scaled % 10;
+    displayValue.decimalIndex = (decimals == 0) ? 0 : DISPLAY_DIGITS - decimals;
     return (result);
   }
 
@@ -129,23 +117,12 @@ public:
     displayValue.digits[0] = 0;
     displayValue.digits[1] = 0;
     displayValue.digits[2] = 0;
-    String s = String(abs(inputValue), 0);
-    switch (s.length())
+    long number = lround(abs(inputValue));
+    if (number < 1000)
     {
-    case 1:
-      displayValue.digits[2] = s[0] - '0';
-      break;
-
-    case 2:
-      displayValue.digits[1] = s[0] - '0';
-      displayValue.digits[2] = s[1] - '0';
-      break;
-
-    case 3:
-      displayValue.digits[0] = s[0] - '0';
-      displayValue.digits[1] = s[1] - '0';
-      displayValue.digits[2] = s[2] - '0';
-      break;
+      displayValue.digits[0] = number / 100;
+      displayValue.digits[1] = (number / 10) % 10;
+      displayValue.digits[2] = number % 10;
     }
   }
 
@@ -191,4 +168,37 @@ public:
     *green = (value >> 8) & 255;
     *red = (value >> 16) & 255;
   }
+
+  // FNV-1a hash of a memory block, used as checksum of the data kept in RTC memory and NVS
+  static uint32_t getChecksum(const void *data, size_t size)
+  {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t hash = 2166136261UL;
+
+    for (size_t i = 0; i < size; i++)
+    {
+      hash = (hash ^ bytes[i]) * 16777619UL;
+    }
+    return (hash);
+  }
+
+private:
+  // rounds a positive value divided by the unit to the most decimals still fitting in the 3 digits,
+  // returns the digits as an integer or -1 if the value does not fit,
+  // scaling before dividing keeps halves exact, e.g. 1005 W -> 1.01k
+  static long roundToDisplayDigits(double value, double unit, uint8_t *decimals)
+  {
+    static const double factors[] = {100.0, 10.0, 1.0};
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+      long scaled = lround(value * factors[i] / unit);
+      if (scaled < 1000)
+      {
+        *decimals = 2 - i;
+        return (scaled);
+      }
+    }
+    return (-1);
+  }
 };
\ No newline at end of file
@@ -9,10 +9,26 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <JsonArena.hpp>
 #include <Ethernet.h>
 #include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Profiler.hpp>
+#include <Config.hpp>
 #include <Settings.h>
 
+// values of a response, kept over resets
+typedef struct
+{
+  double SOC;
+  double P_Akku;
+  double P_Grid;
+  double P_Load;
+  double P_PV;
+  double rel_Autonomy;
+  double rel_SelfConsumption;
+} INVERTER_VALUES;
+
 class Inverter
 {
 public:
@@ -25,10 +41,10 @@ public:
   {
   }
 
-  // returns the defined request interval
+  // returns the configured request interval
   int getRequestInterval() const
   {
-    return (INVERTER_POLLINGINTERVAL);
+    return (Config::get().getActive().pollingInterval);
   }
 
   // returns the battery charge value
@@ -68,6 +84,18 @@ public:
     return (_P_PV);
   }
 
+  // returns the share of the load covered by solar and battery
+  double getAutonomy() const
+  {
+    return (_rel_Autonomy);
+  }
+
+  // returns the share of the produced energy used on site
+  double getSelfConsumption() const
+  {
+    return (_rel_SelfConsumption);
+  }
+
   // returns the overall status
   bool getOverallStatus() const
   {
@@ -81,45 +109,83 @@ public:
     }
   }
 
-  // gets values from the inverter
-  bool requestValues(EthernetClient *client) 
+  // copies the values
+  void getValues(INVERTER_VALUES *values) const
+  {
+    values->SOC = _SOC;
+    values->P_Akku = _P_Akku;
+    values->P_Grid = _P_Grid;
+    values->P_Load = _P_Load;
+    values->P_PV = _P_PV;
+    values->rel_Autonomy = _rel_Autonomy;
+    values->rel_SelfConsumption = _rel_SelfConsumption;
+  }
+
+  // sets values received earlier, e.g. restored at boot
+  void setValues(const INVERTER_VALUES &values)
+  {
+    _SOC = values.SOC;
+    _P_Akku = values.P_Akku;
+    _P_Grid = values.P_Grid;
+    _P_Load = values.P_Load;
+    _P_PV = values.P_PV;
+    _rel_Autonomy = values.rel_Autonomy;
+    _rel_SelfConsumption = values.rel_SelfConsumption;
+  }
+
+  // gets values from the inverter, the response body is kept in the given buffer
+  // and decoded in the given arena
+  bool requestValues(EthernetClient *client, JsonArena *arena, char *body, size_t size, size_t *length)
   {
     bool result = false;
+    size_t contentLength = 0;
+    *length = 0;
+    const CONFIG &config = Config::get().getActive();
     resetValues();
     // connect to the inverter if not connected
     if (!client->connected())
     {
-      D_println("Client is disconnected");
-      if (!client->connect(INVERTER_IPADDRESS, INVERTER_PORT))
+      LOG_VERBOSE(LOG_INVERTER, "Client is disconnected");
+      PROFILE_START(connectProbe);
+      if (!client->connect(config.inverterAddress, config.inverterPort))
       {
-        D_println("Failed to connect to the inverter");
+        LOG_WARNING(LOG_INVERTER, "Failed to connect to the inverter");
       }
+      PROFILE_STOP(connectProbe, profile_stage::connect);
     }
     if (client->connected())
     {
+      PROFILE_START(probe);
       // send HTTP request
-      D_println("Connected to the inverter");
+      LOG_VERBOSE(LOG_INVERTER, "Connected to the inverter");
       client->println(F("GET /solar_api/v1/GetPowerFlowRealtimeData.fcgi HTTP/1.1"));
       client->print(F("Host: "));
-      client->println(F(INVERTER_IPADDRESS));
+      client->println(config.inverterAddress);
       client->println(F("Connection: close"));
       if (client->println() != 0)
       {
+        PROFILE_LAP(probe, profile_stage::request);
         // check HTTP status
         char status[32] = {0};
         client->readBytesUntil('\r', status, sizeof(status));
+        PROFILE_LAP(probe, profile_stage::status);
         if (strcmp(status + 9, "200 OK") == 0)
         {
-          D_println("Received status OK");
-          // Skip HTTP headers
-          char endOfHeaders[] = "\r\n\r\n";
-          if (client->find(endOfHeaders))
+          LOG_VERBOSE(LOG_INVERTER, "Received status OK");
+          // read the headers up to the empty line, only the content length is used
+          if (readHeaders(client, &contentLength))
           {
-            D_println("Received response");
-            if (!decodeJSON(client))
+            PROFILE_LAP(probe, profile_stage::headers);
+            LOG_VERBOSE(LOG_INVERTER, "Received response");
+            if (!readBody(client, contentLength, body, size, length))
+            {
+              LOG_WARNING(LOG_INVERTER, "Response too large");
+            }
+            else if (!decodeJSON(body, *length, arena))
             {
               result = true;
             }
+            PROFILE_STOP(probe, profile_stage::decode);
             // read till end
             while (client->available())
             {
@@ -129,20 +195,20 @@ public:
           }
           else
           {
-            D_println(F("Invalid response"));
+            LOG_WARNING(LOG_INVERTER, "Invalid response");
             client->stop();
           }
         }
         else
         {
-          D_print("Received wrong status: ");
-          D_println(status);
+          // the status text is not kept, only its code is logged
+          LOG_WARNING(LOG_INVERTER, "Received wrong status: %d", atoi(status + 9));
           client->stop();
         }
       }
       else
       {
-        D_println("Failed to send request");
+        LOG_WARNING(LOG_INVERTER, "Failed to send request");
         client->stop();
       }
     }
@@ -155,18 +221,78 @@ private:
   double _P_Grid; // grid power
   double _P_Load; // load power
   double _P_PV;   // solar power
+  double _rel_Autonomy;        // autonomy in percent
+  double _rel_SelfConsumption; // self consumption in percent
+
+  // skips the rest of the status line and the headers, returns false if the empty line is not received
+  static bool readHeaders(EthernetClient *client, size_t *contentLength)
+  {
+    char header[64];
+
+    client->readBytesUntil('\n', header, sizeof(header) - 1);
+    while (true)
+    {
+      size_t length = client->readBytesUntil('\n', header, sizeof(header) - 1);
+      header[length] = '\0';
+      if (length == 0)
+      {
+        return (false);
+      }
+      if (strcmp(header, "\r") == 0)
+      {
+        return (true);
+      }
+      if (strncasecmp(header, "Content-Length:", 15) == 0)
+      {
+        *contentLength = strtoul(header + 15, nullptr, 10);
+      }
+    }
+  }
+
+  // reads the body up to the content length, without content length until the inverter closes the connection,
+  // returns false if the body does not fit into the buffer
+  static bool readBody(EthernetClient *client, size_t contentLength, char *body, size_t size, size_t *length)
+  {
+    if (contentLength > 0)
+    {
+      if (contentLength > size)
+      {
+        return (false);
+      }
+      *length = client->readBytes(body, contentLength);
+      return (true);
+    }
+    unsigned long start = millis();
+    while ((client->connected() || client->available()) && (millis() - start < client->getTimeout()))
+    {
+      int available = client->available();
+      if (available > 0)
+      {
+        if (*length + available > size)
+        {
+          return (false);
+        }
+        *length += client->read((uint8_t *)body + *length, available);
+      }
+      else
+      {
+        delay(1);
+      }
+    }
+    return (true);
+  }
 
-  // reads and decodes the JSON response
-  DeserializationError decodeJSON(EthernetClient *client)
+  // decodes the JSON response, the body is not changed
+  DeserializationError decodeJSON(const char *body, size_t length, JsonArena *arena)
   {
-    JsonDocument doc;
+    arena->reset();
+    JsonDocument doc(arena);
 
-    DeserializationError error = deserializeJson(doc, *client);
+    DeserializationError error = deserializeJson(doc, body, length);
 
     if (error)
     {
-      D_print("deserializeJson() failed: ");
-      D_println(error.c_str());
+      LOG_WARNING(LOG_INVERTER, "deserializeJson() failed: %s", error.c_str());
     }
     else
     {
@@ -180,6 +306,8 @@ private:
       _P_Grid = powerRoundToZero(Body_Data_Site["P_Grid"]);
       _P_Load = powerRoundToZero(Body_Data_Site["P_Load"]);
       _P_PV = powerRoundToZero(Body_Data_Site["P_PV"]);
+      _rel_Autonomy = Body_Data_Site["rel_Autonomy"];
+      _rel_SelfConsumption = Body_Data_Site["rel_SelfConsumption"];
     }
     return (error);
   }
@@ -187,7 +315,7 @@ private:
   // sets values to 0 within a defined range
   double powerRoundToZero(double value) const
   {
-    if (abs(value) < POWER_ROUND_TO_ZERO_RANGE)
+    if (abs(value) < Config::get().getActive().powerRoundToZeroRange)
     {
       return (0);
     }
@@ -205,5 +333,7 @@ private:
     _P_Grid = 0.0;
     _P_Load = 0.0;
     _P_PV = 0.0;
+    _rel_Autonomy = 0.0;
+    _rel_SelfConsumption = 0.0;
   }
 };
\ No newline at end of file
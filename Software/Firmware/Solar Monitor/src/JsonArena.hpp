@@ -0,0 +1,163 @@
+// JsonArena.hpp
+
+// fixed memory for the JSON documents, replaces the heap allocator of ArduinoJson
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define JSON_ARENA_SIZE 8192    // in bytes, holds a decoded inverter response with room to spare
+#define JSON_ARENA_ALIGNMENT 8  // alignment of the blocks, suits doubles
+#define JSON_ARENA_NO_BLOCK SIZE_MAX
+
+// blocks are taken one after another, only the last block can grow, shrink or be given back,
+// all blocks are released at once with reset() before the next document
+class JsonArena : public ArduinoJson::Allocator
+{
+public:
+  JsonArena()
+  {
+    _used = 0;
+    _last = JSON_ARENA_NO_BLOCK;
+    _peak = 0;
+    _failures = 0;
+  }
+
+  virtual ~JsonArena()
+  {
+  }
+
+  // releases all blocks, the documents using them must be gone
+  void reset()
+  {
+    _used = 0;
+    _last = JSON_ARENA_NO_BLOCK;
+  }
+
+  void *allocate(size_t size) override
+  {
+    size_t offset = _used;
+
+    if (!reserve(offset, size))
+    {
+      return (nullptr);
+    }
+    _last = offset;
+    return (&_buffer[offset + getHeaderSize()]);
+  }
+
+  void deallocate(void *ptr) override
+  {
+    if ((ptr != nullptr) && (getOffset(ptr) == _last))
+    {
+      _used = _last;
+      _last = JSON_ARENA_NO_BLOCK;
+    }
+  }
+
+  void *reallocate(void *ptr, size_t newSize) override
+  {
+    if (ptr == nullptr)
+    {
+      return (allocate(newSize));
+    }
+
+    size_t offset = getOffset(ptr);
+    size_t oldSize = getBlockSize(offset);
+
+    // the last block grows or shrinks in place
+    if (offset == _last)
+    {
+      return (reserve(offset, newSize) ? ptr : nullptr);
+    }
+
+    // other blocks keep their space when shrinking and are copied when growing
+    if (newSize <= oldSize)
+    {
+      setBlockSize(offset, newSize);
+      return (ptr);
+    }
+    void *block = allocate(newSize);
+    if (block != nullptr)
+    {
+      memcpy(block, ptr, oldSize);
+    }
+    return (block);
+  }
+
+  // returns the number of bytes in use
+  size_t getUsed() const
+  {
+    return (_used);
+  }
+
+  // returns the highest number of bytes used since boot
+  size_t getPeak() const
+  {
+    return (_peak);
+  }
+
+  // returns the number of requests which did not fit
+  unsigned long getFailures() const
+  {
+    return (_failures);
+  }
+
+private:
+  alignas(JSON_ARENA_ALIGNMENT) uint8_t _buffer[JSON_ARENA_SIZE];
+  size_t _used;
+  size_t _last; // offset of the last block
+  size_t _peak;
+  unsigned long _failures;
+
+  // each block starts with its size
+  static size_t getHeaderSize()
+  {
+    return (align(sizeof(size_t)));
+  }
+
+  static size_t align(size_t size)
+  {
+    return ((size + JSON_ARENA_ALIGNMENT - 1) & ~(size_t)(JSON_ARENA_ALIGNMENT - 1));
+  }
+
+  size_t getOffset(const void *ptr) const
+  {
+    return ((const uint8_t *)ptr - _buffer - getHeaderSize());
+  }
+
+  size_t getBlockSize(size_t offset) const
+  {
+    size_t size;
+    memcpy(&size, &_buffer[offset], sizeof(size));
+    return (size);
+  }
+
+  void setBlockSize(size_t offset, size_t size)
+  {
+    memcpy(&_buffer[offset], &size, sizeof(size));
+  }
+
+  // sets the size of the block at offset, which becomes the end of the used space
+  bool reserve(size_t offset, size_t size)
+  {
+    size_t end = offset + getHeaderSize() + align(size);
+
+    if ((size > JSON_ARENA_SIZE) || (end > JSON_ARENA_SIZE))
+    {
+      _failures++;
+      return (false);
+    }
+    setBlockSize(offset, size);
+    _used = end;
+    if (_used > _peak)
+    {
+      _peak = _used;
+    }
+    return (true);
+  }
+};
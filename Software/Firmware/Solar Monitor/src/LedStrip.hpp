@@ -0,0 +1,287 @@
+// LedStrip.hpp
+
+// drives the WS2812 backlight LEDs, either using the RMT peripheral or the NeoPixel library
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include <driver/rmt.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Profiler.hpp>
+#include <Settings.h>
+
+// RMT channel used for the LEDs
+#define LEDSTRIP_RMT_CHANNEL RMT_CHANNEL_0
+
+// WS2812 bit timing in RMT ticks, the RMT clock is divided down to 40 MHz, 25 ns per tick
+#define LEDSTRIP_RMT_CLOCK_DIVIDER 2
+#define LEDSTRIP_T0H 14 // 350 ns
+#define LEDSTRIP_T0L 32 // 800 ns
+#define LEDSTRIP_T1H 28 // 700 ns
+#define LEDSTRIP_T1L 24 // 600 ns
+
+// low time in us latching the colors before the next frame, WS2812B needs at least 280 us
+#define LEDSTRIP_RESET_TIME 300
+
+// maximum number of LEDs, the buffers are fixed in size
+#define LEDSTRIP_MAX_LEDS 72
+
+class LedStrip
+{
+public:
+  LedStrip(uint16_t ledCount, uint8_t pin) : _ledCount(min(ledCount, (uint16_t)LEDSTRIP_MAX_LEDS)), _pin(pin)
+  {
+    memset(_pixels, 0, _ledCount * 3);
+    memset(_txBuffer, 0, _ledCount * 3);
+    memset(_scales, 255, _ledCount);
+    _brightness = 255;
+    _mutex = nullptr;
+    _pending = false;
+    _outputTime = 0;
+    _frameEndTime = 0;
+  }
+
+  virtual ~LedStrip()
+  {
+    if (LED_DRIVER == LED_DRIVER_RMT)
+    {
+      rmt_driver_uninstall(LEDSTRIP_RMT_CHANNEL);
+    }
+    if (_mutex != nullptr)
+    {
+      vSemaphoreDelete(_mutex);
+    }
+  }
+
+  // initializes the LED driver
+  void begin()
+  {
+    _mutex = xSemaphoreCreateMutex();
+    if (LED_DRIVER == LED_DRIVER_RMT)
+    {
+      rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)_pin, LEDSTRIP_RMT_CHANNEL);
+      config.clk_div = LEDSTRIP_RMT_CLOCK_DIVIDER;
+      if ((rmt_config(&config) != ESP_OK) ||
+          (rmt_driver_install(config.channel, 0, 0) != ESP_OK) ||
+          (rmt_translator_init(config.channel, &LedStrip::translate) != ESP_OK))
+      {
+        LOG_ERROR(LOG_DISPLAY, "Failed to initialize RMT for LEDs");
+      }
+      rmt_register_tx_end_callback(&LedStrip::onTransmitted, this);
+    }
+    else
+    {
+      // the library allocates its pixel buffer here, once at boot
+      _neoPixel.updateType(NEO_GRB + NEO_KHZ800);
+      _neoPixel.updateLength(_ledCount);
+      _neoPixel.setPin(_pin);
+      _neoPixel.begin();
+    }
+  }
+
+  // returns the number of LEDs
+  uint16_t getLedCount() const
+  {
+    return (_ledCount);
+  }
+
+  // sets the color of a LED, 0xRRGGBB
+  void setPixelColor(uint16_t index, uint32_t color)
+  {
+    if (index < _ledCount)
+    {
+      uint8_t *pixel = &_pixels[index * 3];
+      pixel[0] = (color >> 8) & 255;  // green
+      pixel[1] = (color >> 16) & 255; // red
+      pixel[2] = color & 255;         // blue
+    }
+  }
+
+  // sets the brightness of a LED used by animations, 0..255, applied on top of the color
+  void setPixelScale(uint16_t index, uint8_t scale)
+  {
+    if (index < _ledCount)
+    {
+      _scales[index] = scale;
+    }
+  }
+
+  // sets the brightness of all LEDs in percent, applied with the next show()
+  void setBrightness(uint8_t brightness)
+  {
+    if (brightness > 100)
+    {
+      brightness = 100;
+    }
+    _brightness = (brightness * 255 + 50) / 100;
+  }
+
+  // sets all LEDs off and resets the brightness of all LEDs
+  void clear()
+  {
+    memset(_pixels, 0, _ledCount * 3);
+    memset(_scales, 255, _ledCount);
+  }
+
+  // sends the colors to the LEDs, with RMT this returns immediately,
+  // if a transmission is still running or the LEDs are latching the colors are sent by the next update(),
+  // may be called from the main loop and from the animation timer
+  void show()
+  {
+    lock();
+    unsigned long start = micros();
+    PROFILE_START(probe);
+
+    if (LED_DRIVER == LED_DRIVER_RMT)
+    {
+      _pending = true;
+      transmit();
+    }
+    else
+    {
+      // blocking, interrupts are disabled while sending
+      for (uint16_t i = 0; i < _ledCount; i++)
+      {
+        uint8_t pixel[3];
+        scalePixel(i, pixel);
+        _neoPixel.setPixelColor(i, pixel[1], pixel[0], pixel[2]);
+      }
+      _neoPixel.show();
+    }
+    _outputTime += micros() - start;
+    PROFILE_STOP(probe, profile_stage::led_show);
+    unlock();
+  }
+
+  // sends colors which could not be sent by show() because the previous transmission was running
+  // or the LEDs were latching
+  void update()
+  {
+    if (_pending)
+    {
+      lock();
+      unsigned long start = micros();
+      transmit();
+      _outputTime += micros() - start;
+      unlock();
+    }
+  }
+
+  // returns if colors wait for update(), a running transmission alone needs no call
+  bool isPending() const
+  {
+    return (_pending);
+  }
+
+  // returns the time spent in show() and update() since the last call in us
+  unsigned long takeOutputTime()
+  {
+    unsigned long outputTime = _outputTime;
+    _outputTime = 0;
+    return (outputTime);
+  }
+
+private:
+  uint16_t _ledCount;
+  uint8_t _pin;
+  uint8_t _pixels[LEDSTRIP_MAX_LEDS * 3];   // GRB
+  uint8_t _txBuffer[LEDSTRIP_MAX_LEDS * 3]; // GRB, read by the RMT driver while sending
+  uint8_t _scales[LEDSTRIP_MAX_LEDS];       // brightness of each LED, 255 is full
+  uint8_t _brightness; // brightness of all LEDs, 255 is full
+  SemaphoreHandle_t _mutex;
+  bool _pending;
+  unsigned long _outputTime;
+  volatile int64_t _frameEndTime; // in us, set when the RMT has sent the last bit of a frame
+  Adafruit_NeoPixel _neoPixel;
+
+  void lock()
+  {
+    if (_mutex != nullptr)
+    {
+      xSemaphoreTake(_mutex, portMAX_DELAY);
+    }
+  }
+
+  void unlock()
+  {
+    if (_mutex != nullptr)
+    {
+      xSemaphoreGive(_mutex);
+    }
+  }
+
+  // returns the color bytes of a LED with the brightness applied
+  void scalePixel(uint16_t index, uint8_t *pixel) const
+  {
+    uint16_t scale = (_scales[index] * _brightness + 127) / 255;
+    for (int i = 0; i < 3; i++)
+    {
+      pixel[i] = (scale == 255) ? _pixels[index * 3 + i] : (_pixels[index * 3 + i] * scale + 127) / 255;
+    }
+  }
+
+  // starts the transmission if the previous one is finished and the LEDs have latched its colors,
+  // a new frame starting earlier would be taken as continuation of the previous one
+  void transmit()
+  {
+    if ((rmt_wait_tx_done(LEDSTRIP_RMT_CHANNEL, 0) == ESP_OK) &&
+        (esp_timer_get_time() - _frameEndTime >= LEDSTRIP_RESET_TIME))
+    {
+      for (uint16_t i = 0; i < _ledCount; i++)
+      {
+        scalePixel(i, &_txBuffer[i * 3]);
+      }
+      rmt_write_sample(LEDSTRIP_RMT_CHANNEL, _txBuffer, _ledCount * 3, false);
+      _pending = false;
+    }
+  }
+
+  // records the end of a frame, called by the RMT driver in the interrupt after the last bit
+  static void IRAM_ATTR onTransmitted(rmt_channel_t channel, void *arg)
+  {
+    if (channel == LEDSTRIP_RMT_CHANNEL)
+    {
+      ((LedStrip *)arg)->_frameEndTime = esp_timer_get_time();
+    }
+  }
+
+  // converts the pixel bytes to RMT items, called by the RMT driver while sending
+  static void IRAM_ATTR translate(const void *src, rmt_item32_t *dest, size_t srcSize,
+                                  size_t wantedNum, size_t *translatedSize, size_t *itemNum)
+  {
+    rmt_item32_t bit0;
+    rmt_item32_t bit1;
+    bit0.level0 = 1;
+    bit0.duration0 = LEDSTRIP_T0H;
+    bit0.level1 = 0;
+    bit0.duration1 = LEDSTRIP_T0L;
+    bit1.level0 = 1;
+    bit1.duration0 = LEDSTRIP_T1H;
+    bit1.level1 = 0;
+    bit1.duration1 = LEDSTRIP_T1L;
+
+    const uint8_t *source = (const uint8_t *)src;
+    size_t size = 0;
+    size_t num = 0;
+    while ((size < srcSize) && (num + 8 <= wantedNum))
+    {
+      for (int i = 7; i >= 0; i--)
+      {
+        dest->val = (source[size] & (1 << i)) ? bit1.val : bit0.val;
+        dest++;
+        num++;
+      }
+      size++;
+    }
+    *translatedSize = size;
+    *itemNum = num;
+  }
+};
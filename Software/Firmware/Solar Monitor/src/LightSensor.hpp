@@ -0,0 +1,161 @@
+// LightSensor.hpp
+
+// reads the ambient light from a BH1750 sensor on I2C
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Events.h>
+#include <Settings.h>
+
+// BH1750 I2C address with ADDR pin low
+#define BH1750_ADDRESS 0x23
+
+// BH1750 commands
+#define BH1750_POWER_ON 0x01
+#define BH1750_CONTINUOUS_HIGH_RES 0x10 // 1 lux resolution, new value every 120 ms
+
+// I2C clock
+#define LIGHTSENSOR_I2C_FREQUENCY 400000
+
+class LightSensor
+{
+public:
+  LightSensor(uint8_t pinSDA, uint8_t pinSCL) : _pinSDA(pinSDA), _pinSCL(pinSCL)
+  {
+    _available = false;
+    _valid = false;
+    _lux = 0;
+    _lastReadTimestamp = 0;
+  }
+
+  virtual ~LightSensor()
+  {
+  }
+
+  // starts continuous measurements, afterwards the latest value can be read at any time
+  // without waiting for a conversion
+  bool begin()
+  {
+#if SIMULATED_LIGHT_SENSOR
+    _available = true;
+#else
+    Wire.begin(_pinSDA, _pinSCL, LIGHTSENSOR_I2C_FREQUENCY);
+    // keep a missing sensor from blocking the loop
+    Wire.setTimeOut(10);
+    _available = sendCommand(BH1750_POWER_ON) && sendCommand(BH1750_CONTINUOUS_HIGH_RES);
+    if (!_available)
+    {
+      LOG_WARNING(LOG_SENSORS, "Light sensor not found");
+    }
+#endif
+    _lastReadTimestamp = millis();
+    return (_available);
+  }
+
+  // reads the sensor if the read interval has elapsed, returns true if there is a new value
+  bool process()
+  {
+    bool result = false;
+    float lux = 0;
+
+    if (_available && (millis() - _lastReadTimestamp >= AMBIENT_READ_INTERVAL))
+    {
+      _lastReadTimestamp = millis();
+      if (read(&lux))
+      {
+        // smooth out short changes, e.g. shadows
+        _lux = _valid ? _lux + AMBIENT_FILTER * (lux - _lux) : lux;
+        _valid = true;
+        result = true;
+      }
+    }
+    return (result);
+  }
+
+  // returns the time in ms until the next read, NO_DEADLINE without sensor
+  unsigned long getTimeToNextRead() const
+  {
+    unsigned long result = NO_DEADLINE;
+
+    if (_available)
+    {
+      unsigned long elapsed = millis() - _lastReadTimestamp;
+      result = (elapsed < AMBIENT_READ_INTERVAL) ? AMBIENT_READ_INTERVAL - elapsed : 0;
+    }
+    return (result);
+  }
+
+  // returns if the sensor has delivered a value
+  bool isValid() const
+  {
+    return (_valid);
+  }
+
+  // returns the filtered ambient light in lux
+  float getLux() const
+  {
+    return (_lux);
+  }
+
+  // returns the brightness in percent for the filtered ambient light,
+  // interpolated on a logarithmic scale like the eye perceives it
+  uint8_t getBrightness() const
+  {
+    uint8_t brightness = 100;
+
+    if (_valid)
+    {
+      float lux = constrain(_lux, (float)AMBIENT_DARK_LUX, (float)AMBIENT_BRIGHT_LUX);
+      float position = log10f(lux / AMBIENT_DARK_LUX) / log10f((float)AMBIENT_BRIGHT_LUX / AMBIENT_DARK_LUX);
+      brightness = AMBIENT_MIN_BRIGHTNESS + (100 - AMBIENT_MIN_BRIGHTNESS) * position + 0.5;
+    }
+    return (brightness);
+  }
+
+private:
+  uint8_t _pinSDA;
+  uint8_t _pinSCL;
+  bool _available;
+  bool _valid;
+  float _lux;
+  unsigned long _lastReadTimestamp;
+
+  bool sendCommand(uint8_t command)
+  {
+    Wire.beginTransmission(BH1750_ADDRESS);
+    Wire.write(command);
+    return (Wire.endTransmission() == 0);
+  }
+
+  // reads the last measurement, the sensor measures continuously, so this never waits
+  bool read(float *lux)
+  {
+    bool result = false;
+
+#if SIMULATED_LIGHT_SENSOR
+    // sweeps between dark and bright in two minutes
+    *lux = AMBIENT_BRIGHT_LUX / 2.0 * (1 + sin(2 * PI * millis() / 120000.0));
+    result = true;
+#else
+    if (Wire.requestFrom((uint8_t)BH1750_ADDRESS, (uint8_t)2) == 2)
+    {
+      uint16_t raw = Wire.read() << 8;
+      raw |= Wire.read();
+      *lux = raw / 1.2;
+      result = true;
+    }
+    else
+    {
+      LOG_WARNING(LOG_SENSORS, "Failed to read light sensor");
+    }
+#endif
+    return (result);
+  }
+};
@@ -0,0 +1,372 @@
+// Logger.hpp
+
+// deferred logger, a call stores only the format string address and the binary arguments
+// in a lock-free ring buffer, the logger task formats and prints the messages later,
+// levels and modules are filtered at compile time by LOG_LEVEL and LOG_MODULES in DebugDefs.h
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <DebugDefs.h>
+
+// levels
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_VERBOSE 4
+
+// modules, bits of LOG_MODULES
+#define LOG_MAIN 0x01
+#define LOG_CONTROLLER 0x02
+#define LOG_NETWORK 0x04
+#define LOG_INVERTER 0x08
+#define LOG_DISPLAY 0x10   // displays, LEDs, dimmer, cathode usage
+#define LOG_SENSORS 0x20   // light sensor, temperature sensor, GPS
+#define LOG_INPUT 0x40     // PIR, button
+#define LOG_SCHEDULER 0x80
+
+#define LOG_BUFFER_SIZE 64     // messages, power of 2
+#define LOG_MAX_ARGS 6
+#define LOG_LINE_LENGTH 128
+#define LOG_FLUSH_INTERVAL 20  // in ms
+#define LOG_TASK_STACK 3072
+#define LOG_TASK_PRIORITY 1
+#define LOG_TASK_CORE 0
+
+// logs a printf style message, %s arguments must be strings which are never changed, e.g. literals,
+// calls above LOG_LEVEL or of modules not in LOG_MODULES are removed by the compiler
+#define LOG_AT(level, module, ...)                                     \
+  do                                                                   \
+  {                                                                    \
+    if (((level) <= LOG_LEVEL) && (((module) & (LOG_MODULES)) != 0))   \
+    {                                                                  \
+      Logger::get().log(level, module, __VA_ARGS__);                   \
+    }                                                                  \
+  } while (0)
+
+#define LOG_ERROR(module, ...) LOG_AT(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#define LOG_WARNING(module, ...) LOG_AT(LOG_LEVEL_WARNING, module, __VA_ARGS__)
+#define LOG_INFO(module, ...) LOG_AT(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#define LOG_VERBOSE(module, ...) LOG_AT(LOG_LEVEL_VERBOSE, module, __VA_ARGS__)
+
+enum class log_arg : uint8_t
+{
+  integer,
+  unsigned_integer,
+  real,
+  string
+};
+
+// logged message, the format string is not copied
+typedef struct
+{
+  uint32_t timestamp; // in ms
+  const char *format;
+  uint8_t level;
+  uint8_t module;
+  uint8_t argCount;
+  log_arg types[LOG_MAX_ARGS];
+  union
+  {
+    int32_t i;
+    uint32_t u;
+    float f;
+    const char *s;
+  } args[LOG_MAX_ARGS];
+} LOG_RECORD;
+
+class Logger
+{
+public:
+  // returns the logger shared by all modules
+  static Logger &get()
+  {
+    static Logger logger;
+    return (logger);
+  }
+
+  // starts the logger task printing the messages on serial
+  void begin()
+  {
+    if ((LOG_LEVEL > LOG_LEVEL_NONE) && (_task == nullptr))
+    {
+      if (!DEBUG)
+      {
+        Serial.begin(115200);
+      }
+      xTaskCreatePinnedToCore(&Logger::run, "logger", LOG_TASK_STACK, this,
+                              LOG_TASK_PRIORITY, &_task, LOG_TASK_CORE);
+    }
+  }
+
+  // stores a message, never blocks, the message is dropped if the buffer is full,
+  // may be called from any task or interrupt
+  template <typename... Args>
+  void log(uint8_t level, uint8_t module, const char *format, Args... args)
+  {
+    static_assert(sizeof...(args) <= LOG_MAX_ARGS, "too many log arguments");
+
+    uint32_t position = _head.load(std::memory_order_relaxed);
+    LOG_SLOT *slot;
+
+    // reserve a slot
+    while (true)
+    {
+      slot = &_slots[position & (LOG_BUFFER_SIZE - 1)];
+      int32_t difference = (int32_t)(slot->sequence.load(std::memory_order_acquire) - position);
+      if (difference == 0)
+      {
+        if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (difference < 0)
+      {
+        // full
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      else
+      {
+        position = _head.load(std::memory_order_relaxed);
+      }
+    }
+
+    LOG_RECORD &record = slot->record;
+    record.timestamp = millis();
+    record.format = format;
+    record.level = level;
+    record.module = module;
+    record.argCount = 0;
+    setArgs(record, args...);
+    // publish to the logger task
+    slot->sequence.store(position + 1, std::memory_order_release);
+  }
+
+  // formats and prints all stored messages, returns the number of messages printed,
+  // called by the logger task only
+  uint32_t flush(Print &out)
+  {
+    uint32_t count = 0;
+    LOG_RECORD record;
+    char line[LOG_LINE_LENGTH];
+
+    while (take(&record))
+    {
+      format(record, line, sizeof(line));
+      out.println(line);
+      count++;
+    }
+    uint32_t dropped = _dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+      snprintf(line, sizeof(line), "%lu log messages dropped", (unsigned long)dropped);
+      out.println(line);
+    }
+    return (count);
+  }
+
+  // formats a message as text, prefixed with the time, the level and the module
+  static void format(const LOG_RECORD &record, char *line, size_t size)
+  {
+    static const char levels[] = {' ', 'E', 'W', 'I', 'V'};
+    int length = snprintf(line, size, "%6lu.%03lu %c %-5s ",
+                          (unsigned long)(record.timestamp / 1000), (unsigned long)(record.timestamp % 1000),
+                          (record.level <= LOG_LEVEL_VERBOSE) ? levels[record.level] : '?',
+                          getModuleName(record.module));
+    if ((length > 0) && ((size_t)length < size))
+    {
+      formatMessage(record, line + length, size - length);
+    }
+  }
+
+private:
+  // buffer slot, the sequence tells producers and consumer whose turn it is
+  typedef struct
+  {
+    std::atomic<uint32_t> sequence;
+    LOG_RECORD record;
+  } LOG_SLOT;
+
+  LOG_SLOT _slots[LOG_BUFFER_SIZE];
+  std::atomic<uint32_t> _head; // next position to write
+  uint32_t _tail;              // next position to read, used by the logger task only
+  std::atomic<uint32_t> _dropped;
+  TaskHandle_t _task;
+
+  Logger()
+  {
+    for (uint32_t i = 0; i < LOG_BUFFER_SIZE; i++)
+    {
+      _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _head.store(0, std::memory_order_relaxed);
+    _tail = 0;
+    _dropped.store(0, std::memory_order_relaxed);
+    _task = nullptr;
+  }
+
+  static void run(void *arg)
+  {
+    Logger *logger = (Logger *)arg;
+    char buffer[32];
+
+    // the float conversion of newlib keeps big number buffers per task on the heap,
+    // converting once at start takes them before the heap guard is sealed
+    snprintf(buffer, sizeof(buffer), "%.6f", 123456789.123456);
+    while (true)
+    {
+      logger->flush(Serial);
+      vTaskDelay(pdMS_TO_TICKS(LOG_FLUSH_INTERVAL));
+    }
+  }
+
+  // takes the oldest message, returns false if there is none
+  bool take(LOG_RECORD *record)
+  {
+    LOG_SLOT *slot = &_slots[_tail & (LOG_BUFFER_SIZE - 1)];
+    if ((int32_t)(slot->sequence.load(std::memory_order_acquire) - (_tail + 1)) < 0)
+    {
+      return (false);
+    }
+    *record = slot->record;
+    // hand the slot back to the producers
+    slot->sequence.store(_tail + LOG_BUFFER_SIZE, std::memory_order_release);
+    _tail++;
+    return (true);
+  }
+
+  static void setArgs(LOG_RECORD &record)
+  {
+  }
+
+  template <typename T, typename... Args>
+  static void setArgs(LOG_RECORD &record, T arg, Args... args)
+  {
+    setArg(record, arg);
+    setArgs(record, args...);
+  }
+
+  static void setArg(LOG_RECORD &record, int value)
+  {
+    record.types[record.argCount] = log_arg::integer;
+    record.args[record.argCount++].i = value;
+  }
+
+  static void setArg(LOG_RECORD &record, long value)
+  {
+    setArg(record, (int)value);
+  }
+
+  static void setArg(LOG_RECORD &record, unsigned int value)
+  {
+    record.types[record.argCount] = log_arg::unsigned_integer;
+    record.args[record.argCount++].u = value;
+  }
+
+  static void setArg(LOG_RECORD &record, unsigned long value)
+  {
+    setArg(record, (unsigned int)value);
+  }
+
+  static void setArg(LOG_RECORD &record, double value)
+  {
+    record.types[record.argCount] = log_arg::real;
+    record.args[record.argCount++].f = (float)value;
+  }
+
+  static void setArg(LOG_RECORD &record, const char *value)
+  {
+    record.types[record.argCount] = log_arg::string;
+    record.args[record.argCount++].s = value;
+  }
+
+  // formats the message, each conversion is passed to snprintf with its argument
+  static void formatMessage(const LOG_RECORD &record, char *text, size_t size)
+  {
+    const char *format = record.format;
+    uint8_t arg = 0;
+    size_t length = 0;
+
+    while ((*format != 0) && (length + 1 < size))
+    {
+      if ((*format != '%') || (format[1] == '%') || (arg >= record.argCount))
+      {
+        text[length++] = *format;
+        format += ((*format == '%') && (format[1] == '%')) ? 2 : 1;
+        continue;
+      }
+
+      // copy the conversion, e.g. %5.2f, without length modifiers
+      char conversion[12];
+      size_t conversionLength = 0;
+      conversion[conversionLength++] = *format++;
+      while ((*format != 0) && (strchr("-+ #0123456789.", *format) != nullptr) && (conversionLength < sizeof(conversion) - 3))
+      {
+        conversion[conversionLength++] = *format++;
+      }
+      while ((*format == 'l') || (*format == 'h'))
+      {
+        format++;
+      }
+      char type = *format;
+      if (type == 0)
+      {
+        break;
+      }
+      format++;
+
+      // the type of the stored argument wins over the conversion
+      int written = 0;
+      switch (record.types[arg])
+      {
+      case log_arg::integer:
+        conversion[conversionLength++] = (strchr("xXuoc", type) != nullptr) ? type : 'd';
+        conversion[conversionLength] = 0;
+        written = snprintf(text + length, size - length, conversion, (int)record.args[arg].i);
+        break;
+
+      case log_arg::unsigned_integer:
+        conversion[conversionLength++] = (strchr("xXodic", type) != nullptr) ? type : 'u';
+        conversion[conversionLength] = 0;
+        written = snprintf(text + length, size - length, conversion, (unsigned int)record.args[arg].u);
+        break;
+
+      case log_arg::real:
+        conversion[conversionLength++] = (strchr("eEgG", type) != nullptr) ? type : 'f';
+        conversion[conversionLength] = 0;
+        written = snprintf(text + length, size - length, conversion, (double)record.args[arg].f);
+        break;
+
+      case log_arg::string:
+        conversion[conversionLength++] = 's';
+        conversion[conversionLength] = 0;
+        written = snprintf(text + length, size - length, conversion,
+                           (record.args[arg].s != nullptr) ? record.args[arg].s : "(null)");
+        break;
+      }
+      arg++;
+      if (written > 0)
+      {
+        length = min(length + written, size - 1);
+      }
+    }
+    text[length] = 0;
+  }
+
+  // returns a short name of a module
+  static const char *getModuleName(uint8_t module)
+  {
+    static const char *names[] = {"main", "ctrl", "net", "inv", "disp", "sens", "input", "sched"};
+    uint8_t index = (module != 0) ? __builtin_ctz(module) : 0;
+    return ((index < 8) ? names[index] : "?");
+  }
+};
@@ -0,0 +1,697 @@
+// Network.hpp
+
+// runs the ethernet port and the inverter requests in a separate task,
+// so blocking network operations never delay the display, the button or the sensors
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <esp_mac.h>
+#include <Arduino.h>
+#include <SPI.h>
+#include <Ethernet.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Inverter.hpp>
+#include <JsonArena.hpp>
+#include <HeapGuard.hpp>
+#include <Preferences.h>
+#include <Profiler.hpp>
+#include <Config.hpp>
+#include <FirmwareUpdate.hpp>
+#include <FlashWriter.hpp>
+#include <Dashboard.hpp>
+#include <Cluster.hpp>
+#include <ApiCache.hpp>
+#include <Errors.hpp>
+#include <Events.h>
+#include <Settings.h>
+
+#define NETWORK_TASK_STACK 8192
+#define NETWORK_TASK_PRIORITY 1
+#define NETWORK_TASK_CORE 0 // the loop runs on core 1
+#define NETWORK_SERVE_INTERVAL 100 // in ms, web server clients are checked in this interval
+#define NETWORK_CLIENT_TIMEOUT 1000 // in ms
+#define NETWORK_BODY_SIZE 1024     // maximum size of a request body, e.g. a configuration
+
+// NVS namespace and key of the last DHCP lease
+#define NETWORK_NAMESPACE "network"
+#define NETWORK_LEASE_KEY "lease"
+#define NETWORK_LEASE_VERSION 1
+
+enum class network_state
+{
+  initializing,
+  ready,
+  failed
+};
+
+// addresses assigned by DHCP, stored to be reused at boot
+typedef struct
+{
+  uint32_t version;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+} NETWORK_LEASE;
+
+class Network
+{
+public:
+  Network(uint8_t pinCS) : _pinCS(pinCS), _server(HTTP_PORT)
+  {
+    _task = nullptr;
+    _mutex = nullptr;
+    _state = network_state::initializing;
+    _error = ERR_SUCCESS;
+    _newValues = false;
+    _valuesTimestamp = 0;
+    _notify = nullptr;
+    _notifyArg = nullptr;
+    _leaseReused = false;
+    _restartPending = false;
+    _temperature = NAN;
+  }
+
+  virtual ~Network()
+  {
+    if (_task != nullptr)
+    {
+      vTaskDelete(_task);
+    }
+    if (_mutex != nullptr)
+    {
+      vSemaphoreDelete(_mutex);
+    }
+  }
+
+  // starts the network task, the callback is notified on state changes and new values
+  void begin(EVENT_CALLBACK notify, void *notifyArg)
+  {
+    _notify = notify;
+    _notifyArg = notifyArg;
+    _mutex = xSemaphoreCreateMutex();
+    if (xTaskCreatePinnedToCore(&Network::run, "network", NETWORK_TASK_STACK, this,
+                                NETWORK_TASK_PRIORITY, &_task, NETWORK_TASK_CORE) != pdPASS)
+    {
+      LOG_ERROR(LOG_NETWORK, "Failed to create network task");
+      _task = nullptr;
+      _state = network_state::failed;
+    }
+  }
+
+  // asks the network task to request new values from the inverter, returns immediately
+  void requestValues()
+  {
+    if ((_task != nullptr) && (_state == network_state::ready))
+    {
+      xTaskNotifyGive(_task);
+    }
+  }
+
+  // copies the values received since the last call, returns false if there are none,
+  // the optional timestamp is set to the time the values have been received in us
+  bool takeValues(Inverter *inverter, int64_t *timestamp = nullptr)
+  {
+    bool result = false;
+
+    if (_newValues)
+    {
+      xSemaphoreTake(_mutex, portMAX_DELAY);
+      *inverter = _values;
+      if (timestamp != nullptr)
+      {
+        *timestamp = _valuesTimestamp;
+      }
+      _newValues = false;
+      xSemaphoreGive(_mutex);
+      result = true;
+    }
+    return (result);
+  }
+
+  // sets the enclosure temperature in degrees celsius shown by /metrics and the dashboard, NAN without sensor
+  void setTemperature(float temperature)
+  {
+    _temperature = temperature;
+  }
+
+  // returns the state of the network initialization
+  network_state getState() const
+  {
+    return (_state);
+  }
+
+  // returns the error code if the initialization failed
+  int getError() const
+  {
+    return (_error);
+  }
+
+  // returns the IP address assigned by DHCP
+  IPAddress getLocalIP() const
+  {
+    return (_localIP);
+  }
+
+  // returns if a new firmware has been written and the controller should restart
+  bool isRestartPending() const
+  {
+    return (_restartPending);
+  }
+
+  // provides access to the memory used to decode the inverter responses
+  const JsonArena *getJsonArena() const
+  {
+    return (&_jsonArena);
+  }
+
+private:
+  uint8_t _pinCS;
+  TaskHandle_t _task;
+  SemaphoreHandle_t _mutex;
+  volatile network_state _state;
+  volatile int _error;
+  byte _mac[6];
+  IPAddress _localIP;
+  EthernetClient _client;
+  EthernetServer _server;
+  Inverter _inverter;          // used by the network task
+  Inverter _values;            // last values, protected by the mutex
+  JsonArena _jsonArena;        // decodes the inverter responses without the heap
+  char _body[NETWORK_BODY_SIZE]; // body of the last web client request
+  FirmwareUpdate _update;
+  Dashboard _dashboard;          // pushes the values to the browsers
+  Cluster _cluster;              // shares the values with the other monitors
+  ApiCache _apiCache;            // last inverter response, served to other clients
+  EthernetClient _updateClient;  // downloads the firmware image
+  FlashWriter _flashWriter;      // writes the firmware image to the inactive app partition
+  volatile bool _restartPending; // a new firmware has been written
+  volatile float _temperature;   // set by the main loop
+  Preferences _preferences;
+  bool _leaseReused;           // the address of the last DHCP lease is used without asking the server
+  volatile bool _newValues;
+  int64_t _valuesTimestamp; // in us
+  EVENT_CALLBACK _notify;
+  void *_notifyArg;
+
+  static void run(void *arg)
+  {
+    ((Network *)arg)->loop();
+  }
+
+  // network task, owns the ethernet port
+  void loop()
+  {
+    _error = initNetwork();
+    if (_error != ERR_SUCCESS)
+    {
+      _state = network_state::failed;
+      notify();
+      _task = nullptr;
+      vTaskDelete(nullptr);
+    }
+    _client.setTimeout(10000);
+    _server.begin();
+    if (CLUSTER_ENABLED)
+    {
+      _cluster.begin(_mac);
+    }
+    _state = network_state::ready;
+    notify();
+
+    while (true)
+    {
+      // wait for a request, serve web clients and renew the DHCP lease if needed in between
+      bool requested = (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NETWORK_SERVE_INTERVAL)) > 0);
+      Ethernet.maintain();
+      serveClient();
+      _dashboard.process();
+      _cluster.process();
+      // the download blocks the inverter requests, the main loop keeps running on the other core
+      if (_update.isRequested() && (_update.run(_updateClient, _flashWriter) == ERR_SUCCESS))
+      {
+        _restartPending = true;
+        notify();
+      }
+      // a follower takes the values of the leader instead of polling the inverter
+      INVERTER_VALUES values;
+      if (_cluster.receive(&values))
+      {
+        _inverter.setValues(values);
+        storeValues(values);
+      }
+      // the leader also polls while its own display is off, the followers depend on it
+      if ((requested && _cluster.isPolling()) || _cluster.isPollDue())
+      {
+        pollInverter();
+      }
+      // the first request has been made with the reused address, the DHCP server is asked now
+      if (requested && _leaseReused)
+      {
+        renewLease();
+      }
+    }
+  }
+
+  // requests the values from the inverter, keeps the response for other clients and sends the values
+  // to the followers, skipped if a client caused a request just before
+  void pollInverter()
+  {
+    INVERTER_VALUES values;
+    size_t size = 0;
+    size_t length = 0;
+
+    if (_apiCache.isRequestedWithin(CONFIG_MIN_POLLINGINTERVAL * 1000UL))
+    {
+      return;
+    }
+    char *body = _apiCache.getBuffer(&size);
+    if (_inverter.requestValues(&_client, &_jsonArena, body, size, &length))
+    {
+      _apiCache.commit(length);
+      _inverter.getValues(&values);
+      storeValues(values);
+      _cluster.publish(&values);
+    }
+    else
+    {
+      // the followers keep waiting for this unit
+      _cluster.publish(nullptr);
+    }
+  }
+
+  // passes new values to the main loop and the dashboard
+  void storeValues(const INVERTER_VALUES &values)
+  {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _values = _inverter;
+    _valuesTimestamp = esp_timer_get_time();
+    _newValues = true;
+    xSemaphoreGive(_mutex);
+    notify();
+    // the dashboard shows the same values, the browsers cause no inverter requests
+    _dashboard.publish(values, _temperature);
+  }
+
+  // answers a web client, / returns the dashboard page, /events keeps the client open for the dashboard values,
+  // /metrics returns the latency histograms and the temperature, /cluster returns the role in the cluster,
+  // the inverter API path returns the last inverter response, a new request is made only if it is stale,
+  // a follower of a cluster sends the client to the leader,
+  // GET /config returns the configuration, POST /config changes the key=value pairs of the body if the API token is sent,
+  // POST /update starts a firmware update after the response if the API token is sent, GET /update returns its progress
+  void serveClient()
+  {
+    EthernetClient client = _server.available();
+    if (client)
+    {
+      bool keepOpen = false;
+      char line[64] = {0};
+      char header[64];
+      char token[CONFIG_TOKEN_SIZE] = {0};
+      size_t contentLength = 0;
+      client.setTimeout(NETWORK_CLIENT_TIMEOUT);
+      client.readBytesUntil('\r', line, sizeof(line) - 1);
+      // skip the rest of the request line, then read the headers up to the empty line,
+      // only the content length and the API token are used
+      client.readBytesUntil('\n', header, sizeof(header) - 1);
+      while (true)
+      {
+        size_t length = client.readBytesUntil('\n', header, sizeof(header) - 1);
+        header[length] = '\0';
+        if ((length == 0) || (strcmp(header, "\r") == 0))
+        {
+          break;
+        }
+        if (strncasecmp(header, "Content-Length:", 15) == 0)
+        {
+          contentLength = strtoul(header + 15, nullptr, 10);
+        }
+        else if (strncasecmp(header, "Authorization: Bearer ", 22) == 0)
+        {
+          size_t tokenLength = strcspn(header + 22, " \r");
+          if (tokenLength < sizeof(token))
+          {
+            memcpy(token, header + 22, tokenLength);
+            token[tokenLength] = '\0';
+          }
+        }
+      }
+      if (strncmp(line, "GET / ", 6) == 0)
+      {
+        _dashboard.sendPage(client);
+      }
+      else if (strncmp(line, "GET /events ", 12) == 0)
+      {
+        keepOpen = _dashboard.addViewer(client);
+        if (!keepOpen)
+        {
+          sendStatus(client, "503 Service Unavailable");
+        }
+      }
+      else if (PROFILING && (strncmp(line, "GET /metrics ", 13) == 0))
+      {
+        sendStatus(client, "200 OK");
+        Profiler::get().print(client);
+        printTemperature(client);
+      }
+      else if ((strncmp(line, "GET " API_CACHE_PATH, 4 + strlen(API_CACHE_PATH)) == 0) &&
+               ((line[4 + strlen(API_CACHE_PATH)] == ' ') || (line[4 + strlen(API_CACHE_PATH)] == '?')))
+      {
+        if (_cluster.isPolling())
+        {
+          // clients waiting meanwhile are served from the new response
+          bool requested = _apiCache.isRequestDue() && (_state == network_state::ready);
+          if (requested)
+          {
+            pollInverter();
+          }
+          if (!_apiCache.send(client, requested))
+          {
+            sendStatus(client, "503 Service Unavailable");
+          }
+        }
+        else if ((uint32_t)_cluster.getLeaderAddress() != 0)
+        {
+          // a follower never requests the inverter, the leader has the current response,
+          // the query is kept unless the request line has been cut
+          char *end = strchr(line + 4, ' ');
+          if (end != nullptr)
+          {
+            *end = '\0';
+          }
+          _apiCache.redirect(client, _cluster.getLeaderAddress(), (end != nullptr) ? line + 4 : API_CACHE_PATH);
+        }
+        else
+        {
+          // no leader has been heard yet
+          sendStatus(client, "503 Service Unavailable");
+        }
+      }
+      else if (strncmp(line, "GET /cluster ", 13) == 0)
+      {
+        sendStatus(client, "200 OK");
+        _cluster.print(client);
+      }
+      else if (strncmp(line, "GET /config ", 12) == 0)
+      {
+        sendStatus(client, "200 OK");
+        Config::get().print(client);
+      }
+      else if (strncmp(line, "POST /config ", 13) == 0)
+      {
+        int error = ERR_CONFIG_SYNTAX;
+        if (!Config::get().isAuthorized(token))
+        {
+          LOG_WARNING(LOG_NETWORK, "Configuration change without valid API token rejected");
+          error = ERR_UNAUTHORIZED;
+        }
+        else if (contentLength < sizeof(_body))
+        {
+          size_t length = client.readBytes(_body, contentLength);
+          _body[length] = '\0';
+          error = Config::get().update(_body);
+        }
+        if (error == ERR_SUCCESS)
+        {
+          // applied by the main loop with its next pass
+          notify(controller_event::config);
+          sendStatus(client, "200 OK");
+          Config::get().print(client);
+        }
+        else
+        {
+          sendStatus(client, getErrorStatus(error));
+          client.println(Errors::getErrorText(error));
+        }
+      }
+      else if (strncmp(line, "GET /update ", 12) == 0)
+      {
+        sendStatus(client, "200 OK");
+        _update.print(client);
+      }
+      else if (strncmp(line, "POST /update ", 13) == 0)
+      {
+        int error = ERR_UPDATE_REQUEST;
+        if (!Config::get().isAuthorized(token))
+        {
+          LOG_WARNING(LOG_NETWORK, "Firmware update without valid API token rejected");
+          error = ERR_UNAUTHORIZED;
+        }
+        else if (contentLength < sizeof(_body))
+        {
+          size_t length = client.readBytes(_body, contentLength);
+          _body[length] = '\0';
+          error = _update.request(_body);
+        }
+        if (error == ERR_SUCCESS)
+        {
+          sendStatus(client, "202 Accepted");
+        }
+        else
+        {
+          sendStatus(client, getErrorStatus(error));
+          client.println(Errors::getErrorText(error));
+        }
+      }
+      else
+      {
+        sendStatus(client, "404 Not Found");
+      }
+      if (!keepOpen)
+      {
+        client.stop();
+      }
+    }
+  }
+
+  // prints the enclosure temperature
+  void printTemperature(Print &out) const
+  {
+    char line[32] = "Temperature: n/a";
+
+    if (!isnan(_temperature))
+    {
+      snprintf(line, sizeof(line), "Temperature: %.1f C", _temperature);
+    }
+    out.println(line);
+  }
+
+  // returns the HTTP status of a rejected request
+  static const char *getErrorStatus(int error)
+  {
+    const char *status = "400 Bad Request";
+
+    if (error == ERR_UNAUTHORIZED)
+    {
+      status = "401 Unauthorized";
+    }
+    else if ((error == ERR_CONFIG_BUSY) || (error == ERR_UPDATE_BUSY))
+    {
+      status = "503 Service Unavailable";
+    }
+    return (status);
+  }
+
+  // sends the status line and the headers of a plain text response
+  static void sendStatus(EthernetClient &client, const char *status)
+  {
+    client.print(F("HTTP/1.1 "));
+    client.println(status);
+    client.println(F("Content-Type: text/plain"));
+    client.println(F("Connection: close"));
+    client.println();
+  }
+
+  void notify(controller_event event = controller_event::network)
+  {
+    if (_notify != nullptr)
+    {
+      _notify(_notifyArg, event);
+    }
+  }
+
+  // initializes the network hardware
+  int initNetwork()
+  {
+    int result = ERR_SUCCESS;
+    NETWORK_LEASE lease;
+
+    LOG_INFO(LOG_NETWORK, "Initializing network...");
+    LOG_VERBOSE(LOG_NETWORK, "Getting mac address");
+    // get mac address, this ESP32 type provides an ethernet mac address
+    esp_err_t err = esp_read_mac(_mac, ESP_MAC_ETH);
+    if (err == ESP_OK)
+    {
+      LOG_INFO(LOG_NETWORK, "MAC Address: %2X:%2X:%2X:%2X:%2X:%2X",
+               _mac[0], _mac[1], _mac[2], _mac[3], _mac[4], _mac[5]);
+
+      LOG_VERBOSE(LOG_NETWORK, "Initializing ethernet port...");
+      Ethernet.init(_pinCS);
+      if (NETWORK_MODE == NETWORK_STATIC)
+      {
+        lease.ip = toAddress(NETWORK_STATIC_IP);
+        lease.gateway = toAddress(NETWORK_STATIC_GATEWAY);
+        lease.subnet = toAddress(NETWORK_STATIC_SUBNET);
+        lease.dns = toAddress(NETWORK_STATIC_DNS);
+        result = beginStatic(lease);
+      }
+      else if (NETWORK_LEASE_REUSE && loadLease(&lease))
+      {
+        // the DHCP server is asked after the first request
+        LOG_INFO(LOG_NETWORK, "Reusing the last DHCP address");
+        result = beginStatic(lease);
+        _leaseReused = (result == ERR_SUCCESS);
+      }
+      else
+      {
+        result = beginDHCP();
+      }
+    }
+    else
+    {
+      LOG_ERROR(LOG_NETWORK, "Failed to retrieve mac address");
+      result = ERR_ETHERNET_NOMAC;
+    }
+    return (result);
+  }
+
+  // configures a fixed address, returns at once
+  int beginStatic(const NETWORK_LEASE &lease)
+  {
+    int result = ERR_SUCCESS;
+
+    Ethernet.begin(_mac, IPAddress(lease.ip), IPAddress(lease.dns), IPAddress(lease.gateway), IPAddress(lease.subnet));
+    if (Ethernet.hardwareStatus() == EthernetNoHardware)
+    {
+      LOG_ERROR(LOG_NETWORK, "Ethernet port not found");
+      result = ERR_ETHERNET_NOHARDWARE;
+    }
+    else
+    {
+      if (Ethernet.linkStatus() == LinkOFF)
+      {
+        // the inverter requests fail until the cable is connected
+        LOG_WARNING(LOG_NETWORK, "Ethernet cable not connected");
+      }
+      _localIP = Ethernet.localIP();
+      logAddress("Static IP");
+    }
+    return (result);
+  }
+
+  // gets an address from the DHCP server, blocks until the server answers or the timeout
+  int beginDHCP()
+  {
+    int result = ERR_SUCCESS;
+
+    LOG_VERBOSE(LOG_NETWORK, "Getting IP address using DHCP...");
+    if (Ethernet.begin(_mac) != 0)
+    {
+      _localIP = Ethernet.localIP();
+      logAddress("DHCP assigned IP");
+      if (NETWORK_LEASE_REUSE)
+      {
+        saveLease();
+      }
+      result = ERR_SUCCESS;
+    }
+    else
+    {
+      LOG_ERROR(LOG_NETWORK, "Failed to initialize network using DHCP");
+      result = ERR_ETHERNET_NODHCP;
+      if (Ethernet.hardwareStatus() == EthernetNoHardware)
+      {
+        LOG_ERROR(LOG_NETWORK, "Ethernet port not found");
+        result = ERR_ETHERNET_NOHARDWARE;
+      }
+      else
+      {
+        if (Ethernet.linkStatus() == LinkOFF)
+        {
+          LOG_ERROR(LOG_NETWORK, "Ethernet cable not connected");
+          result = ERR_ETHERNET_LINKOFF;
+        }
+      }
+    }
+    return (result);
+  }
+
+  // asks the DHCP server for a lease after the values have been requested with the reused address,
+  // the server may assign another address, without answer the reused address is kept
+  void renewLease()
+  {
+    NETWORK_LEASE lease;
+
+    LOG_INFO(LOG_NETWORK, "Renewing the reused address");
+    _leaseReused = false;
+    // NVS allocates internally
+    HeapGuard::get().suspend();
+    bool stored = loadLease(&lease);
+    if ((beginDHCP() != ERR_SUCCESS) && stored)
+    {
+      beginStatic(lease);
+    }
+    HeapGuard::get().resume();
+  }
+
+  // reads the last DHCP lease from NVS, returns false if there is none
+  bool loadLease(NETWORK_LEASE *lease)
+  {
+    bool result = false;
+
+    if (_preferences.begin(NETWORK_NAMESPACE, true))
+    {
+      result = (_preferences.getBytes(NETWORK_LEASE_KEY, lease, sizeof(NETWORK_LEASE)) == sizeof(NETWORK_LEASE)) &&
+               (lease->version == NETWORK_LEASE_VERSION) && (lease->ip != 0);
+      _preferences.end();
+    }
+    return (result);
+  }
+
+  // writes the address assigned by DHCP to NVS, only if it has changed
+  void saveLease()
+  {
+    NETWORK_LEASE stored;
+    NETWORK_LEASE lease;
+
+    lease.version = NETWORK_LEASE_VERSION;
+    lease.ip = Ethernet.localIP();
+    lease.gateway = Ethernet.gatewayIP();
+    lease.subnet = Ethernet.subnetMask();
+    lease.dns = Ethernet.dnsServerIP();
+    if (loadLease(&stored) && (memcmp(&stored, &lease, sizeof(lease)) == 0))
+    {
+      return;
+    }
+    if (!_preferences.begin(NETWORK_NAMESPACE, false) ||
+        (_preferences.putBytes(NETWORK_LEASE_KEY, &lease, sizeof(lease)) != sizeof(lease)))
+    {
+      LOG_WARNING(LOG_NETWORK, "Failed to store the DHCP lease");
+    }
+    _preferences.end();
+  }
+
+  // converts an address in dotted notation
+  static uint32_t toAddress(const char *text)
+  {
+    IPAddress address;
+    address.fromString(text);
+    return ((uint32_t)address);
+  }
+
+  void logAddress(const char *text)
+  {
+    IPAddress gateway = Ethernet.gatewayIP();
+    IPAddress dns = Ethernet.dnsServerIP();
+    LOG_INFO(LOG_NETWORK, "%s: %u.%u.%u.%u", text, _localIP[0], _localIP[1], _localIP[2], _localIP[3]);
+    LOG_INFO(LOG_NETWORK, "Gateway: %u.%u.%u.%u", gateway[0], gateway[1], gateway[2], gateway[3]);
+    LOG_INFO(LOG_NETWORK, "DNS Server %u.%u.%u.%u", dns[0], dns[1], dns[2], dns[3]);
+  }
+};
@@ -0,0 +1,289 @@
+// NmeaParser.hpp
+
+// incremental NMEA parser for the time of RMC and ZDA sentences, works without heap allocations
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+
+#define NMEA_MAX_LENGTH 82 // maximum sentence length defined by NMEA 0183
+#define NMEA_MAX_FIELDS 24
+
+// UTC date and time of a sentence
+typedef struct
+{
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+  uint16_t millisecond;
+} NMEA_TIME;
+
+enum class nmea_state
+{
+  idle,
+  body,
+  checksum
+};
+
+class NmeaParser
+{
+public:
+  NmeaParser()
+  {
+    _state = nmea_state::idle;
+    _length = 0;
+    _checksum = 0;
+    _receivedChecksum = 0;
+    _checksumDigits = 0;
+    _sentenceCount = 0;
+    _errorCount = 0;
+    memset(&_time, 0, sizeof(_time));
+  }
+
+  virtual ~NmeaParser()
+  {
+  }
+
+  // feeds one received character, returns true if a sentence with a valid time has been completed
+  bool encode(char c)
+  {
+    bool result = false;
+    int digit;
+
+    if (c == '$')
+    {
+      // a new sentence starts, even if the last one was incomplete
+      _state = nmea_state::body;
+      _length = 0;
+      _checksum = 0;
+      return (result);
+    }
+
+    switch (_state)
+    {
+    case nmea_state::idle:
+      break;
+
+    case nmea_state::body:
+      if (c == '*')
+      {
+        _state = nmea_state::checksum;
+        _receivedChecksum = 0;
+        _checksumDigits = 0;
+      }
+      else if ((c == '\r') || (c == '\n') || (_length >= NMEA_MAX_LENGTH))
+      {
+        // sentences without checksum are not accepted
+        _state = nmea_state::idle;
+        _errorCount++;
+      }
+      else
+      {
+        _buffer[_length++] = c;
+        _checksum ^= c;
+      }
+      break;
+
+    case nmea_state::checksum:
+      digit = hexDigit(c);
+      if (digit < 0)
+      {
+        _state = nmea_state::idle;
+        _errorCount++;
+      }
+      else
+      {
+        _receivedChecksum = (_receivedChecksum << 4) | digit;
+        if (++_checksumDigits == 2)
+        {
+          _state = nmea_state::idle;
+          if (_receivedChecksum == _checksum)
+          {
+            _buffer[_length] = 0;
+            _sentenceCount++;
+            result = parse();
+          }
+          else
+          {
+            _errorCount++;
+          }
+        }
+      }
+      break;
+    }
+    return (result);
+  }
+
+  // returns the time of the last sentence with a valid time
+  const NMEA_TIME &getTime() const
+  {
+    return (_time);
+  }
+
+  // returns the number of sentences with a correct checksum
+  unsigned long getSentenceCount() const
+  {
+    return (_sentenceCount);
+  }
+
+  // returns the number of malformed sentences and checksum errors
+  unsigned long getErrorCount() const
+  {
+    return (_errorCount);
+  }
+
+private:
+  char _buffer[NMEA_MAX_LENGTH + 1]; // sentence without '$' and checksum
+  uint8_t _length;
+  nmea_state _state;
+  uint8_t _checksum;
+  uint8_t _receivedChecksum;
+  uint8_t _checksumDigits;
+  unsigned long _sentenceCount;
+  unsigned long _errorCount;
+  NMEA_TIME _time;
+
+  static int hexDigit(char c)
+  {
+    int result = -1;
+
+    if ((c >= '0') && (c <= '9'))
+    {
+      result = c - '0';
+    }
+    else if ((c >= 'A') && (c <= 'F'))
+    {
+      result = c - 'A' + 10;
+    }
+    else if ((c >= 'a') && (c <= 'f'))
+    {
+      result = c - 'a' + 10;
+    }
+    return (result);
+  }
+
+  // returns the value of a fixed number of decimal digits, -1 if a character is not a digit
+  static int parseDigits(const char *text, uint8_t count)
+  {
+    int value = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+      if ((text[i] < '0') || (text[i] > '9'))
+      {
+        return (-1);
+      }
+      value = value * 10 + (text[i] - '0');
+    }
+    return (value);
+  }
+
+  // parses hhmmss[.sss] into the time
+  static bool parseTime(const char *text, NMEA_TIME *time)
+  {
+    int hour = parseDigits(text, 2);
+    int minute = (hour >= 0) ? parseDigits(text + 2, 2) : -1;
+    int second = (minute >= 0) ? parseDigits(text + 4, 2) : -1;
+
+    if ((second < 0) || (hour > 23) || (minute > 59) || (second > 60))
+    {
+      return (false);
+    }
+    time->hour = hour;
+    time->minute = minute;
+    time->second = second;
+
+    // fraction, up to milliseconds
+    time->millisecond = 0;
+    if (text[6] == '.')
+    {
+      uint16_t factor = 100;
+      for (const char *p = text + 7; (*p >= '0') && (*p <= '9') && (factor > 0); p++)
+      {
+        time->millisecond += (*p - '0') * factor;
+        factor /= 10;
+      }
+    }
+    return (true);
+  }
+
+  // splits the sentence into fields in place and takes the time of RMC and ZDA sentences
+  bool parse()
+  {
+    const char *fields[NMEA_MAX_FIELDS];
+    uint8_t fieldCount = 0;
+    NMEA_TIME time;
+
+    fields[fieldCount++] = _buffer;
+    for (uint8_t i = 0; (i < _length) && (fieldCount < NMEA_MAX_FIELDS); i++)
+    {
+      if (_buffer[i] == ',')
+      {
+        _buffer[i] = 0;
+        fields[fieldCount++] = &_buffer[i + 1];
+      }
+    }
+
+    // the first field is talker (GP, GN, ...) and sentence type
+    if (strlen(fields[0]) != 5)
+    {
+      return (false);
+    }
+    const char *type = fields[0] + 2;
+
+    if ((strcmp(type, "RMC") == 0) && (fieldCount >= 10))
+    {
+      // time, status, latitude, N/S, longitude, E/W, speed, course, date ddmmyy
+      if ((fields[2][0] != 'A') || !parseTime(fields[1], &time))
+      {
+        return (false);
+      }
+      int day = parseDigits(fields[9], 2);
+      int month = (day >= 0) ? parseDigits(fields[9] + 2, 2) : -1;
+      int year = (month >= 0) ? parseDigits(fields[9] + 4, 2) : -1;
+      if (year < 0)
+      {
+        return (false);
+      }
+      time.day = day;
+      time.month = month;
+      time.year = 2000 + year;
+    }
+    else if ((strcmp(type, "ZDA") == 0) && (fieldCount >= 5))
+    {
+      // time, day, month, year
+      if (!parseTime(fields[1], &time) ||
+          (strlen(fields[2]) != 2) || (strlen(fields[3]) != 2) || (strlen(fields[4]) != 4))
+      {
+        return (false);
+      }
+      int day = parseDigits(fields[2], 2);
+      int month = parseDigits(fields[3], 2);
+      int year = parseDigits(fields[4], 4);
+      if ((day < 0) || (month < 0) || (year < 0))
+      {
+        return (false);
+      }
+      time.day = day;
+      time.month = month;
+      time.year = year;
+    }
+    else
+    {
+      return (false);
+    }
+
+    if ((time.month < 1) || (time.month > 12) || (time.day < 1) || (time.day > 31))
+    {
+      return (false);
+    }
+    _time = time;
+    return (true);
+  }
+};
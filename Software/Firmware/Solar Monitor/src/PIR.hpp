@@ -8,8 +8,32 @@
 #pragma once
 
 #include <Arduino.h>
-#include <FunctionalInterrupt.h>
+#include <driver/gpio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Events.h>
+
+// edges closer than this to the last accepted edge are ignored, the level of the next accepted edge
+// is read again, so a dropped edge cannot hide the following one
+#define PIR_DEBOUNCE 50 // in ms
+
+// number of edges buffered between interrupt and main loop
+#define PIR_QUEUE_LENGTH 8
+
+// edge captured by the interrupt
+typedef struct
+{
+  uint8_t level;
+  unsigned long timestamp;
+} PIR_EDGE;
+
+enum class presence_state
+{
+  vacant,
+  occupied
+};
 
 class PIR
 {
@@ -17,43 +41,199 @@ class PIR
 public:
   PIR(uint8_t pinPIR, int pirDelay) : _pinPIR(pinPIR), _pirDelay(pirDelay * 1000 * 60)
   {
-    _pirTimestamp = 0;
+    _edges = nullptr;
+    _state = presence_state::occupied;
+    _level = LOW;
+    _lastMotionTimestamp = 0;
+    _isrEdgeTimestamp = 0;
+    _interruptCount = 0;
+    _lastInterruptCount = 0;
+    _interruptsPerMinute = 0;
+    _lastStatisticsTimestamp = 0;
+    _wakeupArmed = false;
+    _started = false;
+    _notify = nullptr;
+    _notifyArg = nullptr;
   }
 
   virtual ~PIR()
   {
+    if (_edges != nullptr)
+    {
+      detachInterrupt(_pinPIR);
+      vQueueDelete(_edges);
+    }
   }
 
-  void begin()
+  // starts capturing the edges of the PIR output, the callback is notified on each accepted edge,
+  // the room is considered occupied at startup
+  void begin(EVENT_CALLBACK notify = nullptr, void *notifyArg = nullptr)
   {
+    _notify = notify;
+    _notifyArg = notifyArg;
+    _started = true;
     if (_pirDelay > 0)
     {
+      _edges = xQueueCreate(PIR_QUEUE_LENGTH, sizeof(PIR_EDGE));
+      _level = digitalRead(_pinPIR);
+      _lastMotionTimestamp = millis();
+      _lastStatisticsTimestamp = millis();
       // set ISR
-      attachInterrupt(_pinPIR, std::bind(&PIR::handlePIRTimeout, this), HIGH);
+      attachInterruptArg(_pinPIR, &PIR::onInterrupt, this, CHANGE);
     }
   }
 
-  // provides PIR status
-  bool process() const
+  // provides PIR status, the room becomes occupied with motion
+  // and vacant after no motion for the PIR delay
+  bool process()
   {
-    bool result = true;
-    if (_pirDelay > 0)
+    PIR_EDGE edge;
+
+    if (_pirDelay == 0)
     {
-      if (millis() - _pirTimestamp > (_pirDelay))
+      return (true);
+    }
+
+    while (xQueueReceive(_edges, &edge, 0) == pdTRUE)
+    {
+      _lastMotionTimestamp = edge.timestamp;
+      if ((edge.level == HIGH) && (_state == presence_state::vacant))
       {
-        result = false;
+        LOG_INFO(LOG_INPUT, "PIR: occupied");
+        _state = presence_state::occupied;
       }
     }
+
+    // the pin level is the reference, an edge may have been dropped by the debouncing
+    _level = digitalRead(_pinPIR);
+    if (_level == HIGH)
+    {
+      _lastMotionTimestamp = millis();
+      _state = presence_state::occupied;
+    }
+    else if ((_state == presence_state::occupied) && (millis() - _lastMotionTimestamp >= _pirDelay))
+    {
+      LOG_INFO(LOG_INPUT, "PIR: vacant");
+      _state = presence_state::vacant;
+    }
+
+    // interrupt statistics
+    if (millis() - _lastStatisticsTimestamp >= 60 * 1000UL)
+    {
+      unsigned long count = _interruptCount;
+      _interruptsPerMinute = count - _lastInterruptCount;
+      _lastInterruptCount = count;
+      _lastStatisticsTimestamp = millis();
+    }
+    return (_state == presence_state::occupied);
+  }
+
+  // returns the time in ms until the room becomes vacant, NO_DEADLINE if vacant,
+  // while the PIR output is high or disabled
+  unsigned long getTimeToTimeout() const
+  {
+    unsigned long result = NO_DEADLINE;
+    if ((_pirDelay > 0) && (_state == presence_state::occupied) && (_level == LOW))
+    {
+      unsigned long elapsed = millis() - _lastMotionTimestamp;
+      result = (elapsed < _pirDelay) ? _pirDelay - elapsed : 0;
+    }
     return (result);
   }
 
+  // changes the PIR delay in minutes, 0 disables PIR,
+  // a PIR disabled at startup is not enabled before the next restart
+  void setDelay(int pirDelay)
+  {
+    if (_started && (_edges == nullptr) && (pirDelay > 0))
+    {
+      LOG_WARNING(LOG_INPUT, "PIR enabled with the next restart");
+      return;
+    }
+    _pirDelay = pirDelay * 1000UL * 60;
+  }
+
+  // returns the number of interrupts during the last full minute
+  unsigned long getInterruptsPerMinute() const
+  {
+    return (_interruptsPerMinute);
+  }
+
+  // lets a high PIR output wake up the CPU from light sleep,
+  // this turns the interrupt into a level interrupt until the first wakeup
+  void enableWakeup()
+  {
+    if ((_pirDelay > 0) && !_wakeupArmed)
+    {
+      _wakeupArmed = true;
+      gpio_wakeup_enable((gpio_num_t)_pinPIR, GPIO_INTR_HIGH_LEVEL);
+    }
+  }
+
+  // restores the edge interrupt
+  void disableWakeup()
+  {
+    if (_wakeupArmed)
+    {
+      _wakeupArmed = false;
+      gpio_wakeup_disable((gpio_num_t)_pinPIR);
+      gpio_set_intr_type((gpio_num_t)_pinPIR, GPIO_INTR_ANYEDGE);
+    }
+  }
+
 private:
   uint8_t _pinPIR;
-  volatile unsigned long _pirTimestamp;
   unsigned long _pirDelay;
+  QueueHandle_t _edges;
+  presence_state _state;
+  uint8_t _level;
+  unsigned long _lastMotionTimestamp;
+  unsigned long _isrEdgeTimestamp;       // last accepted edge, only used by the ISR
+  volatile unsigned long _interruptCount;
+  unsigned long _lastInterruptCount;
+  unsigned long _interruptsPerMinute;
+  unsigned long _lastStatisticsTimestamp;
+  volatile bool _wakeupArmed;
+  bool _started;
+  EVENT_CALLBACK _notify;
+  void *_notifyArg;
 
-  void IRAM_ATTR handlePIRTimeout()
+  static void IRAM_ATTR onInterrupt(void *arg)
   {
-    _pirTimestamp = millis();
+    ((PIR *)arg)->handleInterrupt();
+  }
+
+  // captures an edge and passes it to the main loop
+  void IRAM_ATTR handleInterrupt()
+  {
+    _interruptCount++;
+
+    // woken up from light sleep, the level interrupt would fire as long as the output is high
+    if (_wakeupArmed)
+    {
+      _wakeupArmed = false;
+      gpio_wakeup_disable((gpio_num_t)_pinPIR);
+      gpio_set_intr_type((gpio_num_t)_pinPIR, GPIO_INTR_ANYEDGE);
+    }
+
+    uint8_t level = digitalRead(_pinPIR);
+    unsigned long now = millis();
+    if (now - _isrEdgeTimestamp < PIR_DEBOUNCE)
+    {
+      return;
+    }
+    _isrEdgeTimestamp = now;
+
+    PIR_EDGE edge = {level, now};
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR(_edges, &edge, &woken);
+    if (_notify != nullptr)
+    {
+      _notify(_notifyArg, controller_event::pir);
+    }
+    if (woken)
+    {
+      portYIELD_FROM_ISR();
+    }
   }
 };
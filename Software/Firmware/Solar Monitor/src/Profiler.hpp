@@ -0,0 +1,169 @@
+// Profiler.hpp
+
+// latency histograms of the stages between the inverter request and the latched tubes,
+// the probes are compiled out unless PROFILING is set in DebugDefs.h
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <DebugDefs.h>
+
+#define PROFILE_BUCKETS 24        // bucket i holds durations from 2^i to 2^(i+1) - 1 us, the last one all longer
+#define PROFILE_PRINT_INTERVAL 60 // in seconds, the histograms are printed on serial
+
+#if PROFILING
+// starts a probe, a local timestamp in us
+#define PROFILE_START(probe) int64_t probe = esp_timer_get_time()
+// records the time since the probe was started
+#define PROFILE_STOP(probe, stage) Profiler::get().record(stage, esp_timer_get_time() - (probe))
+// records the time since the probe was started and restarts it for the next stage
+#define PROFILE_LAP(probe, stage) (probe) = Profiler::get().lap(stage, probe)
+#else
+#define PROFILE_START(probe)
+#define PROFILE_STOP(probe, stage)
+#define PROFILE_LAP(probe, stage)
+#endif
+
+enum class profile_stage : uint8_t
+{
+  connect,       // connecting to the inverter
+  request,       // sending the HTTP request
+  status,        // waiting for and reading the HTTP status line
+  headers,       // skipping the HTTP headers
+  decode,        // decoding the JSON response
+  formatting,    // formatting a value for a display board
+  frame,         // building the frame of a display board
+  shift_out,     // shifting the frame of a display board out
+  led_show,      // sending the LED colors
+  rotation_step, // one step of the cathode exercise
+  end_to_end,    // values received until the final values are latched
+  event_push,    // sending an event to one dashboard viewer
+  count
+};
+
+// latency histogram of a stage
+typedef struct
+{
+  uint32_t count;
+  uint64_t sum;     // in us
+  uint32_t min;     // in us
+  uint32_t max;     // in us
+  uint32_t buckets[PROFILE_BUCKETS];
+} PROFILE_HISTOGRAM;
+
+class Profiler
+{
+public:
+  // returns the profiler shared by all modules
+  static Profiler &get()
+  {
+    static Profiler profiler;
+    return (profiler);
+  }
+
+  // adds a duration in us to the histogram of a stage,
+  // each stage is recorded by one task only, so no locking is needed
+  void record(profile_stage stage, int64_t duration)
+  {
+    PROFILE_HISTOGRAM &histogram = _histograms[(int)stage];
+    uint32_t us = (duration > 0) ? ((duration < (int64_t)UINT32_MAX) ? (uint32_t)duration : UINT32_MAX) : 0;
+    uint8_t bucket = 31 - __builtin_clz(us | 1);
+
+    histogram.buckets[(bucket < PROFILE_BUCKETS) ? bucket : PROFILE_BUCKETS - 1]++;
+    histogram.count++;
+    histogram.sum += us;
+    if ((histogram.count == 1) || (us < histogram.min))
+    {
+      histogram.min = us;
+    }
+    if (us > histogram.max)
+    {
+      histogram.max = us;
+    }
+  }
+
+  // records the time since the start timestamp, returns the current timestamp
+  int64_t lap(profile_stage stage, int64_t start)
+  {
+    int64_t now = esp_timer_get_time();
+    record(stage, now - start);
+    return (now);
+  }
+
+  // returns the histogram of a stage
+  const PROFILE_HISTOGRAM &getHistogram(profile_stage stage) const
+  {
+    return (_histograms[(int)stage]);
+  }
+
+  // returns the upper limit in us of the bucket holding the given percentile of a stage
+  uint32_t getPercentile(profile_stage stage, uint8_t percent) const
+  {
+    const PROFILE_HISTOGRAM &histogram = _histograms[(int)stage];
+    uint32_t rank = ((uint64_t)histogram.count * percent + 99) / 100;
+    uint32_t seen = 0;
+    uint32_t result = 0;
+
+    for (uint8_t i = 0; (i < PROFILE_BUCKETS) && (histogram.count > 0); i++)
+    {
+      seen += histogram.buckets[i];
+      if (seen >= rank)
+      {
+        // the upper limit, but never more than the longest duration seen
+        result = (2UL << i) - 1;
+        if ((i == PROFILE_BUCKETS - 1) || (result > histogram.max))
+        {
+          result = histogram.max;
+        }
+        break;
+      }
+    }
+    return (result);
+  }
+
+  // prints count, average, min, max and percentiles of all stages in us
+  void print(Print &out) const
+  {
+    out.println("stage              count      avg      min      max      p50      p90      p99");
+    for (int i = 0; i < (int)profile_stage::count; i++)
+    {
+      const PROFILE_HISTOGRAM &histogram = _histograms[i];
+      profile_stage stage = (profile_stage)i;
+      char buffer[100];
+      snprintf(buffer, sizeof(buffer), "%-14s %9lu %8lu %8lu %8lu %8lu %8lu %8lu",
+               getStageName(stage), (unsigned long)histogram.count,
+               (unsigned long)((histogram.count > 0) ? histogram.sum / histogram.count : 0),
+               (unsigned long)histogram.min, (unsigned long)histogram.max,
+               (unsigned long)getPercentile(stage, 50), (unsigned long)getPercentile(stage, 90),
+               (unsigned long)getPercentile(stage, 99));
+      out.println(buffer);
+    }
+  }
+
+  // clears all histograms
+  void reset()
+  {
+    memset(_histograms, 0, sizeof(_histograms));
+  }
+
+  // returns the name of a stage
+  static const char *getStageName(profile_stage stage)
+  {
+    static const char *names[] = {"connect", "request", "status", "headers", "decode",
+                                  "formatting", "frame", "shift_out", "led_show",
+                                  "rotation_step", "end_to_end", "event_push"};
+    return (((int)stage < (int)profile_stage::count) ? names[(int)stage] : "?");
+  }
+
+private:
+  PROFILE_HISTOGRAM _histograms[(int)profile_stage::count];
+
+  Profiler()
+  {
+    reset();
+  }
+};
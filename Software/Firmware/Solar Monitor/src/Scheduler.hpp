@@ -0,0 +1,356 @@
+// Scheduler.hpp
+
+// cooperative scheduler for the periodic jobs of the main loop,
+// the deadlines are kept in a min-heap, run time and deadline misses are recorded per task
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Events.h>
+
+#define SCHEDULER_MAX_TASKS 12
+#define SCHEDULER_LATENESS 10 // in ms, a task started later than this after its deadline missed it
+#define SCHEDULER_NO_TASK 255
+
+typedef void (*SCHEDULER_CALLBACK)(void *arg);
+
+// registered task
+typedef struct
+{
+  const char *name;
+  SCHEDULER_CALLBACK callback;
+  void *arg;
+  unsigned long interval; // in ms
+  unsigned long budget;   // in us
+  unsigned long deadline; // in ms
+  bool enabled;
+  bool rescheduled;       // the deadline has been set by the task itself
+  uint8_t heapIndex;
+  unsigned long runCount;
+  unsigned long runTime;    // in us, total
+  unsigned long maxRunTime; // in us
+  unsigned long overruns;   // runs longer than the budget
+  unsigned long misses;     // runs started too late
+  unsigned long maxLateness; // in ms
+} SCHEDULER_TASK;
+
+class Scheduler
+{
+public:
+  Scheduler()
+  {
+    _taskCount = 0;
+    _heapSize = 0;
+    _pass = 0;
+    memset(_lastPass, 0, sizeof(_lastPass));
+  }
+
+  virtual ~Scheduler()
+  {
+  }
+
+  // registers a task, first run after one interval, returns the task id
+  uint8_t add(const char *name, SCHEDULER_CALLBACK callback, void *arg,
+              unsigned long interval, unsigned long budget, bool enabled = true)
+  {
+    if (_taskCount >= SCHEDULER_MAX_TASKS)
+    {
+      LOG_ERROR(LOG_SCHEDULER, "Too many scheduler tasks");
+      return (SCHEDULER_NO_TASK);
+    }
+
+    uint8_t id = _taskCount++;
+    SCHEDULER_TASK &task = _tasks[id];
+    memset(&task, 0, sizeof(task));
+    task.name = name;
+    task.callback = callback;
+    task.arg = arg;
+    task.interval = interval;
+    task.budget = budget;
+    task.deadline = millis() + interval;
+    task.heapIndex = SCHEDULER_NO_TASK;
+    if (enabled)
+    {
+      insert(id);
+    }
+    return (id);
+  }
+
+  // lets the task run again, first run after the given delay in ms
+  void enable(uint8_t id, unsigned long delay)
+  {
+    if (id < _taskCount)
+    {
+      _tasks[id].deadline = millis() + delay;
+      insert(id);
+    }
+  }
+
+  // stops the task until it is enabled again
+  void disable(uint8_t id)
+  {
+    if ((id < _taskCount) && _tasks[id].enabled)
+    {
+      _tasks[id].enabled = false;
+      remove(_tasks[id].heapIndex);
+    }
+  }
+
+  // returns if the task is enabled
+  bool isEnabled(uint8_t id) const
+  {
+    return ((id < _taskCount) && _tasks[id].enabled);
+  }
+
+  // sets the next run of a task to the given delay from now in ms,
+  // called by a running task it replaces the next regular run
+  void schedule(uint8_t id, unsigned long delay)
+  {
+    if (id < _taskCount)
+    {
+      _tasks[id].deadline = millis() + delay;
+      _tasks[id].rescheduled = true;
+      if (_tasks[id].enabled)
+      {
+        update(_tasks[id].heapIndex);
+      }
+    }
+  }
+
+  // runs the task at once, enables it if needed
+  void trigger(uint8_t id)
+  {
+    enable(id, 0);
+    schedule(id, 0);
+  }
+
+  // changes the interval of a task, applied from the next run
+  void setInterval(uint8_t id, unsigned long interval)
+  {
+    if (id < _taskCount)
+    {
+      _tasks[id].interval = interval;
+    }
+  }
+
+  // runs all due tasks in the order of their deadlines, each task at most once,
+  // returns the number of tasks run
+  uint8_t run()
+  {
+    uint8_t count = 0;
+
+    _pass++;
+    while ((_heapSize > 0) && (getRemainingTime(_heap[0]) == 0) && (_lastPass[_heap[0]] != _pass))
+    {
+      uint8_t id = _heap[0];
+      _lastPass[id] = _pass;
+      execute(_tasks[id]);
+      count++;
+    }
+    return (count);
+  }
+
+  // returns the time in ms until the next task is due, NO_DEADLINE if no task is enabled
+  unsigned long getTimeToNextDeadline() const
+  {
+    return ((_heapSize > 0) ? getRemainingTime(_heap[0]) : NO_DEADLINE);
+  }
+
+  // returns the statistics of a task
+  const SCHEDULER_TASK *getTask(uint8_t id) const
+  {
+    return ((id < _taskCount) ? &_tasks[id] : nullptr);
+  }
+
+  // returns the number of registered tasks
+  uint8_t getTaskCount() const
+  {
+    return (_taskCount);
+  }
+
+  // prints run count, run time and deadline misses of all tasks
+  void printStatistics(Print &out) const
+  {
+    out.println("task          runs    avg us  max us  budget  overruns  misses  late ms");
+    for (uint8_t i = 0; i < _taskCount; i++)
+    {
+      const SCHEDULER_TASK &task = _tasks[i];
+      char buffer[96];
+      snprintf(buffer, sizeof(buffer), "%-12s %6lu %8lu %7lu %7lu %9lu %7lu %8lu",
+               task.name, task.runCount,
+               (task.runCount > 0) ? task.runTime / task.runCount : 0UL,
+               task.maxRunTime, task.budget, task.overruns, task.misses, task.maxLateness);
+      out.println(buffer);
+    }
+  }
+
+  // resets the statistics of all tasks
+  void resetStatistics()
+  {
+    for (uint8_t i = 0; i < _taskCount; i++)
+    {
+      SCHEDULER_TASK &task = _tasks[i];
+      task.runCount = 0;
+      task.runTime = 0;
+      task.maxRunTime = 0;
+      task.overruns = 0;
+      task.misses = 0;
+      task.maxLateness = 0;
+    }
+  }
+
+private:
+  SCHEDULER_TASK _tasks[SCHEDULER_MAX_TASKS];
+  uint8_t _heap[SCHEDULER_MAX_TASKS]; // task ids, the earliest deadline first
+  unsigned long _lastPass[SCHEDULER_MAX_TASKS]; // pass of the last run, a task runs once per pass
+  uint8_t _taskCount;
+  uint8_t _heapSize;
+  unsigned long _pass;
+
+  // runs a task, records its statistics and sets its next deadline
+  void execute(SCHEDULER_TASK &task)
+  {
+    unsigned long now = millis();
+    unsigned long lateness = now - task.deadline;
+    if (lateness > task.maxLateness)
+    {
+      task.maxLateness = lateness;
+    }
+    if (lateness > SCHEDULER_LATENESS)
+    {
+      task.misses++;
+    }
+
+    task.rescheduled = false;
+    unsigned long start = micros();
+    task.callback(task.arg);
+    unsigned long runTime = micros() - start;
+
+    task.runCount++;
+    task.runTime += runTime;
+    if (runTime > task.maxRunTime)
+    {
+      task.maxRunTime = runTime;
+    }
+    if (runTime > task.budget)
+    {
+      task.overruns++;
+    }
+
+    // the task may have disabled or rescheduled itself
+    if (task.enabled && !task.rescheduled)
+    {
+      // keep the period, unless the next run is already due
+      task.deadline += task.interval;
+      if ((long)(task.deadline - millis()) < 0)
+      {
+        task.deadline = millis() + task.interval;
+      }
+      update(task.heapIndex);
+    }
+  }
+
+  // returns the time in ms until the deadline of a task
+  unsigned long getRemainingTime(uint8_t id) const
+  {
+    long remaining = (long)(_tasks[id].deadline - millis());
+    return ((remaining > 0) ? (unsigned long)remaining : 0);
+  }
+
+  // returns if the deadline of task a is before the deadline of task b,
+  // tasks registered first win on equal deadlines
+  bool isBefore(uint8_t a, uint8_t b) const
+  {
+    long difference = (long)(_tasks[a].deadline - _tasks[b].deadline);
+    return ((difference < 0) || ((difference == 0) && (a < b)));
+  }
+
+  // adds an enabled task to the heap
+  void insert(uint8_t id)
+  {
+    SCHEDULER_TASK &task = _tasks[id];
+    if (!task.enabled)
+    {
+      task.enabled = true;
+      _heap[_heapSize] = id;
+      task.heapIndex = _heapSize++;
+      siftUp(task.heapIndex);
+    }
+    else
+    {
+      update(task.heapIndex);
+    }
+  }
+
+  // removes a task from the heap
+  void remove(uint8_t index)
+  {
+    uint8_t id = _heap[index];
+    _tasks[id].heapIndex = SCHEDULER_NO_TASK;
+    _heapSize--;
+    if (index < _heapSize)
+    {
+      place(index, _heap[_heapSize]);
+      update(index);
+    }
+  }
+
+  // restores the heap order after the deadline of a task has changed
+  void update(uint8_t index)
+  {
+    siftDown(siftUp(index));
+  }
+
+  void place(uint8_t index, uint8_t id)
+  {
+    _heap[index] = id;
+    _tasks[id].heapIndex = index;
+  }
+
+  uint8_t siftUp(uint8_t index)
+  {
+    uint8_t id = _heap[index];
+    while (index > 0)
+    {
+      uint8_t parent = (index - 1) / 2;
+      if (!isBefore(id, _heap[parent]))
+      {
+        break;
+      }
+      place(index, _heap[parent]);
+      index = parent;
+    }
+    place(index, id);
+    return (index);
+  }
+
+  uint8_t siftDown(uint8_t index)
+  {
+    uint8_t id = _heap[index];
+    while (true)
+    {
+      uint8_t child = index * 2 + 1;
+      if (child >= _heapSize)
+      {
+        break;
+      }
+      if ((child + 1 < _heapSize) && isBefore(_heap[child + 1], _heap[child]))
+      {
+        child++;
+      }
+      if (!isBefore(_heap[child], id))
+      {
+        break;
+      }
+      place(index, _heap[child]);
+      index = child;
+    }
+    place(index, id);
+    return (index);
+  }
+};
@@ -0,0 +1,171 @@
+// SignalFilter.hpp
+
+// smooths the values of one quantity before they are shown, a chain of outlier rejection,
+// sliding median, exponential moving average and deadband, fixed memory and constant time per value
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <math.h>
+
+#define FILTER_MAX_WINDOW 5  // longest median window, odd
+#define FILTER_MAX_REJECTS 2 // outliers ignored in a row, then the jump is taken as real
+#define FILTER_MAX_GAP 3     // in polling intervals, without values for this time the filter starts over
+
+// settings of a filter, part of the runtime configuration
+typedef struct
+{
+  uint16_t window;    // median of the last 1, 3 or 5 values
+  uint16_t outlier;   // values further away from the median are ignored, 0 disables
+  uint16_t smoothing; // weight of a new value in percent, 100 disables
+  uint16_t deadband;  // the output changes only by at least this amount, 0 disables
+} FILTER_SETTINGS;
+
+class SignalFilter
+{
+public:
+  SignalFilter()
+  {
+    _size = 0;
+    _next = 0;
+    _rejects = 0;
+    _average = 0.0;
+    _output = 0.0;
+    _lastTimestamp = 0;
+    _changes = 0;
+    _rejected = 0;
+  }
+
+  virtual ~SignalFilter()
+  {
+  }
+
+  // shows a value until the first value is added, e.g. restored at boot
+  void setOutput(double value)
+  {
+    _size = 0;
+    _output = value;
+  }
+
+  // adds a value received at the given time in ms, after a gap longer than maxGap in ms,
+  // e.g. with the display off, or with a changed window the filter starts over, returns the output
+  double add(double value, const FILTER_SETTINGS &settings, unsigned long timestamp, unsigned long maxGap)
+  {
+    double output = _output;
+
+    if ((_size == 0) || (_size != constrain(settings.window | 1, 1, FILTER_MAX_WINDOW)) ||
+        (timestamp - _lastTimestamp > maxGap))
+    {
+      reset(value, settings);
+    }
+    else if ((settings.outlier > 0) && (fabs(value - getMedian()) > settings.outlier) && (_rejects < FILTER_MAX_REJECTS))
+    {
+      // a single spike, the output is kept
+      _rejects++;
+      _rejected++;
+    }
+    else
+    {
+      _rejects = 0;
+      insert(value);
+      double median = getMedian();
+      _average += (median - _average) * constrain(settings.smoothing, 1, 100) / 100.0;
+      if (median == 0.0)
+      {
+        // a value rounded to zero is shown at once, the average would approach it only slowly
+        _average = 0.0;
+        _output = 0.0;
+      }
+      else if (fabs(_average - _output) >= settings.deadband)
+      {
+        _output = _average;
+      }
+    }
+    _lastTimestamp = timestamp;
+    if (_output != output)
+    {
+      _changes++;
+    }
+    return (_output);
+  }
+
+  // returns the filtered value
+  double getOutput() const
+  {
+    return (_output);
+  }
+
+  // returns the number of output changes
+  unsigned long getChanges() const
+  {
+    return (_changes);
+  }
+
+  // returns the number of ignored outliers
+  unsigned long getRejected() const
+  {
+    return (_rejected);
+  }
+
+private:
+  double _window[FILTER_MAX_WINDOW]; // last values in order of arrival, ring buffer
+  double _sorted[FILTER_MAX_WINDOW]; // same values sorted
+  uint8_t _size;
+  uint8_t _next;    // oldest value of the ring buffer
+  uint8_t _rejects; // outliers ignored in a row
+  double _average;
+  double _output;
+  unsigned long _lastTimestamp; // in ms
+  unsigned long _changes;
+  unsigned long _rejected;
+
+  // starts over with the given value
+  void reset(double value, const FILTER_SETTINGS &settings)
+  {
+    _size = constrain(settings.window | 1, 1, FILTER_MAX_WINDOW);
+    for (uint8_t i = 0; i < _size; i++)
+    {
+      _window[i] = value;
+      _sorted[i] = value;
+    }
+    _next = 0;
+    _rejects = 0;
+    _average = value;
+    _output = value;
+  }
+
+  double getMedian() const
+  {
+    return (_sorted[_size / 2]);
+  }
+
+  // replaces the oldest value, the sorted values are kept in order by moving at most the window size
+  void insert(double value)
+  {
+    double oldest = _window[_next];
+    uint8_t i = 0;
+
+    _window[_next] = value;
+    _next = (_next + 1) % _size;
+    // remove the oldest value
+    while (_sorted[i] != oldest)
+    {
+      i++;
+    }
+    for (; i < _size - 1; i++)
+    {
+      _sorted[i] = _sorted[i + 1];
+    }
+    // insert the new value
+    i = _size - 1;
+    while ((i > 0) && (_sorted[i - 1] > value))
+    {
+      _sorted[i] = _sorted[i - 1];
+      i--;
+    }
+    _sorted[i] = value;
+  }
+};
@@ -0,0 +1,129 @@
+// Snapshot.hpp
+
+// keeps the last inverter values over resets and power losses, they are shown at boot
+// until the network delivers new values
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <HeapGuard.hpp>
+#include <Helper.hpp>
+#include <Inverter.hpp>
+
+// NVS namespace and key of the snapshot
+#define SNAPSHOT_NAMESPACE "snapshot"
+#define SNAPSHOT_KEY "values"
+
+// marks a valid snapshot, changed with the layout of INVERTER_VALUES
+#define SNAPSHOT_MAGIC 0x534E5001
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t checksum; // of the values, RTC memory holds garbage after power on
+  INVERTER_VALUES values;
+} SNAPSHOT;
+
+// survives a reset but not a power loss, not cleared at boot
+RTC_NOINIT_ATTR static SNAPSHOT rtcSnapshot;
+
+class Snapshot
+{
+public:
+  Snapshot()
+  {
+    _dirty = false;
+    _open = false;
+  }
+
+  virtual ~Snapshot()
+  {
+    if (_open)
+    {
+      _preferences.end();
+    }
+  }
+
+  // opens the NVS namespace
+  void begin()
+  {
+    _open = _preferences.begin(SNAPSHOT_NAMESPACE, false);
+    if (!_open)
+    {
+      LOG_ERROR(LOG_CONTROLLER, "Failed to open snapshot storage");
+    }
+  }
+
+  // restores the last values, from RTC memory after a reset, from NVS after a power loss,
+  // returns false if there are none
+  bool load(INVERTER_VALUES *values)
+  {
+    bool result = false;
+    SNAPSHOT snapshot;
+
+    if (isValid(rtcSnapshot))
+    {
+      *values = rtcSnapshot.values;
+      LOG_INFO(LOG_CONTROLLER, "Values restored from RTC memory");
+      result = true;
+    }
+    else if (_open && (_preferences.getBytes(SNAPSHOT_KEY, &snapshot, sizeof(snapshot)) == sizeof(snapshot)) &&
+             isValid(snapshot))
+    {
+      *values = snapshot.values;
+      rtcSnapshot = snapshot;
+      LOG_INFO(LOG_CONTROLLER, "Values restored from NVS");
+      result = true;
+    }
+    return (result);
+  }
+
+  // keeps new values in RTC memory, called for each set of values
+  void update(const INVERTER_VALUES &values)
+  {
+    rtcSnapshot.magic = SNAPSHOT_MAGIC;
+    rtcSnapshot.values = values;
+    rtcSnapshot.checksum = getChecksum(values);
+    _dirty = true;
+  }
+
+  // writes the values last updated to NVS, called in a long interval to keep the flash wear low
+  bool save()
+  {
+    bool result = true;
+
+    if (_open && _dirty)
+    {
+      // NVS allocates internally
+      HeapGuard::get().suspend();
+      result = (_preferences.putBytes(SNAPSHOT_KEY, &rtcSnapshot, sizeof(rtcSnapshot)) == sizeof(rtcSnapshot));
+      HeapGuard::get().resume();
+      if (result)
+      {
+        _dirty = false;
+      }
+    }
+    return (result);
+  }
+
+private:
+  Preferences _preferences;
+  bool _open;
+  bool _dirty; // RTC memory holds values not yet written to NVS
+
+  static bool isValid(const SNAPSHOT &snapshot)
+  {
+    return ((snapshot.magic == SNAPSHOT_MAGIC) && (snapshot.checksum == getChecksum(snapshot.values)));
+  }
+
+  static uint32_t getChecksum(const INVERTER_VALUES &values)
+  {
+    return (Helper::getChecksum(&values, sizeof(values)));
+  }
+};
@@ -0,0 +1,133 @@
+// TemperatureSensor.hpp
+
+// reads the enclosure temperature from a DS18B20 sensor on one-wire
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <OneWire.h>
+#include <DallasTemperature.h>
+#include <DebugDefs.h>
+#include <Logger.hpp>
+#include <Events.h>
+#include <Settings.h>
+
+// resolution in bits, 12 bits need 750 ms per conversion
+#define TEMPERATURE_RESOLUTION 12
+#define TEMPERATURE_CONVERSION_TIME (750UL >> (12 - TEMPERATURE_RESOLUTION)) // in ms
+
+class TemperatureSensor
+{
+public:
+  TemperatureSensor(uint8_t pin) : _oneWire(pin), _sensors(&_oneWire)
+  {
+    _available = false;
+    _valid = false;
+    _converting = false;
+    _temperature = 0;
+    _conversionTimestamp = 0;
+  }
+
+  virtual ~TemperatureSensor()
+  {
+  }
+
+  // initializes the sensor and starts the first conversion
+  bool begin()
+  {
+    _sensors.begin();
+    _available = (_sensors.getDeviceCount() > 0);
+    if (_available)
+    {
+      _sensors.setResolution(TEMPERATURE_RESOLUTION);
+      // conversions run in the background, the result is collected later
+      _sensors.setWaitForConversion(false);
+      startConversion();
+    }
+    else
+    {
+      LOG_WARNING(LOG_SENSORS, "Temperature sensor not found");
+    }
+    return (_available);
+  }
+
+  // collects a finished conversion and starts the next one when due,
+  // returns true if there is a new value
+  bool process()
+  {
+    bool result = false;
+
+    if (!_available)
+    {
+      return (result);
+    }
+    if (_converting)
+    {
+      if (millis() - _conversionTimestamp >= TEMPERATURE_CONVERSION_TIME)
+      {
+        _converting = false;
+        float temperature = _sensors.getTempCByIndex(0);
+        if (temperature != DEVICE_DISCONNECTED_C)
+        {
+          _temperature = temperature;
+          _valid = true;
+          result = true;
+        }
+        else
+        {
+          LOG_WARNING(LOG_SENSORS, "Failed to read temperature sensor");
+        }
+      }
+    }
+    else if (millis() - _conversionTimestamp >= THERMAL_READ_INTERVAL * 1000)
+    {
+      startConversion();
+    }
+    return (result);
+  }
+
+  // returns the time in ms until a conversion is collected or started, NO_DEADLINE without sensor
+  unsigned long getTimeToNextRead() const
+  {
+    unsigned long result = NO_DEADLINE;
+
+    if (_available)
+    {
+      unsigned long interval = _converting ? TEMPERATURE_CONVERSION_TIME : THERMAL_READ_INTERVAL * 1000UL;
+      unsigned long elapsed = millis() - _conversionTimestamp;
+      result = (elapsed < interval) ? interval - elapsed : 0;
+    }
+    return (result);
+  }
+
+  // returns if the sensor has delivered a value
+  bool isValid() const
+  {
+    return (_valid);
+  }
+
+  // returns the temperature in degrees celsius
+  float getTemperature() const
+  {
+    return (_temperature);
+  }
+
+private:
+  OneWire _oneWire;
+  DallasTemperature _sensors;
+  bool _available;
+  bool _valid;
+  bool _converting;
+  float _temperature;
+  unsigned long _conversionTimestamp;
+
+  void startConversion()
+  {
+    _sensors.requestTemperatures();
+    _conversionTimestamp = millis();
+    _converting = true;
+  }
+};
@@ -0,0 +1,274 @@
+// VirtualDisplay.hpp
+
+// decodes the bits shifted to the display chain back to digits and symbols
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <DisplayHAL.hpp>
+#include <DebugDefs.h>
+
+// characters per display board in a rendered frame
+#define VIRTUAL_DISPLAY_BOARD_WIDTH 16
+
+class VirtualDisplay
+{
+public:
+  VirtualDisplay(uint8_t displayCount) : _displayCount(min(displayCount, (uint8_t)DISPLAY_MAX_COUNT))
+  {
+    for (uint8_t i = 0; i < _displayCount; i++)
+    {
+      _chain[i] = 0;
+      _latched[i] = 0;
+    }
+    _storeLevel = HIGH;
+    _blankLevel = LOW;
+    _bitCount = 0;
+    _frameCount = 0;
+    _storeBeginTimestamp = 0;
+    _lastUpdateDuration = 0;
+    _lastUpdateBitCount = 0;
+  }
+
+  virtual ~VirtualDisplay()
+  {
+  }
+
+  // called for each bit shifted into the chain, the new bit enters register 1 of the
+  // last display, all other bits move one register towards the first display
+  void shiftBit(uint8_t value)
+  {
+    uint64_t carry = value ? 1 : 0;
+    for (uint8_t i = 0; i < _displayCount; i++)
+    {
+      uint64_t out = _chain[i] >> 63;
+      _chain[i] = (_chain[i] << 1) | carry;
+      carry = out;
+    }
+    _bitCount++;
+  }
+
+  // called on each transition of the store line
+  void store(uint8_t level)
+  {
+    if (level == _storeLevel)
+    {
+      return;
+    }
+    _storeLevel = level;
+    if (level == LOW)
+    {
+      // store begin
+      _storeBeginTimestamp = micros();
+      _bitCount = 0;
+    }
+    else
+    {
+      // store commit, the shifted bits become visible
+      for (uint8_t i = 0; i < _displayCount; i++)
+      {
+        _latched[i] = _chain[i];
+      }
+      _lastUpdateDuration = micros() - _storeBeginTimestamp;
+      _lastUpdateBitCount = _bitCount;
+      _frameCount++;
+#if VIRTUAL_DISPLAY
+      print(Serial);
+#endif
+    }
+  }
+
+  // called on each change of the blank line
+  void blank(uint8_t level)
+  {
+    _blankLevel = level;
+  }
+
+  // returns the latched frame of a display board, one bit per register
+  uint64_t getFrame(uint8_t displayNumber) const
+  {
+    return (_latched[_displayCount - 1 - displayNumber]);
+  }
+
+  // returns the number of committed frames
+  unsigned long getFrameCount() const
+  {
+    return (_frameCount);
+  }
+
+  // returns the time between store begin and store commit of the last frame in us
+  unsigned long getLastUpdateDuration() const
+  {
+    return (_lastUpdateDuration);
+  }
+
+  // returns the number of bits shifted between store begin and store commit of the last frame
+  unsigned long getLastUpdateBitCount() const
+  {
+    return (_lastUpdateBitCount);
+  }
+
+  // renders the visible tubes of a display board as text,
+  // numeric tubes show the lit number, symbol tubes the sign name,
+  // '*' marks a tube with more than one cathode lit
+  void renderFrame(uint8_t displayNumber, char *buffer, size_t size) const
+  {
+    const char *tubes[TUBECOUNT] = {0};
+    char digits[TUBECOUNT][2] = {{0}};
+    bool decimalPoints[TUBECOUNT] = {false};
+    uint64_t frame = getFrame(displayNumber);
+    register_type regType;
+    uint8_t digit = 0;
+    uint8_t number = 0;
+
+    if (_blankLevel == LOW)
+    {
+      snprintf(buffer, size, "%-*s", VIRTUAL_DISPLAY_BOARD_WIDTH - 1, "(blank)");
+      return;
+    }
+
+    for (uint8_t i = 1; i <= _displayHAL.getRegisterCount(); i++)
+    {
+      if ((frame & REGISTER_BIT(i)) == 0)
+      {
+        continue;
+      }
+      regType = _displayHAL.getRegisterInfo(i, &digit, &number);
+      if (digit >= TUBECOUNT)
+      {
+        continue;
+      }
+      switch (regType)
+      {
+      case register_type::decimal_point:
+        decimalPoints[digit] = true;
+        break;
+
+      case register_type::number:
+        digits[digit][0] = '0' + number;
+        tubes[digit] = (tubes[digit] == nullptr) ? digits[digit] : "*";
+        break;
+
+      default:
+        if (_displayHAL.isCathode(i))
+        {
+          tubes[digit] = (tubes[digit] == nullptr) ? getSignName(regType) : "*";
+        }
+        break;
+      }
+    }
+
+    snprintf(buffer, size, "%-2s %s%s%s%s%s %-2s %-2s",
+             tubes[0] ? tubes[0] : "",
+             tubes[1] ? tubes[1] : " ", decimalPoints[1] ? "." : "",
+             tubes[2] ? tubes[2] : " ", decimalPoints[2] ? "." : "",
+             tubes[3] ? tubes[3] : " ",
+             tubes[4] ? tubes[4] : "",
+             tubes[5] ? tubes[5] : "");
+  }
+
+  // prints the visible content of all display boards in one line
+  void print(Print &out) const
+  {
+    char buffer[VIRTUAL_DISPLAY_BOARD_WIDTH];
+
+    out.print("[");
+    out.print(_frameCount);
+    out.print("] ");
+    for (uint8_t i = 0; i < _displayCount; i++)
+    {
+      renderFrame(i, buffer, sizeof(buffer));
+      out.print("| ");
+      out.print(buffer);
+      out.print(" ");
+    }
+    out.print("| ");
+    out.print(_lastUpdateDuration);
+    out.println("us");
+  }
+
+private:
+  uint8_t _displayCount;
+  DisplayHAL _displayHAL;
+  uint64_t _chain[DISPLAY_MAX_COUNT];   // shifted bits, index 0 is the display nearest to the controller
+  uint64_t _latched[DISPLAY_MAX_COUNT]; // bits visible after the last store commit
+  uint8_t _storeLevel;
+  uint8_t _blankLevel;
+  unsigned long _bitCount;
+  unsigned long _frameCount;
+  unsigned long _storeBeginTimestamp;
+  unsigned long _lastUpdateDuration;
+  unsigned long _lastUpdateBitCount;
+
+  // returns a short name of a sign
+  static const char *getSignName(register_type regType)
+  {
+    const char *name = "?";
+
+    switch (regType)
+    {
+    case register_type::mu_sign:
+      name = "u";
+      break;
+    case register_type::pi_sign:
+      name = "pi";
+      break;
+    case register_type::P_sign:
+      name = "P";
+      break;
+    case register_type::M_sign:
+      name = "M";
+      break;
+    case register_type::m_sign:
+      name = "m";
+      break;
+    case register_type::k_sign:
+      name = "k";
+      break;
+    case register_type::n_sign:
+      name = "n";
+      break;
+    case register_type::percent_sign:
+      name = "%";
+      break;
+    case register_type::plus_sign:
+    case register_type::overall_plus_sign:
+      name = "+";
+      break;
+    case register_type::minus_sign:
+    case register_type::overall_minus_sign:
+      name = "-";
+      break;
+    case register_type::omega_sign:
+      name = "O";
+      break;
+    case register_type::H_sign:
+      name = "H";
+      break;
+    case register_type::A_sign:
+      name = "A";
+      break;
+    case register_type::S_sign:
+      name = "S";
+      break;
+    case register_type::V_sign:
+      name = "V";
+      break;
+    case register_type::Hz_sign:
+      name = "Hz";
+      break;
+    case register_type::F_sign:
+      name = "F";
+      break;
+    case register_type::W_sign:
+      name = "W";
+      break;
+    default:
+      break;
+    }
+    return (name);
+  }
+};
@@ -7,26 +7,57 @@
 
 #include <main.h>
 
+#if HEAP_GUARD
+// allocations with new are reported to the heap guard, replaced here as main.cpp is the only translation unit
+void *operator new(size_t size)
+{
+  HeapGuard::get().onAllocation(size);
+  void *ptr = malloc(size);
+  if (ptr == nullptr)
+  {
+    abort();
+  }
+  return (ptr);
+}
+
+void *operator new[](size_t size)
+{
+  return (operator new(size));
+}
+
+void operator delete(void *ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  free(ptr);
+}
+#endif
+
 void setup()
 {
   // init console
   D_Begin(115200);
+  Logger::get().begin();
+#if PROFILING && !DEBUG
+  // the latency histograms are printed on serial
+  Serial.begin(115200);
+#endif
 
-  D_print("Initializing controller...");
+  LOG_INFO(LOG_MAIN, "Initializing controller...");
   int status = controller.begin();
   if (status != ERR_SUCCESS)
   {
-    D_print("Controller initialization failed. Error: ");
-    D_print(status);
-    D_print(" ");
-    D_println(Errors::getErrorText(status));
+    LOG_ERROR(LOG_MAIN, "Controller initialization failed. Error: %d %s", status, Errors::getErrorText(status));
     // error in initialization, stop
     while (true)
       ;
   }
   else
   {
-    D_println("Controller successfully initialized");
+    LOG_INFO(LOG_MAIN, "Controller successfully initialized");
   }
 }
 
@@ -35,8 +66,10 @@ void loop()
   if (!controller.process())
   {
     // error in controller process, stop
-    D_print("Error in controller process, stopping...");
+    LOG_ERROR(LOG_MAIN, "Error in controller process, stopping...");
     while (true)
       ;
   }
+  // sleep until the next event or deadline
+  controller.waitForEvent();
 }
@@ -0,0 +1,71 @@
+// Adafruit_NeoPixel.h
+
+// host double of the NeoPixel library, the colors are kept, show() sends nothing
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+#define NEO_GRB 0x52
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel
+{
+public:
+  unsigned long shows = 0;
+
+  Adafruit_NeoPixel()
+  {
+  }
+
+  Adafruit_NeoPixel(uint16_t length, int16_t pin, uint16_t type)
+  {
+    updateLength(length);
+    setPin(pin);
+    updateType(type);
+  }
+
+  void begin()
+  {
+  }
+
+  void updateLength(uint16_t length)
+  {
+    _pixels.assign(length * 3, 0);
+  }
+
+  void updateType(uint16_t)
+  {
+  }
+
+  void setPin(int16_t)
+  {
+  }
+
+  void setPixelColor(uint16_t index, uint8_t red, uint8_t green, uint8_t blue)
+  {
+    if ((size_t)index * 3 + 2 < _pixels.size())
+    {
+      _pixels[index * 3] = green;
+      _pixels[index * 3 + 1] = red;
+      _pixels[index * 3 + 2] = blue;
+    }
+  }
+
+  void show()
+  {
+    shows++;
+  }
+
+  uint8_t *getPixels()
+  {
+    return (_pixels.data());
+  }
+
+private:
+  std::vector<uint8_t> _pixels; // GRB
+};
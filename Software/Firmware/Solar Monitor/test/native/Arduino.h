@@ -0,0 +1,573 @@
+// Arduino.h
+
+// host double of the Arduino core for the native tests, time advances only by delay() or
+// Native::advance() and runs the tasks and esp_timer timers due, pin levels are kept in memory and can be
+// watched by a hook, input levels set by the test fire the attached interrupts
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <esp_heap_caps.h>
+
+using std::abs;
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define ONLOW 0x04
+#define ONHIGH 0x05
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define PROGMEM
+#define F(text) (text)
+#define PI 3.1415926535897932384626433832795
+#define constrain(amount, low, high) ((amount) < (low) ? (low) : ((amount) > (high) ? (high) : (amount)))
+#define digitalPinToInterrupt(pin) (pin)
+
+#define NATIVE_PIN_COUNT 40
+#define NATIVE_LEDC_CHANNELS 16
+
+namespace Native
+{
+  // simulated time in us
+  inline uint64_t now = 0;
+
+  // levels of all pins
+  inline uint8_t pins[NATIVE_PIN_COUNT] = {0};
+
+  // duty cycles of the PWM channels
+  inline uint32_t duties[NATIVE_LEDC_CHANNELS] = {0};
+
+  // called after each digitalWrite()
+  inline std::function<void(uint8_t pin, uint8_t level)> onWrite;
+
+  // interrupts attached to the pins and their modes, 0 if not attached
+  inline std::function<void(void)> interrupts[NATIVE_PIN_COUNT];
+  inline uint8_t interruptModes[NATIVE_PIN_COUNT] = {0};
+
+  // defined with the timers in esp_timer.h and the tasks in freertos/task.h
+  inline void clearTimers();
+  inline bool runUntil(uint64_t until, std::function<bool()> condition = nullptr);
+  inline void sleep(uint64_t us);
+  inline void clearTasks();
+
+  // depth of the calls into doubles of hardware with its own memory, e.g. the socket buffers of the
+  // ethernet chip, a test modelling the heap takes their memory elsewhere
+  inline int hardwareCalls = 0;
+
+  // advances the simulated time in us, the tasks and timers due meanwhile run
+  inline void advanceMicros(uint64_t us)
+  {
+    runUntil(now + us);
+  }
+
+  // advances the simulated time
+  inline void advance(unsigned long ms)
+  {
+    advanceMicros((uint64_t)ms * 1000);
+  }
+
+  // sets the level of an input pin, the interrupt fires on a matching edge or level
+  inline void setPin(uint8_t pin, uint8_t level)
+  {
+    pin %= NATIVE_PIN_COUNT;
+    bool changed = (pins[pin] != level);
+    pins[pin] = level;
+    if (!interrupts[pin])
+    {
+      return;
+    }
+    switch (interruptModes[pin])
+    {
+    case RISING:
+    case FALLING:
+      if (changed && (level == ((interruptModes[pin] == RISING) ? HIGH : LOW)))
+      {
+        interrupts[pin]();
+      }
+      break;
+
+    case CHANGE:
+      if (changed)
+      {
+        interrupts[pin]();
+      }
+      break;
+
+    case ONLOW:
+    case ONHIGH:
+      if (level == ((interruptModes[pin] == ONHIGH) ? HIGH : LOW))
+      {
+        interrupts[pin]();
+      }
+      break;
+    }
+  }
+
+  // restarts the simulated time, clears the pins and the interrupts and stops the timers and tasks
+  inline void reset()
+  {
+    now = 0;
+    memset(pins, 0, sizeof(pins));
+    memset(duties, 0, sizeof(duties));
+    onWrite = nullptr;
+    for (int pin = 0; pin < NATIVE_PIN_COUNT; pin++)
+    {
+      interrupts[pin] = nullptr;
+      interruptModes[pin] = 0;
+    }
+    clearTimers();
+    clearTasks();
+  }
+}
+
+// marks a call into a double of hardware for its lifetime
+struct NativeHardware
+{
+  NativeHardware()
+  {
+    Native::hardwareCalls++;
+  }
+
+  ~NativeHardware()
+  {
+    Native::hardwareCalls--;
+  }
+};
+
+inline unsigned long millis()
+{
+  return ((unsigned long)(Native::now / 1000));
+}
+
+inline unsigned long micros()
+{
+  return ((unsigned long)Native::now);
+}
+
+// a task blocks, the test advances the time
+inline void delay(unsigned long ms)
+{
+  Native::sleep((uint64_t)ms * 1000);
+}
+
+inline void delayMicroseconds(unsigned int us)
+{
+  Native::sleep(us);
+}
+
+inline void pinMode(uint8_t, uint8_t)
+{
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t level)
+{
+  Native::pins[pin % NATIVE_PIN_COUNT] = level;
+  if (Native::onWrite)
+  {
+    Native::onWrite(pin, level);
+  }
+}
+
+inline int digitalRead(uint8_t pin)
+{
+  return (Native::pins[pin % NATIVE_PIN_COUNT]);
+}
+
+inline int analogRead(uint8_t)
+{
+  return (0);
+}
+
+inline void attachInterrupt(uint8_t pin, std::function<void(void)> handler, int mode)
+{
+  Native::interrupts[pin % NATIVE_PIN_COUNT] = handler;
+  Native::interruptModes[pin % NATIVE_PIN_COUNT] = mode;
+}
+
+inline void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode)
+{
+  attachInterrupt(pin, [handler, arg]()
+                  { handler(arg); }, mode);
+}
+
+inline void detachInterrupt(uint8_t pin)
+{
+  Native::interrupts[pin % NATIVE_PIN_COUNT] = nullptr;
+  Native::interruptModes[pin % NATIVE_PIN_COUNT] = 0;
+}
+
+inline uint32_t ledcSetup(uint8_t, uint32_t frequency, uint8_t)
+{
+  return (frequency);
+}
+
+inline void ledcAttachPin(uint8_t, uint8_t)
+{
+}
+
+inline void ledcWrite(uint8_t channel, uint32_t duty)
+{
+  Native::duties[channel % NATIVE_LEDC_CHANNELS] = duty;
+}
+
+class Print
+{
+public:
+  virtual ~Print()
+  {
+  }
+
+  virtual size_t write(uint8_t) = 0;
+
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t count = 0;
+    while ((count < size) && write(buffer[count]))
+    {
+      count++;
+    }
+    return (count);
+  }
+
+  size_t write(const char *text)
+  {
+    return (write((const uint8_t *)text, strlen(text)));
+  }
+
+  size_t print(const char *text)
+  {
+    return (write(text));
+  }
+
+  size_t print(char c)
+  {
+    return (write((uint8_t)c));
+  }
+
+  size_t print(int value, int = 10)
+  {
+    return (print((long)value));
+  }
+
+  size_t print(unsigned int value, int = 10)
+  {
+    return (print((unsigned long)value));
+  }
+
+  size_t print(long value, int = 10)
+  {
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", value);
+    return (write(text));
+  }
+
+  size_t print(unsigned long value, int = 10)
+  {
+    char text[24];
+    snprintf(text, sizeof(text), "%lu", value);
+    return (write(text));
+  }
+
+  size_t print(double value, int digits = 2)
+  {
+    char text[32];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return (write(text));
+  }
+
+  size_t println()
+  {
+    return (write("\r\n"));
+  }
+
+  template <typename T>
+  size_t println(T value)
+  {
+    size_t count = print(value);
+    return (count + println());
+  }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    return (write(text));
+  }
+
+  virtual void flush()
+  {
+  }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+
+  virtual int peek()
+  {
+    return (-1);
+  }
+
+  void setTimeout(unsigned long timeout)
+  {
+    _timeout = timeout;
+  }
+
+  unsigned long getTimeout() const
+  {
+    return (_timeout);
+  }
+
+  size_t readBytes(char *buffer, size_t length)
+  {
+    size_t count = 0;
+    int c;
+    while ((count < length) && ((c = timedRead()) >= 0))
+    {
+      buffer[count++] = (char)c;
+    }
+    return (count);
+  }
+
+  size_t readBytes(uint8_t *buffer, size_t length)
+  {
+    return (readBytes((char *)buffer, length));
+  }
+
+  size_t readBytesUntil(char terminator, char *buffer, size_t length)
+  {
+    size_t count = 0;
+    int c;
+    while ((count < length) && ((c = timedRead()) >= 0) && (c != terminator))
+    {
+      buffer[count++] = (char)c;
+    }
+    return (count);
+  }
+
+protected:
+  unsigned long _timeout = 1000;
+
+  // polls for the next byte at most the timeout like the Arduino core, the simulation runs meanwhile
+  int timedRead()
+  {
+    unsigned long start = millis();
+    while (available() <= 0)
+    {
+      if (millis() - start >= _timeout)
+      {
+        return (-1);
+      }
+      delay(1);
+    }
+    return (read());
+  }
+};
+
+// serial port, the output goes to stdout, the input is taken from a buffer set by the test
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long, uint32_t = 0, int8_t = -1, int8_t = -1)
+  {
+  }
+
+  void end()
+  {
+  }
+
+  void setRxBufferSize(size_t)
+  {
+  }
+
+  void onReceive(std::function<void(void)>, bool = false)
+  {
+  }
+
+  operator bool() const
+  {
+    return (true);
+  }
+
+  // sets the received data
+  void feed(const char *data, size_t length)
+  {
+    _input = data;
+    _inputLength = length;
+  }
+
+  int available() override
+  {
+    return ((int)_inputLength);
+  }
+
+  int read() override
+  {
+    if (_inputLength == 0)
+    {
+      return (-1);
+    }
+    _inputLength--;
+    return ((uint8_t)*_input++);
+  }
+
+  size_t read(uint8_t *buffer, size_t size)
+  {
+    size_t count = min(size, _inputLength);
+    memcpy(buffer, _input, count);
+    _input += count;
+    _inputLength -= count;
+    return (count);
+  }
+
+  size_t write(uint8_t c) override
+  {
+    return (fputc(c, stdout) == EOF ? 0 : 1);
+  }
+
+  using Print::write;
+
+private:
+  const char *_input = nullptr;
+  size_t _inputLength = 0;
+};
+
+#define SERIAL_8N1 0x800001c
+
+inline HardwareSerial Serial;
+inline HardwareSerial Serial1;
+inline HardwareSerial Serial2;
+
+class IPAddress
+{
+public:
+  IPAddress() : _address(0)
+  {
+  }
+
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+  {
+    _bytes[0] = a;
+    _bytes[1] = b;
+    _bytes[2] = c;
+    _bytes[3] = d;
+  }
+
+  IPAddress(uint32_t address) : _address(address)
+  {
+  }
+
+  bool fromString(const char *text)
+  {
+    unsigned int parts[4];
+    char end;
+    if ((sscanf(text, "%u.%u.%u.%u%c", &parts[0], &parts[1], &parts[2], &parts[3], &end) != 4) ||
+        (parts[0] > 255) || (parts[1] > 255) || (parts[2] > 255) || (parts[3] > 255))
+    {
+      return (false);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+      _bytes[i] = (uint8_t)parts[i];
+    }
+    return (true);
+  }
+
+  operator uint32_t() const
+  {
+    return (_address);
+  }
+
+  bool operator==(const IPAddress &other) const
+  {
+    return (_address == other._address);
+  }
+
+  uint8_t operator[](int index) const
+  {
+    return (_bytes[index]);
+  }
+
+  uint8_t &operator[](int index)
+  {
+    return (_bytes[index]);
+  }
+
+private:
+  union
+  {
+    uint8_t _bytes[4];
+    uint32_t _address;
+  };
+};
+
+class EspClass
+{
+public:
+  uint32_t getFreeHeap()
+  {
+    return ((uint32_t)heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+  }
+
+  uint32_t getMinFreeHeap()
+  {
+    return ((uint32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+  }
+
+  uint32_t getMaxAllocHeap()
+  {
+    return ((uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+  }
+
+  uint32_t getCpuFreqMHz()
+  {
+    return (240);
+  }
+
+  uint32_t getCycleCount()
+  {
+    return ((uint32_t)(Native::now * 240));
+  }
+
+  void restart()
+  {
+  }
+};
+
+inline EspClass ESP;
+
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
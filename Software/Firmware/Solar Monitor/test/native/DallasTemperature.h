@@ -0,0 +1,88 @@
+// DallasTemperature.h
+
+// host double of the DS18B20 library with one simulated sensor, a conversion takes the time of the
+// resolution, a read during a conversion returns the previous result, 85 C after power on
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <OneWire.h>
+
+#define DEVICE_DISCONNECTED_C -127
+#define NATIVE_DS18B20_POWER_ON 85.0 // in C, the register before the first conversion
+
+namespace Native
+{
+  // the simulated sensor, present on the bus with the temperature of the enclosure in C
+  inline bool ds18b20Present = true;
+  inline float ds18b20Temperature = 25;
+}
+
+class DallasTemperature
+{
+public:
+  unsigned long conversions = 0;
+
+  explicit DallasTemperature(OneWire *)
+  {
+  }
+
+  void begin()
+  {
+  }
+
+  uint8_t getDeviceCount()
+  {
+    return (Native::ds18b20Present ? 1 : 0);
+  }
+
+  void setResolution(uint8_t resolution)
+  {
+    _resolution = resolution;
+  }
+
+  void setWaitForConversion(bool wait)
+  {
+    _wait = wait;
+  }
+
+  int16_t millisToWaitForConversion(uint8_t resolution)
+  {
+    return (750 >> (12 - resolution));
+  }
+
+  void requestTemperatures()
+  {
+    _start = millis();
+    _converting = true;
+    conversions++;
+    if (_wait)
+    {
+      delay(millisToWaitForConversion(_resolution));
+    }
+  }
+
+  float getTempCByIndex(uint8_t index)
+  {
+    if (!Native::ds18b20Present || (index > 0))
+    {
+      return (DEVICE_DISCONNECTED_C);
+    }
+    if (_converting && (millis() - _start >= (unsigned long)millisToWaitForConversion(_resolution)))
+    {
+      _converting = false;
+      _value = Native::ds18b20Temperature;
+    }
+    return (_value);
+  }
+
+private:
+  uint8_t _resolution = 12;
+  bool _wait = true;
+  bool _converting = false;
+  unsigned long _start = 0;
+  float _value = NATIVE_DS18B20_POWER_ON;
+};
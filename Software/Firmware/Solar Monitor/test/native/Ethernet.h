@@ -0,0 +1,467 @@
+// Ethernet.h
+
+// host double of the Ethernet library, the UDP sockets joined to a multicast group share a simulated
+// network segment, a datagram comes from the local address at the time its socket joined,
+// a test can drop datagrams between two sockets, TCP clients connect to services
+// registered by the test, e.g. the inverter, which answer a complete request after their latency,
+// connections opened by the test like a browser are accepted by the servers of the firmware,
+// the DHCP exchange takes its time and fails without link or server, the buffers are in the chip,
+// not on the heap of the ESP32
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define NATIVE_DHCP_TIME 1500     // in ms, the DHCP exchange with an answering server
+#define NATIVE_SOCKET_BUFFER 2048 // in bytes, transmit buffer of a socket
+
+enum EthernetHardwareStatus
+{
+  EthernetNoHardware,
+  EthernetW5100,
+  EthernetW5200,
+  EthernetW5500
+};
+
+enum EthernetLinkStatus
+{
+  Unknown,
+  LinkON,
+  LinkOFF
+};
+
+// a TCP connection, the client sends the request, the server the response
+struct NativeConnection
+{
+  std::string request;
+  std::string response;
+  size_t requestRead = 0;
+  size_t responseRead = 0;
+  bool answered = false; // the response of a service is complete
+  uint64_t arrival = 0;  // in us, when the response of a service reaches the client
+  bool closed = false;   // by either side
+};
+
+// a server on the simulated network answering the requests of the firmware
+struct NativeService
+{
+  std::function<std::string(const std::string &request)> respond;
+  unsigned long latency = 0; // in ms, from the end of the request to the response
+  unsigned long requests = 0;
+};
+
+class EthernetClass
+{
+public:
+  bool hardware = true;   // the ethernet port is found
+  bool link = true;       // the cable is connected
+  bool dhcpServer = true; // a DHCP server answers
+  unsigned long dhcpTime = NATIVE_DHCP_TIME;
+  IPAddress dhcpAddress = IPAddress(192, 168, 1, 20); // assigned by the DHCP server
+  unsigned long dhcpRequests = 0;
+  std::map<std::string, NativeService> services; // keyed by host:port
+  std::deque<std::pair<uint16_t, std::shared_ptr<NativeConnection>>> pending; // not yet accepted, with their port
+
+  // removes the services, the connections and the addresses
+  void reset()
+  {
+    hardware = true;
+    link = true;
+    dhcpServer = true;
+    dhcpTime = NATIVE_DHCP_TIME;
+    dhcpAddress = IPAddress(192, 168, 1, 20);
+    dhcpRequests = 0;
+    services.clear();
+    pending.clear();
+    _localIP = IPAddress();
+    _gateway = IPAddress();
+    _subnet = IPAddress();
+    _dns = IPAddress();
+  }
+
+  void init(uint8_t)
+  {
+  }
+
+  // asks the DHCP server for an address, blocks until the answer or the timeout, returns 0 on failure
+  int begin(uint8_t *, unsigned long timeout = 60000, unsigned long = 4000)
+  {
+    if (!hardware)
+    {
+      return (0);
+    }
+    dhcpRequests++;
+    if (!link || !dhcpServer)
+    {
+      delay(timeout);
+      return (0);
+    }
+    delay(dhcpTime);
+    _localIP = dhcpAddress;
+    _gateway = IPAddress(dhcpAddress[0], dhcpAddress[1], dhcpAddress[2], 1);
+    _subnet = IPAddress(255, 255, 255, 0);
+    _dns = _gateway;
+    return (1);
+  }
+
+  void begin(uint8_t *, IPAddress ip, IPAddress dns, IPAddress gateway, IPAddress subnet)
+  {
+    _localIP = ip;
+    _dns = dns;
+    _gateway = gateway;
+    _subnet = subnet;
+  }
+
+  EthernetHardwareStatus hardwareStatus()
+  {
+    return (hardware ? EthernetW5500 : EthernetNoHardware);
+  }
+
+  EthernetLinkStatus linkStatus()
+  {
+    return (link ? LinkON : LinkOFF);
+  }
+
+  int maintain()
+  {
+    return (0);
+  }
+
+  IPAddress localIP()
+  {
+    return (_localIP);
+  }
+
+  IPAddress gatewayIP()
+  {
+    return (_gateway);
+  }
+
+  IPAddress subnetMask()
+  {
+    return (_subnet);
+  }
+
+  IPAddress dnsServerIP()
+  {
+    return (_dns);
+  }
+
+  // opens a connection to a server of the firmware like a browser, the request is sent at once
+  std::shared_ptr<NativeConnection> open(uint16_t port, const std::string &request)
+  {
+    std::shared_ptr<NativeConnection> connection = std::make_shared<NativeConnection>();
+    connection->request = request;
+    pending.push_back({port, connection});
+    return (connection);
+  }
+
+private:
+  IPAddress _localIP;
+  IPAddress _gateway;
+  IPAddress _subnet;
+  IPAddress _dns;
+};
+
+inline EthernetClass Ethernet;
+
+class EthernetClient : public Client
+{
+public:
+  EthernetClient()
+  {
+  }
+
+  // a connection accepted by a server
+  explicit EthernetClient(std::shared_ptr<NativeConnection> connection) : _connection(connection), _accepted(true)
+  {
+  }
+
+  int connect(IPAddress ip, uint16_t port) override
+  {
+    char host[16];
+    snprintf(host, sizeof(host), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    return (connect(host, port));
+  }
+
+  // connects to a service of the test, fails without link or service
+  int connect(const char *host, uint16_t port) override
+  {
+    NativeHardware hardware;
+    stop();
+    auto service = Ethernet.services.find(std::string(host) + ":" + std::to_string(port));
+    if (!Ethernet.link || (service == Ethernet.services.end()))
+    {
+      return (0);
+    }
+    _connection = std::make_shared<NativeConnection>();
+    _service = &service->second;
+    _accepted = false;
+    return (1);
+  }
+
+  size_t write(uint8_t c) override
+  {
+    return (write(&c, 1));
+  }
+
+  // a service answers when the empty line ending the request has been sent
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    NativeHardware hardware;
+    if (!connected())
+    {
+      return (0);
+    }
+    if (_accepted)
+    {
+      _connection->response.append((const char *)buffer, size);
+      return (size);
+    }
+    std::string &request = _connection->request;
+    request.append((const char *)buffer, size);
+    if (!_connection->answered && (request.size() >= 4) && (request.compare(request.size() - 4, 4, "\r\n\r\n") == 0))
+    {
+      _service->requests++;
+      _connection->response = _service->respond ? _service->respond(request) : std::string();
+      _connection->arrival = Native::now + (uint64_t)_service->latency * 1000;
+      _connection->answered = true;
+    }
+    return (size);
+  }
+
+  int availableForWrite()
+  {
+    return (connected() ? NATIVE_SOCKET_BUFFER : 0);
+  }
+
+  int available() override
+  {
+    if (!_connection)
+    {
+      return (0);
+    }
+    if (_accepted)
+    {
+      return ((int)(_connection->request.size() - _connection->requestRead));
+    }
+    if (!_connection->answered || (Native::now < _connection->arrival))
+    {
+      return (0);
+    }
+    return ((int)(_connection->response.size() - _connection->responseRead));
+  }
+
+  int read() override
+  {
+    uint8_t c;
+    return ((read(&c, 1) == 1) ? c : -1);
+  }
+
+  int read(uint8_t *buffer, size_t size) override
+  {
+    size_t count = min(size, (size_t)available());
+    if (count > 0)
+    {
+      std::string &data = _accepted ? _connection->request : _connection->response;
+      size_t &position = _accepted ? _connection->requestRead : _connection->responseRead;
+      memcpy(buffer, data.data() + position, count);
+      position += count;
+    }
+    return ((int)count);
+  }
+
+  // a service closes the connection after its response, the unread data is still available
+  uint8_t connected() override
+  {
+    if (!_connection || (_connection->closed && (available() == 0)))
+    {
+      return (0);
+    }
+    return (_accepted || !_connection->answered || (available() > 0) || (Native::now < _connection->arrival));
+  }
+
+  void stop() override
+  {
+    if (_connection)
+    {
+      _connection->closed = true;
+      _connection.reset();
+    }
+  }
+
+  operator bool()
+  {
+    return (_connection != nullptr);
+  }
+
+  using Print::write;
+
+private:
+  std::shared_ptr<NativeConnection> _connection;
+  NativeService *_service = nullptr;
+  bool _accepted = false;
+};
+
+class EthernetServer
+{
+public:
+  explicit EthernetServer(uint16_t port) : _port(port)
+  {
+  }
+
+  void begin()
+  {
+    _listening = true;
+  }
+
+  // returns the next connection opened by the test on the port, an empty client if there is none
+  EthernetClient available()
+  {
+    NativeHardware hardware;
+    std::deque<std::pair<uint16_t, std::shared_ptr<NativeConnection>>> &pending = Ethernet.pending;
+    for (auto it = pending.begin(); _listening && (it != pending.end()); it++)
+    {
+      if (it->first == _port)
+      {
+        EthernetClient client(it->second);
+        pending.erase(it);
+        return (client);
+      }
+    }
+    return (EthernetClient());
+  }
+
+private:
+  uint16_t _port;
+  bool _listening = false;
+};
+
+class EthernetUDP : public Stream
+{
+public:
+  // decides if a datagram sent by one socket reaches another, all are delivered without it
+  static std::function<bool(const EthernetUDP *from, const EthernetUDP *to)> &deliver()
+  {
+    static std::function<bool(const EthernetUDP *, const EthernetUDP *)> filter;
+    return (filter);
+  }
+
+  virtual ~EthernetUDP()
+  {
+    stop();
+  }
+
+  uint8_t beginMulticast(IPAddress, uint16_t)
+  {
+    NativeHardware hardware;
+    stop();
+    _localIP = Ethernet.localIP();
+    getSegment().push_back(this);
+    return (1);
+  }
+
+  void stop()
+  {
+    std::vector<EthernetUDP *> &segment = getSegment();
+    segment.erase(std::remove(segment.begin(), segment.end(), this), segment.end());
+    _received.clear();
+  }
+
+  int beginPacket(IPAddress, uint16_t)
+  {
+    _sending.clear();
+    return (1);
+  }
+
+  // sends to all joined sockets, the own socket included like a multicast loopback
+  int endPacket()
+  {
+    NativeHardware hardware;
+    for (EthernetUDP *socket : getSegment())
+    {
+      if (!deliver() || deliver()(this, socket))
+      {
+        socket->_received.push_back({_localIP, _sending});
+      }
+    }
+    return (1);
+  }
+
+  size_t write(uint8_t c) override
+  {
+    NativeHardware hardware;
+    _sending += (char)c;
+    return (1);
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    NativeHardware hardware;
+    _sending.append((const char *)buffer, size);
+    return (size);
+  }
+
+  using Print::write;
+
+  int parsePacket()
+  {
+    NativeHardware hardware;
+    if (_received.empty())
+    {
+      return (0);
+    }
+    _remoteIP = _received.front().first;
+    _packet = _received.front().second;
+    _received.pop_front();
+    _position = 0;
+    return ((int)_packet.size());
+  }
+
+  int available() override
+  {
+    return ((int)(_packet.size() - _position));
+  }
+
+  // returns the sender of the datagram parsed last
+  IPAddress remoteIP()
+  {
+    return (_remoteIP);
+  }
+
+  int read() override
+  {
+    return ((_position < _packet.size()) ? (uint8_t)_packet[_position++] : -1);
+  }
+
+  int read(uint8_t *buffer, size_t size)
+  {
+    size_t count = min(size, _packet.size() - _position);
+    memcpy(buffer, _packet.data() + _position, count);
+    _position += count;
+    return ((int)count);
+  }
+
+private:
+  std::deque<std::pair<IPAddress, std::string>> _received; // with their sender
+  IPAddress _localIP;
+  IPAddress _remoteIP;
+  std::string _sending;
+  std::string _packet;
+  size_t _position = 0;
+
+  static std::vector<EthernetUDP *> &getSegment()
+  {
+    static std::vector<EthernetUDP *> segment;
+    return (segment);
+  }
+};
@@ -0,0 +1,54 @@
+// NativeInverter.h
+
+// simulated Fronius inverter on the network of the Ethernet double, answers the power flow request
+// with the values given by the test after its latency
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Ethernet.h>
+#include <Inverter.hpp>
+#include <string>
+
+#define NATIVE_INVERTER_ADDRESS "192.168.1.50"
+#define NATIVE_INVERTER_LATENCY 120 // in ms, the inverter takes its time to answer
+
+namespace Native
+{
+  // returns the response of the inverter to the power flow request
+  inline std::string getInverterResponse(const INVERTER_VALUES &values)
+  {
+    char body[512];
+    char header[128];
+
+    int length = snprintf(body, sizeof(body),
+                          "{\"Body\":{\"Data\":{\"Inverters\":{\"1\":{\"DT\":1,\"SOC\":%.1f}},"
+                          "\"Site\":{\"Mode\":\"bidirectional\",\"P_Akku\":%.2f,\"P_Grid\":%.2f,\"P_Load\":%.2f,"
+                          "\"P_PV\":%.2f,\"rel_Autonomy\":%.2f,\"rel_SelfConsumption\":%.2f}}},"
+                          "\"Head\":{\"Status\":{\"Code\":0}}}",
+                          values.SOC, values.P_Akku, values.P_Grid, values.P_Load, values.P_PV,
+                          values.rel_Autonomy, values.rel_SelfConsumption);
+    snprintf(header, sizeof(header),
+             "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %d\r\nConnection: close\r\n\r\n",
+             length);
+    return (std::string(header) + body);
+  }
+
+  // registers the inverter at the address and port of the configuration, the values of each request
+  // are taken from the function
+  inline NativeService &addInverter(std::function<INVERTER_VALUES()> values,
+                                    unsigned long latency = NATIVE_INVERTER_LATENCY)
+  {
+    const CONFIG &config = Config::get().getActive();
+    NativeService &service = Ethernet.services[std::string(config.inverterAddress) + ":" + std::to_string(config.inverterPort)];
+    service.respond = [values](const std::string &)
+    {
+      return (getInverterResponse(values()));
+    };
+    service.latency = latency;
+    service.requests = 0;
+    return (service);
+  }
+}
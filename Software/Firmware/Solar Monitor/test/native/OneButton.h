@@ -0,0 +1,210 @@
+// OneButton.h
+
+// host double of the OneButton library 2.5, the state machine and the debouncing follow the library,
+// a new pin level counts only after it has been read unchanged for the debounce time, so a single
+// tick after an edge sees the old level
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+
+class OneButton
+{
+public:
+  typedef void (*callbackFunction)(void);
+  typedef void (*parameterizedCallbackFunction)(void *);
+
+  OneButton()
+  {
+  }
+
+  explicit OneButton(const int pin, const bool activeLow = true, const bool pullupActive = true)
+  {
+    _pin = pin;
+    _buttonPressed = activeLow ? LOW : HIGH;
+    pinMode(pin, pullupActive ? INPUT_PULLUP : INPUT);
+  }
+
+  void setDebounceMs(const int ms)
+  {
+    _debounceMs = ms;
+  }
+
+  void setClickMs(const unsigned int ms)
+  {
+    _clickMs = ms;
+  }
+
+  void setPressMs(const unsigned int ms)
+  {
+    _pressMs = ms;
+  }
+
+  void attachClick(parameterizedCallbackFunction function, void *parameter)
+  {
+    _click = function;
+    _clickParameter = parameter;
+  }
+
+  void attachDoubleClick(parameterizedCallbackFunction function, void *parameter)
+  {
+    _doubleClick = function;
+    _doubleClickParameter = parameter;
+    _maxClicks = max(_maxClicks, 2);
+  }
+
+  void attachLongPressStart(parameterizedCallbackFunction function, void *parameter)
+  {
+    _longPressStart = function;
+    _longPressStartParameter = parameter;
+  }
+
+  // reads the pin and runs the state machine
+  void tick()
+  {
+    if (_pin >= 0)
+    {
+      tick(debounce(digitalRead(_pin) == _buttonPressed));
+    }
+  }
+
+  void tick(bool activeLevel)
+  {
+    unsigned long now = millis();
+    unsigned long waitTime = now - _startTime;
+
+    switch (_state)
+    {
+    case state::init:
+      if (activeLevel)
+      {
+        _state = state::down;
+        _startTime = now;
+        _clicks = 0;
+      }
+      break;
+
+    case state::down:
+      if (!activeLevel)
+      {
+        _state = state::up;
+        _startTime = now;
+      }
+      else if (waitTime > _pressMs)
+      {
+        call(_longPressStart, _longPressStartParameter);
+        _state = state::press;
+      }
+      break;
+
+    case state::up:
+      _clicks++;
+      _state = state::count;
+      break;
+
+    case state::count:
+      if (activeLevel)
+      {
+        _state = state::down;
+        _startTime = now;
+      }
+      else if ((waitTime >= _clickMs) || (_clicks == _maxClicks))
+      {
+        if (_clicks == 1)
+        {
+          call(_click, _clickParameter);
+        }
+        else if (_clicks == 2)
+        {
+          call(_doubleClick, _doubleClickParameter);
+        }
+        reset();
+      }
+      break;
+
+    case state::press:
+      if (!activeLevel)
+      {
+        _state = state::pressEnd;
+        _startTime = now;
+      }
+      break;
+
+    case state::pressEnd:
+      reset();
+      break;
+    }
+  }
+
+  void reset()
+  {
+    _state = state::init;
+    _clicks = 0;
+    _startTime = 0;
+  }
+
+  bool isIdle() const
+  {
+    return (_state == state::init);
+  }
+
+private:
+  enum class state
+  {
+    init,
+    down,
+    up,
+    count,
+    press,
+    pressEnd
+  };
+
+  int _pin = -1;
+  int _buttonPressed = LOW;
+  unsigned int _debounceMs = 50;
+  unsigned int _clickMs = 400;
+  unsigned int _pressMs = 800;
+  int _maxClicks = 1;
+  state _state = state::init;
+  int _clicks = 0;
+  unsigned long _startTime = 0;
+  bool _debouncedLevel = false;
+  bool _lastDebounceLevel = false;
+  unsigned long _lastDebounceTime = 0;
+  parameterizedCallbackFunction _click = nullptr;
+  void *_clickParameter = nullptr;
+  parameterizedCallbackFunction _doubleClick = nullptr;
+  void *_doubleClickParameter = nullptr;
+  parameterizedCallbackFunction _longPressStart = nullptr;
+  void *_longPressStartParameter = nullptr;
+
+  // takes a level after it has been stable for the debounce time
+  bool debounce(bool level)
+  {
+    unsigned long now = millis();
+    if (level == _lastDebounceLevel)
+    {
+      if (now - _lastDebounceTime >= _debounceMs)
+      {
+        _debouncedLevel = level;
+      }
+    }
+    else
+    {
+      _lastDebounceTime = now;
+      _lastDebounceLevel = level;
+    }
+    return (_debouncedLevel);
+  }
+
+  static void call(parameterizedCallbackFunction function, void *parameter)
+  {
+    if (function != nullptr)
+    {
+      function(parameter);
+    }
+  }
+};
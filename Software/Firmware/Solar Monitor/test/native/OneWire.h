@@ -0,0 +1,26 @@
+// OneWire.h
+
+// host double of the 1-Wire bus, the devices are simulated by DallasTemperature.h
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+
+class OneWire
+{
+public:
+  explicit OneWire(uint8_t pin) : _pin(pin)
+  {
+  }
+
+  uint8_t getPin() const
+  {
+    return (_pin);
+  }
+
+private:
+  uint8_t _pin;
+};
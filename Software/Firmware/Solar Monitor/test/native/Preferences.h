@@ -0,0 +1,106 @@
+// Preferences.h
+
+// host double of the NVS preferences, the namespaces are kept in memory and survive
+// a simulated restart of the firmware objects, like the flash they are not on the heap of the ESP32
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences
+{
+public:
+  // returns the stored entries of all namespaces, keyed by namespace/key
+  static std::map<std::string, std::vector<uint8_t>> &getStore()
+  {
+    static std::map<std::string, std::vector<uint8_t>> store;
+    return (store);
+  }
+
+  bool begin(const char *name, bool = false)
+  {
+    NativeHardware hardware;
+    _name = name;
+    return (true);
+  }
+
+  void end()
+  {
+  }
+
+  bool clear()
+  {
+    NativeHardware hardware;
+    std::string prefix = _name + "/";
+    auto &store = getStore();
+    for (auto it = store.begin(); it != store.end();)
+    {
+      it = (it->first.compare(0, prefix.size(), prefix) == 0) ? store.erase(it) : std::next(it);
+    }
+    return (true);
+  }
+
+  bool remove(const char *key)
+  {
+    NativeHardware hardware;
+    return (getStore().erase(getKey(key)) > 0);
+  }
+
+  bool isKey(const char *key)
+  {
+    NativeHardware hardware;
+    return (getStore().count(getKey(key)) > 0);
+  }
+
+  size_t getBytesLength(const char *key)
+  {
+    NativeHardware hardware;
+    auto it = getStore().find(getKey(key));
+    return ((it == getStore().end()) ? 0 : it->second.size());
+  }
+
+  size_t getBytes(const char *key, void *buffer, size_t length)
+  {
+    NativeHardware hardware;
+    auto it = getStore().find(getKey(key));
+    if ((it == getStore().end()) || (it->second.size() > length))
+    {
+      return (0);
+    }
+    memcpy(buffer, it->second.data(), it->second.size());
+    return (it->second.size());
+  }
+
+  size_t putBytes(const char *key, const void *buffer, size_t length)
+  {
+    NativeHardware hardware;
+    getStore()[getKey(key)].assign((const uint8_t *)buffer, (const uint8_t *)buffer + length);
+    return (length);
+  }
+
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0)
+  {
+    uint32_t value = defaultValue;
+    getBytes(key, &value, sizeof(value));
+    return (value);
+  }
+
+  size_t putUInt(const char *key, uint32_t value)
+  {
+    return (putBytes(key, &value, sizeof(value)));
+  }
+
+private:
+  std::string _name;
+
+  std::string getKey(const char *key) const
+  {
+    return (_name + "/" + key);
+  }
+};
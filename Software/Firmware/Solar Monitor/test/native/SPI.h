@@ -0,0 +1,24 @@
+// SPI.h
+
+// host double of the SPI bus, the simulated ethernet port is not attached to a bus
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+
+class SPIClass
+{
+public:
+  void begin(int8_t = -1, int8_t = -1, int8_t = -1, int8_t = -1)
+  {
+  }
+
+  void end()
+  {
+  }
+};
+
+inline SPIClass SPI;
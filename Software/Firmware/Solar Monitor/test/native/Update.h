@@ -0,0 +1,82 @@
+// Update.h
+
+// host double of the Update library, the image is kept in memory, the MD5 hash is compared as it is set
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <string>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+#define UPDATE_ERROR_OK 0
+#define UPDATE_ERROR_WRITE 1
+#define UPDATE_ERROR_SIZE 4
+#define UPDATE_ERROR_MD5 9
+
+class UpdateClass
+{
+public:
+  std::string image; // written so far
+  std::string md5;   // hash of the image expected by the test, any hash is accepted if empty
+
+  bool begin(size_t size, int = 0, int = -1, uint8_t = LOW, const char * = nullptr)
+  {
+    image.clear();
+    _size = size;
+    _active = true;
+    _error = UPDATE_ERROR_OK;
+    return (true);
+  }
+
+  bool setMD5(const char *hash)
+  {
+    _md5 = hash;
+    return (strlen(hash) == 32);
+  }
+
+  size_t write(uint8_t *data, size_t length)
+  {
+    if (!_active)
+    {
+      _error = UPDATE_ERROR_WRITE;
+      return (0);
+    }
+    image.append((const char *)data, length);
+    return (length);
+  }
+
+  bool end(bool = false)
+  {
+    _active = false;
+    if (image.size() != _size)
+    {
+      _error = UPDATE_ERROR_SIZE;
+    }
+    else if (!md5.empty() && (strcasecmp(md5.c_str(), _md5.c_str()) != 0))
+    {
+      _error = UPDATE_ERROR_MD5;
+    }
+    return (_error == UPDATE_ERROR_OK);
+  }
+
+  void abort()
+  {
+    _active = false;
+  }
+
+  uint8_t getError()
+  {
+    return (_error);
+  }
+
+private:
+  size_t _size = 0;
+  bool _active = false;
+  uint8_t _error = UPDATE_ERROR_OK;
+  std::string _md5;
+};
+
+inline UpdateClass Update;
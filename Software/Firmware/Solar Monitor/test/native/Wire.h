@@ -0,0 +1,134 @@
+// Wire.h
+
+// host double of the I2C bus with a simulated BH1750 light sensor, the sensor measures the light
+// set by the test continuously and returns the last finished measurement, it can be removed from the bus
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+#define NATIVE_BH1750_ADDRESS 0x23
+#define NATIVE_BH1750_MEASUREMENT_TIME 120 // in ms, continuous high resolution mode
+
+class TwoWire
+{
+public:
+  bool present = true;          // the sensor answers
+  std::function<float()> light; // in lux, the light falling on the sensor
+  std::vector<uint8_t> commands;
+  unsigned long requests = 0;
+  unsigned long failures = 0; // requests the sensor did not answer
+  uint16_t timeout = 0;       // in ms
+
+  // removes the sensor data and the bus settings
+  void reset()
+  {
+    present = true;
+    light = nullptr;
+    commands.clear();
+    requests = 0;
+    failures = 0;
+    timeout = 0;
+    _measuring = false;
+  }
+
+  bool begin(int = -1, int = -1, uint32_t = 0)
+  {
+    return (true);
+  }
+
+  void setTimeOut(uint16_t ms)
+  {
+    timeout = ms;
+  }
+
+  void beginTransmission(uint8_t address)
+  {
+    _address = address;
+    _sent.clear();
+  }
+
+  size_t write(uint8_t data)
+  {
+    NativeHardware hardware;
+    _sent.push_back(data);
+    return (1);
+  }
+
+  // returns 2 if the address is not acknowledged
+  uint8_t endTransmission(bool = true)
+  {
+    NativeHardware hardware;
+    if (!isSensor(_address))
+    {
+      return (2);
+    }
+    for (uint8_t command : _sent)
+    {
+      commands.push_back(command);
+      if (command == 0x10)
+      {
+        // the first measurement takes its time
+        _measuring = true;
+        _measureStart = millis();
+      }
+    }
+    return (0);
+  }
+
+  // reads the two bytes of the last measurement, high byte first
+  uint8_t requestFrom(uint8_t address, uint8_t length)
+  {
+    NativeHardware hardware;
+    requests++;
+    _received.clear();
+    if (!isSensor(address))
+    {
+      failures++;
+      return (0);
+    }
+    uint16_t raw = 0;
+    if (_measuring && (millis() - _measureStart >= NATIVE_BH1750_MEASUREMENT_TIME) && light)
+    {
+      raw = (uint16_t)constrain(light() * 1.2 + 0.5, 0.0, 65535.0);
+    }
+    _received.push_back(raw >> 8);
+    _received.push_back(raw & 0xff);
+    _received.resize(min((size_t)length, _received.size()));
+    return ((uint8_t)_received.size());
+  }
+
+  int available()
+  {
+    return ((int)_received.size());
+  }
+
+  int read()
+  {
+    if (_received.empty())
+    {
+      return (-1);
+    }
+    uint8_t data = _received.front();
+    _received.erase(_received.begin());
+    return (data);
+  }
+
+private:
+  uint8_t _address = 0;
+  std::vector<uint8_t> _sent;
+  std::vector<uint8_t> _received;
+  bool _measuring = false;
+  unsigned long _measureStart = 0;
+
+  bool isSensor(uint8_t address) const
+  {
+    return (present && (address == NATIVE_BH1750_ADDRESS));
+  }
+};
+
+inline TwoWire Wire;
@@ -0,0 +1,54 @@
+// gpio.h
+
+// host double of the ESP-IDF GPIO driver, the interrupt types change the modes of the interrupts
+// attached by the Arduino double, pins enabled for the wakeup from light sleep are kept
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_err.h>
+
+typedef int gpio_num_t;
+
+// same values as the Arduino interrupt modes
+typedef enum
+{
+  GPIO_INTR_DISABLE = 0,
+  GPIO_INTR_POSEDGE = RISING,
+  GPIO_INTR_NEGEDGE = FALLING,
+  GPIO_INTR_ANYEDGE = CHANGE,
+  GPIO_INTR_LOW_LEVEL = ONLOW,
+  GPIO_INTR_HIGH_LEVEL = ONHIGH
+} gpio_int_type_t;
+
+namespace Native
+{
+  // pins waking up the CPU from light sleep
+  inline bool wakeupPins[NATIVE_PIN_COUNT] = {false};
+}
+
+inline esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type)
+{
+  Native::interruptModes[pin % NATIVE_PIN_COUNT] = (uint8_t)type;
+  return (ESP_OK);
+}
+
+// only level interrupts can wake up the CPU, the interrupt of the pin becomes a level interrupt
+inline esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t type)
+{
+  if ((type != GPIO_INTR_LOW_LEVEL) && (type != GPIO_INTR_HIGH_LEVEL))
+  {
+    return (ESP_ERR_INVALID_ARG);
+  }
+  Native::wakeupPins[pin % NATIVE_PIN_COUNT] = true;
+  return (gpio_set_intr_type(pin, type));
+}
+
+inline esp_err_t gpio_wakeup_disable(gpio_num_t pin)
+{
+  Native::wakeupPins[pin % NATIVE_PIN_COUNT] = false;
+  return (ESP_OK);
+}
@@ -0,0 +1,163 @@
+// rmt.h
+
+// host double of the ESP-IDF RMT driver sending WS2812 frames, a frame takes 10 us per byte,
+// the end of transmission callback is called by a timer in simulated time, the last frame is kept
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include <vector>
+
+#define NATIVE_RMT_BYTE_TIME 10 // in us, 8 bits of 1.25 us
+
+typedef enum
+{
+  RMT_CHANNEL_0,
+  RMT_CHANNEL_1,
+  RMT_CHANNEL_MAX
+} rmt_channel_t;
+
+typedef enum
+{
+  RMT_MODE_TX,
+  RMT_MODE_RX
+} rmt_mode_t;
+
+typedef struct
+{
+  union
+  {
+    struct
+    {
+      uint32_t duration0 : 15;
+      uint32_t level0 : 1;
+      uint32_t duration1 : 15;
+      uint32_t level1 : 1;
+    };
+    uint32_t val;
+  };
+} rmt_item32_t;
+
+typedef struct
+{
+  rmt_mode_t rmt_mode;
+  rmt_channel_t channel;
+  gpio_num_t gpio_num;
+  uint8_t clk_div;
+  uint8_t mem_block_num;
+  uint32_t flags;
+  struct
+  {
+    bool loop_en;
+    bool carrier_en;
+    bool idle_output_en;
+    int idle_level;
+  } tx_config;
+} rmt_config_t;
+
+#define RMT_DEFAULT_CONFIG_TX(gpio, channel_id) {RMT_MODE_TX, channel_id, gpio, 80, 1, 0, {false, false, true, 0}}
+
+typedef void (*sample_to_rmt_t)(const void *src, rmt_item32_t *dest, size_t src_size, size_t wanted_num,
+                                size_t *translated_size, size_t *item_num);
+typedef void (*rmt_tx_end_fn_t)(rmt_channel_t channel, void *arg);
+
+typedef struct
+{
+  rmt_tx_end_fn_t function;
+  void *arg;
+} rmt_tx_end_callback_t;
+
+// channel of the double
+struct NativeRmtChannel
+{
+  bool installed;
+  esp_timer_handle_t timer; // ends the transmission
+  std::vector<uint8_t> frame;
+  unsigned long frames;
+};
+
+namespace Native
+{
+  inline NativeRmtChannel rmtChannels[RMT_CHANNEL_MAX];
+  inline rmt_tx_end_callback_t rmtCallback = {nullptr, nullptr};
+
+  inline void onRmtTransmitted(void *arg)
+  {
+    if (rmtCallback.function != nullptr)
+    {
+      rmtCallback.function((rmt_channel_t)(intptr_t)arg, rmtCallback.arg);
+    }
+  }
+}
+
+inline esp_err_t rmt_config(const rmt_config_t *config)
+{
+  return ((config->channel < RMT_CHANNEL_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG);
+}
+
+inline esp_err_t rmt_driver_install(rmt_channel_t channel, size_t, int)
+{
+  NativeRmtChannel &rmt = Native::rmtChannels[channel];
+  if (rmt.installed)
+  {
+    return (ESP_ERR_INVALID_STATE);
+  }
+  esp_timer_create_args_t args = {&Native::onRmtTransmitted, (void *)(intptr_t)channel, ESP_TIMER_TASK, "rmt", false};
+  esp_timer_create(&args, &rmt.timer);
+  rmt.installed = true;
+  rmt.frames = 0;
+  rmt.frame.clear();
+  return (ESP_OK);
+}
+
+inline esp_err_t rmt_driver_uninstall(rmt_channel_t channel)
+{
+  NativeRmtChannel &rmt = Native::rmtChannels[channel];
+  if (!rmt.installed)
+  {
+    return (ESP_ERR_INVALID_STATE);
+  }
+  esp_timer_stop(rmt.timer);
+  esp_timer_delete(rmt.timer);
+  rmt.installed = false;
+  return (ESP_OK);
+}
+
+inline esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t)
+{
+  return (Native::rmtChannels[channel].installed ? ESP_OK : ESP_ERR_INVALID_STATE);
+}
+
+inline rmt_tx_end_callback_t rmt_register_tx_end_callback(rmt_tx_end_fn_t function, void *arg)
+{
+  rmt_tx_end_callback_t previous = Native::rmtCallback;
+  Native::rmtCallback = {function, arg};
+  return (previous);
+}
+
+// returns ESP_ERR_TIMEOUT while a frame is sent, waits only with a wait time of 0
+inline esp_err_t rmt_wait_tx_done(rmt_channel_t channel, uint32_t)
+{
+  NativeRmtChannel &rmt = Native::rmtChannels[channel];
+  return ((rmt.installed && esp_timer_is_active(rmt.timer)) ? ESP_ERR_TIMEOUT : ESP_OK);
+}
+
+inline esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *sample, size_t size, bool)
+{
+  NativeRmtChannel &rmt = Native::rmtChannels[channel];
+  if (!rmt.installed || esp_timer_is_active(rmt.timer))
+  {
+    return (ESP_ERR_INVALID_STATE);
+  }
+  // the samples are copied to the memory of the peripheral
+  NativeHardware hardware;
+  rmt.frame.assign(sample, sample + size);
+  rmt.frames++;
+  return (esp_timer_start_once(rmt.timer, size * NATIVE_RMT_BYTE_TIME));
+}
@@ -0,0 +1,133 @@
+// esp_heap_caps.h
+
+// host double of the ESP-IDF heap, a test which replaces operator new takes the memory of the firmware
+// from the simulated heap, the blocks are taken first fit and merged when released like by the ESP-IDF
+// allocator, so the free heap, its minimum and the largest block show the fragmentation,
+// without such a test the heap stays free
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+#define NATIVE_HEAP_SIZE (160 * 1024) // in bytes, about the free heap of the Arduino core after boot
+#define NATIVE_HEAP_ALIGNMENT 16      // in bytes, also the size of a block header
+
+namespace Native
+{
+  // header in front of each block, the size includes the header
+  struct NativeHeapBlock
+  {
+    size_t size;
+    bool used;
+  };
+
+  alignas(NATIVE_HEAP_ALIGNMENT) inline uint8_t heapMemory[NATIVE_HEAP_SIZE];
+  inline size_t heapFree = NATIVE_HEAP_SIZE;
+  inline size_t heapMinFree = NATIVE_HEAP_SIZE;
+
+  inline NativeHeapBlock *getHeapBlock(size_t offset)
+  {
+    return ((NativeHeapBlock *)(heapMemory + offset));
+  }
+
+  // one free block over the whole heap
+  inline void resetHeap()
+  {
+    getHeapBlock(0)->size = NATIVE_HEAP_SIZE;
+    getHeapBlock(0)->used = false;
+    heapFree = NATIVE_HEAP_SIZE;
+    heapMinFree = NATIVE_HEAP_SIZE;
+  }
+
+  // returns if the memory has been taken from the simulated heap
+  inline bool isHeapMemory(const void *ptr)
+  {
+    return ((ptr >= heapMemory) && (ptr < heapMemory + NATIVE_HEAP_SIZE));
+  }
+
+  // takes the first free block large enough, nullptr if there is none
+  inline void *allocateHeap(size_t size)
+  {
+    if (getHeapBlock(0)->size == 0)
+    {
+      resetHeap();
+    }
+    size_t needed = NATIVE_HEAP_ALIGNMENT + (size + NATIVE_HEAP_ALIGNMENT - 1) / NATIVE_HEAP_ALIGNMENT * NATIVE_HEAP_ALIGNMENT;
+    for (size_t offset = 0; offset < NATIVE_HEAP_SIZE; offset += getHeapBlock(offset)->size)
+    {
+      NativeHeapBlock *block = getHeapBlock(offset);
+      if (!block->used && (block->size >= needed))
+      {
+        // the rest becomes a free block if it can hold data
+        if (block->size - needed > NATIVE_HEAP_ALIGNMENT)
+        {
+          getHeapBlock(offset + needed)->size = block->size - needed;
+          getHeapBlock(offset + needed)->used = false;
+          block->size = needed;
+        }
+        block->used = true;
+        heapFree -= block->size;
+        heapMinFree = (heapFree < heapMinFree) ? heapFree : heapMinFree;
+        return (heapMemory + offset + NATIVE_HEAP_ALIGNMENT);
+      }
+    }
+    return (nullptr);
+  }
+
+  // frees the block and merges the free blocks next to each other
+  inline void releaseHeap(void *ptr)
+  {
+    NativeHeapBlock *released = (NativeHeapBlock *)((uint8_t *)ptr - NATIVE_HEAP_ALIGNMENT);
+    released->used = false;
+    heapFree += released->size;
+    for (size_t offset = 0; offset < NATIVE_HEAP_SIZE; offset += getHeapBlock(offset)->size)
+    {
+      NativeHeapBlock *block = getHeapBlock(offset);
+      while (!block->used && (offset + block->size < NATIVE_HEAP_SIZE) && !getHeapBlock(offset + block->size)->used)
+      {
+        block->size += getHeapBlock(offset + block->size)->size;
+      }
+    }
+  }
+
+  // returns the largest free block without its header
+  inline size_t getLargestHeapBlock()
+  {
+    size_t largest = 0;
+    if (getHeapBlock(0)->size == 0)
+    {
+      resetHeap();
+    }
+    for (size_t offset = 0; offset < NATIVE_HEAP_SIZE; offset += getHeapBlock(offset)->size)
+    {
+      NativeHeapBlock *block = getHeapBlock(offset);
+      if (!block->used && (block->size > largest))
+      {
+        largest = block->size;
+      }
+    }
+    return ((largest > NATIVE_HEAP_ALIGNMENT) ? largest - NATIVE_HEAP_ALIGNMENT : 0);
+  }
+}
+
+inline size_t heap_caps_get_free_size(uint32_t)
+{
+  return (Native::heapFree);
+}
+
+inline size_t heap_caps_get_minimum_free_size(uint32_t)
+{
+  return (Native::heapMinFree);
+}
+
+inline size_t heap_caps_get_largest_free_block(uint32_t)
+{
+  return (Native::getLargestHeapBlock());
+}
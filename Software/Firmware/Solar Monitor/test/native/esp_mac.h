@@ -0,0 +1,31 @@
+// esp_mac.h
+
+// host double of the ESP-IDF MAC addresses, all interfaces share a fixed address set by the test
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <esp_err.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum
+{
+  ESP_MAC_WIFI_STA,
+  ESP_MAC_WIFI_SOFTAP,
+  ESP_MAC_BT,
+  ESP_MAC_ETH
+} esp_mac_type_t;
+
+namespace Native
+{
+  inline uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x12, 0x34, 0x57};
+}
+
+inline esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t)
+{
+  memcpy(mac, Native::mac, sizeof(Native::mac));
+  return (ESP_OK);
+}
@@ -0,0 +1,54 @@
+// esp_pm.h
+
+// host double of the ESP-IDF power management, CONFIG_PM_ENABLE is not set on the host,
+// the locks only count their holders
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <esp_err.h>
+
+typedef enum
+{
+  ESP_PM_CPU_FREQ_MAX,
+  ESP_PM_APB_FREQ_MAX,
+  ESP_PM_NO_LIGHT_SLEEP
+} esp_pm_lock_type_t;
+
+typedef struct
+{
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+} esp_pm_config_esp32_t;
+
+typedef int *esp_pm_lock_handle_t;
+
+inline esp_err_t esp_pm_configure(const void *)
+{
+  return (ESP_ERR_NOT_SUPPORTED);
+}
+
+inline esp_err_t esp_pm_lock_create(esp_pm_lock_type_t, int, const char *, esp_pm_lock_handle_t *handle)
+{
+  *handle = new int(0);
+  return (ESP_OK);
+}
+
+inline esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+  (*handle)++;
+  return (ESP_OK);
+}
+
+inline esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+  if (*handle == 0)
+  {
+    return (ESP_ERR_INVALID_STATE);
+  }
+  (*handle)--;
+  return (ESP_OK);
+}
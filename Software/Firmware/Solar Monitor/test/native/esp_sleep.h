@@ -0,0 +1,15 @@
+// esp_sleep.h
+
+// host double of the ESP-IDF sleep modes, the host never sleeps
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <esp_err.h>
+
+inline esp_err_t esp_sleep_enable_gpio_wakeup()
+{
+  return (ESP_OK);
+}
@@ -0,0 +1,172 @@
+// esp_timer.h
+
+// host double of the ESP-IDF high resolution timer, returns the simulated time, started timers
+// fire in the order of their deadlines while the simulated time advances
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_err.h>
+#include <vector>
+
+typedef struct NativeTimer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum
+{
+  ESP_TIMER_TASK
+} esp_timer_dispatch_t;
+
+typedef struct
+{
+  esp_timer_cb_t callback;
+  void *arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct NativeTimer
+{
+  esp_timer_cb_t callback;
+  void *arg;
+  uint64_t period; // in us, 0 for a one-shot timer
+  uint64_t due;    // in us of the simulated time
+  bool active;
+  unsigned long fired;
+};
+
+namespace Native
+{
+  // returns the created timers
+  inline std::vector<NativeTimer *> &getTimers()
+  {
+    static std::vector<NativeTimer *> timers;
+    return (timers);
+  }
+
+  // returns the deadline of the next timer in us, UINT64_MAX if no timer is active
+  inline uint64_t getNextDeadline()
+  {
+    uint64_t deadline = UINT64_MAX;
+    for (NativeTimer *timer : getTimers())
+    {
+      if (timer->active)
+      {
+        deadline = min(deadline, timer->due);
+      }
+    }
+    return (deadline);
+  }
+
+  // fires the timers due until the given time, the simulated time is set to each deadline
+  // before the callback, a callback may start, stop or delete timers
+  inline void runTimers(uint64_t until)
+  {
+    while (true)
+    {
+      NativeTimer *next = nullptr;
+      for (NativeTimer *timer : getTimers())
+      {
+        if (timer->active && (timer->due <= until) && ((next == nullptr) || (timer->due < next->due)))
+        {
+          next = timer;
+        }
+      }
+      if (next == nullptr)
+      {
+        break;
+      }
+      now = max(now, next->due);
+      if (next->period > 0)
+      {
+        next->due += next->period;
+      }
+      else
+      {
+        next->active = false;
+      }
+      next->fired++;
+      next->callback(next->arg);
+    }
+  }
+
+  // stops all timers, the timers of objects of a previous test stay allocated
+  inline void clearTimers()
+  {
+    for (NativeTimer *timer : getTimers())
+    {
+      timer->active = false;
+    }
+  }
+}
+
+inline int64_t esp_timer_get_time()
+{
+  return ((int64_t)Native::now);
+}
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *timer)
+{
+  if ((args == nullptr) || (args->callback == nullptr) || (timer == nullptr))
+  {
+    return (ESP_ERR_INVALID_ARG);
+  }
+  *timer = new NativeTimer{args->callback, args->arg, 0, 0, false, 0};
+  Native::getTimers().push_back(*timer);
+  return (ESP_OK);
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout)
+{
+  if (timer->active)
+  {
+    return (ESP_ERR_INVALID_STATE);
+  }
+  timer->period = 0;
+  timer->due = Native::now + timeout;
+  timer->active = true;
+  return (ESP_OK);
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+  if (timer->active)
+  {
+    return (ESP_ERR_INVALID_STATE);
+  }
+  timer->period = max(period, (uint64_t)1);
+  timer->due = Native::now + timer->period;
+  timer->active = true;
+  return (ESP_OK);
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+  if (!timer->active)
+  {
+    return (ESP_ERR_INVALID_STATE);
+  }
+  timer->active = false;
+  return (ESP_OK);
+}
+
+inline esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+  std::vector<NativeTimer *> &timers = Native::getTimers();
+  if (timer->active)
+  {
+    return (ESP_ERR_INVALID_STATE);
+  }
+  timers.erase(std::remove(timers.begin(), timers.end(), timer), timers.end());
+  delete timer;
+  return (ESP_OK);
+}
+
+inline bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+  return (timer->active);
+}
@@ -0,0 +1,53 @@
+// FreeRTOS.h
+
+// host double of the FreeRTOS types used by the firmware, the tests run in one thread,
+// critical sections do nothing
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(...)
+
+typedef struct
+{
+  uint32_t owner;
+  uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0, 0}
+
+inline void portENTER_CRITICAL(portMUX_TYPE *)
+{
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE *)
+{
+}
+
+inline void portENTER_CRITICAL_ISR(portMUX_TYPE *)
+{
+}
+
+inline void portEXIT_CRITICAL_ISR(portMUX_TYPE *)
+{
+}
+
+inline BaseType_t xPortInIsrContext()
+{
+  return (pdFALSE);
+}
@@ -0,0 +1,83 @@
+// queue.h
+
+// host double of the FreeRTOS queues, the storage is taken at creation and the items are copied like on
+// the target, a receive on an empty queue blocks a task or runs the simulation of the test until an item
+// arrives or the time is up
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <vector>
+
+struct NativeQueue
+{
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  std::vector<uint8_t> storage;
+  UBaseType_t first; // index of the oldest item
+  UBaseType_t count;
+};
+
+typedef NativeQueue *QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+  return (new NativeQueue{length, itemSize, std::vector<uint8_t>(length * itemSize), 0, 0});
+}
+
+inline void vQueueDelete(QueueHandle_t queue)
+{
+  delete queue;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+  if (!Native::wait([queue]()
+                    { return (queue->count < queue->length); }, Native::getWaitTime(ticks)))
+  {
+    return (pdFALSE);
+  }
+  UBaseType_t index = (queue->first + queue->count) % queue->length;
+  memcpy(queue->storage.data() + index * queue->itemSize, item, queue->itemSize);
+  queue->count++;
+  return (pdTRUE);
+}
+
+inline BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken)
+{
+  if (woken != nullptr)
+  {
+    *woken = pdFALSE;
+  }
+  return (xQueueSend(queue, item, 0));
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+  if (!Native::wait([queue]()
+                    { return (queue->count > 0); }, Native::getWaitTime(ticks)))
+  {
+    return (pdFALSE);
+  }
+  memcpy(item, queue->storage.data() + queue->first * queue->itemSize, queue->itemSize);
+  queue->first = (queue->first + 1) % queue->length;
+  queue->count--;
+  return (pdTRUE);
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+  return (queue->count);
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t queue)
+{
+  queue->first = 0;
+  queue->count = 0;
+  return (pdPASS);
+}
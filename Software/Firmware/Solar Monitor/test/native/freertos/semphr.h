@@ -0,0 +1,65 @@
+// semphr.h
+
+// host double of the FreeRTOS semaphores, a take on an empty semaphore blocks a task or runs the
+// simulation of the test until it is given or the time is up, mutexes have no priority inheritance
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+struct NativeSemaphore
+{
+  UBaseType_t count;
+  UBaseType_t maxCount;
+};
+
+typedef NativeSemaphore *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+  return (new NativeSemaphore{1, 1});
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+  return (new NativeSemaphore{0, 1});
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+  if (!Native::wait([semaphore]()
+                    { return (semaphore->count > 0); }, Native::getWaitTime(ticks)))
+  {
+    return (pdFALSE);
+  }
+  semaphore->count--;
+  return (pdTRUE);
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+  if (semaphore->count >= semaphore->maxCount)
+  {
+    return (pdFALSE);
+  }
+  semaphore->count++;
+  return (pdTRUE);
+}
+
+inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *woken)
+{
+  if (woken != nullptr)
+  {
+    *woken = pdFALSE;
+  }
+  return (xSemaphoreGive(semaphore));
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+  delete semaphore;
+}
@@ -0,0 +1,286 @@
+// task.h
+
+// host double of the FreeRTOS tasks, each task runs in a thread but only one thread runs at a time,
+// the test or a task, a task runs until it blocks, blocked tasks resume in simulated time when
+// their condition holds or their timeout has passed, a delay of the test runs the tasks and timers due
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define NATIVE_WAIT_FOREVER UINT64_MAX
+
+struct NativeTask
+{
+  void (*function)(void *arg);
+  void *arg;
+  UBaseType_t priority;
+  std::function<bool()> condition; // the task waits for, empty if it only waits for the time
+  uint64_t wake;                   // in us, when the wait times out
+  uint32_t notifications;
+  bool started;
+  bool deleted;
+  unsigned long runs;              // times the task has been resumed
+};
+
+typedef NativeTask *TaskHandle_t;
+typedef uint32_t StackType_t;
+
+typedef struct
+{
+  uint8_t reserved[4];
+} StaticTask_t;
+
+namespace Native
+{
+  // never destroyed, the threads of the tasks still wait when the test ends
+  inline std::mutex &getTaskLock()
+  {
+    static std::mutex *lock = new std::mutex();
+    return (*lock);
+  }
+
+  inline std::condition_variable &getTaskSignal()
+  {
+    static std::condition_variable *signal = new std::condition_variable();
+    return (*signal);
+  }
+
+  inline std::vector<NativeTask *> &getTasks()
+  {
+    static std::vector<NativeTask *> *tasks = new std::vector<NativeTask *>();
+    return (*tasks);
+  }
+
+  // the task running now, nullptr while the test runs
+  inline NativeTask *runningTask = nullptr;
+
+  // the task of the calling thread, nullptr for the test
+  inline NativeTask *&currentTask()
+  {
+    static thread_local NativeTask *task = nullptr;
+    return (task);
+  }
+
+  // returns if a task can run now
+  inline bool isReady(NativeTask *task)
+  {
+    return (!task->deleted &&
+            (!task->started || (task->wake <= now) || (task->condition && task->condition())));
+  }
+
+  // runs a task until it blocks, called by the test
+  inline void resume(NativeTask *task)
+  {
+    std::unique_lock<std::mutex> lock(getTaskLock());
+    task->runs++;
+    runningTask = task;
+    getTaskSignal().notify_all();
+    getTaskSignal().wait(lock, []()
+                         { return (runningTask == nullptr); });
+  }
+
+  // blocks the calling task until the condition holds or the time is up, returns the condition
+  inline bool block(std::function<bool()> condition, uint64_t wake)
+  {
+    NativeTask *task = currentTask();
+    {
+      std::unique_lock<std::mutex> lock(getTaskLock());
+      task->condition = condition;
+      task->wake = wake;
+      runningTask = nullptr;
+      getTaskSignal().notify_all();
+      getTaskSignal().wait(lock, [task]()
+                           { return (runningTask == task); });
+      task->condition = nullptr;
+    }
+    return (!condition || condition());
+  }
+
+  // runs the tasks and timers due until the given time or until the condition holds,
+  // the ready task of the highest priority runs first, then the time advances to the next deadline,
+  // returns the condition
+  inline bool runUntil(uint64_t until, std::function<bool()> condition)
+  {
+    while (!(condition && condition()))
+    {
+      NativeTask *next = nullptr;
+      uint64_t deadline = getNextDeadline();
+      for (NativeTask *task : getTasks())
+      {
+        if (isReady(task) && ((next == nullptr) || (task->priority > next->priority)))
+        {
+          next = task;
+        }
+        if (!task->deleted && task->started)
+        {
+          deadline = min(deadline, task->wake);
+        }
+      }
+      if (next != nullptr)
+      {
+        resume(next);
+        continue;
+      }
+      if ((deadline > until) || (deadline == NATIVE_WAIT_FOREVER))
+      {
+        break;
+      }
+      now = max(now, deadline);
+      runTimers(now);
+    }
+    if (condition && condition())
+    {
+      return (true);
+    }
+    // nothing would ever happen in a wait forever
+    if (until != NATIVE_WAIT_FOREVER)
+    {
+      now = max(now, until);
+    }
+    return (!condition);
+  }
+
+  // waits for the condition at most the given time in us, the test runs the simulation meanwhile
+  inline bool wait(std::function<bool()> condition, uint64_t timeout)
+  {
+    if (condition())
+    {
+      return (true);
+    }
+    if (timeout == 0)
+    {
+      return (false);
+    }
+    uint64_t until = (timeout == NATIVE_WAIT_FOREVER) ? NATIVE_WAIT_FOREVER : now + timeout;
+    if (currentTask() != nullptr)
+    {
+      return (block(condition, until));
+    }
+    return (runUntil(until, condition));
+  }
+
+  // lets the time pass, a task blocks, the test runs the simulation
+  inline void sleep(uint64_t us)
+  {
+    if (currentTask() != nullptr)
+    {
+      block(nullptr, now + us);
+    }
+    else
+    {
+      runUntil(now + us);
+    }
+  }
+
+  // returns the wait time of a timeout in ticks
+  inline uint64_t getWaitTime(TickType_t ticks)
+  {
+    return ((ticks == portMAX_DELAY) ? NATIVE_WAIT_FOREVER : (uint64_t)ticks * portTICK_PERIOD_MS * 1000);
+  }
+
+  // stops all tasks, their threads wait forever
+  inline void clearTasks()
+  {
+    for (NativeTask *task : getTasks())
+    {
+      task->deleted = true;
+    }
+    getTasks().clear();
+  }
+
+  // thread of a task, waits for its first run
+  inline void runTask(NativeTask *task)
+  {
+    currentTask() = task;
+    {
+      std::unique_lock<std::mutex> lock(getTaskLock());
+      getTaskSignal().wait(lock, [task]()
+                           { return (runningTask == task); });
+      task->started = true;
+    }
+    task->function(task->arg);
+    // a task must not return, it is deleted
+    task->deleted = true;
+    block(nullptr, NATIVE_WAIT_FOREVER);
+  }
+}
+
+// the task starts with the next delay of the test
+inline BaseType_t xTaskCreatePinnedToCore(void (*function)(void *), const char *, uint32_t, void *arg,
+                                          UBaseType_t priority, TaskHandle_t *handle, BaseType_t)
+{
+  NativeTask *task = new NativeTask{function, arg, priority, nullptr, 0, 0, false, false, 0};
+  Native::getTasks().push_back(task);
+  std::thread(Native::runTask, task).detach();
+  if (handle != nullptr)
+  {
+    *handle = task;
+  }
+  return (pdPASS);
+}
+
+inline TaskHandle_t xTaskCreateStaticPinnedToCore(void (*function)(void *), const char *name, uint32_t stack, void *arg,
+                                                  UBaseType_t priority, StackType_t *, StaticTask_t *, BaseType_t core)
+{
+  TaskHandle_t task = nullptr;
+  xTaskCreatePinnedToCore(function, name, stack, arg, priority, &task, core);
+  return (task);
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+  Native::sleep(Native::getWaitTime(ticks));
+}
+
+inline TickType_t xTaskGetTickCount()
+{
+  return ((TickType_t)(millis() / portTICK_PERIOD_MS));
+}
+
+// a task deleting itself never returns
+inline void vTaskDelete(TaskHandle_t task)
+{
+  if (task == nullptr)
+  {
+    task = Native::currentTask();
+  }
+  if (task != nullptr)
+  {
+    task->deleted = true;
+    std::vector<NativeTask *> &tasks = Native::getTasks();
+    tasks.erase(std::remove(tasks.begin(), tasks.end(), task), tasks.end());
+    if (task == Native::currentTask())
+    {
+      Native::block(nullptr, NATIVE_WAIT_FOREVER);
+    }
+  }
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+  task->notifications++;
+  return (pdPASS);
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+  NativeTask *task = Native::currentTask();
+  if ((task == nullptr) || !Native::wait([task]()
+                                         { return (task->notifications > 0); }, Native::getWaitTime(ticks)))
+  {
+    return (0);
+  }
+  uint32_t value = task->notifications;
+  task->notifications = clear ? 0 : value - 1;
+  return (value);
+}
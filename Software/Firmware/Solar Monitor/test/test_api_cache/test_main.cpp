@@ -0,0 +1,134 @@
+// test_main.cpp
+
+// tests of the inverter API served to other clients, the network task runs in simulated time against
+// the inverter on the ethernet double, clients arriving faster than the polling interval are served from
+// the cached response with at most one inverter request per interval, a follower sends them to the leader
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Network.hpp>
+#include <NativeInverter.h>
+
+#define PIN_CS 5                                             // chip select of the ethernet port
+#define POLLING_INTERVAL (INVERTER_POLLINGINTERVAL * 1000UL) // in ms
+#define CLIENT_INTERVAL 250                                  // in ms, between two clients
+#define INTERVALS 6                                          // polling intervals of clients
+#define API_REQUEST "GET " API_CACHE_PATH " HTTP/1.1\r\nHost: solar-monitor\r\n\r\n"
+
+static const INVERTER_VALUES inverterValues = {80.0, -1200.0, 0.0, 1800.0, 3000.0, 100.0, 60.0};
+static Network *network;
+static std::vector<unsigned long> requests; // times the inverter has been asked, in ms
+
+static INVERTER_VALUES getValues()
+{
+  requests.push_back(millis());
+  return (inverterValues);
+}
+
+// returns the body of a response
+static std::string getBody(const std::string &response)
+{
+  size_t start = response.find("\r\n\r\n");
+  return ((start == std::string::npos) ? std::string() : response.substr(start + 4));
+}
+
+void setUp()
+{
+  char settings[] = "inverter.address=" NATIVE_INVERTER_ADDRESS;
+
+  Native::reset();
+  Ethernet.reset();
+  Preferences::getStore().clear();
+  Config::get().begin();
+  Config::get().update(settings);
+  Config::get().apply();
+  Native::addInverter(getValues);
+  requests.clear();
+  network = new Network(PIN_CS);
+  network->begin(nullptr, nullptr);
+  while (network->getState() == network_state::initializing)
+  {
+    delay(10);
+  }
+  TEST_ASSERT_TRUE(network->getState() == network_state::ready);
+}
+
+void tearDown()
+{
+  delete network;
+}
+
+// a client every 250 ms, the first client of an interval causes the only request to the inverter,
+// the others get the cached response unchanged
+void test_coalescing()
+{
+  std::vector<std::shared_ptr<NativeConnection>> clients;
+  char message[96];
+
+  unsigned long start = millis();
+  while (millis() - start < INTERVALS * POLLING_INTERVAL)
+  {
+    clients.push_back(Ethernet.open(HTTP_PORT, API_REQUEST));
+    delay(CLIENT_INTERVAL);
+  }
+  delay(NETWORK_CLIENT_TIMEOUT);
+
+  std::string body = getBody(Native::getInverterResponse(inverterValues));
+  for (std::shared_ptr<NativeConnection> &client : clients)
+  {
+    TEST_ASSERT_TRUE(client->closed);
+    TEST_ASSERT_EQUAL(0, client->response.find("HTTP/1.1 200 OK\r\n"));
+    TEST_ASSERT_EQUAL_STRING(body.c_str(), getBody(client->response).c_str());
+  }
+  for (size_t i = 1; i < requests.size(); i++)
+  {
+    TEST_ASSERT_TRUE(requests[i] - requests[i - 1] >= POLLING_INTERVAL);
+  }
+  TEST_ASSERT_TRUE(requests.size() <= INTERVALS);
+  TEST_ASSERT_TRUE(requests.size() >= INTERVALS - 1);
+  snprintf(message, sizeof(message), "%u clients in %lu s, %u inverter requests",
+           (unsigned int)clients.size(), INTERVALS * POLLING_INTERVAL / 1000, (unsigned int)requests.size());
+  TEST_MESSAGE(message);
+}
+
+// without a response yet the client gets none
+void test_no_response()
+{
+  ApiCache cache;
+  std::shared_ptr<NativeConnection> connection = std::make_shared<NativeConnection>();
+  EthernetClient client(connection);
+
+  TEST_ASSERT_FALSE(cache.send(client, false));
+  TEST_ASSERT_EQUAL(0, connection->response.size());
+}
+
+// a follower sends the client to the same target on the leader
+void test_redirect()
+{
+  ApiCache cache;
+  std::shared_ptr<NativeConnection> connection = std::make_shared<NativeConnection>();
+  EthernetClient client(connection);
+
+  cache.redirect(client, IPAddress(192, 168, 1, 7), API_CACHE_PATH "?Scope=System");
+  TEST_ASSERT_EQUAL_STRING("HTTP/1.1 307 Temporary Redirect\r\n"
+                           "Location: http://192.168.1.7" API_CACHE_PATH "?Scope=System\r\n"
+                           "Content-Length: 0\r\n"
+                           "Connection: close\r\n\r\n",
+                           connection->response.c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, cache.getRedirects());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_coalescing);
+  RUN_TEST(test_no_response);
+  RUN_TEST(test_redirect);
+  return (UNITY_END());
+}
@@ -0,0 +1,111 @@
+// test_main.cpp
+
+// tests of the backlight colors, the plain rating colors and the precomputed gradient, the gradient
+// shows the configured colors at the centers of the ratings and blends them in linear light in between
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <Backlight.hpp>
+
+#define GAMMA 2.2
+
+#define RGB(red, green, blue) (((red) << 16) | ((green) << 8) | (blue))
+#define CHANNEL(color, shift) (((color) >> (shift)) & 255)
+
+// the colors of Settings.h
+#define POOR RGB(255, 0, 0)
+#define FAIR RGB(255, 100, 0)
+#define GOOD RGB(0, 255, 0)
+#define EXCELLENT RGB(0, 153, 153)
+
+// centers of the ratings fall on entries of the table
+#define FAIR_CENTER 21
+#define GOOD_CENTER 42
+#define EXCELLENT_MIN (BACKLIGHT_LUT_SIZE - 1)
+
+static Backlight *backlight;
+
+void setUp()
+{
+  backlight = new Backlight();
+  backlight->setRating(rating_step::poor, -1000, 0, POOR);
+  backlight->setRating(rating_step::fair, 1, 2 * FAIR_CENTER - 1, FAIR);
+  backlight->setRating(rating_step::good, 2 * FAIR_CENTER, 2 * GOOD_CENTER - 2 * FAIR_CENTER, GOOD);
+  backlight->setRating(rating_step::excellent, EXCELLENT_MIN, 1000, EXCELLENT);
+}
+
+void tearDown()
+{
+  delete backlight;
+}
+
+// each value range has its color, values are rounded
+void test_rating_colors()
+{
+  TEST_ASSERT_EQUAL_HEX32(POOR, backlight->getColor(-500));
+  TEST_ASSERT_EQUAL_HEX32(POOR, backlight->getColor(0.4));
+  TEST_ASSERT_EQUAL_HEX32(FAIR, backlight->getColor(0.6));
+  TEST_ASSERT_EQUAL_HEX32(GOOD, backlight->getColor(GOOD_CENTER));
+  TEST_ASSERT_EQUAL_HEX32(EXCELLENT, backlight->getColor(1000));
+  TEST_ASSERT_EQUAL_HEX32(0, backlight->getColor(2000));
+}
+
+// the configured colors are shown unchanged at the centers and beyond the outer ratings
+void test_gradient_stops()
+{
+  backlight->buildGradient(GAMMA);
+  TEST_ASSERT_EQUAL_HEX32(POOR, backlight->getGradientColor(-500));
+  TEST_ASSERT_EQUAL_HEX32(POOR, backlight->getGradientColor(0));
+  TEST_ASSERT_EQUAL_HEX32(FAIR, backlight->getGradientColor(FAIR_CENTER));
+  TEST_ASSERT_EQUAL_HEX32(GOOD, backlight->getGradientColor(GOOD_CENTER));
+  TEST_ASSERT_EQUAL_HEX32(EXCELLENT, backlight->getGradientColor(EXCELLENT_MIN));
+  TEST_ASSERT_EQUAL_HEX32(EXCELLENT, backlight->getGradientColor(1000));
+}
+
+// between two stops every channel moves from one color to the other without overshooting, blending in
+// linear light keeps the mixed colors brighter than mixing the encoded values
+void test_gradient_blend()
+{
+  static const int stops[] = {0, FAIR_CENTER, GOOD_CENTER, EXCELLENT_MIN};
+  static const int colors[] = {POOR, FAIR, GOOD, EXCELLENT};
+  Backlight plain;
+
+  plain = *backlight;
+  plain.buildGradient(1.0);
+  backlight->buildGradient(GAMMA);
+  for (int segment = 0; segment < 3; segment++)
+  {
+    for (int shift = 16; shift >= 0; shift -= 8)
+    {
+      int from = CHANNEL(colors[segment], shift);
+      int to = CHANNEL(colors[segment + 1], shift);
+      int last = from;
+      for (int value = stops[segment]; value <= stops[segment + 1]; value++)
+      {
+        int channel = CHANNEL(backlight->getGradientColor(value), shift);
+        int linear = CHANNEL(plain.getGradientColor(value), shift);
+        TEST_ASSERT_TRUE((to >= from) ? (channel >= last) : (channel <= last));
+        TEST_ASSERT_TRUE(channel >= linear);
+        last = channel;
+      }
+      TEST_ASSERT_EQUAL(to, last);
+    }
+  }
+
+  // halfway from red to orange the green channel is the mean in linear light
+  int green = CHANNEL(backlight->getGradientColor(FAIR_CENTER / 2.0), 8);
+  int expected = (int)round(pow(0.5 * pow(100 / 255.0, GAMMA), 1 / GAMMA) * 255);
+  TEST_ASSERT_INT_WITHIN(5, expected, green);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_rating_colors);
+  RUN_TEST(test_gradient_stops);
+  RUN_TEST(test_gradient_blend);
+  return (UNITY_END());
+}
@@ -0,0 +1,305 @@
+// test_main.cpp
+
+// boots the whole controller in simulated time against the NVS and ethernet doubles, the frames shifted
+// to the display chain are decoded by the virtual display, measures the time to the first frame with and
+// without stored values, covers the snapshot kept over resets and power losses and the reuse of the DHCP lease
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <string>
+#include <Controller.hpp>
+#include <VirtualDisplay.hpp>
+#include <NativeInverter.h>
+
+#define BATTERY_CHARGE_DISPLAY 4
+#define ROLL_TIME (TRANSITION_MAX_FRAMES * DIGIT_TRANSITION_STEPINTERVAL) // in ms, the digits roll to new values
+
+static Controller *controller;
+static VirtualDisplay *virtualDisplay;
+static INVERTER_VALUES inverterValues;
+static unsigned long firstRequest; // in ms since boot, when the inverter received the first request
+static bool addressShown;          // the IP address has been on the tubes
+
+static INVERTER_VALUES getValues(double batteryCharge)
+{
+  return (INVERTER_VALUES{batteryCharge, -1200.0, 0.0, 1800.0, 3000.0, 100.0, 60.0});
+}
+
+// returns the text of a display board
+static std::string getText(int displayNumber)
+{
+  char text[VIRTUAL_DISPLAY_BOARD_WIDTH];
+
+  virtualDisplay->renderFrame(displayNumber, text, sizeof(text));
+  return (text);
+}
+
+// decodes the pins like the shift registers
+static void onWrite(uint8_t pin, uint8_t level)
+{
+  if ((pin == PIN_SHIFT) && (level == SHIFT_COMMIT))
+  {
+    virtualDisplay->shiftBit(digitalRead(PIN_DATA));
+  }
+  else if (pin == PIN_STORE)
+  {
+    virtualDisplay->store(level);
+    if ((level == STORE_COMMIT) && (getText(0).find("192") != std::string::npos))
+    {
+      addressShown = true;
+    }
+  }
+}
+
+// powers the controller on at time 0, the NVS keeps its content
+static void boot()
+{
+  delete controller;
+  Native::reset();
+  Ethernet.services.clear();
+  Ethernet.pending.clear();
+  Ethernet.dhcpRequests = 0;
+  Native::addInverter([]()
+                      {
+                        if (firstRequest == NO_DEADLINE)
+                        {
+                          firstRequest = millis();
+                        }
+                        return (inverterValues); });
+  firstRequest = NO_DEADLINE;
+  addressShown = false;
+  delete virtualDisplay;
+  virtualDisplay = new VirtualDisplay(DISPLAY_COUNT);
+  virtualDisplay->blank(HIGH);
+  Native::onWrite = onWrite;
+  Native::setPin(PIN_BUTTON1, HIGH);
+  Native::setPin(PIN_PIR, HIGH);
+  controller = new Controller();
+  TEST_ASSERT_EQUAL(ERR_SUCCESS, controller->begin());
+}
+
+// runs the main loop until the condition holds after a pass, the frames are latched by the passes,
+// returns the time since boot in ms
+static unsigned long runUntil(std::function<bool()> condition, unsigned long limit)
+{
+  while (true)
+  {
+    TEST_ASSERT_TRUE(controller->process());
+    if (condition())
+    {
+      return (millis());
+    }
+    TEST_ASSERT_TRUE(millis() < limit);
+    controller->waitForEvent();
+  }
+}
+
+// runs the main loop until the battery charge display shows the text
+static unsigned long runUntilShown(const char *text, unsigned long limit)
+{
+  return (runUntil([text]()
+                   { return (getText(BATTERY_CHARGE_DISPLAY).find(text) != std::string::npos); }, limit));
+}
+
+// runs the main loop for the given time
+static void run(unsigned long duration)
+{
+  unsigned long end = millis() + duration;
+
+  while (millis() < end)
+  {
+    TEST_ASSERT_TRUE(controller->process());
+    controller->waitForEvent();
+  }
+}
+
+// the lease is reused from now on, the values are kept in NVS
+static void storeSnapshot()
+{
+  boot();
+  runUntilShown("80.0", 10000);
+  controller->saveSnapshot();
+}
+
+// a power loss clears the RTC memory
+static void powerLoss()
+{
+  memset(&rtcSnapshot, 0, sizeof(rtcSnapshot));
+}
+
+// prints the times of a boot
+static void report(const char *name, unsigned long firstFrame, unsigned long values)
+{
+  char message[128];
+
+  snprintf(message, sizeof(message), "%s: first frame after %lu ms, values after %lu ms, first request after %lu ms",
+           name, firstFrame, values, firstRequest);
+  TEST_MESSAGE(message);
+}
+
+void setUp()
+{
+  char settings[] = "inverter.address=" NATIVE_INVERTER_ADDRESS;
+
+  Native::reset();
+  Ethernet.reset();
+  Wire.reset();
+  Preferences::getStore().clear();
+  powerLoss();
+  Config::get().begin();
+  Config::get().update(settings);
+  Config::get().apply();
+  inverterValues = getValues(80.0);
+  controller = nullptr;
+  virtualDisplay = nullptr;
+}
+
+void tearDown()
+{
+  delete controller;
+  controller = nullptr;
+}
+
+// the first boot waits for DHCP, the IP address is shown until the first values arrive
+void test_first_frame_without_snapshot()
+{
+  boot();
+  TEST_ASSERT_EQUAL_UINT32(0, virtualDisplay->getFrame(0));
+  unsigned long firstFrame = runUntil([]()
+                                      { return (addressShown); }, 10000);
+  TEST_ASSERT_UINT32_WITHIN(10, NATIVE_DHCP_TIME, firstFrame);
+  unsigned long values = runUntilShown("80.0", 10000);
+  TEST_ASSERT_TRUE(values >= NATIVE_DHCP_TIME + NATIVE_INVERTER_LATENCY);
+  TEST_ASSERT_TRUE(values <= NATIVE_DHCP_TIME + NATIVE_INVERTER_LATENCY + ROLL_TIME);
+  TEST_ASSERT_EQUAL(1, Ethernet.dhcpRequests);
+  report("Without snapshot", firstFrame, values);
+}
+
+// after a power loss the values stored in NVS are shown at once, the IP address is not shown,
+// the reused lease lets the first request go out without waiting for DHCP
+void test_first_frame_with_snapshot()
+{
+  storeSnapshot();
+  powerLoss();
+  inverterValues = getValues(55.0);
+  boot();
+  unsigned long firstFrame = runUntilShown("80.0", 10000);
+  TEST_ASSERT_EQUAL_UINT32(0, firstFrame);
+  unsigned long values = runUntilShown("55.0", 10000);
+  TEST_ASSERT_TRUE(values >= NATIVE_INVERTER_LATENCY);
+  TEST_ASSERT_TRUE(values <= NATIVE_INVERTER_LATENCY + ROLL_TIME);
+  TEST_ASSERT_FALSE(addressShown);
+  report("With snapshot", firstFrame, values);
+}
+
+// the snapshot is taken from RTC memory after a reset, from NVS after a power loss, it is only written
+// to NVS with the save interval and when it has changed, damaged snapshots are not shown
+void test_snapshot()
+{
+  INVERTER_VALUES values;
+  Preferences preferences;
+  Snapshot snapshot;
+
+  preferences.begin(SNAPSHOT_NAMESPACE);
+  snapshot.begin();
+  TEST_ASSERT_FALSE(snapshot.load(&values));
+
+  // kept in RTC memory, written to NVS with the next save
+  snapshot.update(getValues(42.0));
+  TEST_ASSERT_FALSE(preferences.isKey(SNAPSHOT_KEY));
+  TEST_ASSERT_TRUE(snapshot.load(&values));
+  TEST_ASSERT_EQUAL_DOUBLE(42.0, values.SOC);
+  TEST_ASSERT_TRUE(snapshot.save());
+  TEST_ASSERT_TRUE(preferences.isKey(SNAPSHOT_KEY));
+
+  // not written again without new values
+  preferences.remove(SNAPSHOT_KEY);
+  TEST_ASSERT_TRUE(snapshot.save());
+  TEST_ASSERT_FALSE(preferences.isKey(SNAPSHOT_KEY));
+  snapshot.update(getValues(43.0));
+  TEST_ASSERT_TRUE(snapshot.save());
+
+  // a reset keeps the RTC memory even if NVS has older values
+  snapshot.update(getValues(44.0));
+  TEST_ASSERT_TRUE(snapshot.load(&values));
+  TEST_ASSERT_EQUAL_DOUBLE(44.0, values.SOC);
+
+  // a power loss leaves the values of the last save
+  powerLoss();
+  TEST_ASSERT_TRUE(snapshot.load(&values));
+  TEST_ASSERT_EQUAL_DOUBLE(43.0, values.SOC);
+  // the values have been copied to RTC memory
+  preferences.remove(SNAPSHOT_KEY);
+  TEST_ASSERT_TRUE(snapshot.load(&values));
+  TEST_ASSERT_EQUAL_DOUBLE(43.0, values.SOC);
+
+  // garbage in RTC memory and a damaged record in NVS
+  rtcSnapshot.values.SOC = 99.0;
+  TEST_ASSERT_FALSE(snapshot.load(&values));
+  snapshot.update(getValues(45.0));
+  TEST_ASSERT_TRUE(snapshot.save());
+  powerLoss();
+  std::vector<uint8_t> &record = Preferences::getStore()[SNAPSHOT_NAMESPACE "/" SNAPSHOT_KEY];
+  record[offsetof(SNAPSHOT, values)] ^= 0x01;
+  TEST_ASSERT_FALSE(snapshot.load(&values));
+}
+
+// the lease of the first boot is reused by the next boots, the DHCP server is asked after the first request,
+// a new address is taken over and stored, without answer the reused address is kept
+void test_lease_reuse()
+{
+  NETWORK_LEASE lease;
+  Preferences preferences;
+
+  boot();
+  runUntilShown("80.0", 10000);
+  TEST_ASSERT_EQUAL(1, Ethernet.dhcpRequests);
+  TEST_ASSERT_UINT32_WITHIN(10, NATIVE_DHCP_TIME, firstRequest);
+  preferences.begin(NETWORK_NAMESPACE);
+  TEST_ASSERT_EQUAL(sizeof(lease), preferences.getBytes(NETWORK_LEASE_KEY, &lease, sizeof(lease)));
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)IPAddress(192, 168, 1, 20), lease.ip);
+
+  // the first request goes out at once, then the server is asked
+  inverterValues = getValues(81.0);
+  boot();
+  TEST_ASSERT_EQUAL(0, Ethernet.dhcpRequests);
+  runUntilShown("81.0", 10000);
+  TEST_ASSERT_TRUE(firstRequest < 10);
+  TEST_ASSERT_TRUE(Ethernet.localIP() == IPAddress(192, 168, 1, 20));
+  run(NATIVE_DHCP_TIME + 100);
+  TEST_ASSERT_EQUAL(1, Ethernet.dhcpRequests);
+
+  // the server assigns another address
+  Ethernet.dhcpAddress = IPAddress(192, 168, 1, 33);
+  inverterValues = getValues(82.0);
+  boot();
+  runUntilShown("82.0", 10000);
+  TEST_ASSERT_TRUE(Ethernet.localIP() == IPAddress(192, 168, 1, 20));
+  run(NATIVE_DHCP_TIME + 100);
+  TEST_ASSERT_TRUE(Ethernet.localIP() == IPAddress(192, 168, 1, 33));
+  TEST_ASSERT_EQUAL(sizeof(lease), preferences.getBytes(NETWORK_LEASE_KEY, &lease, sizeof(lease)));
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)IPAddress(192, 168, 1, 33), lease.ip);
+
+  // the server does not answer, the values keep coming with the reused address
+  Ethernet.dhcpServer = false;
+  inverterValues = getValues(83.0);
+  boot();
+  runUntilShown("83.0", 10000);
+  inverterValues = getValues(66.0);
+  run(90000);
+  TEST_ASSERT_TRUE(Ethernet.localIP() == IPAddress(192, 168, 1, 33));
+  runUntilShown("66.0", millis() + 10000);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_first_frame_without_snapshot);
+  RUN_TEST(test_first_frame_with_snapshot);
+  RUN_TEST(test_snapshot);
+  RUN_TEST(test_lease_reuse);
+  return (UNITY_END());
+}
@@ -0,0 +1,193 @@
+// test_main.cpp
+
+// tests of the button, a simulated pin is pressed and released while the button task runs in simulated
+// time and posts its actions to a main loop waiting on an event queue like the controller, covers the
+// recognition of clicks, double clicks and long presses with a bouncing contact, the latency from the
+// recognition to the main loop and the idle button task
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <Button.hpp>
+#include <vector>
+
+#define PIN_BUTTON 34
+#define PRESSED LOW
+#define RELEASED HIGH
+#define LOOP_MAX_WAIT 10000 // in ms, like the controller
+#define MAX_LATENCY 50      // in ms, from the recognition to the main loop
+#define MAX_CLICK_DELAY (BUTTON_DEBOUNCE_TIME + BUTTON_CLICK_TIME + 2 * BUTTON_TICK_INTERVAL)
+
+// action taken by the main loop
+typedef struct
+{
+  button_action action;
+  unsigned long latency; // in ms, from the recognition by the button task
+  unsigned long time;    // in ms, when the main loop took it
+} TAKEN_ACTION;
+
+static Button *button;
+static QueueHandle_t events;
+static std::vector<TAKEN_ACTION> actions;
+
+static void onEvent(void *, controller_event event)
+{
+  xQueueSend(events, &event, 0);
+}
+
+// runs the main loop for the given time, it sleeps until an event arrives
+static void serve(unsigned long duration)
+{
+  unsigned long start = millis();
+  controller_event event;
+  BUTTON_EVENT buttonEvent;
+
+  while (millis() - start < duration)
+  {
+    unsigned long wait = min((unsigned long)LOOP_MAX_WAIT, duration - (millis() - start));
+    if (xQueueReceive(events, &event, pdMS_TO_TICKS(wait)) == pdTRUE)
+    {
+      while (button->getAction(&buttonEvent))
+      {
+        actions.push_back({buttonEvent.action, millis() - buttonEvent.timestamp, millis()});
+      }
+    }
+  }
+}
+
+// sets the pin level with a bouncing contact, one level per millisecond
+static void bounce(uint8_t level)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    Native::setPin(PIN_BUTTON, level);
+    delay(1);
+    Native::setPin(PIN_BUTTON, !level);
+    delay(1);
+  }
+  Native::setPin(PIN_BUTTON, level);
+}
+
+// presses the button for the given time
+static void press(unsigned long duration)
+{
+  bounce(PRESSED);
+  serve(duration);
+  bounce(RELEASED);
+}
+
+// returns the only action taken, checks the latency
+static button_action getOnlyAction()
+{
+  TEST_ASSERT_EQUAL(1, actions.size());
+  TEST_ASSERT_TRUE(actions[0].latency < MAX_LATENCY);
+  return (actions[0].action);
+}
+
+void setUp()
+{
+  Native::reset();
+  Native::setPin(PIN_BUTTON, RELEASED);
+  actions.clear();
+  events = xQueueCreate(16, sizeof(controller_event));
+  button = new Button(PIN_BUTTON);
+  button->begin(onEvent, nullptr);
+  serve(1000);
+}
+
+void tearDown()
+{
+  delete button;
+  vQueueDelete(events);
+}
+
+// a short press is a click, recognized when no second click follows
+void test_click()
+{
+  press(100);
+  unsigned long release = millis();
+  serve(1000);
+  TEST_ASSERT_TRUE(getOnlyAction() == button_action::click);
+  TEST_ASSERT_TRUE(actions[0].time - release <= MAX_CLICK_DELAY);
+}
+
+// a second press within the click time makes a double click
+void test_double_click()
+{
+  press(80);
+  serve(100);
+  press(80);
+  serve(1000);
+  TEST_ASSERT_TRUE(getOnlyAction() == button_action::double_click);
+}
+
+// holding the button starts a long press, released later it is no click
+void test_long_press()
+{
+  unsigned long start = millis();
+  press(BUTTON_PRESS_TIME + 500);
+  serve(1000);
+  TEST_ASSERT_TRUE(getOnlyAction() == button_action::long_press);
+  TEST_ASSERT_TRUE(actions[0].time - start <= BUTTON_PRESS_TIME + BUTTON_DEBOUNCE_TIME + 2 * BUTTON_TICK_INTERVAL);
+}
+
+// every press of a series is recognized, also presses right after the task went to sleep
+void test_series()
+{
+  unsigned long maxLatency = 0;
+  unsigned long maxDelay = 0;
+  char message[96];
+
+  for (unsigned long pause = MAX_CLICK_DELAY; pause < MAX_CLICK_DELAY + 200; pause += 7)
+  {
+    actions.clear();
+    press(60);
+    unsigned long release = millis();
+    serve(pause);
+    serve(1000);
+    TEST_ASSERT_TRUE(getOnlyAction() == button_action::click);
+    maxLatency = max(maxLatency, actions[0].latency);
+    maxDelay = max(maxDelay, actions[0].time - release);
+  }
+  snprintf(message, sizeof(message), "click to main loop: %lu ms at most, release to click: %lu ms at most",
+           maxLatency, maxDelay);
+  TEST_MESSAGE(message);
+}
+
+// contact bounce shorter than the debounce time is no press
+void test_glitch()
+{
+  bounce(PRESSED);
+  bounce(RELEASED);
+  serve(2000);
+  TEST_ASSERT_EQUAL(0, actions.size());
+}
+
+// the idle button task sleeps until the button is touched
+void test_idle()
+{
+  NativeTask *task = Native::getTasks().back();
+  unsigned long runs = task->runs;
+  serve(60000);
+  TEST_ASSERT_EQUAL_UINT32(runs, task->runs);
+
+  press(100);
+  serve(1000);
+  runs = task->runs;
+  serve(60000);
+  TEST_ASSERT_EQUAL_UINT32(runs, task->runs);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_click);
+  RUN_TEST(test_double_click);
+  RUN_TEST(test_long_press);
+  RUN_TEST(test_series);
+  RUN_TEST(test_glitch);
+  RUN_TEST(test_idle);
+  return (UNITY_END());
+}
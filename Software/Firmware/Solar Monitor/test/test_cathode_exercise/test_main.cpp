@@ -0,0 +1,209 @@
+// test_main.cpp
+
+// tests of the cathode usage counters and the exercise of the least used cathodes, the frames of the
+// exercise are shifted out on the simulated pins and compared with the accumulated on-times
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <Display.hpp>
+
+// pins of the controller board
+#define PIN_BLANK 13
+#define PIN_DATA 4
+#define PIN_STORE 16
+#define PIN_SHIFT 17
+#define PIN_LEDCTL 14
+
+#define SHOWN_NUMBER 5
+
+static Display *display;
+static uint64_t shiftedFrame; // collected from the data pin, the highest register comes first
+
+static void onWrite(uint8_t pin, uint8_t level)
+{
+  if ((pin == PIN_SHIFT) && (level == SHIFT_COMMIT))
+  {
+    shiftedFrame = (shiftedFrame << 1) | digitalRead(PIN_DATA);
+  }
+}
+
+// shows the digits on the numeric tubes with the W sign for the given time
+static void show(uint8_t number, unsigned long duration)
+{
+  DISPLAY_VALUE value = {0};
+
+  for (int i = 0; i < DIGITCOUNT; i++)
+  {
+    value.digits[i] = number;
+  }
+  value.wattFlag = true;
+  display->clear();
+  display->setValues(value);
+  display->setRegisters();
+  display->latchFrame();
+  delay(duration);
+}
+
+// returns the frame of a step of the prepared exercise
+static uint64_t getStepFrame(uint8_t step)
+{
+  shiftedFrame = 0;
+  display->setSequenceRegisters(step);
+  return (shiftedFrame);
+}
+
+// returns the registers of a tube, digit 0 is the left symbol tube
+static uint64_t getTubeMask(uint8_t tube)
+{
+  DisplayHAL hal;
+  uint64_t mask = 0;
+  uint8_t digit = 0;
+  uint8_t number = 0;
+
+  for (uint8_t i = 1; i <= REGISTERCOUNT; i++)
+  {
+    hal.getRegisterInfo(i, &digit, &number);
+    if (hal.isCathode(i) && (digit == tube))
+    {
+      mask |= REGISTER_BIT(i);
+    }
+  }
+  return (mask);
+}
+
+void setUp()
+{
+  Native::reset();
+  Native::onWrite = onWrite;
+  display = new Display(display_type::solar_power, value_type::watts, true, PIN_DATA, PIN_STORE, PIN_SHIFT, PIN_BLANK, PIN_LEDCTL);
+  display->getCathodeUsage()->setLit(true);
+}
+
+void tearDown()
+{
+  delete display;
+  Native::onWrite = nullptr;
+}
+
+// the lit registers collect their on-time, the remainder below a second is kept, nothing counts while unlit
+void test_on_time()
+{
+  CathodeUsage *usage = display->getCathodeUsage();
+
+  usage->setFrame(REGISTER_BIT(1) | REGISTER_BIT(64));
+  delay(1500);
+  usage->setFrame(REGISTER_BIT(1));
+  delay(700);
+  usage->setLit(false);
+  delay(5000);
+  usage->account();
+  TEST_ASSERT_EQUAL_UINT32(2, usage->getOnTime(1));
+  TEST_ASSERT_EQUAL_UINT32(2200, usage->getRecentOnTime(1));
+  TEST_ASSERT_EQUAL_UINT32(1, usage->getOnTime(64));
+  TEST_ASSERT_EQUAL_UINT32(0, usage->getOnTime(2));
+  usage->startInterval();
+  TEST_ASSERT_EQUAL_UINT32(0, usage->getRecentOnTime(1));
+  TEST_ASSERT_EQUAL_UINT32(2, usage->getOnTime(1));
+}
+
+// the counters survive a restart, they are only written when they have changed
+void test_persistence()
+{
+  Preferences preferences;
+  CathodeUsage restored;
+
+  preferences.begin("cathodes");
+  preferences.clear();
+  TEST_ASSERT_TRUE(display->getCathodeUsage()->save(preferences, "board0"));
+  TEST_ASSERT_FALSE(preferences.isKey("board0"));
+  show(1, 3000);
+  TEST_ASSERT_TRUE(display->getCathodeUsage()->save(preferences, "board0"));
+  TEST_ASSERT_TRUE(restored.load(preferences, "board0"));
+  for (uint8_t i = 1; i <= REGISTERCOUNT; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(display->getCathodeUsage()->getOnTime(i), restored.getOnTime(i));
+  }
+  preferences.clear();
+}
+
+// each tube runs through its cathodes not lit in the interval, the least used first,
+// the number shown in the interval is left out
+void test_exercise_order()
+{
+  // number n has been lit for (n + 1) * 2 s, 9 the longest
+  for (uint8_t number = 0; number <= 9; number++)
+  {
+    show(number, (number + 1) * 2000UL);
+  }
+  display->getCathodeUsage()->startInterval();
+  show(SHOWN_NUMBER, 2000);
+  uint64_t shown = display->buildFrame();
+
+  uint8_t stepCount = display->prepareExercise();
+  TEST_ASSERT_TRUE(stepCount >= 9);
+  TEST_ASSERT_TRUE(stepCount <= CATHODE_EXERCISE_MAX_STEPS);
+
+  CathodeUsage *usage = display->getCathodeUsage();
+  for (uint8_t tube = 0; tube < TUBECOUNT; tube++)
+  {
+    uint64_t mask = getTubeMask(tube);
+    uint64_t visited = 0;
+    uint32_t lastOnTime = 0;
+    bool exercising = true;
+
+    for (uint8_t step = 0; step < stepCount; step++)
+    {
+      uint64_t frame = getStepFrame(step) & mask;
+      if (frame == (shown & mask))
+      {
+        // the tube is done and shows its content again
+        exercising = false;
+        continue;
+      }
+      TEST_ASSERT_TRUE(exercising);
+      TEST_ASSERT_EQUAL(1, __builtin_popcountll(frame));
+      uint8_t registerNumber = __builtin_ctzll(frame) + 1;
+      TEST_ASSERT_TRUE(usage->getRecentOnTime(registerNumber) < CATHODE_EXERCISE_MIN_ONTIME);
+      TEST_ASSERT_TRUE(usage->getOnTime(registerNumber) >= lastOnTime);
+      TEST_ASSERT_EQUAL_HEX64(0, visited & frame);
+      lastOnTime = usage->getOnTime(registerNumber);
+      visited |= frame;
+    }
+  }
+
+  // the numeric tubes run from 0 to 9 without the shown number
+  DisplayHAL hal;
+  uint8_t expected = 0;
+  for (uint8_t step = 0; step < 9; step++, expected++)
+  {
+    expected += (expected == SHOWN_NUMBER) ? 1 : 0;
+    uint64_t frame = getStepFrame(step) & getTubeMask(1);
+    uint8_t digit = 0;
+    uint8_t number = 0;
+    TEST_ASSERT_EQUAL(register_type::number, hal.getRegisterInfo(__builtin_ctzll(frame) + 1, &digit, &number));
+    TEST_ASSERT_EQUAL_UINT8(expected, number);
+  }
+}
+
+// cathodes all lit in the interval need no exercise, the current content is shown
+void test_nothing_to_exercise()
+{
+  show(3, 0);
+  display->getCathodeUsage()->setFrame(~0ULL);
+  delay(CATHODE_EXERCISE_MIN_ONTIME);
+  TEST_ASSERT_EQUAL_UINT8(0, display->prepareExercise());
+  TEST_ASSERT_EQUAL_HEX64(display->buildFrame(), getStepFrame(0));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_on_time);
+  RUN_TEST(test_persistence);
+  RUN_TEST(test_exercise_order);
+  RUN_TEST(test_nothing_to_exercise);
+  return (UNITY_END());
+}
@@ -0,0 +1,314 @@
+// test_main.cpp
+
+// simulation of several monitors sharing one inverter, each node runs the cluster part of the network task
+// with its own uptime on a simulated network segment, covers the election at startup, the staggered
+// failover when the leader goes silent, a restarted leader, a late node and datagrams lost on the way,
+// the followers know the address of the leader to send the API clients there
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <Cluster.hpp>
+
+#define NODE_COUNT 4
+#define STEP 50                                              // in ms, pass of the network task
+#define POLLING_INTERVAL (INVERTER_POLLINGINTERVAL * 1000UL) // in ms
+
+typedef struct
+{
+  Cluster *cluster;
+  byte mac[6];
+  bool running;
+  unsigned long bootTime;   // in ms of the simulation
+  unsigned long nextPoll;   // in ms of the simulation
+  unsigned long polls;      // inverter requests
+  unsigned long received;   // values taken from the leader
+  unsigned long lastValues; // in ms of the simulation
+} NODE;
+
+// node ids 0x12 and 0x02 share a stagger slot
+static const uint8_t nodeIds[NODE_COUNT] = {0x12, 0x05, 0x02, 0x0B};
+
+// collects the printed state of a node
+class TextPrint : public Print
+{
+public:
+  char text[256] = {0};
+
+  size_t write(uint8_t c) override
+  {
+    size_t length = strlen(text);
+    if (length + 1 >= sizeof(text))
+    {
+      return (0);
+    }
+    text[length] = (char)c;
+    return (1);
+  }
+};
+
+static NODE nodes[NODE_COUNT];
+static unsigned long simulationTime; // in ms
+
+// returns the address of a node, the last byte is the node id
+static IPAddress getAddress(const NODE &node)
+{
+  return (IPAddress(192, 168, 1, node.mac[5]));
+}
+
+// starts a node, its uptime begins now
+static void start(NODE &node)
+{
+  delete node.cluster;
+  node.cluster = new Cluster();
+  node.running = true;
+  node.bootTime = simulationTime;
+  node.nextPoll = simulationTime;
+  Native::now = 0;
+  Ethernet.begin(node.mac, getAddress(node), IPAddress(192, 168, 1, 1), IPAddress(192, 168, 1, 1), IPAddress(255, 255, 255, 0));
+  node.cluster->begin(node.mac);
+}
+
+// a stopped node neither sends nor receives
+static void stop(NODE &node)
+{
+  delete node.cluster;
+  node.cluster = nullptr;
+  node.running = false;
+}
+
+// one pass of the network task of a node, like Network::loop()
+static void pass(NODE &node)
+{
+  INVERTER_VALUES values;
+
+  Native::now = (uint64_t)(simulationTime - node.bootTime) * 1000;
+  bool requested = (simulationTime >= node.nextPoll);
+  if (requested)
+  {
+    node.nextPoll += POLLING_INTERVAL;
+  }
+  node.cluster->process();
+  if (node.cluster->receive(&values))
+  {
+    node.received++;
+    node.lastValues = simulationTime;
+  }
+  if ((requested && node.cluster->isPolling()) || node.cluster->isPollDue())
+  {
+    values = {50, 100, -200, -900, 1000, 80, 90};
+    node.polls++;
+    node.lastValues = simulationTime;
+    node.cluster->publish(&values);
+  }
+}
+
+static void runFor(unsigned long duration)
+{
+  unsigned long end = simulationTime + duration;
+
+  while (simulationTime < end)
+  {
+    simulationTime += STEP;
+    for (NODE &node : nodes)
+    {
+      if (node.running)
+      {
+        pass(node);
+      }
+    }
+  }
+}
+
+static int getLeaderCount()
+{
+  int count = 0;
+
+  for (NODE &node : nodes)
+  {
+    count += (node.running && (node.cluster->getRole() == cluster_role::leader)) ? 1 : 0;
+  }
+  return (count);
+}
+
+static NODE &getNode(uint8_t nodeId)
+{
+  for (NODE &node : nodes)
+  {
+    if (node.mac[5] == nodeId)
+    {
+      return (node);
+    }
+  }
+  return (nodes[0]);
+}
+
+static unsigned long getPolls()
+{
+  unsigned long polls = 0;
+
+  for (NODE &node : nodes)
+  {
+    polls += node.polls;
+  }
+  return (polls);
+}
+
+// the running nodes follow the leader and have its values from the last interval
+static void checkCluster(uint8_t leaderId)
+{
+  TEST_ASSERT_EQUAL(1, getLeaderCount());
+  for (NODE &node : nodes)
+  {
+    if (!node.running)
+    {
+      continue;
+    }
+    TEST_ASSERT_EQUAL_UINT32(getNode(leaderId).cluster->getNodeId(), node.cluster->getLeaderId());
+    TEST_ASSERT_TRUE(node.cluster->isPolling() == (node.mac[5] == leaderId));
+    TEST_ASSERT_EQUAL_UINT32((node.mac[5] == leaderId) ? 0 : (uint32_t)getAddress(getNode(leaderId)),
+                             (uint32_t)node.cluster->getLeaderAddress());
+    TEST_ASSERT_TRUE(simulationTime - node.lastValues <= POLLING_INTERVAL);
+  }
+}
+
+static unsigned long getElections()
+{
+  unsigned long elections = 0;
+
+  for (NODE &node : nodes)
+  {
+    if (node.running)
+    {
+      TextPrint out;
+      node.cluster->print(out);
+      const char *text = strstr(out.text, "elections=");
+      elections += (text != nullptr) ? strtoul(text + 10, nullptr, 10) : 0;
+    }
+  }
+  return (elections);
+}
+
+void setUp()
+{
+  Native::reset();
+  Ethernet.reset();
+  EthernetUDP::deliver() = nullptr;
+  simulationTime = 0;
+  for (int i = 0; i < NODE_COUNT; i++)
+  {
+    byte mac[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, nodeIds[i]};
+    memcpy(nodes[i].mac, mac, sizeof(mac));
+    nodes[i].cluster = nullptr;
+    nodes[i].polls = 0;
+    nodes[i].received = 0;
+    nodes[i].lastValues = 0;
+    start(nodes[i]);
+  }
+}
+
+void tearDown()
+{
+  for (NODE &node : nodes)
+  {
+    stop(node);
+  }
+  EthernetUDP::deliver() = nullptr;
+}
+
+// the nodes started together elect one leader, of two nodes taking over at once the lower node id stays
+void test_election()
+{
+  runFor(CLUSTER_STARTUP_TIMEOUT * POLLING_INTERVAL);
+  TEST_ASSERT_EQUAL(0, getPolls());
+  runFor(60000);
+  checkCluster(0x02);
+  // only the leader polls, once per interval
+  unsigned long polls = getPolls();
+  runFor(10 * POLLING_INTERVAL);
+  TEST_ASSERT_EQUAL_UINT32(polls + 10, getPolls());
+}
+
+// the node of the first stagger slot takes over a silent leader, the others follow it without an election
+void test_staggered_failover()
+{
+  runFor(60000);
+  checkCluster(0x02);
+  stop(getNode(0x02));
+  unsigned long elections = getElections();
+  runFor(CLUSTER_LEADER_TIMEOUT * POLLING_INTERVAL);
+  TEST_ASSERT_EQUAL(0, getLeaderCount());
+  runFor(CLUSTER_STAGGER_SLOTS * CLUSTER_STAGGER_INTERVAL + POLLING_INTERVAL);
+  checkCluster(0x12);
+  TEST_ASSERT_EQUAL_UINT32(elections + 1, getElections());
+  runFor(60000);
+  checkCluster(0x12);
+}
+
+// a restarted leader has a lower uptime, the followers take its datagrams although the sequence starts again
+void test_leader_restart()
+{
+  runFor(60000);
+  checkCluster(0x02);
+  NODE &leader = getNode(0x02);
+  unsigned long received = getNode(0x05).received;
+
+  stop(leader);
+  runFor(2000);
+  start(leader);
+  runFor(CLUSTER_STARTUP_TIMEOUT * POLLING_INTERVAL + CLUSTER_STAGGER_SLOTS * CLUSTER_STAGGER_INTERVAL);
+  checkCluster(0x02);
+  TEST_ASSERT_TRUE(getNode(0x05).received > received);
+  runFor(60000);
+  checkCluster(0x02);
+}
+
+// a node joining later follows the leader without an election
+void test_late_join()
+{
+  NODE &late = getNode(0x0B);
+
+  stop(late);
+  runFor(60000);
+  checkCluster(0x02);
+  unsigned long elections = getElections();
+  start(late);
+  runFor(60000);
+  checkCluster(0x02);
+  TEST_ASSERT_EQUAL_UINT32(elections, getElections());
+}
+
+// datagrams lost within the leader timeout change nothing, only the leader polls
+void test_lossy_network()
+{
+  static unsigned long count = 0;
+
+  EthernetUDP::deliver() = [](const EthernetUDP *, const EthernetUDP *)
+  {
+    return ((++count % 3) != 0);
+  };
+  runFor(60000);
+  unsigned long polls = getPolls();
+  unsigned long leaderPolls = getNode(0x02).polls;
+  runFor(120000);
+  TEST_ASSERT_EQUAL(1, getLeaderCount());
+  TEST_ASSERT_TRUE(getNode(0x02).cluster->isPolling());
+  TEST_ASSERT_EQUAL_UINT32(getNode(0x02).polls - leaderPolls, getPolls() - polls);
+  for (NODE &node : nodes)
+  {
+    TEST_ASSERT_TRUE(simulationTime - node.lastValues <= 3 * POLLING_INTERVAL);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_election);
+  RUN_TEST(test_staggered_failover);
+  RUN_TEST(test_leader_restart);
+  RUN_TEST(test_late_join);
+  RUN_TEST(test_lossy_network);
+  return (UNITY_END());
+}
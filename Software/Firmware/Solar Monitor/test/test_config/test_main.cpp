@@ -0,0 +1,206 @@
+// test_main.cpp
+
+// tests of the stored configuration, the stored layout keeps its size when the display chain limit
+// changes, a configuration stored by version 2 is taken over with its ratings and filters and the
+// API token of the changing requests is checked
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <Config.hpp>
+
+// configuration as stored by version 2
+typedef struct
+{
+  char inverterAddress[CONFIG_ADDRESS_SIZE];
+  uint16_t inverterPort;
+  uint16_t pollingInterval;
+  uint16_t pirDelay;
+  uint16_t rotationInterval;
+  uint16_t rotationStepInterval;
+  uint16_t powerRoundToZeroRange;
+  uint32_t colors[RATING_COUNT];
+  CONFIG_RANGE ratings[CONFIG_V2_BOARD_COUNT][RATING_COUNT];
+  FILTER_SETTINGS filters[DISPLAY_TYPE_COUNT];
+} CONFIG_V2;
+
+typedef struct
+{
+  uint16_t version;
+  uint16_t size;
+  uint32_t checksum;
+  CONFIG_V2 config;
+} CONFIG_RECORD_V2;
+
+static void store(uint16_t version, const CONFIG_V2 &config, size_t size)
+{
+  Preferences preferences;
+  CONFIG_RECORD_V2 record;
+
+  record.version = version;
+  record.size = size;
+  record.checksum = Helper::getChecksum(&config, size);
+  record.config = config;
+  preferences.begin(CONFIG_NAMESPACE);
+  preferences.putBytes(CONFIG_KEY, &record, offsetof(CONFIG_RECORD_V2, config) + size);
+}
+
+// returns the configuration loaded from the storage
+static CONFIG load()
+{
+  Config::get().begin();
+  return (Config::get().getActive());
+}
+
+// returns the defaults of Settings.h and Layout.h
+static CONFIG getDefaults()
+{
+  Preferences preferences;
+  preferences.begin(CONFIG_NAMESPACE);
+  preferences.clear();
+  return (load());
+}
+
+static CONFIG_V2 getVersion2()
+{
+  CONFIG_V2 config;
+
+  memset(&config, 0, sizeof(config));
+  strcpy(config.inverterAddress, "10.1.2.3");
+  config.inverterPort = 8080;
+  config.pollingInterval = 30;
+  config.pirDelay = 7;
+  config.rotationInterval = 3;
+  config.rotationStepInterval = 500;
+  config.powerRoundToZeroRange = 20;
+  for (int i = 0; i < RATING_COUNT; i++)
+  {
+    config.colors[i] = 0x102030 * (i + 1);
+  }
+  for (int i = 0; i < CONFIG_V2_BOARD_COUNT; i++)
+  {
+    for (int j = 0; j < RATING_COUNT; j++)
+    {
+      config.ratings[i][j] = {i * 100 + j, i * 100 + j + 50};
+    }
+  }
+  for (int i = 0; i < DISPLAY_TYPE_COUNT; i++)
+  {
+    config.filters[i] = {3, (uint16_t)(10 + i), 40, (uint16_t)i};
+  }
+  return (config);
+}
+
+// compares the fields of version 1, the ratings of the boards in the layout
+static void checkVersion1Fields(const CONFIG &config, const CONFIG_V2 &stored)
+{
+  TEST_ASSERT_EQUAL_STRING(stored.inverterAddress, config.inverterAddress);
+  TEST_ASSERT_EQUAL_UINT16(stored.inverterPort, config.inverterPort);
+  TEST_ASSERT_EQUAL_UINT16(stored.pollingInterval, config.pollingInterval);
+  TEST_ASSERT_EQUAL_UINT16(stored.pirDelay, config.pirDelay);
+  TEST_ASSERT_EQUAL_UINT16(stored.powerRoundToZeroRange, config.powerRoundToZeroRange);
+  TEST_ASSERT_EQUAL_MEMORY(stored.colors, config.colors, sizeof(stored.colors));
+  for (int i = 0; i < DISPLAY_COUNT; i++)
+  {
+    TEST_ASSERT_EQUAL_MEMORY(stored.ratings[i], config.ratings[i], sizeof(stored.ratings[i]));
+  }
+}
+
+void setUp()
+{
+  getDefaults();
+}
+
+void tearDown()
+{
+}
+
+// the rating rows do not follow the chain limit, so a firmware with another limit reads the same layout
+void test_layout()
+{
+  TEST_ASSERT_EQUAL(CONFIG_BOARD_COUNT * RATING_COUNT * sizeof(CONFIG_RANGE), sizeof(((CONFIG *)nullptr)->ratings));
+  TEST_ASSERT_EQUAL(offsetof(CONFIG_V2, ratings), offsetof(CONFIG, ratings));
+  TEST_ASSERT_EQUAL(offsetof(CONFIG, ratings) + sizeof(((CONFIG *)nullptr)->ratings), offsetof(CONFIG, filters));
+}
+
+// a configuration of version 2 keeps its ratings and its filters, which were stored at another offset
+void test_load_version2()
+{
+  CONFIG_V2 stored = getVersion2();
+
+  store(2, stored, sizeof(stored));
+  CONFIG active = load();
+  checkVersion1Fields(active, stored);
+  TEST_ASSERT_EQUAL_MEMORY(stored.filters, active.filters, sizeof(stored.filters));
+}
+
+// a configuration of version 1 has no filters, they keep the defaults
+void test_load_version1()
+{
+  CONFIG defaults = getDefaults();
+  CONFIG_V2 stored = getVersion2();
+
+  store(1, stored, offsetof(CONFIG_V2, filters));
+  CONFIG active = load();
+  checkVersion1Fields(active, stored);
+  TEST_ASSERT_EQUAL_MEMORY(defaults.filters, active.filters, sizeof(active.filters));
+}
+
+// an updated configuration is stored as the current version and read back
+void test_store_and_load()
+{
+  char text[] = "rating.1.good=-5,5&filter.grid=5,100,30,10&pir.delay=9";
+
+  TEST_ASSERT_EQUAL(ERR_SUCCESS, Config::get().update(text));
+  TEST_ASSERT_TRUE(Config::get().apply());
+  CONFIG updated = Config::get().getActive();
+  CONFIG active = load();
+  TEST_ASSERT_EQUAL_MEMORY(&updated, &active, sizeof(CONFIG));
+  TEST_ASSERT_EQUAL_INT32(-5, active.ratings[1][(int)rating_step::good].min);
+  TEST_ASSERT_EQUAL_UINT16(100, active.filters[(int)display_type::grid_power].outlier);
+  TEST_ASSERT_EQUAL_UINT16(9, active.pirDelay);
+}
+
+// the API token is set like the other settings, a wrong, shorter or longer token is refused
+void test_api_token()
+{
+  char text[] = "api.token=s3cret-T0ken";
+  char invalid[] = "api.token=two words";
+
+  TEST_ASSERT_FALSE(Config::get().isAuthorized(""));
+  TEST_ASSERT_EQUAL(ERR_SUCCESS, Config::get().update(text));
+  TEST_ASSERT_TRUE(Config::get().isAuthorized("s3cret-T0ken"));
+  TEST_ASSERT_FALSE(Config::get().isAuthorized("s3cret-T0keN"));
+  TEST_ASSERT_FALSE(Config::get().isAuthorized("s3cret"));
+  TEST_ASSERT_FALSE(Config::get().isAuthorized("s3cret-T0ken2"));
+  TEST_ASSERT_FALSE(Config::get().isAuthorized(""));
+  TEST_ASSERT_TRUE(Config::get().apply());
+  TEST_ASSERT_EQUAL(ERR_CONFIG_VALUE, Config::get().update(invalid));
+  CONFIG active = load();
+  TEST_ASSERT_EQUAL_STRING("s3cret-T0ken", active.apiToken);
+}
+
+// a configuration of a newer version is not used
+void test_newer_version()
+{
+  CONFIG defaults = getDefaults();
+  CONFIG_V2 stored = getVersion2();
+
+  store(CONFIG_VERSION + 1, stored, sizeof(stored));
+  CONFIG active = load();
+  TEST_ASSERT_EQUAL_MEMORY(&defaults, &active, sizeof(CONFIG));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_layout);
+  RUN_TEST(test_load_version2);
+  RUN_TEST(test_load_version1);
+  RUN_TEST(test_store_and_load);
+  RUN_TEST(test_api_token);
+  RUN_TEST(test_newer_version);
+  return (UNITY_END());
+}
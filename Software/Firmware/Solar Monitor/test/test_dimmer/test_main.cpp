@@ -0,0 +1,139 @@
+// test_main.cpp
+
+// tests of the fade timing of the tube dimmer, the fade timer fires in simulated time and the duty cycle
+// written to the PWM channel is sampled every millisecond, covers the end points and the duration of
+// fades, a new target while fading and a brightness set at once during a fade
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <Dimmer.hpp>
+
+#define PIN_BLANK 13
+#define CHANNEL 2
+#define MAX_DUTY ((1 << DIMMER_RESOLUTION) - 1)
+
+static Dimmer *dimmer;
+
+typedef struct
+{
+  uint32_t first;        // duty cycle at the start
+  uint32_t last;         // duty cycle at the end
+  unsigned long settled; // in ms, when the last change has been written
+  bool monotonic;        // no step against the direction of the fade
+} FADE_TRACE;
+
+static uint32_t getDuty()
+{
+  return (Native::duties[CHANNEL]);
+}
+
+// samples the duty cycle every millisecond for the given time
+static FADE_TRACE trace(unsigned long duration)
+{
+  FADE_TRACE result = {getDuty(), getDuty(), 0, true};
+  unsigned long start = millis();
+  int direction = 0;
+
+  for (unsigned long ms = 1; ms <= duration; ms++)
+  {
+    delay(1);
+    uint32_t duty = getDuty();
+    if (duty != result.last)
+    {
+      int step = (duty > result.last) ? 1 : -1;
+      result.monotonic = result.monotonic && ((direction == 0) || (step == direction));
+      direction = step;
+      result.last = duty;
+      result.settled = millis() - start;
+    }
+  }
+  return (result);
+}
+
+void setUp()
+{
+  Native::reset();
+  dimmer = new Dimmer(PIN_BLANK, CHANNEL);
+  dimmer->begin();
+}
+
+void tearDown()
+{
+  delete dimmer;
+}
+
+// a fade reaches its end point within one timer interval after the fade time, without going back
+void test_fade_timing()
+{
+  static const uint32_t fadeTimes[] = {100, 1000, 3000};
+
+  for (uint32_t fadeTime : fadeTimes)
+  {
+    dimmer->setBrightness(0, 0);
+    dimmer->setBrightness(100, fadeTime);
+    TEST_ASSERT_TRUE(dimmer->isFading());
+    FADE_TRACE up = trace(fadeTime + 100);
+    TEST_ASSERT_EQUAL_UINT32(0, up.first);
+    TEST_ASSERT_EQUAL_UINT32(MAX_DUTY, up.last);
+    TEST_ASSERT_TRUE(up.monotonic);
+    TEST_ASSERT_TRUE(up.settled >= fadeTime);
+    TEST_ASSERT_TRUE(up.settled <= fadeTime + DIMMER_FADE_INTERVAL);
+    TEST_ASSERT_FALSE(dimmer->isFading());
+    TEST_ASSERT_EQUAL_UINT8(100, dimmer->getBrightness());
+
+    dimmer->setBrightness(20, fadeTime);
+    FADE_TRACE down = trace(fadeTime + 100);
+    TEST_ASSERT_EQUAL_UINT32((MAX_DUTY * 20 + 50) / 100, down.last);
+    TEST_ASSERT_TRUE(down.monotonic);
+    TEST_ASSERT_TRUE(down.settled <= fadeTime + DIMMER_FADE_INTERVAL);
+  }
+}
+
+// the duty cycle follows the elapsed fade time, at half the time about half the way
+void test_fade_linear()
+{
+  dimmer->setBrightness(100, 1000);
+  delay(500);
+  TEST_ASSERT_UINT32_WITHIN(MAX_DUTY * DIMMER_FADE_INTERVAL / 1000 + 1, MAX_DUTY / 2, getDuty());
+  TEST_ASSERT_UINT32_WITHIN(1, 50, dimmer->getBrightness());
+}
+
+// a new target while fading continues from the current duty cycle without a jump
+void test_new_target()
+{
+  dimmer->setBrightness(100, 1000);
+  delay(500);
+  uint32_t duty = getDuty();
+  dimmer->setBrightness(0, 400);
+  TEST_ASSERT_EQUAL_UINT32(duty, getDuty());
+  FADE_TRACE down = trace(500);
+  TEST_ASSERT_EQUAL_UINT32(0, down.last);
+  TEST_ASSERT_TRUE(down.monotonic);
+  TEST_ASSERT_TRUE(down.settled <= 400 + DIMMER_FADE_INTERVAL);
+}
+
+// a brightness without fade time stops a running fade and is written at once
+void test_instant_during_fade()
+{
+  dimmer->setBrightness(100, 1000);
+  delay(300);
+  dimmer->setBrightness(30, 0);
+  TEST_ASSERT_EQUAL_UINT32((MAX_DUTY * 30 + 50) / 100, getDuty());
+  TEST_ASSERT_FALSE(dimmer->isFading());
+  FADE_TRACE after = trace(1000);
+  TEST_ASSERT_EQUAL_UINT32(0, after.settled);
+  TEST_ASSERT_EQUAL_UINT8(30, dimmer->getBrightness());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_fade_timing);
+  RUN_TEST(test_fade_linear);
+  RUN_TEST(test_new_target);
+  RUN_TEST(test_instant_during_fade);
+  return (UNITY_END());
+}
@@ -0,0 +1,313 @@
+// test_main.cpp
+
+// tests of the frame builder of a display board, the frames are decoded with the translation
+// table and compared with the display values, also reports the cost of a frame at 5, 10 and 20 boards
+// and the frame rate of the digit transitions over the whole chain
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <time.h>
+#include <Display.hpp>
+#include <Helper.hpp>
+
+// pins of the controller board
+#define PIN_BLANK 13
+#define PIN_DATA 4
+#define PIN_STORE 16
+#define PIN_SHIFT 17
+#define PIN_LEDCTL 14
+
+#define BENCHMARK_FRAMES 2000
+#define BENCHMARK_MAX_BOARDS 20
+#define BENCHMARK_TRANSITIONS 2000
+#define TRANSITION_MIN_FPS (1000 / DIGIT_TRANSITION_STEPINTERVAL)
+
+// content of a board decoded from a frame
+typedef struct
+{
+  int numbers[DIGITCOUNT]; // lit number per numeric tube, -1 if none, -2 if more than one
+  bool decimalPoints[TUBECOUNT];
+  bool plus;
+  bool minus;
+  bool percent;
+  bool kilo;
+  bool watt;
+  bool error;
+  bool overallPlus;
+  bool overallMinus;
+} BOARD_CONTENT;
+
+static unsigned long shiftedBits;
+static uint64_t shiftedFrame; // the last shifted bits, the highest register comes first
+
+static void onWrite(uint8_t pin, uint8_t level)
+{
+  if ((pin == PIN_SHIFT) && (level == SHIFT_COMMIT))
+  {
+    shiftedBits++;
+    shiftedFrame = (shiftedFrame << 1) | digitalRead(PIN_DATA);
+  }
+}
+
+static BOARD_CONTENT decode(uint64_t frame)
+{
+  DisplayHAL hal;
+  BOARD_CONTENT content = {{-1, -1, -1}};
+  uint8_t digit = 0;
+  uint8_t number = 0;
+
+  for (uint8_t i = 1; i <= hal.getRegisterCount(); i++)
+  {
+    if ((frame & REGISTER_BIT(i)) == 0)
+    {
+      continue;
+    }
+    switch (hal.getRegisterInfo(i, &digit, &number))
+    {
+    case register_type::number:
+      content.numbers[digit - 1] = (content.numbers[digit - 1] == -1) ? number : -2;
+      break;
+    case register_type::decimal_point:
+      content.decimalPoints[digit] = true;
+      break;
+    case register_type::plus_sign:
+      content.plus = true;
+      break;
+    case register_type::minus_sign:
+      content.minus = true;
+      break;
+    case register_type::percent_sign:
+      content.percent = true;
+      break;
+    case register_type::k_sign:
+      content.kilo = true;
+      break;
+    case register_type::W_sign:
+      content.watt = true;
+      break;
+    case register_type::F_sign:
+      content.error = true;
+      break;
+    case register_type::overall_plus_sign:
+      content.overallPlus = true;
+      break;
+    case register_type::overall_minus_sign:
+      content.overallMinus = true;
+      break;
+    default:
+      break;
+    }
+  }
+  return (content);
+}
+
+// checks the decoded frame of a display against the value it was set to
+static void checkFrame(Display &display, const DISPLAY_VALUE &value)
+{
+  BOARD_CONTENT content = decode(display.buildFrame());
+
+  TEST_ASSERT_EQUAL(value.errorFlag, content.error);
+  if (value.errorFlag)
+  {
+    TEST_ASSERT_EQUAL(-1, content.numbers[0]);
+    return;
+  }
+  for (int i = 0; i < DIGITCOUNT; i++)
+  {
+    TEST_ASSERT_EQUAL(value.digits[i], content.numbers[i]);
+  }
+  for (int i = 1; i <= DECIMALPOINTCOUNT; i++)
+  {
+    TEST_ASSERT_EQUAL(value.decimalIndex == i, content.decimalPoints[i]);
+  }
+  TEST_ASSERT_EQUAL(value.plusFlag, content.plus);
+  TEST_ASSERT_EQUAL(value.minusFlag, content.minus);
+  TEST_ASSERT_EQUAL(value.percentageFlag, content.percent);
+  TEST_ASSERT_EQUAL(value.kiloFlag, content.kilo);
+  TEST_ASSERT_EQUAL(value.wattFlag, content.watt);
+  TEST_ASSERT_EQUAL(value.overallStatusPlusFlag, content.overallPlus);
+  TEST_ASSERT_EQUAL(value.overallStatusMinusFlag, content.overallMinus);
+}
+
+static void setValue(Display &display, double value, bool percent, bool overallStatus)
+{
+  DISPLAY_VALUE displayValue = {0};
+
+  display.clear();
+  Helper::convertDoubleToDisplayValue(value, displayValue, percent);
+  if (display.hasOverallStatus())
+  {
+    displayValue.overallStatusPlusFlag = overallStatus;
+    displayValue.overallStatusMinusFlag = !overallStatus;
+  }
+  display.setValues(displayValue);
+  checkFrame(display, displayValue);
+}
+
+void setUp()
+{
+  Native::reset();
+  shiftedBits = 0;
+}
+
+void tearDown()
+{
+}
+
+// each numeric tube lights exactly the digit of the value, signs and decimal points follow the flags
+void test_watt_frames()
+{
+  Display display(display_type::grid_power, value_type::watts, false, PIN_DATA, PIN_STORE, PIN_SHIFT, PIN_BLANK, PIN_LEDCTL);
+
+  for (long watts = -999999; watts <= 999999; watts += 37)
+  {
+    setValue(display, watts, false, false);
+  }
+  for (long centiwatts = -10000; centiwatts <= 10000; centiwatts++)
+  {
+    setValue(display, centiwatts / 100.0, false, false);
+  }
+  setValue(display, 2e6, false, false);
+}
+
+// the battery board has the overall status tube
+void test_percent_frames()
+{
+  Display display(display_type::battery_charge, value_type::battery_charge, true, PIN_DATA, PIN_STORE, PIN_SHIFT, PIN_BLANK, PIN_LEDCTL);
+
+  for (int tenths = -10; tenths <= 1010; tenths++)
+  {
+    setValue(display, tenths / 10.0, true, (tenths % 2) == 0);
+  }
+}
+
+// the frame of a cleared board is empty
+void test_cleared_frame()
+{
+  Display display(display_type::solar_power, value_type::watts, true, PIN_DATA, PIN_STORE, PIN_SHIFT, PIN_BLANK, PIN_LEDCTL);
+
+  setValue(display, 1234, false, true);
+  display.clear();
+  TEST_ASSERT_EQUAL_HEX64(0, display.buildFrame());
+}
+
+// building and shifting the frames grows linearly with the chain, one register per bit
+void test_frame_cost()
+{
+  static Display *displays[BENCHMARK_MAX_BOARDS];
+  static const int boardCounts[] = {5, 10, 20};
+  char message[96];
+
+  for (int i = 0; i < BENCHMARK_MAX_BOARDS; i++)
+  {
+    displays[i] = new Display(display_type::solar_power, value_type::watts, false, PIN_DATA, PIN_STORE, PIN_SHIFT, PIN_BLANK, PIN_LEDCTL);
+    DISPLAY_VALUE value = {0};
+    Helper::convertDoubleToDisplayValue(100 * i + 1.5, value);
+    displays[i]->setValues(value);
+  }
+  Native::onWrite = onWrite;
+  for (int boardCount : boardCounts)
+  {
+    shiftedBits = 0;
+    clock_t start = clock();
+    for (int frame = 0; frame < BENCHMARK_FRAMES; frame++)
+    {
+      for (int i = 0; i < boardCount; i++)
+      {
+        displays[i]->setRegisters();
+      }
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    TEST_ASSERT_EQUAL_UINT32((unsigned long)BENCHMARK_FRAMES * boardCount * REGISTERCOUNT, shiftedBits);
+    snprintf(message, sizeof(message), "%d boards: %.2f us per frame, %.2f us per board",
+             boardCount, seconds * 1e6 / BENCHMARK_FRAMES, seconds * 1e6 / BENCHMARK_FRAMES / boardCount);
+    TEST_MESSAGE(message);
+  }
+  Native::onWrite = nullptr;
+  for (int i = 0; i < BENCHMARK_MAX_BOARDS; i++)
+  {
+    delete displays[i];
+  }
+}
+
+// a transition of all boards of the longest chain is prepared and shifted out frame by frame well within the
+// step interval, every digit rolls forward to the new value within the maximum number of frames
+void test_transition_budget()
+{
+  static Display *displays[DISPLAY_MAX_COUNT];
+  static const int boardCounts[] = {5, DISPLAY_MAX_COUNT};
+  uint32_t seed = 4711;
+  char message[128];
+
+  for (int i = 0; i < DISPLAY_MAX_COUNT; i++)
+  {
+    displays[i] = new Display(display_type::solar_power, value_type::watts, false, PIN_DATA, PIN_STORE, PIN_SHIFT, PIN_BLANK, PIN_LEDCTL);
+    DISPLAY_VALUE value = {0};
+    Helper::convertDoubleToDisplayValue(100 + i, value);
+    displays[i]->setValues(value);
+    displays[i]->setRegisters();
+  }
+  Native::onWrite = onWrite;
+  for (int boardCount : boardCounts)
+  {
+    unsigned long frames = 0;
+    double seconds = 0;
+    for (int transition = 0; transition < BENCHMARK_TRANSITIONS; transition++)
+    {
+      // new values of three digits, the controller sets them before the transition
+      for (int i = 0; i < boardCount; i++)
+      {
+        seed = seed * 1103515245 + 12345;
+        DISPLAY_VALUE value = {0};
+        Helper::convertDoubleToDisplayValue(100 + (seed >> 16) % 900, value);
+        displays[i]->setValues(value);
+      }
+      clock_t start = clock();
+      uint8_t stepCount = 0;
+      for (int i = 0; i < boardCount; i++)
+      {
+        stepCount = max(stepCount, displays[i]->prepareTransition());
+      }
+      for (uint8_t step = 0; step < stepCount; step++)
+      {
+        for (int i = 0; i < boardCount; i++)
+        {
+          displays[i]->setSequenceRegisters(step);
+        }
+      }
+      seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+      frames += stepCount;
+      TEST_ASSERT_TRUE(stepCount <= TRANSITION_MAX_FRAMES);
+      for (int i = 0; (i < boardCount) && (stepCount > 0); i++)
+      {
+        // the last frame of a board shows the new value
+        displays[i]->setSequenceRegisters(stepCount - 1);
+        TEST_ASSERT_EQUAL_HEX64(displays[i]->buildFrame(), shiftedFrame);
+      }
+    }
+    double fps = frames / seconds;
+    snprintf(message, sizeof(message), "%d boards: %lu transition frames, %.2f us per frame, %.0f fps possible",
+             boardCount, frames, seconds * 1e6 / frames, fps);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(fps >= TRANSITION_MIN_FPS);
+  }
+  Native::onWrite = nullptr;
+  for (int i = 0; i < DISPLAY_MAX_COUNT; i++)
+  {
+    delete displays[i];
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_watt_frames);
+  RUN_TEST(test_percent_frames);
+  RUN_TEST(test_cleared_frame);
+  RUN_TEST(test_frame_cost);
+  RUN_TEST(test_transition_budget);
+  return (UNITY_END());
+}
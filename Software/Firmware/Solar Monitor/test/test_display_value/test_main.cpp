@@ -0,0 +1,196 @@
+// test_main.cpp
+
+// exhaustive test of the display value formatting, every integer from -999999 to 999999 and
+// a grid of fractional values are compared with a reference model using exact integer arithmetic,
+// also reports the conversion throughput
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <time.h>
+#include <Helper.hpp>
+
+// the fractional grid has steps of 1/64, exact in a double
+#define GRID_DENOMINATOR 64
+#define GRID_WATTS_LIMIT 1100
+#define GRID_PERCENT_MIN -5
+#define GRID_PERCENT_MAX 105
+
+// expected display of numerator / denominator, rounded half away from zero
+static DISPLAY_VALUE reference(long long numerator, long long denominator, bool percent)
+{
+  static const long long factors[] = {100, 10, 1};
+  DISPLAY_VALUE value = {0};
+  long long magnitude = (numerator < 0) ? -numerator : numerator;
+
+  // below 0.5 is 0
+  if (2 * magnitude < denominator)
+  {
+    numerator = 0;
+    magnitude = 0;
+  }
+  if ((magnitude > 999999 * denominator) || (percent && ((numerator < 0) || (numerator > 100 * denominator))))
+  {
+    value.errorFlag = true;
+    return (value);
+  }
+
+  value.percentageFlag = percent;
+  value.wattFlag = !percent;
+  value.minusFlag = !percent && (numerator < 0);
+  value.plusFlag = !percent && (numerator > 0);
+  for (long long unit : {1LL, 1000LL})
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      long long divisor = denominator * unit;
+      long long scaled = (2 * magnitude * factors[i] + divisor) / (2 * divisor);
+      if (scaled < 1000)
+      {
+        value.kiloFlag = (unit == 1000);
+        value.digits[0] = scaled / 100;
+        value.digits[1] = (scaled / 10) % 10;
+        value.digits[2] = scaled % 10;
+        value.decimalIndex = (i == 2) ? 0 : DISPLAY_DIGITS - (2 - i);
+        return (value);
+      }
+    }
+  }
+  value.errorFlag = true;
+  return (value);
+}
+
+// compares the converted value with the reference, returns false on a difference
+static bool check(long long numerator, long long denominator, bool percent)
+{
+  DISPLAY_VALUE expected = reference(numerator, denominator, percent);
+  DISPLAY_VALUE actual = {0};
+  bool result = Helper::convertDoubleToDisplayValue((double)numerator / denominator, actual, percent);
+
+  if (expected.errorFlag || !result)
+  {
+    return (expected.errorFlag && actual.errorFlag && !result);
+  }
+  return ((actual.errorFlag == false) &&
+          (actual.minusFlag == expected.minusFlag) &&
+          (actual.plusFlag == expected.plusFlag) &&
+          (actual.percentageFlag == expected.percentageFlag) &&
+          (actual.kiloFlag == expected.kiloFlag) &&
+          (actual.wattFlag == expected.wattFlag) &&
+          (actual.decimalIndex == expected.decimalIndex) &&
+          (memcmp(actual.digits, expected.digits, sizeof(actual.digits)) == 0));
+}
+
+// reports the first differences of a sweep
+static void report(long long numerator, long long denominator, bool percent, long *mismatches)
+{
+  char message[96];
+
+  if (!check(numerator, denominator, percent) && ((*mismatches)++ < 5))
+  {
+    snprintf(message, sizeof(message), "mismatch at %lld/%lld%s", numerator, denominator, percent ? " %" : "");
+    TEST_MESSAGE(message);
+  }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// all integer watts, including the kilo range, the rounding carry and the overflow
+void test_all_integers()
+{
+  long mismatches = 0;
+
+  for (long long watts = -999999; watts <= 999999; watts++)
+  {
+    report(watts, 1, false, &mismatches);
+  }
+  TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+// fractional watts around the decimal point shifts and the kilo switch at 999.5
+void test_fractional_watts()
+{
+  long mismatches = 0;
+
+  for (long long numerator = -GRID_WATTS_LIMIT * GRID_DENOMINATOR; numerator <= GRID_WATTS_LIMIT * GRID_DENOMINATOR; numerator++)
+  {
+    report(numerator, GRID_DENOMINATOR, false, &mismatches);
+  }
+  TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+// percent values including the limits 0 and 100
+void test_fractional_percent()
+{
+  long mismatches = 0;
+
+  for (long long numerator = GRID_PERCENT_MIN * GRID_DENOMINATOR; numerator <= GRID_PERCENT_MAX * GRID_DENOMINATOR; numerator++)
+  {
+    report(numerator, GRID_DENOMINATOR, true, &mismatches);
+  }
+  TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+// known values, the halves are rounded up also in the kilo range
+void test_known_values()
+{
+  DISPLAY_VALUE value = {0};
+
+  TEST_ASSERT_TRUE(Helper::convertDoubleToDisplayValue(1005, value));
+  TEST_ASSERT_TRUE(value.kiloFlag);
+  TEST_ASSERT_EQUAL_UINT8(1, value.digits[0]);
+  TEST_ASSERT_EQUAL_UINT8(0, value.digits[1]);
+  TEST_ASSERT_EQUAL_UINT8(1, value.digits[2]);
+  TEST_ASSERT_EQUAL_UINT8(1, value.decimalIndex);
+
+  TEST_ASSERT_TRUE(Helper::convertDoubleToDisplayValue(999.5, value));
+  TEST_ASSERT_TRUE(value.kiloFlag);
+  TEST_ASSERT_EQUAL_UINT8(1, value.digits[0]);
+  TEST_ASSERT_EQUAL_UINT8(1, value.decimalIndex);
+
+  TEST_ASSERT_TRUE(Helper::convertDoubleToDisplayValue(-0.4, value));
+  TEST_ASSERT_FALSE(value.minusFlag);
+  TEST_ASSERT_FALSE(value.plusFlag);
+
+  TEST_ASSERT_TRUE(Helper::convertDoubleToDisplayValue(999499, value));
+  TEST_ASSERT_FALSE(Helper::convertDoubleToDisplayValue(999500, value));
+  TEST_ASSERT_TRUE(value.errorFlag);
+  TEST_ASSERT_FALSE(Helper::convertDoubleToDisplayValue(100.6, value, true));
+}
+
+// reports the time per conversion on the host
+void test_throughput()
+{
+  DISPLAY_VALUE value = {0};
+  volatile uint8_t sink = 0;
+  char message[64];
+  clock_t start = clock();
+
+  for (long watts = -999999; watts <= 999999; watts++)
+  {
+    Helper::convertDoubleToDisplayValue(watts * 1.01, value);
+    sink += value.digits[0];
+  }
+  double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  snprintf(message, sizeof(message), "%.1f ns per value", seconds * 1e9 / 1999999);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_all_integers);
+  RUN_TEST(test_fractional_watts);
+  RUN_TEST(test_fractional_percent);
+  RUN_TEST(test_known_values);
+  RUN_TEST(test_throughput);
+  return (UNITY_END());
+}
@@ -0,0 +1,302 @@
+// test_main.cpp
+
+// tests of the firmware download, a generated image is served by a simulated HTTP server in small pieces
+// and written to a simulated partition, covers a complete image, a truncated or stalled body, a wrong MD5 hash,
+// a missing content length and failing connections and writes
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <string>
+#include <FirmwareUpdate.hpp>
+
+#define IMAGE_SIZE 10000
+#define IMAGE_MD5 "285e66fcb60703d5714a88a5af5a00a2" // of the generated image
+#define OTHER_MD5 "00112233445566778899aabbccddeeff"
+#define PIECE_SIZE 700 // bytes available at once, less than a chunk like a busy socket
+
+// HTTP server answering the image request with a prepared response
+class ServerClient : public Client
+{
+public:
+  std::string response;
+  std::string request;
+  size_t cut = SIZE_MAX;    // the server sends no more than this
+  bool closeAtCut = true;   // the server closes the connection at the cut, otherwise it stops sending
+  bool reachable = true;
+  size_t position = 0;
+  bool open = false;
+
+  int connect(IPAddress, uint16_t port) override
+  {
+    return (connect("", port));
+  }
+
+  int connect(const char *, uint16_t) override
+  {
+    open = reachable;
+    return (open ? 1 : 0);
+  }
+
+  size_t write(uint8_t c) override
+  {
+    request += (char)c;
+    return (1);
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    request.append((const char *)buffer, size);
+    return (size);
+  }
+
+  int available() override
+  {
+    return ((int)min((size_t)PIECE_SIZE, getRemaining()));
+  }
+
+  int read() override
+  {
+    return ((getRemaining() > 0) ? (uint8_t)response[position++] : -1);
+  }
+
+  int read(uint8_t *buffer, size_t size) override
+  {
+    size_t count = min(size, getRemaining());
+    memcpy(buffer, response.data() + position, count);
+    position += count;
+    return ((int)count);
+  }
+
+  uint8_t connected() override
+  {
+    return (open && ((getRemaining() > 0) || !closeAtCut));
+  }
+
+  void stop() override
+  {
+    open = false;
+  }
+
+private:
+  size_t getRemaining() const
+  {
+    return (open ? min(response.size(), cut) - position : 0);
+  }
+};
+
+// partition accepting the image if it is complete and has the expected hash
+class PartitionWriter : public FirmwareWriter
+{
+public:
+  std::string data;
+  char md5[UPDATE_MD5_SIZE] = {0};
+  size_t size = 0;
+  size_t maxWrite = 0;
+  size_t failAt = SIZE_MAX; // writes beyond fail
+  bool begun = false;
+  bool aborted = false;
+  bool bootable = false;
+
+  bool begin(size_t imageSize) override
+  {
+    begun = true;
+    size = imageSize;
+    return (true);
+  }
+
+  bool setMD5(const char *hash) override
+  {
+    snprintf(md5, sizeof(md5), "%s", hash);
+    return (true);
+  }
+
+  size_t write(uint8_t *buffer, size_t length) override
+  {
+    if (data.size() + length > failAt)
+    {
+      return (0);
+    }
+    data.append((const char *)buffer, length);
+    maxWrite = max(maxWrite, length);
+    return (length);
+  }
+
+  // the hash of the generated image is known, any other content would have another hash
+  bool end() override
+  {
+    bootable = (data.size() == size) && (data == image) && (strcasecmp(md5, IMAGE_MD5) == 0);
+    return (bootable);
+  }
+
+  void abort() override
+  {
+    aborted = true;
+  }
+
+  uint8_t getError() override
+  {
+    return (bootable ? 0 : 9);
+  }
+
+  static std::string image;
+};
+
+std::string PartitionWriter::image;
+
+static FirmwareUpdate *update;
+static ServerClient *server;
+static PartitionWriter *writer;
+
+static void setResponse(const char *headers, bool withBody = true)
+{
+  server->response = headers;
+  server->response += "\r\n";
+  if (withBody)
+  {
+    server->response += PartitionWriter::image;
+  }
+}
+
+static int request(const char *url, const char *md5)
+{
+  char text[256];
+
+  snprintf(text, sizeof(text), "url=%s&md5=%s", url, md5);
+  return (update->request(text));
+}
+
+static int run(const char *md5 = IMAGE_MD5)
+{
+  TEST_ASSERT_EQUAL(ERR_SUCCESS, request("http://192.168.1.10:8080/firmware.bin", md5));
+  TEST_ASSERT_TRUE(update->isRequested());
+  return (update->run(*server, *writer));
+}
+
+void setUp()
+{
+  Native::reset();
+  if (PartitionWriter::image.empty())
+  {
+    for (int i = 0; i < IMAGE_SIZE; i++)
+    {
+      PartitionWriter::image += (char)((((i * 7919) >> 3) ^ i) & 0xff);
+    }
+  }
+  update = new FirmwareUpdate();
+  server = new ServerClient();
+  writer = new PartitionWriter();
+  setResponse("HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: 10000\r\n");
+}
+
+void tearDown()
+{
+  delete update;
+  delete server;
+  delete writer;
+}
+
+// the image is requested from the server and written in chunks of at most one buffer
+void test_good_image()
+{
+  TEST_ASSERT_EQUAL(ERR_SUCCESS, run());
+  TEST_ASSERT_EQUAL(0, server->request.find("GET /firmware.bin HTTP/1.1\r\nHost: 192.168.1.10\r\n"));
+  TEST_ASSERT_TRUE(writer->bootable);
+  TEST_ASSERT_FALSE(writer->aborted);
+  TEST_ASSERT_EQUAL(IMAGE_SIZE, writer->size);
+  TEST_ASSERT_TRUE(writer->maxWrite <= UPDATE_CHUNK_SIZE);
+  TEST_ASSERT_TRUE(update->getState() == update_state::done);
+  TEST_ASSERT_FALSE(server->open);
+}
+
+// a connection closed before the end of the image aborts the update
+void test_truncated_body()
+{
+  server->cut = server->response.size() - 4000;
+  TEST_ASSERT_EQUAL(ERR_UPDATE_TIMEOUT, run());
+  TEST_ASSERT_EQUAL(IMAGE_SIZE - 4000, writer->data.size());
+  TEST_ASSERT_TRUE(writer->aborted);
+  TEST_ASSERT_FALSE(writer->bootable);
+  TEST_ASSERT_TRUE(update->getState() == update_state::failed);
+}
+
+// a server that stops sending is given up after the timeout
+void test_stalled_body()
+{
+  server->cut = server->response.size() - 1;
+  server->closeAtCut = false;
+  TEST_ASSERT_EQUAL(ERR_UPDATE_TIMEOUT, run());
+  TEST_ASSERT_TRUE(millis() >= UPDATE_TIMEOUT);
+  TEST_ASSERT_TRUE(writer->aborted);
+}
+
+// a complete image with another hash does not become bootable
+void test_bad_md5()
+{
+  TEST_ASSERT_EQUAL(ERR_UPDATE_VERIFY, run(OTHER_MD5));
+  TEST_ASSERT_EQUAL(IMAGE_SIZE, writer->data.size());
+  TEST_ASSERT_FALSE(writer->bootable);
+}
+
+// without the size the partition is not touched
+void test_missing_content_length()
+{
+  setResponse("HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n");
+  TEST_ASSERT_EQUAL(ERR_UPDATE_HTTP, run());
+  TEST_ASSERT_FALSE(writer->begun);
+}
+
+// an error response is not written
+void test_not_found()
+{
+  setResponse("HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n", false);
+  server->response += "not found";
+  TEST_ASSERT_EQUAL(ERR_UPDATE_HTTP, run());
+  TEST_ASSERT_FALSE(writer->begun);
+}
+
+void test_unreachable_server()
+{
+  server->reachable = false;
+  TEST_ASSERT_EQUAL(ERR_UPDATE_CONNECT, run());
+  TEST_ASSERT_FALSE(writer->begun);
+}
+
+// a failing flash write aborts the update
+void test_write_error()
+{
+  writer->failAt = 5000;
+  TEST_ASSERT_EQUAL(ERR_UPDATE_WRITE, run());
+  TEST_ASSERT_TRUE(writer->aborted);
+  TEST_ASSERT_TRUE(writer->data.size() <= 5000);
+}
+
+// invalid requests are refused, a running update is not replaced
+void test_requests()
+{
+  TEST_ASSERT_EQUAL(ERR_UPDATE_REQUEST, request("ftp://192.168.1.10/firmware.bin", IMAGE_MD5));
+  TEST_ASSERT_EQUAL(ERR_UPDATE_REQUEST, request("http://192.168.1.10", IMAGE_MD5));
+  TEST_ASSERT_EQUAL(ERR_UPDATE_REQUEST, request("http://192.168.1.10:70000/firmware.bin", IMAGE_MD5));
+  TEST_ASSERT_EQUAL(ERR_UPDATE_REQUEST, request("http://192.168.1.10/firmware.bin", "285e66fcb607"));
+  TEST_ASSERT_EQUAL(ERR_UPDATE_REQUEST, request("http://192.168.1.10/firmware.bin", "x85e66fcb60703d5714a88a5af5a00a2"));
+  TEST_ASSERT_FALSE(update->isRequested());
+  TEST_ASSERT_EQUAL(ERR_SUCCESS, request("http://192.168.1.10/firmware.bin", IMAGE_MD5));
+  TEST_ASSERT_EQUAL(ERR_UPDATE_BUSY, request("http://192.168.1.10/other.bin", IMAGE_MD5));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_good_image);
+  RUN_TEST(test_truncated_body);
+  RUN_TEST(test_stalled_body);
+  RUN_TEST(test_bad_md5);
+  RUN_TEST(test_missing_content_length);
+  RUN_TEST(test_not_found);
+  RUN_TEST(test_unreachable_server);
+  RUN_TEST(test_write_error);
+  RUN_TEST(test_requests);
+  return (UNITY_END());
+}
@@ -0,0 +1,161 @@
+// test_main.cpp
+
+// tests of the ambient light sensor against a simulated BH1750 on the I2C bus, covers the start of the
+// continuous measurement, reads that never wait and happen once per read interval, the smoothing filter,
+// a missing or failing sensor and the mapping of the light to the tube brightness
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <LightSensor.hpp>
+
+#define PIN_SDA 21
+#define PIN_SCL 22
+
+static LightSensor *sensor;
+static float lux; // falling on the sensor
+
+// calls process() every millisecond like the scheduler would at most, returns the number of new values
+static unsigned long runFor(unsigned long duration)
+{
+  unsigned long values = 0;
+
+  for (unsigned long ms = 0; ms < duration; ms++)
+  {
+    unsigned long before = micros();
+    values += sensor->process() ? 1 : 0;
+    // reading the last measurement does not wait for the sensor
+    TEST_ASSERT_EQUAL_UINT32(before, micros());
+    delay(1);
+  }
+  return (values);
+}
+
+// returns the brightness for a constant light, read by a new sensor
+static uint8_t getBrightness(float light)
+{
+  LightSensor fresh(PIN_SDA, PIN_SCL);
+
+  lux = light;
+  fresh.begin();
+  delay(AMBIENT_READ_INTERVAL);
+  TEST_ASSERT_TRUE(fresh.process());
+  return (fresh.getBrightness());
+}
+
+void setUp()
+{
+  Native::reset();
+  Wire.reset();
+  Wire.light = []()
+  {
+    return (lux);
+  };
+  lux = 100;
+  sensor = new LightSensor(PIN_SDA, PIN_SCL);
+}
+
+void tearDown()
+{
+  delete sensor;
+}
+
+// the sensor is powered on and measures continuously, a stuck bus cannot block the loop
+void test_begin()
+{
+  TEST_ASSERT_TRUE(sensor->begin());
+  TEST_ASSERT_EQUAL(2, Wire.commands.size());
+  TEST_ASSERT_EQUAL_UINT8(BH1750_POWER_ON, Wire.commands[0]);
+  TEST_ASSERT_EQUAL_UINT8(BH1750_CONTINUOUS_HIGH_RES, Wire.commands[1]);
+  TEST_ASSERT_TRUE(Wire.timeout > 0);
+  TEST_ASSERT_FALSE(sensor->isValid());
+  TEST_ASSERT_EQUAL_UINT8(100, sensor->getBrightness());
+}
+
+// the sensor is read once per interval, the time to the next read tells the main loop how long to sleep
+void test_read_interval()
+{
+  sensor->begin();
+  TEST_ASSERT_EQUAL_UINT32(AMBIENT_READ_INTERVAL, sensor->getTimeToNextRead());
+  delay(AMBIENT_READ_INTERVAL / 4);
+  TEST_ASSERT_EQUAL_UINT32(AMBIENT_READ_INTERVAL * 3 / 4, sensor->getTimeToNextRead());
+  TEST_ASSERT_EQUAL_UINT32(10, runFor(10 * AMBIENT_READ_INTERVAL));
+  TEST_ASSERT_EQUAL_UINT32(10, Wire.requests);
+  TEST_ASSERT_TRUE(sensor->isValid());
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 100, sensor->getLux());
+}
+
+// the first value is taken as it is, later values are smoothed
+void test_filter()
+{
+  lux = 10;
+  sensor->begin();
+  runFor(AMBIENT_READ_INTERVAL + 1);
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 10, sensor->getLux());
+
+  lux = 200;
+  float expected = sensor->getLux();
+  for (int i = 0; i < 10; i++)
+  {
+    runFor(AMBIENT_READ_INTERVAL);
+    expected += AMBIENT_FILTER * (200 - expected);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, expected, sensor->getLux());
+  }
+  // a shadow of one reading moves the value only by the filter weight
+  lux = 0;
+  runFor(AMBIENT_READ_INTERVAL);
+  TEST_ASSERT_FLOAT_WITHIN(0.5, expected * (1 - AMBIENT_FILTER), sensor->getLux());
+}
+
+// without a sensor there is no value and no deadline, a failing read keeps the last value
+void test_missing_sensor()
+{
+  Wire.present = false;
+  TEST_ASSERT_FALSE(sensor->begin());
+  TEST_ASSERT_EQUAL_UINT32(NO_DEADLINE, sensor->getTimeToNextRead());
+  TEST_ASSERT_EQUAL_UINT32(0, runFor(3 * AMBIENT_READ_INTERVAL));
+  TEST_ASSERT_EQUAL_UINT32(0, Wire.requests);
+  TEST_ASSERT_EQUAL_UINT8(100, sensor->getBrightness());
+
+  Wire.present = true;
+  TEST_ASSERT_TRUE(sensor->begin());
+  runFor(AMBIENT_READ_INTERVAL + 1);
+  float value = sensor->getLux();
+  Wire.present = false;
+  TEST_ASSERT_EQUAL_UINT32(0, runFor(3 * AMBIENT_READ_INTERVAL));
+  TEST_ASSERT_EQUAL_UINT32(3, Wire.failures);
+  TEST_ASSERT_TRUE(sensor->isValid());
+  TEST_ASSERT_EQUAL_FLOAT(value, sensor->getLux());
+}
+
+// the brightness rises on a logarithmic scale from the minimum in the dark to full in bright light
+void test_brightness_mapping()
+{
+  TEST_ASSERT_EQUAL_UINT8(AMBIENT_MIN_BRIGHTNESS, getBrightness(0));
+  TEST_ASSERT_EQUAL_UINT8(AMBIENT_MIN_BRIGHTNESS, getBrightness(AMBIENT_DARK_LUX));
+  TEST_ASSERT_EQUAL_UINT8(100, getBrightness(AMBIENT_BRIGHT_LUX));
+  TEST_ASSERT_EQUAL_UINT8(100, getBrightness(50000));
+  // the geometric mean of dark and bright is half way
+  TEST_ASSERT_UINT32_WITHIN(1, (AMBIENT_MIN_BRIGHTNESS + 100) / 2, getBrightness(sqrt(AMBIENT_DARK_LUX * AMBIENT_BRIGHT_LUX)));
+
+  uint8_t last = 0;
+  for (float light = 0; light <= 2 * AMBIENT_BRIGHT_LUX; light += 0.5)
+  {
+    uint8_t brightness = getBrightness(light);
+    TEST_ASSERT_TRUE(brightness >= last);
+    last = brightness;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_begin);
+  RUN_TEST(test_read_interval);
+  RUN_TEST(test_filter);
+  RUN_TEST(test_missing_sensor);
+  RUN_TEST(test_brightness_mapping);
+  return (UNITY_END());
+}
@@ -0,0 +1,243 @@
+// test_main.cpp
+
+// tests of the deferred logger, covers the formatting of the stored arguments with their conversions
+// and widths, the prefix of the lines, full buffers counting the dropped messages and the cost of a
+// call compared to formatting and printing on serial at once
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Logger.hpp>
+
+#define PREFIX_LENGTH 19 // time, level and module
+#define BENCHMARK_CALLS 204800
+#define UART_BYTE_TIME 86.8 // in us, 115200 baud 8N1
+#define UART_FIFO_SIZE 128
+
+// collects the printed lines
+class LineCollector : public Print
+{
+public:
+  std::vector<std::string> lines;
+
+  size_t write(uint8_t c) override
+  {
+    if (c == '\n')
+    {
+      lines.push_back(_line);
+      _line.clear();
+    }
+    else if (c != '\r')
+    {
+      _line += (char)c;
+    }
+    return (1);
+  }
+
+private:
+  std::string _line;
+};
+
+// serial port sending at 115200 baud, print blocks while the transmit FIFO is full
+class UartModel : public Print
+{
+public:
+  double blocked = 0; // in us
+
+  size_t write(uint8_t) override
+  {
+    // a full FIFO blocks for the time of one byte
+    if (_fill >= UART_FIFO_SIZE)
+    {
+      blocked += UART_BYTE_TIME;
+    }
+    else
+    {
+      _fill++;
+    }
+    return (1);
+  }
+
+  using Print::write;
+
+  // sends for the given time
+  void drain(double us)
+  {
+    _fill = (unsigned long)max(0.0, _fill - us / UART_BYTE_TIME);
+  }
+
+private:
+  unsigned long _fill = 0;
+};
+
+static LineCollector *out;
+
+// returns the message of the only line printed, without the prefix
+template <typename... Args>
+static std::string format(const char *text, Args... args)
+{
+  out->lines.clear();
+  Logger::get().log(LOG_LEVEL_INFO, LOG_MAIN, text, args...);
+  TEST_ASSERT_EQUAL_UINT32(1, Logger::get().flush(*out));
+  TEST_ASSERT_EQUAL(1, out->lines.size());
+  TEST_ASSERT_TRUE(out->lines[0].length() >= PREFIX_LENGTH);
+  return (out->lines[0].substr(PREFIX_LENGTH));
+}
+
+void setUp()
+{
+  Native::reset();
+  out = new LineCollector();
+  // messages of a previous test
+  Logger::get().flush(*out);
+  out->lines.clear();
+}
+
+void tearDown()
+{
+  delete out;
+}
+
+// the lines start with the time in seconds, the level and the module
+void test_prefix()
+{
+  Native::advance(12345);
+  Logger::get().log(LOG_LEVEL_WARNING, LOG_NETWORK, "link down");
+  Native::advance(1000);
+  Logger::get().log(LOG_LEVEL_VERBOSE, LOG_SCHEDULER, "run");
+  TEST_ASSERT_EQUAL_UINT32(2, Logger::get().flush(*out));
+  TEST_ASSERT_EQUAL_STRING("    12.345 W net   link down", out->lines[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("    13.345 V sched run", out->lines[1].c_str());
+}
+
+// each argument is formatted as the type it has been stored with, the conversion of the format string
+// adds flags, width and precision
+void test_arguments()
+{
+  TEST_ASSERT_EQUAL_STRING("Error: -3 Ethernet link down", format("Error: %d %s", -3, "Ethernet link down").c_str());
+  TEST_ASSERT_EQUAL_STRING("DHCP assigned IP: 192.168.1.20", format("DHCP assigned IP: %u.%u.%u.%u", 192, 168, 1, 20).c_str());
+  TEST_ASSERT_EQUAL_STRING("4000000000 bytes", format("%u bytes", 4000000000U).c_str());
+  TEST_ASSERT_EQUAL_STRING("latency 12 ms", format("latency %lu ms", 12UL).c_str());
+  TEST_ASSERT_EQUAL_STRING("-5 C", format("%ld C", -5L).c_str());
+  TEST_ASSERT_EQUAL_STRING("123.5 lux", format("%.1f lux", 123.456).c_str());
+  TEST_ASSERT_EQUAL_STRING("1.5e+03", format("%.1e", 1500.0).c_str());
+  TEST_ASSERT_EQUAL_STRING("(null)", format("%s", (const char *)nullptr).c_str());
+
+  // the stored type wins over a conversion that does not fit
+  TEST_ASSERT_EQUAL_STRING("42", format("%s", 42).c_str());
+  TEST_ASSERT_EQUAL_STRING("2.50", format("%.2d", 2.5).c_str());
+  TEST_ASSERT_EQUAL_STRING("ff", format("%x", 255).c_str());
+}
+
+// widths, flags and the percent sign
+void test_widths()
+{
+  TEST_ASSERT_EQUAL_STRING("Battery Charge % 55", format("Battery Charge %% %.0f", 54.6).c_str());
+  TEST_ASSERT_EQUAL_STRING("100%", format("%d%%", 100).c_str());
+  TEST_ASSERT_EQUAL_STRING("[   42]", format("[%5d]", 42).c_str());
+  TEST_ASSERT_EQUAL_STRING("[42   ]", format("[%-5d]", 42).c_str());
+  TEST_ASSERT_EQUAL_STRING("[007]", format("[%03u]", 7U).c_str());
+  TEST_ASSERT_EQUAL_STRING("[ 3.14]", format("[%5.2f]", 3.14159).c_str());
+  TEST_ASSERT_EQUAL_STRING("[+3.1]", format("[%+.1f]", 3.14159).c_str());
+  TEST_ASSERT_EQUAL_STRING("[ab   ]", format("[%-5s]", "ab").c_str());
+  TEST_ASSERT_EQUAL_STRING(" A: B:0C", format("%2X:%2X:%02X", 0xa, 0xb, 0xc).c_str());
+
+  // conversions without an argument are printed as they are
+  TEST_ASSERT_EQUAL_STRING("1 %d", format("%d %d", 1).c_str());
+  TEST_ASSERT_EQUAL_STRING("no arguments %s", format("no arguments %s").c_str());
+}
+
+// a message longer than a line is cut
+void test_long_message()
+{
+  char text[2 * LOG_LINE_LENGTH];
+
+  memset(text, 'x', sizeof(text) - 1);
+  text[sizeof(text) - 1] = 0;
+  std::string message = format("%s", (const char *)text);
+  TEST_ASSERT_EQUAL(LOG_LINE_LENGTH - 1 - PREFIX_LENGTH, message.length());
+}
+
+// a full buffer drops the new messages and counts them, the next flush reports the count once
+void test_dropped()
+{
+  for (int i = 0; i < LOG_BUFFER_SIZE + 5; i++)
+  {
+    Logger::get().log(LOG_LEVEL_INFO, LOG_MAIN, "message %d", i);
+  }
+  TEST_ASSERT_EQUAL_UINT32(LOG_BUFFER_SIZE, Logger::get().flush(*out));
+  TEST_ASSERT_EQUAL(LOG_BUFFER_SIZE + 1, out->lines.size());
+  // the oldest messages are kept
+  TEST_ASSERT_EQUAL_STRING("message 0", out->lines[0].substr(PREFIX_LENGTH).c_str());
+  TEST_ASSERT_EQUAL_STRING("message 63", out->lines[LOG_BUFFER_SIZE - 1].substr(PREFIX_LENGTH).c_str());
+  TEST_ASSERT_EQUAL_STRING("5 log messages dropped", out->lines[LOG_BUFFER_SIZE].c_str());
+
+  // the buffer is free again and the count is cleared
+  out->lines.clear();
+  TEST_ASSERT_EQUAL_STRING("message 1", format("message %d", 1).c_str());
+  out->lines.clear();
+  TEST_ASSERT_EQUAL_UINT32(0, Logger::get().flush(*out));
+  TEST_ASSERT_EQUAL(0, out->lines.size());
+}
+
+// a call stores the message and returns, formatting and printing on serial at once blocks the caller
+// as soon as the transmit FIFO is full
+void test_call_cost()
+{
+  UartModel uart;
+  LineCollector sink;
+  char line[LOG_LINE_LENGTH];
+  char message[128];
+  volatile size_t length = 0;
+  std::chrono::steady_clock::duration elapsed(0);
+
+  // batches of half the buffer, the logger task prints them in between
+  for (int i = 0; i < BENCHMARK_CALLS; i += LOG_BUFFER_SIZE / 2)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for (int j = i; j < i + LOG_BUFFER_SIZE / 2; j++)
+    {
+      Logger::get().log(LOG_LEVEL_INFO, LOG_SENSORS, "Ambient light: %.1f lux, brightness %u", 123.4 + j, (unsigned int)j);
+    }
+    elapsed += std::chrono::steady_clock::now() - start;
+    TEST_ASSERT_EQUAL_UINT32(LOG_BUFFER_SIZE / 2, Logger::get().flush(sink));
+    sink.lines.clear();
+  }
+  double logged = std::chrono::duration<double, std::nano>(elapsed).count() / BENCHMARK_CALLS;
+  // the log calls do not wait
+  TEST_ASSERT_EQUAL_UINT32(0, micros());
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCHMARK_CALLS; i++)
+  {
+    snprintf(line, sizeof(line), "Ambient light: %.1f lux, brightness %u", 123.4 + i, (unsigned int)i);
+    length += uart.println(line);
+    // one message per loop pass of a millisecond
+    uart.drain(1000);
+  }
+  double printed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCHMARK_CALLS;
+  double blocked = uart.blocked / BENCHMARK_CALLS;
+
+  snprintf(message, sizeof(message), "log(): %.1f ns per call, Serial.print: %.1f ns per call and %.0f us blocked on the UART",
+           logged, printed, blocked);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(logged < printed);
+  TEST_ASSERT_TRUE(blocked > 1000);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_prefix);
+  RUN_TEST(test_arguments);
+  RUN_TEST(test_widths);
+  RUN_TEST(test_long_message);
+  RUN_TEST(test_dropped);
+  RUN_TEST(test_call_cost);
+  return (UNITY_END());
+}
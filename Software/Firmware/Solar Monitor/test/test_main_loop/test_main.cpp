@@ -0,0 +1,149 @@
+// test_main.cpp
+
+// measures the wakeups of the main loop per second, a proxy for the CPU load and the current draw,
+// the whole controller runs in simulated time with its tasks, the sensors and the inverter on the network
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <Controller.hpp>
+#include <NativeInverter.h>
+
+#define MEASURE_TIME (10 * 60000UL) // in ms
+
+static Controller *controller;
+
+static INVERTER_VALUES getValues()
+{
+  return (INVERTER_VALUES{80.0, -1200.0, 0.0, 1800.0, 3000.0, 100.0, 60.0});
+}
+
+// runs the main loop like loop() for the given time, returns the number of wakeups
+static unsigned long run(unsigned long duration)
+{
+  unsigned long wakeups = 0;
+  unsigned long end = millis() + duration;
+
+  while (millis() < end)
+  {
+    TEST_ASSERT_TRUE(controller->process());
+    controller->waitForEvent();
+    wakeups++;
+    // a loop which does not wait would never end
+    TEST_ASSERT_TRUE(wakeups <= duration);
+  }
+  return (wakeups);
+}
+
+// clicks the button, the backlight mode changes
+static void click()
+{
+  Native::setPin(PIN_BUTTON1, LOW);
+  run(100);
+  Native::setPin(PIN_BUTTON1, HIGH);
+  run(1000);
+}
+
+// runs the main loop and reports the wakeups per second
+static double measure(const char *name)
+{
+  char message[96];
+
+  double rate = run(MEASURE_TIME) * 1000.0 / MEASURE_TIME;
+  snprintf(message, sizeof(message), "%s: %.2f wakeups/s", name, rate);
+  TEST_MESSAGE(message);
+  return (rate);
+}
+
+void setUp()
+{
+  char settings[] = "inverter.address=" NATIVE_INVERTER_ADDRESS;
+
+  Native::reset();
+  Ethernet.reset();
+  Wire.reset();
+  Wire.light = []()
+  { return (150.0f); };
+  Native::ds18b20Present = true;
+  Native::ds18b20Temperature = 30.0;
+  Preferences::getStore().clear();
+  Config::get().begin();
+  Config::get().update(settings);
+  Config::get().apply();
+  Native::addInverter(getValues);
+
+  Native::setPin(PIN_BUTTON1, HIGH);
+  controller = new Controller();
+  TEST_ASSERT_EQUAL(ERR_SUCCESS, controller->begin());
+  // somebody is in the room, the network comes up and the first values are shown
+  Native::setPin(PIN_PIR, HIGH);
+  run(10000);
+  TEST_ASSERT_TRUE(controller->isHVON());
+}
+
+void tearDown()
+{
+  delete controller;
+}
+
+// with the tubes on the loop wakes up for the polling and the sensors, the backlight effects add
+// their frames only while they are shown
+void test_tubes_on()
+{
+  double rate = measure("Tubes on");
+  TEST_ASSERT_TRUE(rate < 2.0);
+
+  // full backlight
+  click();
+  click();
+  double animated = measure("Tubes on, backlight effects");
+  TEST_ASSERT_TRUE(animated > 1000.0 / FLOW_FRAME_INTERVAL);
+  TEST_ASSERT_TRUE(animated < rate + 1000.0 / FLOW_FRAME_INTERVAL + 1.0);
+}
+
+// with the tubes off only the sensors and the persistence remain
+void test_tubes_off()
+{
+  Native::setPin(PIN_PIR, LOW);
+  run(PIR_DELAY * 60000UL + TUBE_FADE_TIME + 1000);
+  TEST_ASSERT_FALSE(controller->isHVON());
+  double rate = measure("Tubes off");
+  TEST_ASSERT_TRUE(rate < 0.5);
+}
+
+// the loop sleeping with the tubes off is woken up by the PIR at once, not by its next deadline
+void test_wakeup_latency()
+{
+  esp_timer_handle_t timer;
+  esp_timer_create_args_t args = {[](void *)
+                                  { Native::setPin(PIN_PIR, HIGH); }, nullptr, ESP_TIMER_TASK, "motion", false};
+
+  Native::setPin(PIN_PIR, LOW);
+  run(PIR_DELAY * 60000UL + TUBE_FADE_TIME + 1000);
+  TEST_ASSERT_FALSE(controller->isHVON());
+
+  esp_timer_create(&args, &timer);
+  esp_timer_start_once(timer, 3333000);
+  unsigned long motion = millis() + 3333;
+  unsigned long wakeups = 0;
+  while (!controller->isHVON())
+  {
+    controller->waitForEvent();
+    controller->process();
+    wakeups++;
+  }
+  TEST_ASSERT_TRUE(millis() - motion <= 1);
+  TEST_ASSERT_TRUE(wakeups <= 3);
+  esp_timer_delete(timer);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_tubes_on);
+  RUN_TEST(test_tubes_off);
+  RUN_TEST(test_wakeup_latency);
+  return (UNITY_END());
+}
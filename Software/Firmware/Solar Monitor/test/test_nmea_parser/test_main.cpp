@@ -0,0 +1,162 @@
+// test_main.cpp
+
+// tests of the NMEA parser, a recorded receiver output is replayed, checksums are verified in both
+// hex cases and sentences split over several reads or interrupted by a new sentence are handled
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <NmeaParser.hpp>
+
+// output of a receiver, sentences without time, a fix, a lost fix and a date change at new year
+static const char *recording =
+    "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n"
+    "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74\r\n"
+    "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n"
+    "$GPZDA,201530.00,04,07,2002,00,00*60\r\n"
+    "$GPRMC,123519,V,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*7D\r\n"
+    "$GNRMC,235959.250,A,4807.038,N,01131.000,E,0.0,0.0,311224,,,A*73\r\n"
+    "$GNZDA,000000.00,01,01,2025,00,00*7D\r\n";
+
+static NmeaParser *parser;
+
+// feeds a text, returns the number of sentences with a valid time
+static int feed(const char *text, size_t length)
+{
+  int count = 0;
+
+  for (size_t i = 0; i < length; i++)
+  {
+    count += parser->encode(text[i]) ? 1 : 0;
+  }
+  return (count);
+}
+
+static int feed(const char *text)
+{
+  return (feed(text, strlen(text)));
+}
+
+static void checkTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second, uint16_t millisecond)
+{
+  const NMEA_TIME &time = parser->getTime();
+
+  TEST_ASSERT_EQUAL_UINT16(year, time.year);
+  TEST_ASSERT_EQUAL_UINT8(month, time.month);
+  TEST_ASSERT_EQUAL_UINT8(day, time.day);
+  TEST_ASSERT_EQUAL_UINT8(hour, time.hour);
+  TEST_ASSERT_EQUAL_UINT8(minute, time.minute);
+  TEST_ASSERT_EQUAL_UINT8(second, time.second);
+  TEST_ASSERT_EQUAL_UINT16(millisecond, time.millisecond);
+}
+
+void setUp()
+{
+  parser = new NmeaParser();
+}
+
+void tearDown()
+{
+  delete parser;
+}
+
+// only RMC with a fix and ZDA give a time, all sentences pass the checksum
+void test_replay()
+{
+  TEST_ASSERT_EQUAL(4, feed(recording));
+  TEST_ASSERT_EQUAL_UINT32(7, parser->getSentenceCount());
+  TEST_ASSERT_EQUAL_UINT32(0, parser->getErrorCount());
+  checkTime(2025, 1, 1, 0, 0, 0, 0);
+}
+
+// each time sentence is taken on its own
+void test_replay_times()
+{
+  TEST_ASSERT_EQUAL(1, feed("$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n"));
+  checkTime(2094, 3, 23, 12, 35, 19, 0);
+  TEST_ASSERT_EQUAL(1, feed("$GNRMC,235959.250,A,4807.038,N,01131.000,E,0.0,0.0,311224,,,A*73\r\n"));
+  checkTime(2024, 12, 31, 23, 59, 59, 250);
+  TEST_ASSERT_EQUAL(1, feed("$GPZDA,201530.00,04,07,2002,00,00*60\r\n"));
+  checkTime(2002, 7, 4, 20, 15, 30, 0);
+}
+
+// a wrong checksum is counted and the time is kept
+void test_checksum_mismatch()
+{
+  TEST_ASSERT_EQUAL(1, feed("$GPZDA,201530.00,04,07,2002,00,00*60\r\n"));
+  TEST_ASSERT_EQUAL(0, feed("$GNZDA,000000.00,01,01,2025,00,00*7E\r\n"));
+  TEST_ASSERT_EQUAL_UINT32(1, parser->getSentenceCount());
+  TEST_ASSERT_EQUAL_UINT32(1, parser->getErrorCount());
+  checkTime(2002, 7, 4, 20, 15, 30, 0);
+}
+
+// the hex digits of the checksum may be lowercase
+void test_checksum_lowercase()
+{
+  TEST_ASSERT_EQUAL(1, feed("$GNZDA,000000.00,01,01,2025,00,00*7d\r\n"));
+  TEST_ASSERT_EQUAL(1, feed("$GNRMC,235959.250,A,4807.038,N,01131.000,E,0.0,0.0,311224,,,A*73\r\n"));
+  TEST_ASSERT_EQUAL(0, feed("$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*7g\r\n"));
+  TEST_ASSERT_EQUAL_UINT32(2, parser->getSentenceCount());
+  TEST_ASSERT_EQUAL_UINT32(1, parser->getErrorCount());
+}
+
+// sentences without checksum and too long sentences are errors
+void test_malformed()
+{
+  char longSentence[NMEA_MAX_LENGTH + 8] = "$GPTXT,";
+
+  TEST_ASSERT_EQUAL(0, feed("$GPZDA,201530.00,04,07,2002,00,00\r\n"));
+  memset(longSentence + 7, 'X', NMEA_MAX_LENGTH);
+  TEST_ASSERT_EQUAL(0, feed(longSentence));
+  TEST_ASSERT_EQUAL_UINT32(0, parser->getSentenceCount());
+  TEST_ASSERT_EQUAL_UINT32(2, parser->getErrorCount());
+}
+
+// a valid checksum with an invalid time gives no time
+void test_invalid_time()
+{
+  TEST_ASSERT_EQUAL(0, feed("$GPZDA,250000.00,04,07,2002,00,00*62\r\n"));
+  TEST_ASSERT_EQUAL_UINT32(1, parser->getSentenceCount());
+  TEST_ASSERT_EQUAL_UINT32(0, parser->getErrorCount());
+}
+
+// the recording split at every position into two reads gives the same result
+void test_split_sentences()
+{
+  size_t length = strlen(recording);
+
+  for (size_t split = 1; split < length; split++)
+  {
+    delete parser;
+    parser = new NmeaParser();
+    int count = feed(recording, split);
+    count += feed(recording + split, length - split);
+    TEST_ASSERT_EQUAL(4, count);
+    TEST_ASSERT_EQUAL_UINT32(0, parser->getErrorCount());
+  }
+  checkTime(2025, 1, 1, 0, 0, 0, 0);
+}
+
+// a sentence cut off by the start of the next one is dropped, the next one is parsed
+void test_interrupted_sentence()
+{
+  TEST_ASSERT_EQUAL(1, feed("$GPRMC,123519,A,4807.0$GPZDA,201530.00,04,07,2002,00,00*60\r\n"));
+  TEST_ASSERT_EQUAL_UINT32(1, parser->getSentenceCount());
+  checkTime(2002, 7, 4, 20, 15, 30, 0);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_replay);
+  RUN_TEST(test_replay_times);
+  RUN_TEST(test_checksum_mismatch);
+  RUN_TEST(test_checksum_lowercase);
+  RUN_TEST(test_malformed);
+  RUN_TEST(test_invalid_time);
+  RUN_TEST(test_split_sentences);
+  RUN_TEST(test_interrupted_sentence);
+  return (UNITY_END());
+}
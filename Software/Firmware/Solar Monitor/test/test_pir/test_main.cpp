@@ -0,0 +1,202 @@
+// test_main.cpp
+
+// tests of the PIR presence detection, the simulated sensor output chatters on its edges and stays
+// high while there is motion, covers the debouncing in the interrupt, the interrupt count per minute,
+// the delay before the room becomes vacant and the wakeup from light sleep
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <PIR.hpp>
+
+#define PIN_PIR 35
+#define DELAY 1 // in minutes
+#define DELAY_MS (DELAY * 60000UL)
+#define PROCESS_INTERVAL 10 // in ms, the main loop runs at least this often
+
+static PIR *pir;
+static unsigned long notifications;
+static unsigned long changes; // of the presence state seen by process()
+static bool occupied;
+
+static void onEvent(void *, controller_event event)
+{
+  TEST_ASSERT_TRUE(event == controller_event::pir);
+  notifications++;
+}
+
+// runs the main loop for the given time
+static void run(unsigned long duration)
+{
+  for (unsigned long ms = 0; ms < duration; ms += PROCESS_INTERVAL)
+  {
+    delay(PROCESS_INTERVAL);
+    bool state = pir->process();
+    changes += (state != occupied) ? 1 : 0;
+    occupied = state;
+  }
+}
+
+// sets the sensor output chattering, one level per millisecond, the last level is held
+static void chatter(std::initializer_list<uint8_t> levels)
+{
+  for (uint8_t level : levels)
+  {
+    Native::setPin(PIN_PIR, level);
+    delay(1);
+  }
+}
+
+// returns the time in ms until process() reports the room vacant
+static unsigned long runUntilVacant(unsigned long limit)
+{
+  unsigned long start = millis();
+  while (occupied && (millis() - start < limit))
+  {
+    run(PROCESS_INTERVAL);
+  }
+  return (millis() - start);
+}
+
+void setUp()
+{
+  Native::reset();
+  notifications = 0;
+  changes = 0;
+  occupied = true;
+  pir = new PIR(PIN_PIR, DELAY);
+  pir->begin(onEvent, nullptr);
+  delay(1000);
+}
+
+void tearDown()
+{
+  delete pir;
+}
+
+// a chattering rising edge is one accepted edge, an output held high raises no more interrupts,
+// the count of the interrupts is updated once per minute
+void test_held_high()
+{
+  chatter({HIGH, LOW, HIGH, LOW, HIGH});
+  TEST_ASSERT_EQUAL_UINT32(1, notifications);
+  run(3 * DELAY_MS);
+  TEST_ASSERT_TRUE(occupied);
+  TEST_ASSERT_EQUAL_UINT32(0, changes);
+  TEST_ASSERT_EQUAL_UINT32(NO_DEADLINE, pir->getTimeToTimeout());
+  // the chatter has been in the first minute, the sensor has been quiet since
+  TEST_ASSERT_EQUAL_UINT32(0, pir->getInterruptsPerMinute());
+
+  Native::reset();
+  delete pir;
+  pir = new PIR(PIN_PIR, DELAY);
+  pir->begin(onEvent, nullptr);
+  notifications = 0;
+  delay(1000);
+  chatter({HIGH, LOW, HIGH, LOW, HIGH});
+  run(60000);
+  TEST_ASSERT_EQUAL_UINT32(5, pir->getInterruptsPerMinute());
+  TEST_ASSERT_EQUAL_UINT32(1, notifications);
+}
+
+// the room becomes vacant when the output has been low for the whole delay
+void test_vacant_after_delay()
+{
+  chatter({HIGH, LOW, HIGH});
+  run(5000);
+  unsigned long fall = millis();
+  chatter({LOW, HIGH, LOW});
+  run(PROCESS_INTERVAL);
+  TEST_ASSERT_EQUAL_UINT32(DELAY_MS - (millis() - fall), pir->getTimeToTimeout());
+
+  runUntilVacant(2 * DELAY_MS);
+  TEST_ASSERT_FALSE(occupied);
+  TEST_ASSERT_TRUE(millis() - fall >= DELAY_MS);
+  TEST_ASSERT_TRUE(millis() - fall <= DELAY_MS + PROCESS_INTERVAL);
+  TEST_ASSERT_EQUAL_UINT32(1, changes);
+  TEST_ASSERT_EQUAL_UINT32(NO_DEADLINE, pir->getTimeToTimeout());
+}
+
+// motion during the delay starts the delay again, motion in a vacant room makes it occupied at once
+void test_hysteresis()
+{
+  chatter({HIGH, LOW});
+  run(DELAY_MS / 2);
+  // a short pulse, the edges are further apart than the debounce time
+  Native::setPin(PIN_PIR, HIGH);
+  delay(PIR_DEBOUNCE);
+  Native::setPin(PIN_PIR, LOW);
+  unsigned long fall = millis();
+  runUntilVacant(2 * DELAY_MS);
+  TEST_ASSERT_FALSE(occupied);
+  TEST_ASSERT_TRUE(millis() - fall >= DELAY_MS);
+  TEST_ASSERT_TRUE(millis() - fall <= DELAY_MS + PROCESS_INTERVAL);
+
+  // stays vacant without motion
+  run(10 * DELAY_MS);
+  TEST_ASSERT_FALSE(occupied);
+  TEST_ASSERT_EQUAL_UINT32(1, changes);
+
+  // the accepted edge is seen by the next pass even if the output is low again
+  Native::setPin(PIN_PIR, HIGH);
+  Native::setPin(PIN_PIR, LOW);
+  TEST_ASSERT_TRUE(pir->process());
+}
+
+// an edge dropped by the debouncing does not keep the room occupied, the level is read again,
+// and the next edge is not lost
+void test_dropped_edge()
+{
+  // the falling edge comes too early and is dropped
+  chatter({HIGH, LOW});
+  TEST_ASSERT_EQUAL_UINT32(1, notifications);
+  TEST_ASSERT_EQUAL_UINT8(LOW, digitalRead(PIN_PIR));
+  unsigned long rise = millis() - 2;
+  runUntilVacant(2 * DELAY_MS);
+  TEST_ASSERT_FALSE(occupied);
+  TEST_ASSERT_TRUE(millis() - rise <= DELAY_MS + PROCESS_INTERVAL);
+
+  Native::setPin(PIN_PIR, HIGH);
+  TEST_ASSERT_EQUAL_UINT32(2, notifications);
+}
+
+// with the tubes off a high output wakes up the CPU once, then the edge interrupt is back
+void test_wakeup()
+{
+  chatter({HIGH, LOW});
+  runUntilVacant(2 * DELAY_MS);
+  TEST_ASSERT_FALSE(occupied);
+  unsigned long count = notifications;
+
+  pir->enableWakeup();
+  TEST_ASSERT_TRUE(Native::wakeupPins[PIN_PIR]);
+  TEST_ASSERT_EQUAL_UINT8(ONHIGH, Native::interruptModes[PIN_PIR]);
+  Native::setPin(PIN_PIR, HIGH);
+  TEST_ASSERT_FALSE(Native::wakeupPins[PIN_PIR]);
+  TEST_ASSERT_EQUAL_UINT8(CHANGE, Native::interruptModes[PIN_PIR]);
+  TEST_ASSERT_EQUAL_UINT32(count + 1, notifications);
+  // the held level does not fire again
+  Native::setPin(PIN_PIR, HIGH);
+  TEST_ASSERT_EQUAL_UINT32(count + 1, notifications);
+  run(PROCESS_INTERVAL);
+  TEST_ASSERT_TRUE(occupied);
+
+  // disabling a wakeup that did not happen restores the edge interrupt as well
+  pir->enableWakeup();
+  pir->disableWakeup();
+  TEST_ASSERT_FALSE(Native::wakeupPins[PIN_PIR]);
+  TEST_ASSERT_EQUAL_UINT8(CHANGE, Native::interruptModes[PIN_PIR]);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_held_high);
+  RUN_TEST(test_vacant_after_delay);
+  RUN_TEST(test_hysteresis);
+  RUN_TEST(test_dropped_edge);
+  RUN_TEST(test_wakeup);
+  return (UNITY_END());
+}
@@ -0,0 +1,221 @@
+// test_main.cpp
+
+// tests of the scheduler with simulated time, periods over a simulated day, the order of due tasks,
+// enabling and rescheduling from a running task and the run time and deadline statistics
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <Scheduler.hpp>
+
+#define DAY (24UL * 60 * 60 * 1000) // in ms
+#define ORDER_LENGTH 16
+
+static Scheduler *scheduler;
+static unsigned long counts[SCHEDULER_MAX_TASKS];
+static uint8_t order[ORDER_LENGTH];
+static uint8_t orderLength;
+static unsigned long runTime; // in us, simulated run time of each call
+
+static void job(void *arg)
+{
+  uint8_t id = (uint8_t)(intptr_t)arg;
+  counts[id]++;
+  if (orderLength < ORDER_LENGTH)
+  {
+    order[orderLength++] = id;
+  }
+  delayMicroseconds(runTime);
+}
+
+// replaces each regular run by a run after 7 ms
+static void rescheduling(void *arg)
+{
+  job(arg);
+  scheduler->schedule((uint8_t)(intptr_t)arg, 7);
+}
+
+// runs once and stops
+static void oneShot(void *arg)
+{
+  job(arg);
+  scheduler->disable((uint8_t)(intptr_t)arg);
+}
+
+static uint8_t add(const char *name, SCHEDULER_CALLBACK callback, unsigned long interval, bool enabled = true)
+{
+  uint8_t id = scheduler->getTaskCount();
+  return (scheduler->add(name, callback, (void *)(intptr_t)id, interval, 1000, enabled));
+}
+
+// sleeps until the next deadline like the main loop and runs the due tasks, returns the number of runs
+static unsigned long runUntil(unsigned long end)
+{
+  unsigned long runs = 0;
+
+  while (millis() < end)
+  {
+    runs += scheduler->run();
+    unsigned long wait = scheduler->getTimeToNextDeadline();
+    Native::advance(((wait == 0) || (wait == NO_DEADLINE)) ? 1 : min(wait, end - millis()));
+  }
+  return (runs);
+}
+
+void setUp()
+{
+  Native::reset();
+  scheduler = new Scheduler();
+  memset(counts, 0, sizeof(counts));
+  orderLength = 0;
+  runTime = 0;
+}
+
+void tearDown()
+{
+  delete scheduler;
+}
+
+// every task keeps its period over a day
+void test_periods()
+{
+  static const unsigned long intervals[] = {40, 100, 250, 1000, 10000, 60000, 300000, 3600000};
+  const int taskCount = sizeof(intervals) / sizeof(intervals[0]);
+
+  for (int i = 0; i < taskCount; i++)
+  {
+    add("periodic", job, intervals[i]);
+  }
+  uint8_t self = add("rescheduling", rescheduling, 0);
+  runUntil(DAY + 1);
+  for (int i = 0; i < taskCount; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(DAY / intervals[i], counts[i]);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler->getTask(i)->misses);
+  }
+  TEST_ASSERT_EQUAL_UINT32(DAY / 7 + 1, counts[self]);
+}
+
+// due tasks run in the order of their deadlines, registration order on equal deadlines
+void test_order()
+{
+  add("a", job, 30);
+  add("b", job, 10);
+  add("c", job, 30);
+  add("d", job, 20);
+  Native::advance(30);
+  TEST_ASSERT_EQUAL_UINT8(4, scheduler->run());
+  TEST_ASSERT_EQUAL_UINT8(4, orderLength);
+  TEST_ASSERT_EQUAL_UINT8(1, order[0]);
+  TEST_ASSERT_EQUAL_UINT8(3, order[1]);
+  TEST_ASSERT_EQUAL_UINT8(0, order[2]);
+  TEST_ASSERT_EQUAL_UINT8(2, order[3]);
+}
+
+// a task that is due at once again runs only once per call
+void test_once_per_pass()
+{
+  uint8_t id = add("busy", job, 0);
+
+  Native::advance(1);
+  TEST_ASSERT_EQUAL_UINT8(1, scheduler->run());
+  TEST_ASSERT_EQUAL_UINT8(1, scheduler->run());
+  TEST_ASSERT_EQUAL_UINT32(2, counts[id]);
+}
+
+// a disabled task does not run until it is enabled or triggered
+void test_enable_disable()
+{
+  uint8_t id = add("task", job, 100, false);
+
+  TEST_ASSERT_FALSE(scheduler->isEnabled(id));
+  TEST_ASSERT_EQUAL_UINT32(NO_DEADLINE, scheduler->getTimeToNextDeadline());
+  runUntil(1000);
+  TEST_ASSERT_EQUAL_UINT32(0, counts[id]);
+
+  scheduler->enable(id, 50);
+  TEST_ASSERT_EQUAL_UINT32(50, scheduler->getTimeToNextDeadline());
+  runUntil(1000 + 50 + 1);
+  TEST_ASSERT_EQUAL_UINT32(1, counts[id]);
+
+  scheduler->disable(id);
+  runUntil(2000);
+  TEST_ASSERT_EQUAL_UINT32(1, counts[id]);
+
+  scheduler->trigger(id);
+  TEST_ASSERT_TRUE(scheduler->isEnabled(id));
+  TEST_ASSERT_EQUAL_UINT8(1, scheduler->run());
+  TEST_ASSERT_EQUAL_UINT32(100, scheduler->getTimeToNextDeadline());
+}
+
+// a task can stop itself, the other tasks keep running
+void test_disable_while_running()
+{
+  uint8_t once = add("once", oneShot, 10);
+  uint8_t other = add("other", job, 10);
+
+  runUntil(101);
+  TEST_ASSERT_EQUAL_UINT32(1, counts[once]);
+  TEST_ASSERT_EQUAL_UINT32(10, counts[other]);
+  TEST_ASSERT_FALSE(scheduler->isEnabled(once));
+}
+
+// a new interval applies from the next run
+void test_set_interval()
+{
+  uint8_t id = add("task", job, 100);
+
+  runUntil(101);
+  scheduler->setInterval(id, 10);
+  TEST_ASSERT_EQUAL_UINT32(99, scheduler->getTimeToNextDeadline());
+  runUntil(301);
+  TEST_ASSERT_EQUAL_UINT32(2 + 10, counts[id]);
+}
+
+// late starts and runs over the budget are counted, a late task does not catch up
+void test_statistics()
+{
+  uint8_t id = add("task", job, 100);
+
+  runTime = 1500;
+  Native::advance(350);
+  TEST_ASSERT_EQUAL_UINT8(1, scheduler->run());
+  TEST_ASSERT_EQUAL_UINT8(0, scheduler->run());
+  const SCHEDULER_TASK *task = scheduler->getTask(id);
+  TEST_ASSERT_EQUAL_UINT32(1, task->misses);
+  TEST_ASSERT_EQUAL_UINT32(250, task->maxLateness);
+  TEST_ASSERT_EQUAL_UINT32(1, task->overruns);
+  TEST_ASSERT_EQUAL_UINT32(1500, task->maxRunTime);
+  TEST_ASSERT_EQUAL_UINT32(100, scheduler->getTimeToNextDeadline());
+
+  scheduler->resetStatistics();
+  TEST_ASSERT_EQUAL_UINT32(0, task->runCount);
+  TEST_ASSERT_EQUAL_UINT32(0, task->misses);
+}
+
+// no more tasks than the table holds
+void test_task_limit()
+{
+  for (int i = 0; i < SCHEDULER_MAX_TASKS; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(i, add("task", job, 100));
+  }
+  TEST_ASSERT_EQUAL_UINT8(SCHEDULER_NO_TASK, add("task", job, 100));
+  TEST_ASSERT_NULL(scheduler->getTask(SCHEDULER_MAX_TASKS));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_periods);
+  RUN_TEST(test_order);
+  RUN_TEST(test_once_per_pass);
+  RUN_TEST(test_enable_disable);
+  RUN_TEST(test_disable_while_running);
+  RUN_TEST(test_set_interval);
+  RUN_TEST(test_statistics);
+  RUN_TEST(test_task_limit);
+  return (UNITY_END());
+}
@@ -0,0 +1,312 @@
+// test_main.cpp
+
+// tests of the signal filter, the sliding median against a sorted copy of the window, outlier
+// rejection, smoothing, deadband, values rounded to zero and the start over after a gap,
+// benchmarks the default chain on a synthetic cloudy day, the changes of the tubes per hour and the lag
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include <Settings.h>
+#include <Helper.hpp>
+#include <SignalFilter.hpp>
+
+#define INTERVAL 10000         // in ms, between two values
+#define MAX_GAP (3 * INTERVAL) // in ms
+
+#define TRACE_INTERVAL (INVERTER_POLLINGINTERVAL * 1000) // in ms
+#define TRACE_HOURS 12                                   // of daylight
+#define TRACE_LENGTH (TRACE_HOURS * 3600000 / TRACE_INTERVAL)
+#define MAX_LAG 12 // in samples, the shifts tried to find the lag
+
+// changes of the tubes per hour with the default chain, in percent of the unfiltered changes,
+// and the lag it adds
+#define MAX_CHANGES 60 // in percent
+#define MAX_ADDED_LAG (2 * TRACE_INTERVAL / 1000) // in s
+
+typedef struct
+{
+  std::vector<double> solar;
+  std::vector<double> battery;
+  std::vector<double> grid;
+} TRACE;
+
+static SignalFilter *filter;
+static unsigned long timestamp; // in ms
+
+// adds a value one interval after the last one
+static double add(double value, const FILTER_SETTINGS &settings)
+{
+  timestamp += INTERVAL;
+  return (filter->add(value, settings, timestamp, MAX_GAP));
+}
+
+// pseudo random numbers independent of the standard library, uniform in 0..1
+static double uniform(uint32_t &seed)
+{
+  seed = seed * 1103515245 + 12345;
+  return (((seed >> 8) & 0xffffff) / (double)0x1000000);
+}
+
+// pseudo random numbers of the standard normal distribution, Box-Muller
+static double normal(uint32_t &seed)
+{
+  double u = max(uniform(seed), 1e-9);
+  return (sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * uniform(seed)));
+}
+
+// daylight with clouds passing every 1.5 minutes on average, their edges take about 15 s,
+// appliances switched on now and then, the battery follows the surplus one sample late limited
+// to 3 kW and the grid takes the rest, a single bad reading of the grid now and then,
+// powers below 10 W are reported as zero like by the inverter
+static TRACE makeCloudyDay()
+{
+  TRACE trace;
+  uint32_t seed = 7;
+  double dt = TRACE_INTERVAL / 1000.0;
+  double cloud = 1;
+  double target = 1;
+  double soc = 30;
+  double appliance = 0;
+  int applianceLeft = 0;
+  double battery = 0;
+
+  for (int i = 0; i < TRACE_LENGTH; i++)
+  {
+    double daytime = i / (double)TRACE_LENGTH;
+    if (uniform(seed) < dt / 90.0)
+    {
+      target = (uniform(seed) < 0.5) ? 0.25 + 0.25 * uniform(seed) : 0.9 + 0.1 * uniform(seed);
+    }
+    cloud += (target - cloud) * 0.35;
+    double solar = max(0.0, 6000 * sin(M_PI * daytime) * cloud * (1 + 0.02 * normal(seed)) + 8 * normal(seed));
+    if ((applianceLeft == 0) && (uniform(seed) < dt / 1800))
+    {
+      appliance = 1000 + 1500 * uniform(seed);
+      applianceLeft = 12 + (int)(60 * uniform(seed));
+    }
+    if ((applianceLeft > 0) && (--applianceLeft == 0))
+    {
+      appliance = 0;
+    }
+    // base load, compressor and fridge
+    double load = 400 + appliance + 25 * normal(seed) + ((uniform(seed) < 0.05) ? 150 * uniform(seed) : 0);
+    double wanted = constrain(load - solar, -3000.0, 3000.0);
+    if (((soc >= 100) && (wanted < 0)) || ((soc <= 5) && (wanted > 0)))
+    {
+      wanted = 0;
+    }
+    double grid = load - solar - battery;
+    battery += (wanted - battery) * 0.6;
+    soc = constrain(soc - battery * dt / 3600 / 100, 0.0, 100.0);
+    if (uniform(seed) < 0.002)
+    {
+      grid += ((uniform(seed) < 0.5) ? -1 : 1) * 2500;
+    }
+    trace.solar.push_back((solar >= 10) ? solar : 0);
+    trace.battery.push_back((abs(battery) >= 10) ? battery : 0);
+    trace.grid.push_back((abs(grid) >= 10) ? grid : 0);
+  }
+  return (trace);
+}
+
+// filters the values, returns the changes of the tubes per hour and the lag in s, the shift of the
+// values which fits the output best
+static void benchmark(const std::vector<double> &values, const FILTER_SETTINGS &settings, double *changes, double *lag)
+{
+  SignalFilter signalFilter;
+  std::vector<double> output;
+  DISPLAY_VALUE shown;
+  DISPLAY_VALUE last;
+  unsigned long count = 0;
+
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    output.push_back(signalFilter.add(values[i], settings, i * TRACE_INTERVAL, 3 * TRACE_INTERVAL));
+    memset(&shown, 0, sizeof(shown));
+    Helper::convertDoubleToDisplayValue(output[i], shown);
+    if ((i > 0) && (memcmp(&shown, &last, sizeof(shown)) != 0))
+    {
+      count++;
+    }
+    last = shown;
+  }
+  *changes = count / (double)TRACE_HOURS;
+
+  double bestError = INFINITY;
+  for (int shift = 0; shift <= MAX_LAG; shift++)
+  {
+    double error = 0;
+    for (size_t i = MAX_LAG; i < values.size(); i++)
+    {
+      error += abs(output[i] - values[i - shift]);
+    }
+    if (error < bestError)
+    {
+      bestError = error;
+      *lag = shift * TRACE_INTERVAL / 1000.0;
+    }
+  }
+}
+
+void setUp()
+{
+  filter = new SignalFilter();
+  timestamp = 0;
+}
+
+void tearDown()
+{
+  delete filter;
+}
+
+// the output is the median of the last values, compared with a sorted copy of the window
+void test_median()
+{
+  static const uint16_t windows[] = {1, 3, 5};
+
+  for (uint16_t window : windows)
+  {
+    FILTER_SETTINGS settings = {window, 0, 100, 0};
+    double values[FILTER_MAX_WINDOW];
+    uint32_t seed = 12345;
+
+    delete filter;
+    filter = new SignalFilter();
+    for (int i = 0; i < 1000; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      double value = (double)((seed >> 16) % 2000) + 1;
+      double output = add(value, settings);
+      if (i == 0)
+      {
+        // the window starts filled with the first value
+        std::fill(values, values + window, value);
+      }
+      values[i % window] = value;
+      std::vector<double> sorted(values, values + window);
+      std::sort(sorted.begin(), sorted.end());
+      TEST_ASSERT_EQUAL_DOUBLE(sorted[window / 2], output);
+    }
+  }
+}
+
+// a spike is ignored up to the limit of outliers in a row, a lasting jump is then taken
+void test_outlier()
+{
+  FILTER_SETTINGS settings = {1, 50, 100, 0};
+
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(100, settings));
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(900, settings));
+  TEST_ASSERT_EQUAL_DOUBLE(120, add(120, settings));
+  for (int i = 0; i < FILTER_MAX_REJECTS; i++)
+  {
+    TEST_ASSERT_EQUAL_DOUBLE(120, add(900, settings));
+  }
+  TEST_ASSERT_EQUAL_DOUBLE(900, add(900, settings));
+  TEST_ASSERT_EQUAL_UINT32(1 + FILTER_MAX_REJECTS, filter->getRejected());
+}
+
+// a new value is weighted by the smoothing percentage
+void test_smoothing()
+{
+  FILTER_SETTINGS settings = {1, 0, 50, 0};
+
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(100, settings));
+  TEST_ASSERT_EQUAL_DOUBLE(150, add(200, settings));
+  TEST_ASSERT_EQUAL_DOUBLE(175, add(200, settings));
+}
+
+// small changes are held back until they add up to the deadband, zero is shown at once
+void test_deadband()
+{
+  FILTER_SETTINGS settings = {1, 0, 100, 20};
+
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(100, settings));
+  unsigned long changes = filter->getChanges();
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(110, settings));
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(85, settings));
+  TEST_ASSERT_EQUAL_DOUBLE(125, add(125, settings));
+  TEST_ASSERT_EQUAL_UINT32(changes + 1, filter->getChanges());
+
+  settings.smoothing = 10;
+  TEST_ASSERT_EQUAL_DOUBLE(0, add(0, settings));
+  TEST_ASSERT_EQUAL_DOUBLE(0, add(5, settings));
+}
+
+// after a gap or with another window the filter starts over with the new value
+void test_gap_reset()
+{
+  FILTER_SETTINGS settings = {5, 50, 10, 30};
+
+  filter->setOutput(42);
+  TEST_ASSERT_EQUAL_DOUBLE(42, filter->getOutput());
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(100, settings));
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(2000, settings));
+
+  // a gap just within the limit keeps the filter
+  timestamp += MAX_GAP - INTERVAL;
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(2000, settings));
+
+  // a longer gap, e.g. with the display off, shows the new value at once
+  timestamp += MAX_GAP;
+  TEST_ASSERT_EQUAL_DOUBLE(2000, add(2000, settings));
+  TEST_ASSERT_EQUAL_DOUBLE(2000, add(5000, settings));
+
+  // the window is changed
+  settings.window = 3;
+  TEST_ASSERT_EQUAL_DOUBLE(5000, add(5000, settings));
+
+  // the timestamp wraps around
+  delete filter;
+  filter = new SignalFilter();
+  timestamp = ULONG_MAX - INTERVAL - INTERVAL / 2;
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(100, settings));
+  TEST_ASSERT_EQUAL_DOUBLE(100, add(2000, settings));
+}
+
+// the default chain for powers about halves the changes of the tubes on a cloudy day and adds
+// a lag of about two polling intervals
+void test_cloudy_day()
+{
+  FILTER_SETTINGS unfiltered = {1, 0, 100, 0};
+  FILTER_SETTINGS defaults = {FILTER_POWER_WINDOW, FILTER_POWER_OUTLIER, FILTER_POWER_SMOOTHING, FILTER_POWER_DEADBAND};
+  TRACE trace = makeCloudyDay();
+  const char *names[] = {"Solar", "Battery", "Grid"};
+  const std::vector<double> *quantities[] = {&trace.solar, &trace.battery, &trace.grid};
+  char message[128];
+
+  for (int i = 0; i < 3; i++)
+  {
+    double changes;
+    double lag;
+    double filteredChanges;
+    double filteredLag;
+
+    benchmark(*quantities[i], unfiltered, &changes, &lag);
+    benchmark(*quantities[i], defaults, &filteredChanges, &filteredLag);
+    snprintf(message, sizeof(message), "%s: %.0f changes/h unfiltered, %.0f filtered, %.0f s added lag",
+             names[i], changes, filteredChanges, filteredLag - lag);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_DOUBLE(0, lag);
+    TEST_ASSERT_TRUE(filteredChanges <= changes * MAX_CHANGES / 100);
+    TEST_ASSERT_TRUE(filteredLag - lag <= MAX_ADDED_LAG);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_median);
+  RUN_TEST(test_outlier);
+  RUN_TEST(test_smoothing);
+  RUN_TEST(test_deadband);
+  RUN_TEST(test_gap_reset);
+  RUN_TEST(test_cloudy_day);
+  return (UNITY_END());
+}
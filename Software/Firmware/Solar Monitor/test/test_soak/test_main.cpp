@@ -0,0 +1,180 @@
+// test_main.cpp
+
+// soak test of the whole controller in simulated time, two days of polling, formatting and display
+// with the room occupied by day and vacant at night, the memory of the firmware is taken from the
+// simulated heap and every operator new is reported to the heap guard like in main.cpp, so an allocation
+// after initialization stops the test, reports the free heap, its minimum and the largest block
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <Controller.hpp>
+#include <NativeInverter.h>
+
+#define SOAK_TIME (48 * 3600000UL) // in ms
+#define HOUR (3600000UL)           // in ms
+#define OCCUPIED_FROM 7            // hour of the day
+#define OCCUPIED_UNTIL 23          // hour of the day
+
+static Controller *controller;
+static bool heapModel; // the firmware takes its memory from the simulated heap
+
+// takes the memory from the simulated heap while the firmware runs, the doubles of hardware with its
+// own memory and the test take theirs from the host
+void *operator new(size_t size)
+{
+  if (!heapModel || (Native::hardwareCalls > 0))
+  {
+    void *ptr = malloc(size);
+    if (ptr == nullptr)
+    {
+      abort();
+    }
+    return (ptr);
+  }
+  HeapGuard::get().onAllocation(size);
+  void *ptr = Native::allocateHeap(size);
+  if (ptr == nullptr)
+  {
+    abort();
+  }
+  return (ptr);
+}
+
+void *operator new[](size_t size)
+{
+  return (operator new(size));
+}
+
+void operator delete(void *ptr) noexcept
+{
+  if (Native::isHeapMemory(ptr))
+  {
+    Native::releaseHeap(ptr);
+  }
+  else
+  {
+    free(ptr);
+  }
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+  operator delete(ptr);
+}
+
+// a sunny day, the battery charges by day and supplies the load at night
+static INVERTER_VALUES getValues()
+{
+  double hour = fmod(millis() / (double)HOUR, 24.0);
+  double pv = max(0.0, 4000.0 * sin(M_PI * (hour - 6.0) / 12.0));
+  double load = 600.0 + 300.0 * sin(millis() / 60000.0);
+  double akku = (pv > load) ? -min(pv - load, 2500.0) : min(load - pv, 1500.0);
+  double soc = 50.0 + 40.0 * sin(M_PI * (hour - 9.0) / 12.0);
+  return (INVERTER_VALUES{soc, akku, load - pv - akku, -load, pv, 100.0, (pv > 0) ? 60.0 : 0.0});
+}
+
+// returns if the room is occupied at the time
+static bool isOccupied()
+{
+  unsigned long hour = (millis() / HOUR) % 24;
+  return ((hour >= OCCUPIED_FROM) && (hour < OCCUPIED_UNTIL));
+}
+
+// runs the main loop like loop() with the heap guard checking, returns the number of passes
+static unsigned long run(unsigned long duration)
+{
+  unsigned long passes = 0;
+  unsigned long end = millis() + duration;
+
+  while (millis() < end)
+  {
+    Native::setPin(PIN_PIR, isOccupied() ? HIGH : LOW);
+    TEST_ASSERT_TRUE(controller->process());
+    HeapGuard::get().check();
+    controller->waitForEvent();
+    passes++;
+  }
+  return (passes);
+}
+
+void setUp()
+{
+  char settings[] = "inverter.address=" NATIVE_INVERTER_ADDRESS;
+
+  Native::reset();
+  Ethernet.reset();
+  Wire.reset();
+  Wire.light = []()
+  { return (150.0f); };
+  Native::ds18b20Present = true;
+  Native::ds18b20Temperature = 30.0;
+  Preferences::getStore().clear();
+  Config::get().begin();
+  Config::get().update(settings);
+  Config::get().apply();
+  Native::addInverter(getValues);
+  Native::setPin(PIN_BUTTON1, HIGH);
+  // a static object in the firmware
+  controller = new Controller();
+}
+
+void tearDown()
+{
+  heapModel = false;
+  delete controller;
+}
+
+// the heap is sealed with the network, from then on nothing is allocated, the free heap does not shrink
+// and the largest block stays
+void test_soak()
+{
+  char message[160];
+
+  heapModel = true;
+  TEST_ASSERT_EQUAL(ERR_SUCCESS, controller->begin());
+  Native::advance(HOUR * OCCUPIED_FROM);
+  while (!HeapGuard::get().isSealed())
+  {
+    run(1);
+  }
+  size_t sealedFree = HeapGuard::get().getFreeHeap();
+  size_t sealedBlock = HeapGuard::get().getLargestFreeBlock();
+  snprintf(message, sizeof(message), "Sealed: %u bytes free, largest block %u bytes, %u bytes used by the firmware",
+           (unsigned int)sealedFree, (unsigned int)sealedBlock, (unsigned int)(NATIVE_HEAP_SIZE - sealedFree));
+  TEST_MESSAGE(message);
+
+  unsigned long requests = Ethernet.services.begin()->second.requests;
+  unsigned long passes = run(SOAK_TIME);
+  requests = Ethernet.services.begin()->second.requests - requests;
+  size_t freeHeap = HeapGuard::get().getFreeHeap();
+  size_t minFreeHeap = HeapGuard::get().getMinFreeHeap();
+  size_t largestBlock = HeapGuard::get().getLargestFreeBlock();
+  snprintf(message, sizeof(message), "48 h: %lu passes, %lu polls, %u bytes free, min %u, largest block %u bytes",
+           passes, requests, (unsigned int)freeHeap, (unsigned int)minFreeHeap, (unsigned int)largestBlock);
+  TEST_MESSAGE(message);
+
+  TEST_ASSERT_TRUE(requests > SOAK_TIME / 1000 / INVERTER_POLLINGINTERVAL / 2);
+  TEST_ASSERT_TRUE(HeapGuard::get().isSealed());
+  TEST_ASSERT_TRUE(freeHeap >= sealedFree);
+  TEST_ASSERT_TRUE(largestBlock >= sealedBlock);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_soak);
+  return (UNITY_END());
+}
@@ -0,0 +1,257 @@
+// test_main.cpp
+
+// golden frame tests of the display chain, the frames of the displays are shifted out on the
+// simulated pins and decoded by the virtual display like on the real shift register chain,
+// the frames of a digit transition are also written as image to virtual_display.pgm
+
+// Copyright (C) 2024 highvoltglow
+// Licensed under the MIT License
+
+#include <Arduino.h>
+#include <unity.h>
+#include <Display.hpp>
+#include <VirtualDisplay.hpp>
+#include <Helper.hpp>
+
+// pins of the controller board
+#define PIN_BLANK 13
+#define PIN_DATA 4
+#define PIN_STORE 16
+#define PIN_SHIFT 17
+#define PIN_LEDCTL 14
+
+#define CHAIN_LENGTH 5
+
+// image of the frames, one row of cells per frame and one cell per register
+#define IMAGE_PATH "virtual_display.pgm"
+#define IMAGE_CELL 4
+#define IMAGE_GAP 4
+
+static Display *displays[CHAIN_LENGTH];
+static VirtualDisplay *virtualDisplay;
+
+// the displays of the default layout
+static void createDisplays()
+{
+  static const display_type types[CHAIN_LENGTH] = {display_type::solar_power, display_type::battery_power,
+                                                   display_type::grid_power, display_type::load_power,
+                                                   display_type::battery_charge};
+  for (int i = 0; i < CHAIN_LENGTH; i++)
+  {
+    value_type valueType = (types[i] == display_type::battery_charge) ? value_type::battery_charge : value_type::watts;
+    displays[i] = new Display(types[i], valueType, (i == CHAIN_LENGTH - 1),
+                              PIN_DATA, PIN_STORE, PIN_SHIFT, PIN_BLANK, PIN_LEDCTL);
+  }
+}
+
+// decodes the pins like the shift registers, the data bit is taken on the shift commit
+static void onWrite(uint8_t pin, uint8_t level)
+{
+  if ((pin == PIN_SHIFT) && (level == SHIFT_COMMIT))
+  {
+    virtualDisplay->shiftBit(digitalRead(PIN_DATA));
+  }
+  else if (pin == PIN_STORE)
+  {
+    virtualDisplay->store(level);
+  }
+}
+
+// sets the value of a display like the controller
+static void setValue(int displayNumber, double value, bool overallStatus = false)
+{
+  DISPLAY_VALUE displayValue = {0};
+
+  displays[displayNumber]->clear();
+  Helper::convertDoubleToDisplayValue(value, displayValue, displays[displayNumber]->getValueType() != value_type::watts);
+  if (displays[displayNumber]->hasOverallStatus())
+  {
+    displayValue.overallStatusPlusFlag = overallStatus;
+    displayValue.overallStatusMinusFlag = !overallStatus;
+  }
+  displays[displayNumber]->setValues(displayValue);
+}
+
+// shifts the frames of all displays and stores them, the first display is shifted first
+static void update()
+{
+  digitalWrite(PIN_STORE, LOW);
+  for (int i = 0; i < CHAIN_LENGTH; i++)
+  {
+    displays[i]->setRegisters();
+  }
+  digitalWrite(PIN_STORE, HIGH);
+}
+
+// shifts a step of the prepared transitions of all displays and stores it
+static void updateStep(uint8_t step)
+{
+  digitalWrite(PIN_STORE, LOW);
+  for (int i = 0; i < CHAIN_LENGTH; i++)
+  {
+    displays[i]->setSequenceRegisters(step);
+  }
+  digitalWrite(PIN_STORE, HIGH);
+}
+
+static const char *render(int displayNumber)
+{
+  static char text[VIRTUAL_DISPLAY_BOARD_WIDTH];
+  virtualDisplay->renderFrame(displayNumber, text, sizeof(text));
+  return (text);
+}
+
+// writes frames as binary PGM image, lit registers are white
+static bool writeImage(const char *path, const uint64_t frames[][CHAIN_LENGTH], int frameCount)
+{
+  const int boardWidth = REGISTERCOUNT * IMAGE_CELL;
+  const int width = CHAIN_LENGTH * boardWidth + (CHAIN_LENGTH - 1) * IMAGE_GAP;
+  const int height = frameCount * (IMAGE_CELL + IMAGE_GAP);
+  FILE *file = fopen(path, "wb");
+
+  if (file == nullptr)
+  {
+    return (false);
+  }
+  fprintf(file, "P5\n%d %d\n255\n", width, height);
+  for (int y = 0; y < height; y++)
+  {
+    int frame = y / (IMAGE_CELL + IMAGE_GAP);
+    bool gapRow = (y % (IMAGE_CELL + IMAGE_GAP)) >= IMAGE_CELL;
+    for (int x = 0; x < width; x++)
+    {
+      int board = x / (boardWidth + IMAGE_GAP);
+      int offset = x % (boardWidth + IMAGE_GAP);
+      uint8_t pixel = 0;
+      if (!gapRow && (offset < boardWidth))
+      {
+        bool lit = (frames[frame][board] & REGISTER_BIT(offset / IMAGE_CELL + 1)) != 0;
+        pixel = lit ? 255 : 48;
+      }
+      fputc(pixel, file);
+    }
+  }
+  return (fclose(file) == 0);
+}
+
+void setUp()
+{
+  Native::reset();
+  createDisplays();
+  virtualDisplay = new VirtualDisplay(CHAIN_LENGTH);
+  virtualDisplay->blank(HIGH);
+  Native::onWrite = onWrite;
+}
+
+void tearDown()
+{
+  Native::onWrite = nullptr;
+  for (int i = 0; i < CHAIN_LENGTH; i++)
+  {
+    delete displays[i];
+  }
+  delete virtualDisplay;
+}
+
+// the decoded chain holds the frame built by each display
+void test_chain_matches_frames()
+{
+  static const double values[CHAIN_LENGTH] = {4321, -1500.4, 0, -87.6, 42};
+
+  for (int i = 0; i < CHAIN_LENGTH; i++)
+  {
+    setValue(i, values[i], true);
+  }
+  update();
+  TEST_ASSERT_EQUAL_UINT32(1, virtualDisplay->getFrameCount());
+  TEST_ASSERT_EQUAL_UINT32(CHAIN_LENGTH * REGISTERCOUNT, virtualDisplay->getLastUpdateBitCount());
+  for (int i = 0; i < CHAIN_LENGTH; i++)
+  {
+    TEST_ASSERT_EQUAL_HEX64(displays[i]->buildFrame(), virtualDisplay->getFrame(i));
+  }
+}
+
+// golden frames and their decoded text
+void test_golden_frames()
+{
+  static const double values[CHAIN_LENGTH] = {4321, -1500.4, 0, -87.6, 42};
+  static const uint64_t golden[CHAIN_LENGTH] = {
+      0x0100100104002420ULL, 0x0100100404801008ULL, 0x0000100425000000ULL,
+      0x1000100080001042ULL, 0x0000800488040400ULL};
+  static const char *texts[CHAIN_LENGTH] = {
+      "+  4.32 k  W ", "-  1.50 k  W ", "   0.00    W ",
+      "-  87.6    W ", "%  42.0    + "};
+
+  for (int i = 0; i < CHAIN_LENGTH; i++)
+  {
+    setValue(i, values[i], true);
+  }
+  update();
+  for (int i = 0; i < CHAIN_LENGTH; i++)
+  {
+    TEST_ASSERT_EQUAL_HEX64(golden[i], virtualDisplay->getFrame(i));
+    TEST_ASSERT_EQUAL_STRING(texts[i], render(i));
+  }
+}
+
+// an error shows only the F sign, a cleared display nothing
+void test_error_and_clear()
+{
+  setValue(0, 1e7);
+  displays[1]->clear();
+  update();
+  TEST_ASSERT_EQUAL_STRING("          F ", render(0));
+  TEST_ASSERT_EQUAL_HEX64(0, virtualDisplay->getFrame(1));
+  virtualDisplay->blank(LOW);
+  TEST_ASSERT_EQUAL_STRING("(blank)        ", render(0));
+}
+
+// changed digits roll forward one number per frame, the last frame shows the new value
+void test_transition_frames()
+{
+  static const char *texts[] = {"+  208    W ", "+  209    W ", "+  200    W ", "+  201    W ",
+                                "+  202    W ", "+  203    W ", "+  204    W "};
+  static const char *otherTexts[] = {"+  3.30    W ", "+  3.40    W ", "+  3.40    W ", "+  3.40    W ",
+                                     "+  3.40    W ", "+  3.40    W ", "+  3.40    W "};
+  uint64_t frames[TRANSITION_MAX_FRAMES + 1][CHAIN_LENGTH];
+
+  setValue(0, 197);
+  setValue(1, 3.2);
+  update();
+  for (int i = 0; i < CHAIN_LENGTH; i++)
+  {
+    frames[0][i] = virtualDisplay->getFrame(i);
+  }
+
+  setValue(0, 204);
+  setValue(1, 3.4);
+  uint8_t stepCount = 0;
+  for (int i = 0; i < CHAIN_LENGTH; i++)
+  {
+    stepCount = max(stepCount, displays[i]->prepareTransition());
+  }
+  TEST_ASSERT_EQUAL_UINT8(sizeof(texts) / sizeof(texts[0]), stepCount);
+  for (uint8_t step = 0; step < stepCount; step++)
+  {
+    updateStep(step);
+    TEST_ASSERT_EQUAL_STRING(texts[step], render(0));
+    TEST_ASSERT_EQUAL_STRING(otherTexts[step], render(1));
+    for (int i = 0; i < CHAIN_LENGTH; i++)
+    {
+      frames[step + 1][i] = virtualDisplay->getFrame(i);
+    }
+  }
+  TEST_ASSERT_EQUAL_HEX64(displays[0]->buildFrame(), virtualDisplay->getFrame(0));
+  TEST_ASSERT_EQUAL_HEX64(displays[1]->buildFrame(), virtualDisplay->getFrame(1));
+  TEST_ASSERT_TRUE(writeImage(IMAGE_PATH, frames, stepCount + 1));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_chain_matches_frames);
+  RUN_TEST(test_golden_frames);
+  RUN_TEST(test_error_and_clear);
+  RUN_TEST(test_transition_frames);
+  return (UNITY_END());
+}